@@ -0,0 +1,276 @@
+#ifndef CXL_AIO_POOL_HPP
+#define CXL_AIO_POOL_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <vector>
+#include <immintrin.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Building blocks for asynchronous DAX I/O: a bounded lock-free MPMC ring
+// (Vyukov) used for both submission and completion queues, an SPSC ring
+// whose slots are filled in place (io_uring SQ/CQ), and a pool of copy
+// workers that execute queued memcpy/persist tasks.
+
+namespace cxl_intercept {
+
+inline void futex_wait(std::atomic<uint32_t>* addr, uint32_t expected,
+                       const struct timespec* timeout = nullptr) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAIT_PRIVATE,
+            expected, timeout, nullptr, 0);
+}
+
+inline void futex_wake(std::atomic<uint32_t>* addr, int count) {
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(addr), FUTEX_WAKE_PRIVATE,
+            count, nullptr, nullptr, 0);
+}
+
+// Bounded multi-producer multi-consumer ring; capacity is rounded up to a
+// power of two. Each cell carries a sequence number that tells producers
+// and consumers whether it is free or full for their lap.
+template <typename T>
+class MpmcRing {
+public:
+    explicit MpmcRing(size_t capacity) {
+        size_t cap = 2;
+        while (cap < capacity) cap <<= 1;
+        mask_ = cap - 1;
+        cells_ = new Cell[cap];
+        for (size_t i = 0; i < cap; i++) cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+    ~MpmcRing() { delete[] cells_; }
+    MpmcRing(const MpmcRing&) = delete;
+    MpmcRing& operator=(const MpmcRing&) = delete;
+
+    size_t capacity() const { return mask_ + 1; }
+
+    bool try_push(const T& value) {
+        size_t pos = enqueue_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells_[pos & mask_];
+            size_t seq = cell.seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueue_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.data = value;
+                    cell.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // full
+            } else {
+                pos = enqueue_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool try_pop(T& value) {
+        size_t pos = dequeue_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells_[pos & mask_];
+            size_t seq = cell.seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeue_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    value = cell.data;
+                    cell.seq.store(pos + mask_ + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;  // empty
+            } else {
+                pos = dequeue_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    struct alignas(64) Cell {
+        std::atomic<size_t> seq;
+        T data;
+    };
+
+    Cell* cells_ = nullptr;
+    size_t mask_ = 0;
+    alignas(64) std::atomic<size_t> enqueue_{0};
+    alignas(64) std::atomic<size_t> dequeue_{0};
+};
+
+// Bounded single-producer single-consumer ring; capacity is rounded up to
+// a power of two. Slots are used in place: the producer fills the free
+// slots past the tail and publishes them by moving the tail, the consumer
+// reads the slot at the head and frees it by moving the head. Each side
+// keeps its index and a cached copy of the other's on its own cache line,
+// so the lines only move when the cached copy runs out.
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity) {
+        size_t cap = 2;
+        while (cap < capacity) cap <<= 1;
+        mask_ = static_cast<uint32_t>(cap - 1);
+        slots_ = new T[cap]();
+    }
+    ~SpscRing() { delete[] slots_; }
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    size_t capacity() const { return mask_ + 1; }
+
+    // Producer: the free slot n places past the tail, or nullptr if the
+    // ring has no room for it
+    T* claim(uint32_t n = 0) {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail + n - head_cache_ > mask_) {
+            head_cache_ = head_.load(std::memory_order_acquire);
+            if (tail + n - head_cache_ > mask_) return nullptr;
+        }
+        return &slots_[(tail + n) & mask_];
+    }
+
+    // Producer: hand the next count claimed slots to the consumer
+    void publish(uint32_t count = 1) {
+        tail_.store(tail_.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+    // Consumer: the slot at the head, or nullptr if the ring is empty
+    T* front() {
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_cache_) {
+            tail_cache_ = tail_.load(std::memory_order_acquire);
+            if (head == tail_cache_) return nullptr;
+        }
+        return &slots_[head & mask_];
+    }
+
+    // Consumer: number of filled slots
+    uint32_t ready() {
+        tail_cache_ = tail_.load(std::memory_order_acquire);
+        return tail_cache_ - head_.load(std::memory_order_relaxed);
+    }
+
+    // Consumer: free the slot at the head
+    void pop() { head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    // Tail word, to wait on with a futex or MONITOR/MWAIT until the
+    // producer publishes
+    std::atomic<uint32_t>* tail_word() { return &tail_; }
+
+private:
+    T* slots_ = nullptr;
+    uint32_t mask_ = 0;
+    alignas(64) std::atomic<uint32_t> tail_{0};
+    uint32_t head_cache_ = 0;  // producer's view of head_
+    alignas(64) std::atomic<uint32_t> head_{0};
+    uint32_t tail_cache_ = 0;  // consumer's view of tail_
+};
+
+// Fixed pool of worker threads draining a shared task ring. Workers spin
+// briefly before sleeping on a futex so back-to-back submissions at high
+// queue depth do not pay a wakeup each. An affinity mask keeps the workers
+// on the CPUs next to the memory they copy to and from.
+class CopyWorkerPool {
+public:
+    using TaskFn = void (*)(void* ctx, void* arg);
+
+    explicit CopyWorkerPool(unsigned workers, size_t queue_capacity = 4096,
+                            const cpu_set_t* affinity = nullptr)
+        : queue_(queue_capacity) {
+        for (unsigned i = 0; i < workers; i++) {
+            pthread_t thr;
+            if (pthread_create(&thr, nullptr, &CopyWorkerPool::worker_main, this) == 0) {
+                if (affinity) pthread_setaffinity_np(thr, sizeof(cpu_set_t), affinity);
+                threads_.push_back(thr);
+            }
+        }
+    }
+
+    ~CopyWorkerPool() {
+        stop_.store(true, std::memory_order_release);
+        seq_.fetch_add(1, std::memory_order_release);
+        futex_wake(&seq_, INT32_MAX);
+        for (pthread_t thr : threads_) pthread_join(thr, nullptr);
+    }
+
+    CopyWorkerPool(const CopyWorkerPool&) = delete;
+    CopyWorkerPool& operator=(const CopyWorkerPool&) = delete;
+
+    unsigned workers() const { return static_cast<unsigned>(threads_.size()); }
+
+    // Queue fn(ctx, arg); runs it on the calling thread when there are no
+    // workers or the ring is full
+    void submit(TaskFn fn, void* ctx, void* arg) {
+        if (threads_.empty() || !queue_.try_push(Task{fn, ctx, arg})) {
+            fn(ctx, arg);
+            return;
+        }
+        // Pairs with the sleeper's increment-then-recheck in worker_main
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleepers_.load(std::memory_order_relaxed) > 0) {
+            seq_.fetch_add(1, std::memory_order_release);
+            futex_wake(&seq_, 1);
+        }
+    }
+
+private:
+    struct Task {
+        TaskFn fn;
+        void* ctx;
+        void* arg;
+    };
+
+    static constexpr int kSpinIterations = 2000;
+
+    static void* worker_main(void* arg) {
+        // Leave signal handling to the application's threads
+        sigset_t all;
+        sigfillset(&all);
+        pthread_sigmask(SIG_BLOCK, &all, nullptr);
+
+        auto* self = static_cast<CopyWorkerPool*>(arg);
+        Task task;
+        while (!self->stop_.load(std::memory_order_acquire)) {
+            bool found = false;
+            for (int i = 0; i < kSpinIterations; i++) {
+                if (self->queue_.try_pop(task)) {
+                    found = true;
+                    break;
+                }
+                _mm_pause();
+            }
+            if (found) {
+                task.fn(task.ctx, task.arg);
+                continue;
+            }
+
+            uint32_t seq = self->seq_.load(std::memory_order_acquire);
+            self->sleepers_.fetch_add(1, std::memory_order_seq_cst);
+            if (self->queue_.try_pop(task)) {
+                self->sleepers_.fetch_sub(1, std::memory_order_relaxed);
+                task.fn(task.ctx, task.arg);
+                continue;
+            }
+            if (!self->stop_.load(std::memory_order_acquire)) futex_wait(&self->seq_, seq);
+            self->sleepers_.fetch_sub(1, std::memory_order_relaxed);
+        }
+        while (self->queue_.try_pop(task)) task.fn(task.ctx, task.arg);
+        return nullptr;
+    }
+
+    MpmcRing<Task> queue_;
+    std::vector<pthread_t> threads_;
+    std::atomic<bool> stop_{false};
+    alignas(64) std::atomic<uint32_t> seq_{0};
+    std::atomic<uint32_t> sleepers_{0};
+};
+
+} // namespace cxl_intercept
+
+#endif // CXL_AIO_POOL_HPP
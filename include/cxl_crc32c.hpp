@@ -0,0 +1,140 @@
+#ifndef CXL_CRC32C_HPP
+#define CXL_CRC32C_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <immintrin.h>
+
+// CRC32C (Castagnoli) for the integrity mode (FIO_DAX_VERIFY). The SSE4.2
+// crc32 instruction has a 3-cycle latency but issues every cycle, so the
+// buffer is cut into three lanes checksummed side by side, and the lane
+// CRCs are folded together with one PCLMULQDQ multiply each. CPUs without
+// SSE4.2/PCLMUL fall back to a byte-wise table.
+
+namespace cxl_intercept {
+
+namespace crc32c_detail {
+
+constexpr uint32_t kPoly = 0x82f63b78;  // reflected
+
+// a * b mod P, both reflected (bit 31 is x^0)
+constexpr uint32_t multmodp(uint32_t a, uint32_t b) {
+    uint32_t m = 1u << 31, p = 0;
+    for (;;) {
+        if (a & m) {
+            p ^= b;
+            if ((a & (m - 1)) == 0) break;
+        }
+        m >>= 1;
+        b = b & 1 ? (b >> 1) ^ kPoly : b >> 1;
+    }
+    return p;
+}
+
+// x^e mod P
+constexpr uint32_t xpow(uint64_t e) {
+    uint32_t p = 1u << 31, sq = 1u << 30;
+    for (; e; e >>= 1) {
+        if (e & 1) p = multmodp(sq, p);
+        sq = multmodp(sq, sq);
+    }
+    return p;
+}
+
+// Multiplier that shifts a lane CRC past n bytes: the carry-less product
+// with it, reduced by crc32 of the 64-bit result, is crc * x^(8n) mod P
+// (crc32 of a 64-bit value multiplies by x^32, the product adds one more)
+constexpr uint32_t shift_constant(size_t n) { return xpow(8 * n - 33); }
+
+struct Table {
+    uint32_t v[256] = {};
+    constexpr Table() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) c = c & 1 ? (c >> 1) ^ kPoly : c >> 1;
+            v[i] = c;
+        }
+    }
+};
+inline constexpr Table kTable;
+
+inline uint32_t update_sw(uint32_t crc, const unsigned char* p, size_t n) {
+    while (n--) crc = kTable.v[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    return crc;
+}
+
+// Lane lengths for big and small strides; a 4KB block takes one long and
+// two short strides plus a 256-byte tail
+constexpr size_t kLongLane = 1024;
+constexpr size_t kShortLane = 128;
+inline constexpr uint32_t kLong1 = shift_constant(kLongLane);
+inline constexpr uint32_t kLong2 = shift_constant(2 * kLongLane);
+inline constexpr uint32_t kShort1 = shift_constant(kShortLane);
+inline constexpr uint32_t kShort2 = shift_constant(2 * kShortLane);
+
+__attribute__((target("sse4.2,pclmul")))
+inline uint64_t shift(uint64_t crc, uint32_t k) {
+    __m128i r = _mm_clmulepi64_si128(_mm_cvtsi64_si128(crc), _mm_cvtsi32_si128(k), 0);
+    return _mm_crc32_u64(0, _mm_cvtsi128_si64(r));
+}
+
+__attribute__((target("sse4.2")))
+inline uint64_t load64(const unsigned char* p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+template <size_t Lane>
+__attribute__((target("sse4.2,pclmul")))
+inline uint64_t stride(uint64_t c0, const unsigned char*& p, size_t& n, uint32_t k1, uint32_t k2) {
+    while (n >= 3 * Lane) {
+        uint64_t c1 = 0, c2 = 0;
+        for (size_t i = 0; i < Lane; i += 8) {
+            c0 = _mm_crc32_u64(c0, load64(p + i));
+            c1 = _mm_crc32_u64(c1, load64(p + Lane + i));
+            c2 = _mm_crc32_u64(c2, load64(p + 2 * Lane + i));
+        }
+        c0 = shift(c0, k2) ^ shift(c1, k1) ^ c2;
+        p += 3 * Lane;
+        n -= 3 * Lane;
+    }
+    return c0;
+}
+
+__attribute__((target("sse4.2,pclmul")))
+inline uint32_t update_hw(uint32_t crc, const unsigned char* p, size_t n) {
+    uint64_t c = crc;
+    c = stride<kLongLane>(c, p, n, kLong1, kLong2);
+    c = stride<kShortLane>(c, p, n, kShort1, kShort2);
+    for (; n >= 8; p += 8, n -= 8) c = _mm_crc32_u64(c, load64(p));
+    uint32_t c32 = static_cast<uint32_t>(c);
+    for (; n; p++, n--) c32 = _mm_crc32_u8(c32, *p);
+    return c32;
+}
+
+inline bool have_hw() {
+    static const bool hw = __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("pclmul");
+    return hw;
+}
+
+} // namespace crc32c_detail
+
+// CRC32C of n bytes, continuing from crc (0 to start)
+inline uint32_t crc32c(const void* data, size_t n, uint32_t crc = 0) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    crc = ~crc;
+    crc = crc32c_detail::have_hw() ? crc32c_detail::update_hw(crc, p, n)
+                                   : crc32c_detail::update_sw(crc, p, n);
+    return ~crc;
+}
+
+// Table-driven reference, for testing the accelerated path
+inline uint32_t crc32c_sw(const void* data, size_t n, uint32_t crc = 0) {
+    return ~crc32c_detail::update_sw(~crc, static_cast<const unsigned char*>(data), n);
+}
+
+} // namespace cxl_intercept
+
+#endif // CXL_CRC32C_HPP
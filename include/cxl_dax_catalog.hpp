@@ -0,0 +1,602 @@
+#ifndef CXL_DAX_CATALOG_HPP
+#define CXL_DAX_CATALOG_HPP
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sys/file.h>
+#include <unistd.h>
+
+#include "cxl_persist.hpp"
+#include "cxl_shm_namespace.hpp"
+#include "cxl_zero_map.hpp"
+
+// Persistent pathname -> extent catalog stored at the head of a DAX region.
+//
+// Layout (all offsets from the region base):
+//   [0, 4K)            CatalogHeader
+//   [4K, ...)          open-addressed hash table of CatalogEntry, keyed by path
+//   [..., ...)         chunk allocation bitmap, one bit per chunk
+//   [..., ...)         zero map, two bits per zero block (cxl_zero_map.hpp)
+//   [..., data_offset) chunk maps of sparse files: a slot bitmap, then one
+//                      map per catalog entry
+//   [data_offset, end) file extents, allocated in whole chunks (2MB default)
+//
+// A sparse file has no extent: its entry's offset is kSparseExtent | its
+// map slot, and its chunks are allocated one at a time on first write,
+// anywhere in the region, with the map holding the region chunk of each
+// file chunk (0 for none; chunk 0 is always catalog metadata).
+//
+// Updates are ordered so a crash can leak chunks but never hand the same
+// chunk to two files: bitmap bits are persisted before an entry becomes
+// valid, and an entry is invalidated before its bits are cleared.
+// Mutations are serialized by the region's shared namespace (see
+// cxl_shm_namespace.hpp), which also counts opens across processes so an
+// unlinked file keeps its chunks until its last close; without /dev/shm
+// they fall back to a mutex (threads) and flock() on the device fd.
+
+namespace cxl_intercept {
+
+constexpr char kCatalogMagic[8] = {'C', 'X', 'L', 'C', 'A', 'T', 'L', 'G'};
+constexpr uint32_t kCatalogVersion = 1;
+constexpr uint64_t kDefaultChunkSize = 2ULL << 20;
+constexpr uint64_t kDefaultCatalogEntries = 4096;
+constexpr char kZeroMapMagic[8] = {'C', 'X', 'L', 'Z', 'E', 'R', 'O', '1'};
+constexpr uint64_t kMinZeroBlock = 4096;
+constexpr char kChunkMapMagic[8] = {'C', 'X', 'L', 'S', 'P', 'A', 'R', '1'};
+constexpr uint64_t kDefaultSparseMax = 1ULL << 30;
+constexpr uint64_t kSparseExtent = 1ULL << 63;
+
+struct CatalogHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_size;
+    uint64_t region_size;
+    uint64_t chunk_size;
+    uint64_t num_chunks;
+    uint64_t max_entries;
+    uint64_t entries_offset;
+    uint64_t bitmap_offset;
+    uint64_t data_offset;
+    uint64_t live_entries;
+    // Catalogs formatted before the zero map have no such fields (and
+    // whatever the header page held there), so it is only trusted with
+    // its magic
+    char zero_map_magic[8];
+    uint64_t zero_block;
+    uint64_t zero_map_offset;
+    uint64_t zero_map_used;  // sticky: a block has been marked zero
+    // Likewise the chunk maps
+    char chunk_map_magic[8];
+    uint64_t chunk_map_offset;
+    uint64_t chunk_map_chunks;  // chunks per map: the largest sparse file
+};
+
+enum CatalogEntryState : uint32_t {
+    ENTRY_EMPTY = 0,
+    ENTRY_VALID = 1,
+    ENTRY_DELETED = 2,  // tombstone; keeps probe chains intact
+};
+
+struct CatalogEntry {
+    uint32_t state;
+    uint32_t flags;
+    uint64_t offset;     // extent start, bytes from region base; tagged for sparse files
+    uint64_t length;     // bytes reserved for the file
+    uint64_t size;       // logical file size; a WAL's persisted tail
+    uint64_t path_hash;
+    char path[216];
+};
+static_assert(sizeof(CatalogEntry) == 256, "catalog entries are 256 bytes");
+
+struct DaxExtent {
+    uint64_t offset = 0;
+    uint64_t length = 0;
+    bool created = false;
+    int32_t ns_slot = -1;  // namespace entry counting this open, -1 if none
+    CatalogEntry* entry = nullptr;  // catalog entry of the file, if known
+    uint32_t* chunk_map = nullptr;  // a sparse file's chunk map
+};
+
+// Catalog key for a pathname: relative paths are anchored at the cwd so
+// processes started from different directories agree on the name
+inline std::string catalog_path_key(const char* path) {
+    if (path[0] == '/') return path;
+    char cwd[4096];
+    if (!getcwd(cwd, sizeof(cwd))) return path;
+    std::string key = cwd;
+    if (key.back() != '/') key += '/';
+    return key + path;
+}
+
+class DaxCatalog {
+public:
+    // Attach to (or format) the catalog at the head of [base, base + size).
+    // chunk_size, zero_block (0: about 2^29 blocks at most, at least 4KB)
+    // and sparse_max (0: 1GB) are only used when formatting.
+    bool attach(void* base, size_t size, int lock_fd, cxl_ssd::PersistMode mode,
+                bool force_format, uint64_t chunk_size = kDefaultChunkSize, uint64_t zero_block = 0,
+                uint64_t sparse_max = 0) {
+        base_ = static_cast<char*>(base);
+        size_ = size;
+        lock_fd_ = lock_fd;
+        persist_mode_ = mode;
+
+        LockGuard lock(*this);
+        hdr_ = reinterpret_cast<CatalogHeader*>(base_);
+        bool valid = memcmp(hdr_->magic, kCatalogMagic, sizeof(kCatalogMagic)) == 0 &&
+                     hdr_->version == kCatalogVersion &&
+                     hdr_->entry_size == sizeof(CatalogEntry) &&
+                     hdr_->region_size == size;
+        bool formatted = !valid || force_format;
+        if (formatted) {
+            if (!format(chunk_size, zero_block, sparse_max)) return false;
+        } else {
+            fprintf(stderr, "[CATALOG] Attached: %llu files, %llu/%llu chunks free\n",
+                    (unsigned long long)hdr_->live_entries,
+                    (unsigned long long)count_free_chunks(),
+                    (unsigned long long)hdr_->num_chunks);
+        }
+        entries_ = reinterpret_cast<CatalogEntry*>(base_ + hdr_->entries_offset);
+        bitmap_ = reinterpret_cast<uint64_t*>(base_ + hdr_->bitmap_offset);
+        map_slots_ = has_chunk_maps() ? reinterpret_cast<uint64_t*>(base_ + hdr_->chunk_map_offset) : nullptr;
+        auto free = [this](uint64_t offset, uint64_t length) { free_extent(offset, length); };
+        if (lock_fd_ >= 0 && !ns_.attach(lock_fd_, size_, formatted, free)) {
+            fprintf(stderr, "[CATALOG] No shared namespace; opens are not counted across processes\n");
+        }
+        if (has_zero_map()) {
+            zero_map.attach(base_, hdr_->zero_block,
+                            reinterpret_cast<uint64_t*>(base_ + hdr_->zero_map_offset),
+                            &hdr_->zero_map_used, mode);
+            // Alone, so busy blocks were left by a process that died
+            if (!ns_.attached() || ns_.attached_alone()) {
+                zero_map.recover((size_ + hdr_->zero_block - 1) / hdr_->zero_block);
+            }
+        }
+        return true;
+    }
+
+    // Leave the shared namespace; the last process out frees the chunks of
+    // files unlinked while open
+    void detach() {
+        if (!hdr_) return;
+        std::lock_guard<std::mutex> lk(mu_);
+        if (lock_fd_ >= 0) flock(lock_fd_, LOCK_EX);
+        ns_.detach([this](uint64_t offset, uint64_t length) { free_extent(offset, length); });
+        if (lock_fd_ >= 0) flock(lock_fd_, LOCK_UN);
+        zero_map.detach();
+        hdr_ = nullptr;
+    }
+
+    // From a pthread_atfork() child handler
+    void reopen_in_child() { ns_.reopen_in_child(); }
+
+    // The namespace segment's QoS area; nullptr without a segment
+    void* qos_area() const { return ns_.qos_area(); }
+
+    bool attached() const { return hdr_ != nullptr; }
+    uint64_t chunk_size() const { return hdr_->chunk_size; }
+    uint64_t data_offset() const { return hdr_->data_offset; }
+    bool has_zero_map() const {
+        return memcmp(hdr_->zero_map_magic, kZeroMapMagic, sizeof(kZeroMapMagic)) == 0;
+    }
+    bool has_chunk_maps() const {
+        return memcmp(hdr_->chunk_map_magic, kChunkMapMagic, sizeof(kChunkMapMagic)) == 0;
+    }
+    // Largest sparse file, 0 without chunk maps
+    uint64_t sparse_max() const { return map_slots_ ? hdr_->chunk_map_chunks * hdr_->chunk_size : 0; }
+
+    // Zero blocks of the region; attached when the catalog has a map
+    ZeroMap zero_map;
+
+    // Look up path; if absent and create is set, allocate an extent of at
+    // least want bytes (rounded up to whole chunks), or with sparse a chunk
+    // map for up to want bytes (at most sparse_max()). Returns false with
+    // errno set (ENOENT, ENOSPC, ENAMETOOLONG) on failure.
+    bool open_extent(const std::string& path, uint64_t want, bool create, DaxExtent& out,
+                     bool sparse = false) {
+        if (path.size() >= sizeof(CatalogEntry::path)) {
+            errno = ENAMETOOLONG;
+            return false;
+        }
+        LockGuard lock(*this);
+        return open_locked(path, hash_path(path), want, create, sparse, out);
+    }
+
+    // open_extent() for a file being opened: the shared namespace counts the
+    // open until release_extent(out.ns_slot)
+    bool acquire_extent(const std::string& path, uint64_t want, bool create, DaxExtent& out,
+                        bool sparse = false) {
+        if (path.size() >= sizeof(CatalogEntry::path)) {
+            errno = ENAMETOOLONG;
+            return false;
+        }
+        LockGuard lock(*this);
+        uint64_t hash = hash_path(path);
+        if (ns_.attached()) {
+            out.ns_slot = ns_.ref(path, hash, out.offset, out.length);
+            if (out.ns_slot >= 0) {
+                out.created = false;
+                CatalogEntry* e = find(path, hash, nullptr);
+                out.entry = e && e->offset == out.offset ? e : nullptr;
+                out.chunk_map = chunk_map(out.offset);
+                return true;
+            }
+        }
+        if (!open_locked(path, hash, want, create, sparse, out)) return false;
+        if (ns_.attached()) out.ns_slot = ns_.insert(path, hash, out.offset, out.length);
+        return true;
+    }
+
+    // Drop an open counted by acquire_extent(); the last close of a file
+    // unlinked while open frees its chunks
+    void release_extent(int32_t ns_slot) {
+        if (ns_slot < 0 || !ns_.attached()) return;
+        LockGuard lock(*this);
+        uint64_t offset, length;
+        if (ns_.unref(ns_slot, offset, length)) free_extent(offset, length);
+    }
+
+    // Drop path; its chunks return to the free pool now, or at the last
+    // close if some process still has it open
+    bool remove(const std::string& path) {
+        LockGuard lock(*this);
+        uint64_t hash = hash_path(path);
+        CatalogEntry* e = find(path, hash, nullptr);
+        if (!e) {
+            errno = ENOENT;
+            return false;
+        }
+        e->state = ENTRY_DELETED;
+        persist(&e->state, sizeof(e->state));
+        hdr_->live_entries--;
+        persist(&hdr_->live_entries, sizeof(hdr_->live_entries));
+        if (!ns_.attached() || !ns_.orphan(path, hash)) free_extent(e->offset, e->length);
+        return true;
+    }
+
+    // The logical size entry records for the extent at offset, while the
+    // entry still describes it (the slot of a file unlinked while open can
+    // be reused)
+    static uint64_t* logical_size(CatalogEntry* e, uint64_t offset) {
+        if (!e || e->state != ENTRY_VALID || e->offset != offset) return nullptr;
+        return &e->size;
+    }
+
+    uint64_t free_bytes() {
+        LockGuard lock(*this);
+        return count_free_chunks() * hdr_->chunk_size;
+    }
+
+    // Region offset of chunk index of the sparse file whose map is map,
+    // allocated on first use; 0 (ENOSPC) when the region is full. A new
+    // chunk is handed to fill(offset) before the map shows it to other
+    // processes, and is freed again if fill returns false.
+    template <typename Fill>
+    uint64_t map_chunk(uint32_t* map, uint64_t index, Fill&& fill) {
+        std::atomic_ref<uint32_t> slot(map[index]);
+        uint32_t c = slot.load(std::memory_order_acquire);
+        if (c) return c * hdr_->chunk_size;
+        LockGuard lock(*this);
+        c = slot.load(std::memory_order_relaxed);
+        if (!c) {
+            uint64_t first;
+            if (!find_free_run(1, first)) {
+                errno = ENOSPC;
+                return 0;
+            }
+            mark_chunks(first, 1, true);
+            if (!fill(first * hdr_->chunk_size)) {
+                mark_chunks(first, 1, false);
+                return 0;
+            }
+            c = static_cast<uint32_t>(first);
+            slot.store(c, std::memory_order_release);
+            persist(&map[index], sizeof(map[index]));
+        }
+        return c * hdr_->chunk_size;
+    }
+
+    // Chunks allocated to the sparse file whose map is map
+    uint64_t mapped_chunks(uint32_t* map) const {
+        uint64_t n = 0;
+        for (uint64_t i = 0; i < hdr_->chunk_map_chunks; i++) {
+            n += std::atomic_ref<uint32_t>(map[i]).load(std::memory_order_relaxed) != 0;
+        }
+        return n;
+    }
+
+private:
+    class LockGuard {
+    public:
+        explicit LockGuard(DaxCatalog& c) : c_(c), shared_(c.ns_.attached()) {
+            if (shared_) {
+                c_.ns_.lock();
+                return;
+            }
+            c_.mu_.lock();
+            if (c_.lock_fd_ >= 0) flock(c_.lock_fd_, LOCK_EX);
+        }
+        ~LockGuard() {
+            if (shared_) {
+                c_.ns_.unlock();
+                return;
+            }
+            if (c_.lock_fd_ >= 0) flock(c_.lock_fd_, LOCK_UN);
+            c_.mu_.unlock();
+        }
+    private:
+        DaxCatalog& c_;
+        bool shared_;
+    };
+
+    // The chunk map of the sparse file at offset, nullptr for an extent
+    uint32_t* chunk_map(uint64_t offset) const {
+        if (!(offset & kSparseExtent) || !map_slots_) return nullptr;
+        uint64_t slot = offset & ~kSparseExtent;
+        return reinterpret_cast<uint32_t*>(reinterpret_cast<char*>(map_slots_) + map_slots_bytes()) +
+               slot * hdr_->chunk_map_chunks;
+    }
+
+    uint64_t map_slots_bytes() const { return ((hdr_->max_entries + 511) / 512) * 64; }
+
+    void free_extent(uint64_t offset, uint64_t length) {
+        if (uint32_t* map = chunk_map(offset)) {
+            free_chunk_map(map, offset & ~kSparseExtent);
+            return;
+        }
+        mark_chunks(offset / hdr_->chunk_size, length / hdr_->chunk_size, false);
+    }
+
+    // The map is cleared before its chunks are, and the slot last
+    void free_chunk_map(uint32_t* map, uint64_t slot) {
+        uint64_t n = hdr_->chunk_map_chunks;
+        std::vector<uint32_t> owned(map, map + n);
+        memset(map, 0, n * sizeof(uint32_t));
+        persist(map, n * sizeof(uint32_t));
+        for (uint64_t i = 0; i < n; i++) {
+            if (owned[i]) mark_chunks(owned[i], 1, false);
+        }
+        map_slots_[slot / 64] &= ~(1ULL << (slot % 64));
+        persist(&map_slots_[slot / 64], sizeof(uint64_t));
+    }
+
+    bool open_locked(const std::string& path, uint64_t hash, uint64_t want, bool create, bool sparse,
+                     DaxExtent& out) {
+        CatalogEntry* slot = nullptr;
+        if (CatalogEntry* e = find(path, hash, &slot)) {
+            out.offset = e->offset;
+            out.length = e->length;
+            out.created = false;
+            out.entry = e;
+            out.chunk_map = chunk_map(e->offset);
+            return true;
+        }
+        if (!create) {
+            errno = ENOENT;
+            return false;
+        }
+        if (!slot) {
+            errno = ENOSPC;
+            return false;
+        }
+
+        uint64_t chunks = (want + hdr_->chunk_size - 1) / hdr_->chunk_size;
+        if (chunks == 0) chunks = 1;
+        uint64_t offset;
+        if (sparse && map_slots_) {
+            if (chunks > hdr_->chunk_map_chunks) chunks = hdr_->chunk_map_chunks;
+            uint64_t map;
+            if (!find_free_map(map)) {
+                errno = ENOSPC;
+                return false;
+            }
+            map_slots_[map / 64] |= 1ULL << (map % 64);
+            persist(&map_slots_[map / 64], sizeof(uint64_t));
+            offset = kSparseExtent | map;
+        } else {
+            uint64_t first;
+            if (!find_free_run(chunks, first)) {
+                errno = ENOSPC;
+                return false;
+            }
+            mark_chunks(first, chunks, true);
+            offset = first * hdr_->chunk_size;
+        }
+
+        slot->flags = 0;
+        slot->offset = offset;
+        slot->length = chunks * hdr_->chunk_size;
+        slot->size = slot->length;
+        slot->path_hash = hash;
+        memset(slot->path, 0, sizeof(slot->path));
+        memcpy(slot->path, path.data(), path.size());
+        persist(slot, sizeof(*slot));
+        slot->state = ENTRY_VALID;
+        persist(&slot->state, sizeof(slot->state));
+        hdr_->live_entries++;
+        persist(&hdr_->live_entries, sizeof(hdr_->live_entries));
+
+        out.offset = slot->offset;
+        out.length = slot->length;
+        out.created = true;
+        out.entry = slot;
+        out.chunk_map = chunk_map(offset);
+        return true;
+    }
+
+    bool find_free_map(uint64_t& map) {
+        for (uint64_t w = 0; w * 64 < hdr_->max_entries; w++) {
+            if (map_slots_[w] == ~0ULL) continue;
+            map = w * 64 + __builtin_ctzll(~map_slots_[w]);
+            return map < hdr_->max_entries;
+        }
+        return false;
+    }
+
+    static uint64_t hash_path(const std::string& path) {
+        uint64_t h = 1469598103934665603ULL;  // FNV-1a
+        for (unsigned char c : path) {
+            h ^= c;
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    void persist(const void* addr, size_t n) {
+        cxl_ssd::persist_flush(addr, n, persist_mode_);
+        cxl_ssd::persist_fence(persist_mode_);
+    }
+
+    bool format(uint64_t chunk_size, uint64_t zero_block, uint64_t sparse_max) {
+        uint64_t max_entries = kDefaultCatalogEntries;
+        uint64_t entries_offset = 4096;
+        uint64_t bitmap_offset = entries_offset + max_entries * sizeof(CatalogEntry);
+        uint64_t num_chunks = size_ / chunk_size;
+        uint64_t bitmap_bytes = ((num_chunks + 63) / 64) * 8;
+        if (zero_block == 0) {
+            zero_block = kMinZeroBlock;
+            while (size_ / zero_block > (1ULL << 29)) zero_block <<= 1;
+        }
+        if (zero_block < kMinZeroBlock || zero_block > chunk_size || (zero_block & (zero_block - 1)) != 0) {
+            zero_block = kMinZeroBlock;
+        }
+        uint64_t zero_map_offset = (bitmap_offset + bitmap_bytes + 63) & ~uint64_t(63);
+        // Chunk maps take at most 1/64 of the region
+        uint64_t map_chunks = (sparse_max ? sparse_max : kDefaultSparseMax) / chunk_size;
+        if (map_chunks > num_chunks) map_chunks = num_chunks;
+        if (map_chunks > size_ / 64 / (max_entries * sizeof(uint32_t))) {
+            map_chunks = size_ / 64 / (max_entries * sizeof(uint32_t));
+        }
+        uint64_t chunk_map_offset = (zero_map_offset + ZeroMap::map_bytes(size_, zero_block) + 63) & ~uint64_t(63);
+        uint64_t meta_bytes = chunk_map_offset;
+        if (map_chunks) meta_bytes += ((max_entries + 511) / 512) * 64 + max_entries * map_chunks * sizeof(uint32_t);
+        uint64_t reserved_chunks = (meta_bytes + chunk_size - 1) / chunk_size;
+        if (num_chunks <= reserved_chunks) {
+            fprintf(stderr, "[CATALOG] Region too small for a catalog (%zu bytes)\n", size_);
+            hdr_ = nullptr;
+            return false;
+        }
+
+        memset(base_ + entries_offset, 0, meta_bytes - entries_offset);
+        bitmap_ = reinterpret_cast<uint64_t*>(base_ + bitmap_offset);
+        for (uint64_t c = 0; c < reserved_chunks; c++) bitmap_[c / 64] |= 1ULL << (c % 64);
+        persist(base_ + entries_offset, meta_bytes - entries_offset);
+
+        hdr_->version = kCatalogVersion;
+        hdr_->entry_size = sizeof(CatalogEntry);
+        hdr_->region_size = size_;
+        hdr_->chunk_size = chunk_size;
+        hdr_->num_chunks = num_chunks;
+        hdr_->max_entries = max_entries;
+        hdr_->entries_offset = entries_offset;
+        hdr_->bitmap_offset = bitmap_offset;
+        hdr_->data_offset = reserved_chunks * chunk_size;
+        hdr_->live_entries = 0;
+        hdr_->zero_block = zero_block;
+        hdr_->zero_map_offset = zero_map_offset;
+        hdr_->zero_map_used = 0;
+        memcpy(hdr_->zero_map_magic, kZeroMapMagic, sizeof(kZeroMapMagic));
+        hdr_->chunk_map_offset = chunk_map_offset;
+        hdr_->chunk_map_chunks = map_chunks;
+        if (map_chunks) memcpy(hdr_->chunk_map_magic, kChunkMapMagic, sizeof(kChunkMapMagic));
+        else memset(hdr_->chunk_map_magic, 0, sizeof(hdr_->chunk_map_magic));
+        persist(hdr_, sizeof(*hdr_));
+        memcpy(hdr_->magic, kCatalogMagic, sizeof(kCatalogMagic));
+        persist(hdr_->magic, sizeof(hdr_->magic));
+
+        fprintf(stderr, "[CATALOG] Formatted: %llu chunks of %llu KB, %llu reserved, %llu KB zero blocks\n",
+                (unsigned long long)num_chunks, (unsigned long long)(chunk_size >> 10),
+                (unsigned long long)reserved_chunks, (unsigned long long)(zero_block >> 10));
+        return true;
+    }
+
+    // Linear probing. Returns the live entry for path, and via insert_slot
+    // the first reusable slot on the probe chain (nullptr if the table is full).
+    CatalogEntry* find(const std::string& path, uint64_t hash, CatalogEntry** insert_slot) {
+        uint64_t n = hdr_->max_entries;
+        CatalogEntry* reusable = nullptr;
+        for (uint64_t i = 0; i < n; i++) {
+            CatalogEntry* e = &entries_[(hash + i) % n];
+            if (e->state == ENTRY_EMPTY) {
+                if (!reusable) reusable = e;
+                break;
+            }
+            if (e->state == ENTRY_DELETED) {
+                if (!reusable) reusable = e;
+                continue;
+            }
+            if (e->path_hash == hash && path.compare(e->path) == 0) return e;
+        }
+        if (insert_slot) *insert_slot = reusable;
+        return nullptr;
+    }
+
+    bool chunk_used(uint64_t c) const { return bitmap_[c / 64] & (1ULL << (c % 64)); }
+
+    // First-fit search for a run of free chunks, starting at the rover
+    bool find_free_run(uint64_t count, uint64_t& first) {
+        uint64_t n = hdr_->num_chunks;
+        for (int pass = 0; pass < 2; pass++) {
+            uint64_t start = pass == 0 ? rover_ : 0;
+            uint64_t end = pass == 0 ? n : rover_ + count;
+            if (end > n) end = n;
+            uint64_t run = 0;
+            for (uint64_t c = start; c < end; c++) {
+                if (run == 0 && (c % 64) == 0 && bitmap_[c / 64] == ~0ULL) {
+                    c += 63;  // skip a fully allocated word
+                    continue;
+                }
+                if (chunk_used(c)) {
+                    run = 0;
+                    continue;
+                }
+                if (++run == count) {
+                    first = c + 1 - count;
+                    rover_ = c + 1;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void mark_chunks(uint64_t first, uint64_t count, bool used) {
+        for (uint64_t c = first; c < first + count; c++) {
+            if (used) bitmap_[c / 64] |= 1ULL << (c % 64);
+            else bitmap_[c / 64] &= ~(1ULL << (c % 64));
+        }
+        persist(&bitmap_[first / 64], ((first + count + 63) / 64 - first / 64) * 8);
+        if (!used && first < rover_) rover_ = first;
+    }
+
+    uint64_t count_free_chunks() const {
+        const uint64_t* bitmap = reinterpret_cast<const uint64_t*>(base_ + hdr_->bitmap_offset);
+        uint64_t used = 0;
+        uint64_t words = (hdr_->num_chunks + 63) / 64;
+        for (uint64_t w = 0; w < words; w++) used += __builtin_popcountll(bitmap[w]);
+        return hdr_->num_chunks - used;
+    }
+
+    char* base_ = nullptr;
+    size_t size_ = 0;
+    int lock_fd_ = -1;
+    cxl_ssd::PersistMode persist_mode_ = cxl_ssd::PersistMode::CLFLUSHOPT;
+    CatalogHeader* hdr_ = nullptr;
+    CatalogEntry* entries_ = nullptr;
+    uint64_t* bitmap_ = nullptr;
+    uint64_t* map_slots_ = nullptr;  // chunk map slot bitmap, nullptr without maps
+    uint64_t rover_ = 0;
+    std::mutex mu_;
+    ShmNamespace ns_;
+};
+
+} // namespace cxl_intercept
+
+#endif // CXL_DAX_CATALOG_HPP
@@ -0,0 +1,457 @@
+#ifndef CXL_DAX_REGION_HPP
+#define CXL_DAX_REGION_HPP
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "cxl_dax_catalog.hpp"
+#include "cxl_dax_window.hpp"
+#include "cxl_integrity.hpp"
+#include "cxl_qos.hpp"
+
+// A mapped DAX/CXL region and the sysfs facts about it. The intercept
+// libraries open and map regions with raw syscalls so the calls are not
+// routed back through their own open()/mmap()/munmap() wrappers.
+
+namespace cxl_intercept {
+
+constexpr int kMaxDaxRegions = 8;
+constexpr size_t kHugePageSize = 2ULL << 20;
+
+// Regions above kWindowedRegionSize are mapped in windows unless
+// FIO_DAX_WINDOW says otherwise (see cxl_dax_window.hpp)
+constexpr size_t kWindowAuto = SIZE_MAX;
+constexpr size_t kWindowedRegionSize = 64ULL << 30;
+constexpr size_t kDefaultWindowSize = 1ULL << 30;
+constexpr size_t kMinWindowSize = 64ULL << 20;  // holds the catalog of a 16TB region
+constexpr size_t kDefaultMaxWindows = 16;
+
+// "path[:size][@node]"; size accepts K/M/G suffixes, node overrides sysfs.
+// align (FIO_DAX_ALIGN) overrides the device's own alignment; window
+// (FIO_DAX_WINDOW, 0 = map it all) and max_windows (FIO_DAX_MAX_WINDOWS)
+// size the on-demand windows.
+struct DaxRegionSpec {
+    std::string path;
+    size_t size = 0;
+    int node = -1;
+    size_t align = 0;
+    size_t window = kWindowAuto;
+    size_t max_windows = 0;
+};
+
+inline size_t parse_size(const char* s) {
+    char* end = nullptr;
+    unsigned long long v = strtoull(s, &end, 0);
+    switch (end ? *end : '\0') {
+        case 'k': case 'K': v <<= 10; break;
+        case 'm': case 'M': v <<= 20; break;
+        case 'g': case 'G': v <<= 30; break;
+        case 't': case 'T': v <<= 40; break;
+        default: break;
+    }
+    return static_cast<size_t>(v);
+}
+
+// Comma-separated list of region specs (FIO_DAX_DEVICES)
+inline std::vector<DaxRegionSpec> parse_region_list(const char* list) {
+    std::vector<DaxRegionSpec> specs;
+    std::string all = list ? list : "";
+    size_t pos = 0;
+    while (pos <= all.size()) {
+        size_t comma = all.find(',', pos);
+        std::string item = all.substr(pos, comma == std::string::npos ? std::string::npos : comma - pos);
+        pos = comma == std::string::npos ? all.size() + 1 : comma + 1;
+        if (item.empty()) continue;
+
+        DaxRegionSpec spec;
+        size_t at = item.rfind('@');
+        if (at != std::string::npos) {
+            spec.node = atoi(item.c_str() + at + 1);
+            item.resize(at);
+        }
+        size_t colon = item.rfind(':');
+        if (colon != std::string::npos) {
+            spec.size = parse_size(item.c_str() + colon + 1);
+            item.resize(colon);
+        }
+        spec.path = item;
+        specs.push_back(spec);
+    }
+    return specs;
+}
+
+inline bool read_sysfs_long(const std::string& path, long long& value) {
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f) return false;
+    bool ok = fscanf(f, "%lli", &value) == 1;
+    fclose(f);
+    return ok;
+}
+
+// NUMA node of the memory behind fd: devdax devices report it under
+// /sys/bus/dax, files and block devices through their backing block device
+inline int numa_node_of_fd(int fd, const std::string& path) {
+    struct stat st;
+    if (syscall(SYS_fstat, fd, &st) != 0) return -1;
+
+    std::vector<std::string> candidates;
+    char buf[128];
+    if (S_ISCHR(st.st_mode)) {
+        std::string name = path.substr(path.rfind('/') + 1);
+        candidates.push_back("/sys/bus/dax/devices/" + name + "/numa_node");
+        candidates.push_back("/sys/bus/dax/devices/" + name + "/target_node");
+        snprintf(buf, sizeof(buf), "/sys/dev/char/%u:%u/device/numa_node",
+                 major(st.st_rdev), minor(st.st_rdev));
+        candidates.push_back(buf);
+    } else {
+        dev_t dev = S_ISBLK(st.st_mode) ? st.st_rdev : st.st_dev;
+        snprintf(buf, sizeof(buf), "/sys/dev/block/%u:%u/device/numa_node", major(dev), minor(dev));
+        candidates.push_back(buf);
+        // Partitions hang off their parent disk
+        snprintf(buf, sizeof(buf), "/sys/dev/block/%u:%u/../device/numa_node", major(dev), minor(dev));
+        candidates.push_back(buf);
+    }
+    for (const std::string& c : candidates) {
+        long long node;
+        if (read_sysfs_long(c, node) && node >= 0) return static_cast<int>(node);
+    }
+    return -1;
+}
+
+// devdax "align" attribute (2MB or 1GB, the page size the device maps
+// with); 0 when fd is not a devdax device
+inline size_t devdax_align(int fd, const std::string& path) {
+    struct stat st;
+    if (syscall(SYS_fstat, fd, &st) != 0 || !S_ISCHR(st.st_mode)) return 0;
+    std::string name = path.substr(path.rfind('/') + 1);
+    char buf[128];
+    snprintf(buf, sizeof(buf), "/sys/dev/char/%u:%u/align", major(st.st_rdev), minor(st.st_rdev));
+    long long align;
+    if (read_sysfs_long("/sys/bus/dax/devices/" + name + "/align", align) && align > 0) return align;
+    if (read_sysfs_long(buf, align) && align > 0) return align;
+    return 0;
+}
+
+// Page size backing the mapping at addr according to its /proc/self/smaps
+// entry: the VMA's KernelPageSize when that is a huge page (devdax,
+// hugetlbfs), 2MB when any of it is PMD-mapped (THP), else the base page
+inline size_t mapped_page_size(const void* addr) {
+    FILE* f = fopen("/proc/self/smaps", "r");
+    if (!f) return 0;
+    uintptr_t target = reinterpret_cast<uintptr_t>(addr);
+    char line[512];
+    bool in_vma = false;
+    size_t kernel_page_kb = 0, pmd_kb = 0;
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long start, end;
+        if (sscanf(line, "%lx-%lx ", &start, &end) == 2 && strchr(line, '-') < strchr(line, ' ')) {
+            if (in_vma) break;
+            in_vma = target >= start && target < end;
+            continue;
+        }
+        if (!in_vma) continue;
+        size_t kb;
+        if (sscanf(line, "KernelPageSize: %zu kB", &kb) == 1) kernel_page_kb = kb;
+        else if (sscanf(line, "AnonHugePages: %zu kB", &kb) == 1) pmd_kb += kb;
+        else if (sscanf(line, "ShmemPmdMapped: %zu kB", &kb) == 1) pmd_kb += kb;
+        else if (sscanf(line, "FilePmdMapped: %zu kB", &kb) == 1) pmd_kb += kb;
+    }
+    fclose(f);
+    if (kernel_page_kb > 4) return kernel_page_kb << 10;
+    if (pmd_kb) return kHugePageSize;
+    return kernel_page_kb << 10;
+}
+
+inline int current_numa_node() {
+    unsigned cpu = 0, node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) != 0) return -1;
+    return static_cast<int>(node);
+}
+
+// The calling thread's node, refreshed every 256 calls so hot paths do not
+// pay for getcpu() on each I/O
+inline int cached_numa_node() {
+    static thread_local int node = -1;
+    static thread_local unsigned calls = 0;
+    if ((calls++ & 255) == 0) node = current_numa_node();
+    return node;
+}
+
+// CPUs of a node from /sys/devices/system/node/nodeN/cpulist ("0-3,8-11")
+inline bool node_cpuset(int node, cpu_set_t* set) {
+    if (node < 0) return false;
+    char path[96];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+    FILE* f = fopen(path, "r");
+    if (!f) return false;
+    char line[4096];
+    bool ok = fgets(line, sizeof(line), f) != nullptr;
+    fclose(f);
+    if (!ok) return false;
+
+    CPU_ZERO(set);
+    int cpus = 0;
+    for (char* p = line; *p && *p != '\n';) {
+        char* end;
+        long lo = strtol(p, &end, 10);
+        if (end == p) break;
+        long hi = lo;
+        if (*end == '-') hi = strtol(end + 1, &end, 10);
+        for (long c = lo; c <= hi && c < CPU_SETSIZE; c++, cpus++) CPU_SET(c, set);
+        p = *end == ',' ? end + 1 : end;
+    }
+    return cpus > 0;
+}
+
+// Bytes moved to and from a region, split by whether the accessing thread
+// ran on the region's node. Sharded so threads rarely share a line.
+class RegionTraffic {
+public:
+    enum Counter { READ, WRITE, REMOTE_READ, REMOTE_WRITE, NUM_COUNTERS };
+
+    void add(bool write, bool remote, uint64_t bytes) {
+        Shard& s = shards_[shard_index()];
+        s.v[write ? WRITE : READ].fetch_add(bytes, std::memory_order_relaxed);
+        if (remote) s.v[write ? REMOTE_WRITE : REMOTE_READ].fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    uint64_t total(Counter c) const {
+        uint64_t sum = 0;
+        for (const Shard& s : shards_) sum += s.v[c].load(std::memory_order_relaxed);
+        return sum;
+    }
+
+private:
+    static constexpr int kShards = 16;
+
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> v[NUM_COUNTERS] = {};
+    };
+
+    static unsigned shard_index() {
+        static std::atomic<unsigned> next{0};
+        static thread_local unsigned index = next.fetch_add(1, std::memory_order_relaxed) % kShards;
+        return index;
+    }
+
+    Shard shards_[kShards];
+};
+
+struct DaxRegion {
+    std::string path;
+    int fd = -1;
+    char* base = nullptr;
+    size_t size = 0;
+    bool map_sync = false;  // mapped with MAP_SYNC (a real DAX device)
+    int node = -1;
+    size_t align = 0;       // extent and mapping alignment
+    size_t page_size = 0;   // page size seen backing the mapping
+    DaxWindowMap* windows = nullptr;  // windowed mapping, else all mapped
+    DaxCatalog catalog;
+    RegionTraffic traffic;
+    DaxIntegrity integrity;  // per-block CRC32C, when verifying
+    QosBuckets qos;          // tenants' token buckets (FIO_QOS)
+
+    // Open and map spec; size comes from the spec, then fstat(). The
+    // mapping and every extent start on an align boundary: the devdax align
+    // attribute, or 2MB so transparent huge pages can back other devices.
+    // A windowed region is only reserved here; epoch is the domain its
+    // readers hold while touching it (nullptr: accesses are serialized).
+    bool map(const DaxRegionSpec& spec, EpochDomain* epoch = nullptr) {
+        path = spec.path;
+        fd = static_cast<int>(syscall(SYS_openat, AT_FDCWD, path.c_str(), O_RDWR | O_SYNC | O_CLOEXEC));
+        if (fd < 0) return false;
+
+        size_t device_align = devdax_align(fd, path);
+        align = spec.align ? spec.align : device_align ? device_align : kHugePageSize;
+        if (align < kHugePageSize || (align & (align - 1)) != 0) align = kHugePageSize;
+
+        size = spec.size;
+        if (size == 0) {
+            struct stat st;
+            if (syscall(SYS_fstat, fd, &st) == 0) size = st.st_size;
+        }
+        // devdax refuses mappings that are not a multiple of its alignment
+        if (device_align && size >= device_align) size &= ~(device_align - 1);
+        if (size == 0) {
+            unmap();
+            return false;
+        }
+
+        // Reserve address space to carve an aligned window out of; the
+        // kernel only hands out huge-page-aligned addresses for devdax
+        size_t reserve = size + align;
+        char* hole = reinterpret_cast<char*>(syscall(SYS_mmap, nullptr, reserve, PROT_NONE,
+                                                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0));
+        if (hole == MAP_FAILED) {
+            unmap();
+            return false;
+        }
+        char* want = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(hole) + align - 1) & ~(align - 1));
+        if (want > hole) syscall(SYS_munmap, hole, want - hole);
+        if (hole + reserve > want + size) syscall(SYS_munmap, want + size, hole + reserve - (want + size));
+        base = want;
+        node = spec.node >= 0 ? spec.node : numa_node_of_fd(fd, path);
+
+        size_t window = spec.window == kWindowAuto ? (size > kWindowedRegionSize ? kDefaultWindowSize : 0)
+                                                   : spec.window;
+        if (window) {
+            // Power of two, whole extents, and big enough for the catalog
+            if (window < kMinWindowSize) window = kMinWindowSize;
+            if (window < align) window = align;
+            window = size_t(1) << (64 - __builtin_clzll(window - 1));
+            windows = new DaxWindowMap(base, size, window, spec.max_windows ? spec.max_windows
+                                                                            : kDefaultMaxWindows, fd, epoch);
+            // The catalog header lives in the first window
+            if (!windows->pin(0, 1)) {
+                unmap();
+                return false;
+            }
+            map_sync = windows->map_sync();
+            fprintf(stderr, "[DAX_REGION] %s: mapping %zu MB windows on demand, at most %zu live\n",
+                    path.c_str(), window >> 20, windows->max_live());
+            return true;
+        }
+
+        void* p = reinterpret_cast<void*>(syscall(SYS_mmap, want, size, PROT_READ | PROT_WRITE,
+                                                  MAP_SHARED_VALIDATE | MAP_SYNC | MAP_FIXED, fd, 0));
+        map_sync = p != MAP_FAILED;
+        if (p == MAP_FAILED && errno == EOPNOTSUPP) {
+            // Not a DAX file (e.g. tmpfs or memfd for development)
+            p = reinterpret_cast<void*>(syscall(SYS_mmap, want, size, PROT_READ | PROT_WRITE,
+                                                MAP_SHARED | MAP_FIXED, fd, 0));
+        }
+        if (p == MAP_FAILED) {
+            unmap();
+            return false;
+        }
+        madvise(base, size, MADV_HUGEPAGE);
+        return true;
+    }
+
+    // Attach the catalog with align-sized chunks (and zero_block-sized
+    // zero blocks and sparse_max-byte sparse files, if it is formatted),
+    // then check which page size the kernel actually used for the mapping
+    bool attach_catalog(cxl_ssd::PersistMode mode, bool force_format, size_t zero_block = 0,
+                        size_t sparse_max = 0) {
+        if (!catalog.attach(base, size, fd, mode, force_format, align, zero_block, sparse_max)) return false;
+        static_assert(kQosAreaBytes <= kNamespaceQosBytes, "QoS slots fit the namespace segment");
+        qos.attach(catalog.qos_area());
+        if (catalog.chunk_size() % align != 0) {
+            fprintf(stderr, "[DAX_REGION] %s: catalog chunks (%llu KB) are not a multiple of the "
+                    "%zu KB alignment; FIO_DAX_FORMAT=1 reformats\n", path.c_str(),
+                    (unsigned long long)(catalog.chunk_size() >> 10), align >> 10);
+        }
+
+        if (windows && !windows->pin(0, catalog.data_offset())) return false;
+
+        // Fault in the first data chunk so smaps reports how it is mapped
+        if (!ensure(base + catalog.data_offset(), 1)) return false;
+        *static_cast<volatile char*>(base + catalog.data_offset());
+        page_size = mapped_page_size(base + catalog.data_offset());
+        if (page_size && page_size < align) {
+            fprintf(stderr, "[DAX_REGION] %s: mapping backed by %zu KB pages, not %zu KB; "
+                    "expect TLB misses in random-access latencies\n",
+                    path.c_str(), page_size >> 10, align >> 10);
+        }
+        return true;
+    }
+
+    void unmap() {
+        catalog.detach();
+        integrity.detach();
+        if (windows) {
+            windows->stop_reclaimer();
+            fprintf(stderr, "[DAX_REGION] %s: %llu window maps, %llu evictions, peak %zu live\n",
+                    path.c_str(), (unsigned long long)windows->maps(),
+                    (unsigned long long)windows->evictions(), windows->peak_live());
+        }
+        if (base) syscall(SYS_munmap, base, size);
+        if (fd >= 0) syscall(SYS_close, fd);
+        delete windows;
+        windows = nullptr;
+        base = nullptr;
+        fd = -1;
+    }
+
+    // Make [addr, addr + len) of the region accessible; a no-op unless
+    // the region is windowed, and for memory outside it (sparse files'
+    // chunks, mapped with map_at()). False with errno set if a window
+    // cannot be mapped.
+    bool ensure(const void* addr, size_t len) {
+        return !windows || !contains(addr, len) || windows->ensure(static_cast<const char*>(addr) - base, len);
+    }
+
+    // Keep [addr, addr + len) mapped for memory reached without ensure()
+    bool pin(const void* addr, size_t len) {
+        return !windows || !contains(addr, len) || windows->pin(static_cast<const char*>(addr) - base, len);
+    }
+
+    void unpin(const void* addr, size_t len) {
+        if (windows && contains(addr, len)) windows->unpin(static_cast<const char*>(addr) - base, len);
+    }
+
+    // Map [offset, offset + len) of the device over addr, as the region
+    // itself is mapped
+    bool map_at(void* addr, size_t len, uint64_t offset) const {
+        int flags = map_sync ? MAP_SHARED_VALIDATE | MAP_SYNC | MAP_FIXED : MAP_SHARED | MAP_FIXED;
+        return reinterpret_cast<void*>(syscall(SYS_mmap, addr, len, PROT_READ | PROT_WRITE, flags, fd,
+                                               offset)) != MAP_FAILED;
+    }
+
+    // pthread_atfork() handlers
+    void fork_prepare() {
+        if (windows) windows->fork_prepare();
+    }
+    void fork_parent() {
+        if (windows) windows->fork_parent();
+    }
+    void fork_child() {
+        if (windows) windows->fork_child();
+        catalog.reopen_in_child();
+    }
+
+    bool contains(const void* addr, size_t len) const {
+        uintptr_t start = reinterpret_cast<uintptr_t>(addr);
+        uintptr_t b = reinterpret_cast<uintptr_t>(base);
+        return base && start >= b && len <= size && start - b <= size - len;
+    }
+};
+
+// Run metadata (FIO_DAX_METADATA): how each region was mapped, so results
+// can be tied to the alignment and page size they were measured with
+inline bool write_region_metadata(const std::string& file, const char* library, const char* persist,
+                                  const DaxRegion* regions, int count) {
+    FILE* f = fopen(file.c_str(), "w");
+    if (!f) return false;
+    fprintf(f, "{\n  \"library\": \"%s\",\n  \"pid\": %d,\n  \"persist\": \"%s\",\n  \"regions\": [",
+            library, static_cast<int>(getpid()), persist);
+    for (int i = 0; i < count; i++) {
+        const DaxRegion& r = regions[i];
+        fprintf(f, "%s\n    {\"path\": \"%s\", \"size\": %zu, \"node\": %d, \"align\": %zu, "
+                "\"chunk_size\": %llu, \"page_size\": %zu, \"map_sync\": %s, \"window\": %zu}",
+                i ? "," : "", r.path.c_str(), r.size, r.node, r.align,
+                (unsigned long long)r.catalog.chunk_size(), r.page_size, r.map_sync ? "true" : "false",
+                r.windows ? r.windows->window() : 0);
+    }
+    fprintf(f, "\n  ]\n}\n");
+    return fclose(f) == 0;
+}
+
+} // namespace cxl_intercept
+
+#endif // CXL_DAX_REGION_HPP
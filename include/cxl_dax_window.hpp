@@ -0,0 +1,305 @@
+#ifndef CXL_DAX_WINDOW_HPP
+#define CXL_DAX_WINDOW_HPP
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "cxl_aio_pool.hpp"
+#include "cxl_fd_table.hpp"
+
+// On-demand mapping of a large region in fixed-size windows (FIO_DAX_WINDOW).
+// Mapping a 16TB BAR up front costs the page tables of the whole window,
+// built eagerly for PFN mappings, and the startup time to build them. Here
+// the region stays a PROT_NONE reservation, so pointers into it are stable,
+// and a window is mapped over its slice the first time it is touched.
+//
+// At most max_live windows stay mapped; past that the least recently used
+// unpinned one is retired. Readers touch region memory inside an epoch
+// guard, so a retired window is only returned to PROT_NONE after a grace
+// period, by a reclaimer thread: synchronize() cannot run inside the guards
+// the I/O paths hold. Without an epoch domain the caller serializes every
+// access and windows are unmapped as they are retired.
+//
+// Memory reached without ensure() (the catalog, application mmap()s, lazily
+// persisted files written back later) must be pinned.
+
+namespace cxl_intercept {
+
+class DaxWindowMap {
+public:
+    DaxWindowMap(char* base, size_t size, size_t window, size_t max_live, int fd, EpochDomain* epoch)
+        : base_(base), size_(size), window_(window), shift_(__builtin_ctzll(window)),
+          max_live_(max_live ? max_live : 1), fd_(fd), epoch_(epoch),
+          windows_(new Window[(size + window - 1) / window]) {}
+
+    ~DaxWindowMap() { stop_reclaimer(); }
+
+    size_t window() const { return window_; }
+    size_t max_live() const { return max_live_; }
+    bool map_sync() const { return sync_ == 1; }
+
+    // Make [offset, offset + len) accessible. It stays mapped until the
+    // caller leaves its epoch guard (or, without a domain, its next call),
+    // even if it is retired meanwhile. False with errno set (ENOMEM, or EIO
+    // for other mmap() failures) if a window cannot be mapped.
+    bool ensure(size_t offset, size_t len) {
+        if (len == 0) return true;
+        size_t first = offset >> shift_;
+        size_t last = (offset + len - 1) >> shift_;
+        for (size_t i = first; i <= last; i++) {
+            Window& w = windows_[i];
+            if (!w.live.load(std::memory_order_acquire) && !fault(i, first, last)) return false;
+            uint64_t now = clock_.load(std::memory_order_relaxed);
+            if (w.last_use.load(std::memory_order_relaxed) != now) {
+                w.last_use.store(now, std::memory_order_relaxed);
+            }
+        }
+        return true;
+    }
+
+    // Map [offset, offset + len) and keep it mapped until unpin()
+    bool pin(size_t offset, size_t len) {
+        if (len == 0) return true;
+        std::lock_guard<std::mutex> lk(mu_);
+        size_t first = offset >> shift_;
+        size_t last = (offset + len - 1) >> shift_;
+        for (size_t i = first; i <= last; i++) {
+            if (!windows_[i].live.load(std::memory_order_relaxed) && !install(i, first, last)) {
+                for (size_t j = first; j < i; j++) windows_[j].pins--;
+                return false;
+            }
+            windows_[i].pins++;
+        }
+        return true;
+    }
+
+    // Windows mapped past max_live while pinned are retired once unpinned
+    void unpin(size_t offset, size_t len) {
+        if (len == 0) return;
+        std::lock_guard<std::mutex> lk(mu_);
+        for (size_t i = offset >> shift_; i <= (offset + len - 1) >> shift_; i++) {
+            if (windows_[i].pins) windows_[i].pins--;
+        }
+        while (live_.size() > max_live_ && evict_one(SIZE_MAX, 0)) {}
+    }
+
+    uint64_t maps() const { return maps_.load(std::memory_order_relaxed); }
+    uint64_t evictions() const { return evictions_.load(std::memory_order_relaxed); }
+    size_t peak_live() const { return peak_live_; }
+
+    // pthread_atfork() handlers: the reclaimer does not survive fork(), so
+    // the child starts its own when it next retires a window. (It sleeps on
+    // a futex rather than a condition variable, whose waiter bookkeeping
+    // would still count the parent's thread.)
+    void fork_prepare() { mu_.lock(); }
+    void fork_parent() { mu_.unlock(); }
+    void fork_child() {
+        reclaimer_ = false;
+        mu_.unlock();
+    }
+
+    // Stop the reclaimer before the reservation is unmapped
+    void stop_reclaimer() {
+        std::unique_lock<std::mutex> lk(mu_);
+        stop_ = true;
+        wake_all();
+        while (reclaimer_) sleep(lk);
+    }
+
+private:
+    struct Window {
+        std::atomic<uint32_t> live{0};
+        uint32_t pins = 0;               // under mu_
+        std::atomic<uint64_t> last_use{0};
+        uint64_t retired = 0;            // sequence of the last retirement, under mu_
+    };
+
+    struct Retired {
+        size_t index;
+        uint64_t seq;
+    };
+
+    // Slow path of ensure(): map window i, keeping [first, last] resident.
+    // Running out of mappings fails the access that needed the window.
+    bool fault(size_t i, size_t first, size_t last) {
+        std::lock_guard<std::mutex> lk(mu_);
+        if (windows_[i].live.load(std::memory_order_relaxed)) return true;
+        if (install(i, first, last)) return true;
+        int err = errno == ENOMEM ? ENOMEM : EIO;
+        fprintf(stderr, "[DAX_REGION] Failed to map %zu MB window at offset %zu: %s\n",
+                window_ >> 20, i << shift_, strerror(errno));
+        errno = err;
+        return false;
+    }
+
+    // Under mu_: make room, then map window i over its reservation
+    bool install(size_t i, size_t first, size_t last) {
+        while (live_.size() >= max_live_ && evict_one(first, last)) {}
+        if (!map_window(i)) return false;
+        Window& w = windows_[i];
+        w.last_use.store(clock_.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        w.live.store(1, std::memory_order_release);
+        live_.push_back(i);
+        if (live_.size() > peak_live_) peak_live_ = live_.size();
+        maps_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Under mu_: retire the least recently used unpinned window outside
+    // [first, last]; false if there is none
+    bool evict_one(size_t first, size_t last) {
+        size_t victim = SIZE_MAX, at = 0;
+        uint64_t oldest = UINT64_MAX;
+        for (size_t k = 0; k < live_.size(); k++) {
+            size_t i = live_[k];
+            if (windows_[i].pins || (i >= first && i <= last)) continue;
+            uint64_t t = windows_[i].last_use.load(std::memory_order_relaxed);
+            if (t < oldest) {
+                oldest = t;
+                victim = i;
+                at = k;
+            }
+        }
+        if (victim == SIZE_MAX) return false;
+        live_[at] = live_.back();
+        live_.pop_back();
+        windows_[victim].live.store(0, std::memory_order_release);
+        evictions_.fetch_add(1, std::memory_order_relaxed);
+        if (!epoch_) {
+            reserve_window(victim);
+            return true;
+        }
+        windows_[victim].retired = ++retire_seq_;
+        retired_.push_back({victim, retire_seq_});
+        if (!reclaimer_) start_reclaimer();
+        wake_all();
+        return true;
+    }
+
+    bool map_window(size_t i) {
+        char* addr = base_ + (i << shift_);
+        size_t len = window_len(i);
+        off_t offset = static_cast<off_t>(i << shift_);
+        void* p = MAP_FAILED;
+        if (sync_ != 0) {
+            p = reinterpret_cast<void*>(syscall(SYS_mmap, addr, len, PROT_READ | PROT_WRITE,
+                                                MAP_SHARED_VALIDATE | MAP_SYNC | MAP_FIXED, fd_, offset));
+            if (p != MAP_FAILED) sync_ = 1;
+            else if (errno == EOPNOTSUPP) sync_ = 0;  // not a DAX file
+        }
+        if (sync_ == 0) {
+            p = reinterpret_cast<void*>(syscall(SYS_mmap, addr, len, PROT_READ | PROT_WRITE,
+                                                MAP_SHARED | MAP_FIXED, fd_, offset));
+        }
+        if (p == MAP_FAILED) return false;
+        madvise(addr, len, MADV_HUGEPAGE);
+        return true;
+    }
+
+    // Give window i's slice back to the reservation
+    void reserve_window(size_t i) {
+        syscall(SYS_mmap, base_ + (i << shift_), window_len(i), PROT_NONE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+    }
+
+    size_t window_len(size_t i) const {
+        size_t start = i << shift_;
+        return size_ - start < window_ ? size_ - start : window_;
+    }
+
+    // Under mu_. Detached: a fork() child or an exiting process has no
+    // thread object left to join.
+    void start_reclaimer() {
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        pthread_t tid;
+        reclaimer_ = pthread_create(&tid, &attr, reclaim_main, this) == 0;
+        pthread_attr_destroy(&attr);
+    }
+
+    static void* reclaim_main(void* arg) {
+        // Leave signal handling to the application's threads
+        sigset_t all;
+        sigfillset(&all);
+        pthread_sigmask(SIG_BLOCK, &all, nullptr);
+        static_cast<DaxWindowMap*>(arg)->reclaim_loop();
+        return nullptr;
+    }
+
+    // Under mu_: drop it until the next wake_all()
+    void sleep(std::unique_lock<std::mutex>& lk) {
+        uint32_t seq = wake_.load(std::memory_order_relaxed);
+        lk.unlock();
+        futex_wait(&wake_, seq);
+        lk.lock();
+    }
+
+    void wake_all() {
+        wake_.fetch_add(1, std::memory_order_relaxed);
+        futex_wake(&wake_, INT32_MAX);
+    }
+
+    // Wait out readers that may still use a batch of retired windows, then
+    // unmap those that were not mapped (or retired again) meanwhile
+    void reclaim_loop() {
+        std::unique_lock<std::mutex> lk(mu_);
+        while (!stop_) {
+            if (retired_.empty()) {
+                sleep(lk);
+                continue;
+            }
+            std::vector<Retired> batch;
+            batch.swap(retired_);
+            lk.unlock();
+            epoch_->synchronize();
+            lk.lock();
+            for (const Retired& r : batch) {
+                Window& w = windows_[r.index];
+                if (!w.live.load(std::memory_order_relaxed) && w.retired == r.seq) reserve_window(r.index);
+            }
+        }
+        reclaimer_ = false;
+        wake_all();
+    }
+
+    char* base_;
+    size_t size_;
+    size_t window_;
+    unsigned shift_;
+    size_t max_live_;
+    int fd_;
+    EpochDomain* epoch_;
+    std::unique_ptr<Window[]> windows_;
+    int sync_ = -1;                      // MAP_SYNC works: -1 not yet tried
+
+    std::mutex mu_;
+    std::atomic<uint32_t> wake_{0};      // bumped under mu_ to wake sleepers
+    std::vector<size_t> live_;           // mapped windows, unordered
+    std::vector<Retired> retired_;       // awaiting a grace period
+    uint64_t retire_seq_ = 0;
+    size_t peak_live_ = 0;
+    bool reclaimer_ = false;
+    bool stop_ = false;
+
+    std::atomic<uint64_t> clock_{0};     // advances on every window mapped
+    std::atomic<uint64_t> maps_{0};
+    std::atomic<uint64_t> evictions_{0};
+};
+
+} // namespace cxl_intercept
+
+#endif // CXL_DAX_WINDOW_HPP
@@ -0,0 +1,125 @@
+#ifndef CXL_DIRTY_TRACKER_HPP
+#define CXL_DIRTY_TRACKER_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+#include "cxl_persist.hpp"
+
+// Dirty-granule bitmap for one file in lazy persistence mode. Writers copy
+// with cached stores and mark() the granules (64B lines or 4KB pages) they
+// touched; flush() writes back every marked granule in one pass and fences.
+//
+// A writer marks after its copy, and flush() clears a word before writing
+// its granules back, so a write that completed before flush() started is
+// always covered; one racing with flush() stays marked for the next call.
+
+namespace cxl_intercept {
+
+class DirtyTracker {
+public:
+    DirtyTracker(char* base, size_t size, unsigned granule_shift)
+        : base_(base), size_(size), shift_(granule_shift) {
+        size_t granules = (size + (size_t{1} << shift_) - 1) >> shift_;
+        words_count_ = (granules + 63) / 64;
+        // calloc of a large block maps zero pages lazily; untouched parts of
+        // the bitmap cost no memory
+        words_ = static_cast<std::atomic<uint64_t>*>(calloc(words_count_, sizeof(uint64_t)));
+    }
+    ~DirtyTracker() { free(words_); }
+    DirtyTracker(const DirtyTracker&) = delete;
+    DirtyTracker& operator=(const DirtyTracker&) = delete;
+
+    bool valid() const { return words_ != nullptr; }
+    size_t granule() const { return size_t{1} << shift_; }
+    size_t dirty_bytes() const { return dirty_.load(std::memory_order_relaxed) << shift_; }
+
+    // Record [offset, offset + len) as dirty; returns the bytes now dirty
+    size_t mark(size_t offset, size_t len) {
+        if (len == 0) return dirty_bytes();
+        size_t first = offset >> shift_;
+        size_t last = (offset + len - 1) >> shift_;
+        size_t added = 0;
+        for (size_t w = first / 64; w <= last / 64; w++) {
+            uint64_t mask = range_mask(w, first, last);
+            // Skip the atomic when every bit is already set (rewrites of a
+            // hot line between syncs)
+            uint64_t old = words_[w].load(std::memory_order_relaxed);
+            if ((old & mask) == mask) continue;
+            old = words_[w].fetch_or(mask, std::memory_order_acq_rel);
+            added += __builtin_popcountll(mask & ~old);
+        }
+        return (dirty_.fetch_add(added, std::memory_order_relaxed) + added) << shift_;
+    }
+
+    // Write back dirty granules overlapping [offset, offset + len) and fence.
+    // Returns the number of bytes written back.
+    size_t flush(cxl_ssd::PersistMode mode, size_t offset = 0, size_t len = SIZE_MAX) {
+        if (dirty_.load(std::memory_order_relaxed) == 0 || offset >= size_) return 0;
+        if (len > size_ - offset) len = size_ - offset;
+        if (len == 0) return 0;
+        size_t first = offset >> shift_;
+        size_t last = (offset + len - 1) >> shift_;
+        size_t w_first = first / 64;
+        size_t w_last = last / 64;
+        size_t flushed = 0;
+
+        for (size_t w = w_first; w <= w_last; w++) {
+            // Step over clean stretches four words at a time
+            if ((w & 3) == 0 && w + 3 <= w_last &&
+                (words_[w].load(std::memory_order_relaxed) | words_[w + 1].load(std::memory_order_relaxed) |
+                 words_[w + 2].load(std::memory_order_relaxed) | words_[w + 3].load(std::memory_order_relaxed)) == 0) {
+                w += 3;
+                continue;
+            }
+            if (words_[w].load(std::memory_order_relaxed) == 0) continue;
+
+            uint64_t mask = range_mask(w, first, last);
+            uint64_t bits = mask == ~0ULL ? words_[w].exchange(0, std::memory_order_acq_rel)
+                                          : words_[w].fetch_and(~mask, std::memory_order_acq_rel) & mask;
+            flushed += flush_word(w, bits, mode);
+        }
+        if (flushed) cxl_ssd::persist_fence(cxl_ssd::PersistMode::CLWB);
+        return flushed << shift_;
+    }
+
+private:
+    static uint64_t range_mask(size_t w, size_t first, size_t last) {
+        size_t lo = w == first / 64 ? first % 64 : 0;
+        size_t hi = w == last / 64 ? last % 64 : 63;
+        uint64_t upper = hi == 63 ? ~0ULL : ((1ULL << (hi + 1)) - 1);
+        return upper & ~((1ULL << lo) - 1);
+    }
+
+    // Write back each run of consecutive dirty granules in bits; returns
+    // the number of granules
+    size_t flush_word(size_t w, uint64_t bits, cxl_ssd::PersistMode mode) {
+        size_t count = __builtin_popcountll(bits);
+        if (!count) return 0;
+        dirty_.fetch_sub(count, std::memory_order_relaxed);
+        while (bits) {
+            unsigned start = __builtin_ctzll(bits);
+            uint64_t rest = ~(bits >> start);
+            unsigned run = rest ? __builtin_ctzll(rest) : 64 - start;
+            size_t off = ((w * 64) + start) << shift_;
+            size_t n = static_cast<size_t>(run) << shift_;
+            if (off + n > size_) n = size_ - off;
+            cxl_ssd::persist_flush(base_ + off, n, mode);
+            bits = run + start >= 64 ? 0 : bits & ~(((1ULL << run) - 1) << start);
+        }
+        return count;
+    }
+
+    char* base_;
+    size_t size_;
+    unsigned shift_;
+    size_t words_count_ = 0;
+    std::atomic<uint64_t>* words_ = nullptr;
+    std::atomic<size_t> dirty_{0};
+};
+
+} // namespace cxl_intercept
+
+#endif // CXL_DIRTY_TRACKER_HPP
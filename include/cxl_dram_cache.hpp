@@ -0,0 +1,336 @@
+#ifndef CXL_DRAM_CACHE_HPP
+#define CXL_DRAM_CACHE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <immintrin.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+
+// DRAM page cache in front of the DAX regions (FIO_DAX_CACHE). Reads and
+// writes of intercepted files go through 4KB pages held in local DRAM:
+// a hit is served at DRAM speed, a miss fills the page from the region
+// first. Writes only dirty the cached page; it reaches the region when it
+// is evicted, or when fsync() or close() writes the file back.
+//
+// The cache is set-associative, keyed by the page's address in the region
+// mapping, with CLOCK replacement inside each set. Every set has its own
+// spinlock, held across a fill or write-back so a page is never seen half
+// filled. Fills and write-backs go through the owner passed with the
+// access (the intercept's mapping), which must outlive its pages: the
+// owner writes back and drops its range before it goes away.
+//
+// Either may fail (the region window cannot be mapped). A page that cannot
+// be written back stays dirty and is not evicted; a page with no room left
+// in its set is read or written through to the region instead.
+
+namespace cxl_intercept {
+
+class DramCache {
+public:
+    enum Counter { HITS, MISSES, EVICTIONS, WRITEBACKS, NUM_COUNTERS };
+
+    static constexpr size_t kPage = 4096;
+    static constexpr unsigned kMaxWays = 16;
+
+    // Load the page at dev into page; store page back to dev. False with
+    // errno set if dev cannot be reached.
+    using FillFn = bool (*)(void* owner, const char* dev, char* page);
+    using WriteBackFn = bool (*)(void* owner, char* dev, const char* page);
+
+    // Called once, before any I/O; bytes is rounded down to a power of two
+    // number of sets. False if the pages cannot be allocated.
+    bool configure(size_t bytes, unsigned ways, FillFn fill, WriteBackFn write_back) {
+        if (ways == 0 || ways > kMaxWays) ways = 8;
+        size_t sets = bytes / (ways * kPage);
+        if (sets == 0) return false;
+        unsigned bits = 63 - __builtin_clzll(sets);
+        sets = size_t(1) << bits;
+        void* p = mmap(nullptr, sets * ways * kPage, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (p == MAP_FAILED) return false;
+        madvise(p, sets * ways * kPage, MADV_HUGEPAGE);
+        sets_ = new Set[sets];
+        pages_ = static_cast<char*>(p);
+        num_sets_ = sets;
+        set_shift_ = 64 - bits;
+        ways_ = ways;
+        fill_ = fill;
+        write_back_ = write_back;
+        return true;
+    }
+
+    bool enabled() const { return sets_ != nullptr; }
+    size_t size() const { return num_sets_ * ways_ * kPage; }
+    unsigned ways() const { return ways_; }
+
+    // Copy n bytes at dev into dst; returns the bytes that missed, or -1
+    // with errno set if a fill failed
+    ssize_t read(void* owner, const char* dev, char* dst, size_t n) {
+        ssize_t missed = 0;
+        while (n > 0) {
+            uintptr_t page = reinterpret_cast<uintptr_t>(dev) & ~(kPage - 1);
+            size_t off = reinterpret_cast<uintptr_t>(dev) - page;
+            size_t piece = kPage - off < n ? kPage - off : n;
+            Set& s = set_of(page);
+            lock(s);
+            unsigned way;
+            if (lookup(s, page, &way)) {
+                count(HITS);
+            } else {
+                way = claim(s, page, owner, true);
+                count(MISSES);
+                missed += piece;
+            }
+            if (way < ways_) {
+                memcpy(dst, slot(s, way) + off, piece);
+            } else if (!read_through(owner, page, off, dst, piece)) {
+                unlock(s);
+                return -1;
+            }
+            unlock(s);
+            dev += piece;
+            dst += piece;
+            n -= piece;
+        }
+        return missed;
+    }
+
+    // Copy n bytes from src over dev's cached pages and leave them dirty;
+    // pages written only in part are filled first. Returns the bytes that
+    // missed, or -1 with errno set if a fill or write-through failed.
+    ssize_t write(void* owner, char* dev, const char* src, size_t n) {
+        ssize_t missed = 0;
+        while (n > 0) {
+            uintptr_t page = reinterpret_cast<uintptr_t>(dev) & ~(kPage - 1);
+            size_t off = reinterpret_cast<uintptr_t>(dev) - page;
+            size_t piece = kPage - off < n ? kPage - off : n;
+            Set& s = set_of(page);
+            lock(s);
+            unsigned way;
+            if (lookup(s, page, &way)) {
+                count(HITS);
+            } else {
+                way = claim(s, page, owner, piece != kPage);
+                count(MISSES);
+                missed += piece;
+            }
+            if (way == ways_) {
+                bool written = write_through(owner, page, off, src, piece);
+                unlock(s);
+                if (!written) return -1;
+                dev += piece;
+                src += piece;
+                n -= piece;
+                continue;
+            }
+            memcpy(slot(s, way) + off, src, piece);
+            if (!(s.dirty & (1u << way))) {
+                s.dirty |= 1u << way;
+                dirty_.fetch_add(1, std::memory_order_relaxed);
+            }
+            s.owner[way] = owner;
+            unlock(s);
+            dev += piece;
+            src += piece;
+            n -= piece;
+        }
+        return missed;
+    }
+
+    // Write back the dirty pages overlapping [dev, dev + n), and drop every
+    // cached page there if drop is set; returns the pages written back. A
+    // page that fails to write back stays dirty, or with drop is lost (its
+    // owner is going away, and reported the failure).
+    size_t write_back(const char* dev, size_t n, bool drop) {
+        if (!enabled() || (!drop && dirty_.load(std::memory_order_relaxed) == 0)) return 0;
+        uintptr_t lo = reinterpret_cast<uintptr_t>(dev) & ~(kPage - 1);
+        uintptr_t hi = n > UINTPTR_MAX - reinterpret_cast<uintptr_t>(dev)
+                           ? UINTPTR_MAX : reinterpret_cast<uintptr_t>(dev) + n;
+        size_t written = 0;
+        if ((hi - lo) / kPage < num_sets_) {
+            // Fewer pages than sets: look each one up
+            for (uintptr_t page = lo; page < hi; page += kPage) {
+                Set& s = set_of(page);
+                lock(s);
+                unsigned way;
+                if (lookup(s, page, &way)) written += release(s, way, drop);
+                unlock(s);
+            }
+            return written;
+        }
+        for (size_t i = 0; i < num_sets_; i++) {
+            Set& s = sets_[i];
+            lock(s);
+            for (unsigned w = 0; w < ways_; w++) {
+                if (s.tag[w] >= lo && s.tag[w] < hi) written += release(s, w, drop);
+            }
+            unlock(s);
+        }
+        return written;
+    }
+
+    size_t write_back_all() { return write_back(nullptr, SIZE_MAX, false); }
+
+    // pthread_atfork() child handler, after the parent wrote everything
+    // back in its prepare handler: the child starts empty, as locks held
+    // by threads that did not survive fork() are dropped with the pages
+    void fork_child() {
+        if (!enabled()) return;
+        for (size_t i = 0; i < num_sets_; i++) {
+            Set& s = sets_[i];
+            for (unsigned w = 0; w < ways_; w++) s.tag[w] = 0;
+            s.dirty = s.ref = 0;
+            s.hand = 0;
+            s.busy.store(false, std::memory_order_relaxed);
+        }
+        dirty_.store(0, std::memory_order_relaxed);
+    }
+
+    uint64_t total(Counter counter) const {
+        uint64_t sum = 0;
+        for (const Shard& s : shards_) sum += s.v[counter].load(std::memory_order_relaxed);
+        return sum;
+    }
+
+private:
+    static constexpr int kShards = 16;
+
+    struct alignas(64) Set {
+        std::atomic<bool> busy{false};
+        uint8_t hand = 0;         // CLOCK hand
+        uint16_t dirty = 0;       // way bitmaps
+        uint16_t ref = 0;
+        uintptr_t tag[kMaxWays] = {};  // page address, 0 when the way is free
+        void* owner[kMaxWays] = {};
+    };
+
+    static void lock(Set& s) {
+        while (s.busy.exchange(true, std::memory_order_acquire)) _mm_pause();
+    }
+
+    static void unlock(Set& s) { s.busy.store(false, std::memory_order_release); }
+
+    Set& set_of(uintptr_t page) const {
+        uint64_t hash = (page / kPage) * 0x9E3779B97F4A7C15ULL;
+        return sets_[(hash >> (set_shift_ & 63)) & (num_sets_ - 1)];
+    }
+
+    char* slot(const Set& s, unsigned way) const {
+        return pages_ + ((&s - sets_) * ways_ + way) * kPage;
+    }
+
+    // Under the set's lock: find page, marking it referenced
+    bool lookup(Set& s, uintptr_t page, unsigned* way) {
+        for (unsigned w = 0; w < ways_; w++) {
+            if (s.tag[w] == page) {
+                s.ref |= 1u << w;
+                *way = w;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Under the set's lock: take a free way or evict the first one the
+    // CLOCK hand finds unreferenced, and bind it to page. Returns ways_ if
+    // no page could be written back to make room, or the fill failed.
+    unsigned claim(Set& s, uintptr_t page, void* owner, bool fill) {
+        unsigned way = ways_;
+        for (unsigned w = 0; w < ways_ && way == ways_; w++) {
+            if (s.tag[w] == 0) way = w;
+        }
+        // The first sweep clears every reference; by the end of the second
+        // only pages that failed to write back are left
+        for (unsigned steps = 0; way == ways_; steps++) {
+            if (steps == 2 * ways_) return ways_;
+            unsigned w = s.hand;
+            s.hand = static_cast<uint8_t>((w + 1) % ways_);
+            if (s.ref & (1u << w)) {
+                s.ref &= ~(1u << w);
+            } else if (clean(s, w)) {
+                release(s, w, true);
+                count(EVICTIONS);
+                way = w;
+            }
+        }
+        if (fill && !fill_(owner, reinterpret_cast<const char*>(page), slot(s, way))) return ways_;
+        s.tag[way] = page;
+        s.owner[way] = owner;
+        s.ref |= 1u << way;
+        return way;
+    }
+
+    // Under the set's lock: write the way back if it is dirty; false if
+    // that failed, leaving it dirty
+    bool clean(Set& s, unsigned way) {
+        if (!(s.dirty & (1u << way))) return true;
+        if (!write_back_(s.owner[way], reinterpret_cast<char*>(s.tag[way]), slot(s, way))) return false;
+        s.dirty &= ~(1u << way);
+        dirty_.fetch_sub(1, std::memory_order_relaxed);
+        count(WRITEBACKS);
+        return true;
+    }
+
+    // Under the set's lock: write the way back if dirty, free it if drop;
+    // returns 1 if it was written back
+    size_t release(Set& s, unsigned way, bool drop) {
+        bool dirty = s.dirty & (1u << way);
+        size_t written = dirty && clean(s, way) ? 1 : 0;
+        if (drop) {
+            if (s.dirty & (1u << way)) {
+                s.dirty &= ~(1u << way);
+                dirty_.fetch_sub(1, std::memory_order_relaxed);
+            }
+            s.tag[way] = 0;
+            s.owner[way] = nullptr;
+            s.ref &= ~(1u << way);
+        }
+        return written;
+    }
+
+    // A page claim() found no room for goes straight to or from dev
+    bool read_through(void* owner, uintptr_t page, size_t off, char* dst, size_t n) {
+        alignas(64) char buf[kPage];
+        if (!fill_(owner, reinterpret_cast<const char*>(page), buf)) return false;
+        memcpy(dst, buf + off, n);
+        return true;
+    }
+
+    bool write_through(void* owner, uintptr_t page, size_t off, const char* src, size_t n) {
+        alignas(64) char buf[kPage];
+        if (n != kPage && !fill_(owner, reinterpret_cast<const char*>(page), buf)) return false;
+        memcpy(buf + off, src, n);
+        return write_back_(owner, reinterpret_cast<char*>(page), buf);
+    }
+
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> v[NUM_COUNTERS] = {};
+    };
+
+    static unsigned shard_index() {
+        static std::atomic<unsigned> next{0};
+        static thread_local unsigned index = next.fetch_add(1, std::memory_order_relaxed) % kShards;
+        return index;
+    }
+
+    void count(Counter counter) {
+        shards_[shard_index()].v[counter].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    Set* sets_ = nullptr;
+    char* pages_ = nullptr;
+    size_t num_sets_ = 0;
+    unsigned set_shift_ = 64;
+    unsigned ways_ = 0;
+    FillFn fill_ = nullptr;
+    WriteBackFn write_back_ = nullptr;
+    std::atomic<uint64_t> dirty_{0};  // dirty pages, to skip idle syncs
+    Shard shards_[kShards];
+};
+
+} // namespace cxl_intercept
+
+#endif // CXL_DRAM_CACHE_HPP
@@ -0,0 +1,152 @@
+#ifndef CXL_ENGINE_CORE_HPP
+#define CXL_ENGINE_CORE_HPP
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <immintrin.h>
+
+#include "cxl_aio_pool.hpp"
+#include "cxl_dax_catalog.hpp"
+#include "cxl_dax_region.hpp"
+#include "cxl_fd_table.hpp"
+#include "cxl_persist.hpp"
+
+// The parts of the fio external engine (src/fio_cxl_engine.cpp) that do not
+// need fio's headers: file placement, the copies, and the completion ring
+// its copy workers post to. Kept apart so the tests can exercise them
+// without a configured fio tree.
+
+namespace cxl_intercept {
+
+// An open fio file: its extent in one region
+struct EngineFile {
+    DaxRegion* region;
+    char* base;
+    size_t size;
+    int32_t ns_slot;
+};
+
+// Open key on a region of the given NUMA node when one has room, else on
+// any other, as fio_intercept does without placement rules. Returns the
+// file, or nullptr with errno set: EOPNOTSUPP for a sparse file left by
+// fio_intercept (FIO_DAX_SPARSE, no contiguous extent), ENOSPC when no
+// region has room.
+inline EngineFile* engine_place_file(DaxRegion* regions, int count, int node, const std::string& key,
+                                     uint64_t want) {
+    DaxExtent extent;
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < count; i++) {
+            DaxRegion& region = regions[i];
+            if ((region.node == node) != (pass == 0)) continue;
+            if (region.catalog.acquire_extent(key, want, true, extent)) {
+                if (extent.chunk_map) {
+                    region.catalog.release_extent(extent.ns_slot);
+                    errno = EOPNOTSUPP;
+                    return nullptr;
+                }
+                return new EngineFile{&region, region.base + extent.offset, extent.length, extent.ns_slot};
+            }
+            if (errno != ENOSPC) return nullptr;
+        }
+    }
+    errno = ENOSPC;
+    return nullptr;
+}
+
+inline void engine_release_file(EngineFile* file) {
+    file->region->catalog.release_extent(file->ns_slot);
+    delete file;
+}
+
+// Store n bytes from src at dst, durable on return; blocks a thin region
+// holds as zero are filled first, as fio_intercept does
+inline void engine_store(DaxRegion* region, char* dst, const char* src, size_t n, cxl_ssd::PersistMode mode) {
+    ZeroMap& zeros = region->catalog.zero_map;
+    if (zeros.in_use()) {
+        zeros.write(dst, src, n, false, [mode](char* to, const char* from, size_t len, bool claimed) {
+            cxl_ssd::persist_copy_nofence(to, from, len, mode);
+            if (claimed) cxl_ssd::persist_fence(mode);
+        });
+    } else {
+        cxl_ssd::persist_copy_nofence(dst, src, n, mode);
+    }
+    cxl_ssd::persist_fence(mode);
+}
+
+inline void engine_load(DaxRegion* region, const char* src, char* dst, size_t n) {
+    ZeroMap& zeros = region->catalog.zero_map;
+    if (zeros.in_use()) {
+        zeros.read(src, dst, n, [](char* to, const char* from, size_t len) { memcpy(to, from, len); });
+    } else {
+        memcpy(dst, src, n);
+    }
+}
+
+// Copy n bytes between buf and the file at offset under an epoch guard;
+// returns 0, EINVAL if the range is not inside the file, or the errno of a
+// window that could not be mapped. mode must be an eager persistence mode.
+inline int engine_copy(EpochDomain& epoch, const EngineFile* file, bool read, uint64_t offset, void* buf,
+                       size_t n, cxl_ssd::PersistMode mode) {
+    if (!file || offset > file->size || n > file->size - offset) return EINVAL;
+    char* addr = file->base + offset;
+    EpochDomain::Guard guard(epoch);
+    if (!file->region->ensure(addr, n)) return errno;
+    if (read) engine_load(file->region, addr, static_cast<char*>(buf), n);
+    else engine_store(file->region, addr, static_cast<const char*>(buf), n, mode);
+    return 0;
+}
+
+// Completion ring of one fio job: copy workers post finished units, the
+// job's thread reaps them and sleeps on a futex until enough have completed
+template <typename T>
+class EngineCompletions {
+public:
+    // At most depth units are in flight
+    explicit EngineCompletions(unsigned depth) : done_(depth + 1) {}
+
+    void complete(T* unit) {
+        // The ring holds every unit in flight
+        while (!done_.try_push(unit)) _mm_pause();
+        completions_.fetch_add(1, std::memory_order_release);
+        // Pairs with the waiter's increment-then-recheck in reap()
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (waiting_.load(std::memory_order_relaxed)) futex_wake(&completions_, 1);
+    }
+
+    // Move completed units to out, up to max in all; wait until it holds
+    // min, or with a timeout at most until the timeout passes once.
+    // Returns out.size().
+    size_t reap(std::vector<T*>& out, unsigned min, unsigned max, const struct timespec* timeout) {
+        T* unit;
+        for (;;) {
+            uint32_t seen = completions_.load(std::memory_order_acquire);
+            while (out.size() < max && done_.try_pop(unit)) out.push_back(unit);
+            if (out.size() >= min) break;
+            waiting_.fetch_add(1, std::memory_order_seq_cst);
+            if (completions_.load(std::memory_order_acquire) == seen) {
+                futex_wait(&completions_, seen, timeout);
+                if (timeout) {
+                    waiting_.fetch_sub(1, std::memory_order_relaxed);
+                    while (out.size() < max && done_.try_pop(unit)) out.push_back(unit);
+                    break;
+                }
+            }
+            waiting_.fetch_sub(1, std::memory_order_relaxed);
+        }
+        return out.size();
+    }
+
+private:
+    MpmcRing<T*> done_;
+    alignas(64) std::atomic<uint32_t> completions_{0};
+    std::atomic<uint32_t> waiting_{0};
+};
+
+} // namespace cxl_intercept
+
+#endif // CXL_ENGINE_CORE_HPP
@@ -0,0 +1,186 @@
+#ifndef CXL_FD_TABLE_HPP
+#define CXL_FD_TABLE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <sched.h>
+#include <vector>
+#include <immintrin.h>
+
+// Lock-free descriptor table for the LD_PRELOAD intercept libraries.
+// Lookups on the I/O path are a range check plus one atomic load; open/close
+// take a mutex and close() waits for an epoch grace period before freeing.
+
+namespace cxl_intercept {
+
+// Epoch-based reclamation domain (userspace RCU). Readers announce the
+// current epoch while they may dereference a published object; writers
+// unpublish, then synchronize() until every reader that could have seen
+// the old pointer has left.
+class EpochDomain {
+public:
+    static constexpr size_t kMaxReaders = 1024;
+
+    class Guard {
+    public:
+        explicit Guard(EpochDomain& d) : domain_(d) { domain_.enter(); }
+        ~Guard() { domain_.leave(); }
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+    private:
+        EpochDomain& domain_;
+    };
+
+    void enter() {
+        ThreadState& ts = thread_state();
+        if (ts.depth++ > 0) return;
+        if (!ts.slot) ts.slot = acquire_slot();
+        if (ts.slot) {
+            ts.slot->epoch.store(global_.load(std::memory_order_relaxed),
+                                 std::memory_order_relaxed);
+        } else {
+            overflow_readers_.fetch_add(1, std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    void leave() {
+        ThreadState& ts = thread_state();
+        if (--ts.depth > 0) return;
+        if (ts.slot) {
+            ts.slot->epoch.store(0, std::memory_order_release);
+        } else {
+            overflow_readers_.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    // Wait for a grace period. Must not be called from inside a Guard.
+    void synchronize() {
+        uint64_t target = global_.fetch_add(1, std::memory_order_seq_cst) + 1;
+        for (size_t i = 0; i < kMaxReaders; i++) {
+            Slot& s = slots_[i];
+            if (!s.used.load(std::memory_order_acquire)) continue;
+            for (unsigned spins = 0;; spins++) {
+                uint64_t e = s.epoch.load(std::memory_order_acquire);
+                if (e == 0 || e >= target) break;
+                backoff(spins);
+            }
+        }
+        for (unsigned spins = 0; overflow_readers_.load(std::memory_order_acquire) != 0; spins++) {
+            backoff(spins);
+        }
+    }
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch{0};
+        std::atomic<bool> used{false};
+    };
+
+    struct ThreadState {
+        Slot* slot = nullptr;
+        unsigned depth = 0;
+        ~ThreadState() {
+            if (slot) slot->used.store(false, std::memory_order_release);
+        }
+    };
+
+    // One domain per intercept library, so a single thread_local suffices.
+    ThreadState& thread_state() {
+        static thread_local ThreadState ts;
+        return ts;
+    }
+
+    Slot* acquire_slot() {
+        for (size_t i = 0; i < kMaxReaders; i++) {
+            bool expected = false;
+            if (!slots_[i].used.load(std::memory_order_relaxed) &&
+                slots_[i].used.compare_exchange_strong(expected, true,
+                                                       std::memory_order_acq_rel)) {
+                slots_[i].epoch.store(0, std::memory_order_relaxed);
+                return &slots_[i];
+            }
+        }
+        return nullptr;
+    }
+
+    static void backoff(unsigned spins) {
+        if (spins < 64) _mm_pause();
+        else sched_yield();
+    }
+
+    alignas(64) std::atomic<uint64_t> global_{1};
+    alignas(64) std::atomic<uint32_t> overflow_readers_{0};
+    Slot slots_[kMaxReaders];
+};
+
+// Flat table of fake descriptors [base, base + N). Each slot sits on its own
+// cache line so threads working on different fds never share a line.
+template <typename T, size_t N>
+class FakeFdTable {
+public:
+    constexpr explicit FakeFdTable(int base) : base_(base) {}
+
+    bool in_range(int fd) const {
+        return static_cast<unsigned>(fd - base_) < N;
+    }
+
+    // Caller must hold an EpochDomain::Guard while using the result.
+    T* lookup(int fd) const {
+        if (!in_range(fd)) return nullptr;
+        return slots_[fd - base_].obj.load(std::memory_order_acquire);
+    }
+
+    // Publish obj under a free descriptor; -1 when the table is full.
+    int install(T* obj) {
+        std::lock_guard<std::mutex> lock(alloc_mu_);
+        size_t idx;
+        if (!free_.empty()) {
+            idx = free_.back();
+            free_.pop_back();
+        } else if (next_ < N) {
+            idx = next_++;
+        } else {
+            return -1;
+        }
+        slots_[idx].obj.store(obj, std::memory_order_release);
+        return base_ + static_cast<int>(idx);
+    }
+
+    // Unpublish fd. The returned object may only be freed after a grace period.
+    T* remove(int fd) {
+        if (!in_range(fd)) return nullptr;
+        std::lock_guard<std::mutex> lock(alloc_mu_);
+        size_t idx = static_cast<size_t>(fd - base_);
+        T* obj = slots_[idx].obj.exchange(nullptr, std::memory_order_seq_cst);
+        if (obj) free_.push_back(idx);
+        return obj;
+    }
+
+    // Visit every live entry (slow path; for shutdown and reporting).
+    template <typename Fn>
+    void for_each(Fn&& fn) {
+        std::lock_guard<std::mutex> lock(alloc_mu_);
+        for (size_t i = 0; i < next_; i++) {
+            T* obj = slots_[i].obj.load(std::memory_order_acquire);
+            if (obj) fn(base_ + static_cast<int>(i), obj);
+        }
+    }
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<T*> obj{nullptr};
+    };
+
+    const int base_;
+    Slot slots_[N];
+    std::mutex alloc_mu_;
+    size_t next_ = 0;
+    std::vector<size_t> free_;
+};
+
+} // namespace cxl_intercept
+
+#endif // CXL_FD_TABLE_HPP
@@ -0,0 +1,179 @@
+#ifndef CXL_INTEGRITY_HPP
+#define CXL_INTEGRITY_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "cxl_crc32c.hpp"
+
+// End-to-end data verification for a DAX region (FIO_DAX_VERIFY). The
+// region is cut into fixed-size blocks; every write through the intercept
+// stores the CRC32C of the blocks it touched in a side table, and every
+// read checks the blocks it copied against it. The table is anonymous
+// shared memory, so fork()ed workers (fio jobs) share their checksums;
+// blocks no process of the tree wrote have none and are not checked.
+//
+// Each 64-bit table entry doubles as a seqlock for its block:
+//   [0, 32)   CRC32C of the block
+//   32        checksum valid
+//   33        excluded: writable through an application mmap(), so the
+//             intercept no longer sees every store to it
+//   [34, 48)  writes in flight
+//   [48, 64)  generation, bumped by every write that starts
+// A write marks the block in flight and invalid before its stores; the
+// writer that finishes last, with no write started since its own, publishes
+// the new CRC. A read verifies only if the entry was valid before its copy
+// and unchanged after its check, so racing writes skip a check rather than
+// report a false mismatch.
+
+namespace cxl_intercept {
+
+class DaxIntegrity {
+public:
+    enum Counter { CHECKSUMMED, VERIFIED, MISMATCHES, UNVERIFIED, NUM_COUNTERS };
+
+    // Cover [base, base + size) in blocks of block bytes (a power of two)
+    bool attach(const char* base, size_t size, size_t block) {
+        size_t entries = (size + block - 1) / block;
+        void* p = reinterpret_cast<void*>(syscall(SYS_mmap, nullptr, entries * sizeof(uint64_t),
+                                                  PROT_READ | PROT_WRITE,
+                                                  MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0));
+        if (p == MAP_FAILED) return false;
+        base_ = base;
+        block_ = block;
+        shift_ = __builtin_ctzll(block);
+        entries_ = entries;
+        table_ = static_cast<std::atomic<uint64_t>*>(p);
+        return true;
+    }
+
+    void detach() {
+        if (table_) syscall(SYS_munmap, table_, entries_ * sizeof(uint64_t));
+        table_ = nullptr;
+    }
+
+    bool enabled() const { return table_ != nullptr; }
+    size_t block() const { return block_; }
+
+    // Start of the block holding addr
+    const char* block_start(const char* addr) const {
+        return base_ + (static_cast<size_t>(addr - base_) & ~(block_ - 1));
+    }
+
+    // Before storing into the block holding addr; returns the ticket for
+    // end_write()
+    uint32_t begin_write(const char* addr) {
+        std::atomic<uint64_t>& e = entry(addr);
+        uint64_t old = e.load(std::memory_order_relaxed);
+        uint64_t next;
+        do {
+            next = ((old & ~kValid) + kInflightOne + kGenOne);
+        } while (!e.compare_exchange_weak(old, next, std::memory_order_acq_rel, std::memory_order_relaxed));
+        return static_cast<uint32_t>(next >> kGenShift);
+    }
+
+    // After the stores. whole is the new content of the entire block when
+    // the caller has it in DRAM (a full-block write), else nullptr and the
+    // block is read back.
+    void end_write(const char* addr, uint32_t ticket, const void* whole) {
+        std::atomic<uint64_t>& e = entry(addr);
+        uint64_t cur = e.load(std::memory_order_acquire);
+        if (!(cur & kExcluded) && inflight(cur) == 1 && (cur >> kGenShift) == ticket) {
+            uint32_t crc = crc32c(whole ? whole : block_start(addr), block_);
+            uint64_t next = ((cur - kInflightOne) & ~kCrcMask) | kValid | crc;
+            if (e.compare_exchange_strong(cur, next, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+                bump(CHECKSUMMED);
+                return;
+            }
+        }
+        e.fetch_sub(kInflightOne, std::memory_order_acq_rel);
+    }
+
+    // Before copying out of the block holding addr
+    uint64_t begin_read(const char* addr) { return entry(addr).load(std::memory_order_acquire); }
+
+    // After the copy: check the block against the entry begin_read() saw.
+    // whole is the caller's copy of the entire block, if it has one.
+    // False only on a mismatch.
+    bool end_read(const char* addr, uint64_t seen, const void* whole) {
+        if (!(seen & kValid) || inflight(seen)) {
+            bump(UNVERIFIED);
+            return true;
+        }
+        uint32_t crc = crc32c(whole ? whole : block_start(addr), block_);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (entry(addr).load(std::memory_order_relaxed) != seen) {
+            bump(UNVERIFIED);
+            return true;
+        }
+        if (crc == static_cast<uint32_t>(seen)) {
+            bump(VERIFIED);
+            return true;
+        }
+        bump(MISMATCHES);
+        return false;
+    }
+
+    // Stop checking [addr, addr + len): stores can reach it unseen
+    void exclude(const char* addr, size_t len) {
+        if (len == 0) return;
+        size_t first = static_cast<size_t>(addr - base_) >> shift_;
+        size_t last = static_cast<size_t>(addr + len - 1 - base_) >> shift_;
+        for (size_t i = first; i <= last && i < entries_; i++) {
+            uint64_t old = table_[i].load(std::memory_order_relaxed);
+            while (!table_[i].compare_exchange_weak(old, (old & ~kValid) | kExcluded,
+                                                    std::memory_order_acq_rel, std::memory_order_relaxed)) {}
+        }
+    }
+
+    uint64_t total(Counter counter) const {
+        uint64_t sum = 0;
+        for (const Shard& s : shards_) sum += s.v[counter].load(std::memory_order_relaxed);
+        return sum;
+    }
+
+private:
+    static constexpr uint64_t kCrcMask = 0xffffffffULL;
+    static constexpr uint64_t kValid = 1ULL << 32;
+    static constexpr uint64_t kExcluded = 1ULL << 33;
+    static constexpr uint64_t kInflightOne = 1ULL << 34;
+    static constexpr uint64_t kInflightMask = ((1ULL << 14) - 1) << 34;
+    static constexpr unsigned kGenShift = 48;
+    static constexpr uint64_t kGenOne = 1ULL << kGenShift;
+    static constexpr int kShards = 16;
+
+    static uint64_t inflight(uint64_t e) { return (e & kInflightMask) >> 34; }
+
+    std::atomic<uint64_t>& entry(const char* addr) {
+        return table_[static_cast<size_t>(addr - base_) >> shift_];
+    }
+
+    void bump(Counter counter) {
+        shards_[shard_index()].v[counter].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> v[NUM_COUNTERS] = {};
+    };
+
+    static unsigned shard_index() {
+        static std::atomic<unsigned> next{0};
+        static thread_local unsigned index = next.fetch_add(1, std::memory_order_relaxed) % kShards;
+        return index;
+    }
+
+    const char* base_ = nullptr;
+    size_t block_ = 0;
+    unsigned shift_ = 0;
+    size_t entries_ = 0;
+    std::atomic<uint64_t>* table_ = nullptr;
+    Shard shards_[kShards];
+};
+
+} // namespace cxl_intercept
+
+#endif // CXL_INTEGRITY_HPP
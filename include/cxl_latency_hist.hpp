@@ -0,0 +1,317 @@
+#ifndef CXL_LATENCY_HIST_HPP
+#define CXL_LATENCY_HIST_HPP
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <x86intrin.h>
+
+#include "cxl_trace.hpp"
+
+// Device-side latency histograms for the intercept libraries. Each thread
+// records TSC cycles spent in the copy + persist of an operation into its
+// own per-file, per-op histograms with plain (single-writer) stores; the
+// histograms of every thread are merged at exit and written as JSON shaped
+// like fio's clat_ns block (FIO_LAT_HIST_FILE).
+
+namespace cxl_intercept {
+
+enum class LatOp : uint8_t {
+    READ = 0,
+    WRITE,
+    SYNC,
+    COUNT
+};
+
+inline const char* lat_op_name(LatOp op) {
+    switch (op) {
+        case LatOp::READ: return "read";
+        case LatOp::WRITE: return "write";
+        case LatOp::SYNC: return "sync";
+        default: return "unknown";
+    }
+}
+
+// Log-linear histogram: exact below 64 cycles, then 32 buckets per power of
+// two (about 3% relative error) up to 2^45 cycles
+class LatencyHistogram {
+public:
+    static constexpr unsigned kSubBits = 5;
+    static constexpr unsigned kSub = 1u << kSubBits;
+    static constexpr unsigned kMaxShift = 40;
+    static constexpr unsigned kBuckets = (kMaxShift + 2) * kSub;
+
+    static unsigned bucket_of(uint64_t v) {
+        if (v < 2 * kSub) return static_cast<unsigned>(v);
+        unsigned shift = (63 - __builtin_clzll(v)) - kSubBits;
+        if (shift > kMaxShift) return kBuckets - 1;
+        return shift * kSub + static_cast<unsigned>(v >> shift);
+    }
+
+    static uint64_t bucket_low(unsigned i) {
+        if (i < 2 * kSub) return i;
+        return static_cast<uint64_t>(i % kSub + kSub) << (i / kSub - 1);
+    }
+
+    static uint64_t bucket_high(unsigned i) {
+        if (i < 2 * kSub) return i;
+        return (static_cast<uint64_t>(i % kSub + kSub + 1) << (i / kSub - 1)) - 1;
+    }
+
+    // Only the owning thread records, so counters need no read-modify-write
+    void record(uint64_t cycles) {
+        bump(counts_[bucket_of(cycles)], 1);
+        bump(n_, 1);
+        bump(sum_, cycles);
+        sumsq_.store(sumsq_.load(std::memory_order_relaxed) + double(cycles) * double(cycles),
+                     std::memory_order_relaxed);
+        if (cycles < min_.load(std::memory_order_relaxed)) min_.store(cycles, std::memory_order_relaxed);
+        if (cycles > max_.load(std::memory_order_relaxed)) max_.store(cycles, std::memory_order_relaxed);
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (unsigned i = 0; i < kBuckets; i++) {
+            uint64_t c = other.counts_[i].load(std::memory_order_relaxed);
+            if (c) bump(counts_[i], c);
+        }
+        bump(n_, other.count());
+        bump(sum_, other.sum_.load(std::memory_order_relaxed));
+        sumsq_.store(sumsq_.load(std::memory_order_relaxed) + other.sumsq_.load(std::memory_order_relaxed),
+                     std::memory_order_relaxed);
+        if (other.min() < min()) min_.store(other.min(), std::memory_order_relaxed);
+        if (other.max() > max()) max_.store(other.max(), std::memory_order_relaxed);
+    }
+
+    void reset() {
+        for (auto& c : counts_) c.store(0, std::memory_order_relaxed);
+        n_.store(0, std::memory_order_relaxed);
+        sum_.store(0, std::memory_order_relaxed);
+        sumsq_.store(0.0, std::memory_order_relaxed);
+        min_.store(UINT64_MAX, std::memory_order_relaxed);
+        max_.store(0, std::memory_order_relaxed);
+    }
+
+    uint64_t count() const { return n_.load(std::memory_order_relaxed); }
+    uint64_t min() const { return min_.load(std::memory_order_relaxed); }
+    uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+    uint64_t bucket_count(unsigned i) const { return counts_[i].load(std::memory_order_relaxed); }
+
+    double mean() const { return count() ? double(sum_.load(std::memory_order_relaxed)) / count() : 0.0; }
+
+    double stddev() const {
+        uint64_t n = count();
+        if (n < 2) return 0.0;
+        double m = mean();
+        double var = sumsq_.load(std::memory_order_relaxed) / n - m * m;
+        return var > 0 ? std::sqrt(var * n / (n - 1)) : 0.0;
+    }
+
+    // Midpoint of the bucket holding the p-th percentile, clamped to the
+    // exact min and max
+    uint64_t percentile(double p) const {
+        uint64_t n = count();
+        if (!n) return 0;
+        uint64_t rank = static_cast<uint64_t>(std::ceil(p / 100.0 * n));
+        if (rank == 0) rank = 1;
+        uint64_t seen = 0;
+        for (unsigned i = 0; i < kBuckets; i++) {
+            seen += bucket_count(i);
+            if (seen >= rank) {
+                uint64_t v = (bucket_low(i) + bucket_high(i)) / 2;
+                return v < min() ? min() : v > max() ? max() : v;
+            }
+        }
+        return max();
+    }
+
+private:
+    static void bump(std::atomic<uint64_t>& c, uint64_t v) {
+        c.store(c.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> counts_[kBuckets] = {};
+    std::atomic<uint64_t> n_{0};
+    std::atomic<uint64_t> sum_{0};
+    std::atomic<double> sumsq_{0.0};
+    std::atomic<uint64_t> min_{UINT64_MAX};
+    std::atomic<uint64_t> max_{0};
+};
+
+// fio's default completion-latency percentiles
+inline constexpr double kFioPercentiles[] = {
+    1, 5, 10, 20, 30, 40, 50, 60, 70, 80, 90, 95, 99, 99.5, 99.9, 99.95, 99.99
+};
+
+// {"clat_ns": {min, max, mean, stddev, N, percentile, bins}} in nanoseconds
+inline void write_clat_ns(FILE* f, const LatencyHistogram& h, double ns_per_cycle) {
+    fprintf(f, "{\"clat_ns\": {\"min\": %llu, \"max\": %llu, \"mean\": %.3f, \"stddev\": %.3f, \"N\": %llu, "
+            "\"percentile\": {",
+            (unsigned long long)std::llround(h.min() * ns_per_cycle),
+            (unsigned long long)std::llround(h.max() * ns_per_cycle),
+            h.mean() * ns_per_cycle, h.stddev() * ns_per_cycle, (unsigned long long)h.count());
+    bool first = true;
+    for (double p : kFioPercentiles) {
+        fprintf(f, "%s\"%f\": %llu", first ? "" : ", ", p,
+                (unsigned long long)std::llround(h.percentile(p) * ns_per_cycle));
+        first = false;
+    }
+    fprintf(f, "}, \"bins\": {");
+    first = true;
+    for (unsigned i = 0; i < LatencyHistogram::kBuckets; i++) {
+        uint64_t c = h.bucket_count(i);
+        if (!c) continue;
+        uint64_t mid = (LatencyHistogram::bucket_low(i) + LatencyHistogram::bucket_high(i)) / 2;
+        fprintf(f, "%s\"%llu\": %llu", first ? "" : ", ",
+                (unsigned long long)std::llround(mid * ns_per_cycle), (unsigned long long)c);
+        first = false;
+    }
+    fprintf(f, "}}}");
+}
+
+class LatencyRecorder {
+public:
+    static constexpr uint32_t kMaxFiles = 65536;
+
+    // Enable if FIO_LAT_HIST_FILE is set; %p and %n expand as for traces
+    void init_from_env(const char* source) {
+        const char* env = getenv("FIO_LAT_HIST_FILE");
+        if (!env || !*env) return;
+        source_ = source;
+        path_template_ = env;
+        tsc_hz_ = calibrate_tsc_hz();
+        enabled_ = tsc_hz_ != 0;
+    }
+
+    bool enabled() const { return enabled_; }
+    uint64_t begin() const { return enabled_ ? __rdtsc() : 0; }
+
+    // Histogram id for an fd opened on path; the same pair gets the same id
+    // across re-opens. 0 (no recording) when disabled or out of ids.
+    uint32_t register_file(int fd, const std::string& path) {
+        if (!enabled_) return 0;
+        std::lock_guard<std::mutex> lk(files_mu_);
+        for (size_t i = files_.size(); i-- > 0;) {
+            if (files_[i].fd == fd && files_[i].path == path) return static_cast<uint32_t>(i + 1);
+        }
+        if (files_.size() + 1 >= kMaxFiles) return 0;
+        files_.push_back({fd, path});
+        return static_cast<uint32_t>(files_.size());
+    }
+
+    void record(uint32_t id, LatOp op, uint64_t t0) {
+        if (!t0 || !id) return;
+        uint64_t cycles = __rdtsc() - t0;
+        if (LatencyHistogram* h = histogram(id, op)) h->record(cycles);
+    }
+
+    // Merge every thread's histograms and write the JSON file
+    void shutdown() {
+        if (!enabled_) return;
+        enabled_ = false;
+        std::vector<FileInfo> files;
+        {
+            std::lock_guard<std::mutex> lk(files_mu_);
+            files = files_;
+        }
+        std::string path = expand_path_template(path_template_, source_);
+        FILE* f = fopen(path.c_str(), "w");
+        if (!f) return;
+
+        double ns_per_cycle = 1e9 / double(tsc_hz_);
+        fprintf(f, "{\n  \"library\": \"%s\",\n  \"pid\": %d,\n  \"tsc_hz\": %llu,\n  \"files\": [",
+                source_.c_str(), static_cast<int>(getpid()), (unsigned long long)tsc_hz_);
+        std::lock_guard<std::mutex> lk(threads_mu_);
+        bool first_file = true;
+        LatencyHistogram* merged = new LatencyHistogram[static_cast<size_t>(LatOp::COUNT)];
+        for (uint32_t id = 1; id <= files.size(); id++) {
+            bool any = false;
+            for (unsigned op = 0; op < static_cast<unsigned>(LatOp::COUNT); op++) {
+                merged[op].reset();
+                for (ThreadState* ts : threads_) {
+                    if (const LatencyHistogram* h = ts->find(id, static_cast<LatOp>(op))) merged[op].merge(*h);
+                }
+                any = any || merged[op].count() > 0;
+            }
+            if (!any) continue;
+            const FileInfo& file = files[id - 1];
+            fprintf(f, "%s\n    {\"fd\": %d, \"path\": \"%s\"", first_file ? "" : ",", file.fd,
+                    file.path.c_str());
+            for (unsigned op = 0; op < static_cast<unsigned>(LatOp::COUNT); op++) {
+                if (!merged[op].count()) continue;
+                fprintf(f, ", \"%s\": ", lat_op_name(static_cast<LatOp>(op)));
+                write_clat_ns(f, merged[op], ns_per_cycle);
+            }
+            fprintf(f, "}");
+            first_file = false;
+        }
+        delete[] merged;
+        fprintf(f, "\n  ]\n}\n");
+        fclose(f);
+    }
+
+private:
+    struct FileInfo {
+        int fd;
+        std::string path;
+    };
+
+    // Two-level id -> histogram table owned by one thread; other threads
+    // only read it at shutdown, so slots are published with release stores
+    struct ThreadState {
+        static constexpr uint32_t kBlockIds = 256;
+        static constexpr unsigned kOps = static_cast<unsigned>(LatOp::COUNT);
+
+        struct Block {
+            std::atomic<LatencyHistogram*> slots[kBlockIds * kOps] = {};
+        };
+
+        std::atomic<Block*> blocks[kMaxFiles / kBlockIds] = {};
+
+        LatencyHistogram* find(uint32_t id, LatOp op) const {
+            Block* b = blocks[id / kBlockIds].load(std::memory_order_acquire);
+            if (!b) return nullptr;
+            return b->slots[(id % kBlockIds) * kOps + static_cast<unsigned>(op)].load(std::memory_order_acquire);
+        }
+
+        LatencyHistogram* get(uint32_t id, LatOp op) {
+            if (LatencyHistogram* h = find(id, op)) return h;
+            Block* b = blocks[id / kBlockIds].load(std::memory_order_relaxed);
+            if (!b) {
+                b = new Block;
+                blocks[id / kBlockIds].store(b, std::memory_order_release);
+            }
+            LatencyHistogram* h = new LatencyHistogram;
+            b->slots[(id % kBlockIds) * kOps + static_cast<unsigned>(op)].store(h, std::memory_order_release);
+            return h;
+        }
+    };
+
+    LatencyHistogram* histogram(uint32_t id, LatOp op) {
+        static thread_local ThreadState* state = nullptr;
+        if (!state) {
+            state = new ThreadState;
+            std::lock_guard<std::mutex> lk(threads_mu_);
+            threads_.push_back(state);
+        }
+        return state->get(id, op);
+    }
+
+    bool enabled_ = false;
+    uint64_t tsc_hz_ = 0;
+    std::string source_;
+    std::string path_template_;
+    std::mutex files_mu_;
+    std::vector<FileInfo> files_;
+    std::mutex threads_mu_;
+    std::vector<ThreadState*> threads_;
+};
+
+} // namespace cxl_intercept
+
+#endif // CXL_LATENCY_HIST_HPP
@@ -0,0 +1,227 @@
+#ifndef CXL_PERSIST_HPP
+#define CXL_PERSIST_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <cpuid.h>
+#include <immintrin.h>
+
+// Persistence strategies for stores to DAX/CXL memory.
+//
+//   clflushopt  memcpy, then CLFLUSHOPT every touched line (evicts the lines)
+//   clwb        memcpy, then CLWB every touched line (lines stay cached)
+//   nt          non-temporal stores for whole lines, CLWB for partial edges
+//   none        plain memcpy; for eADR platforms or volatile CXL memory
+//   clflush     legacy serializing CLFLUSH, used when CLFLUSHOPT is missing
+//   lazy        plain memcpy; the caller records dirty lines and writes them
+//               back (CLWB) at fsync time. Users that cannot track dirty
+//               lines run it as clwb via eager_persist_mode().
+//
+// Every strategy but none finishes with an SFENCE.
+
+namespace cxl_ssd {
+
+enum class PersistMode {
+    CLFLUSHOPT,
+    CLWB,
+    NT_STORE,
+    NONE,
+    CLFLUSH,
+    LAZY
+};
+
+inline const char* persist_mode_name(PersistMode mode) {
+    switch (mode) {
+        case PersistMode::CLFLUSHOPT: return "clflushopt";
+        case PersistMode::CLWB: return "clwb";
+        case PersistMode::NT_STORE: return "nt";
+        case PersistMode::NONE: return "none";
+        case PersistMode::CLFLUSH: return "clflush";
+        case PersistMode::LAZY: return "lazy";
+    }
+    return "unknown";
+}
+
+inline bool parse_persist_mode(const char* name, PersistMode& mode) {
+    if (!name) return false;
+    if (strcmp(name, "clflushopt") == 0) mode = PersistMode::CLFLUSHOPT;
+    else if (strcmp(name, "clwb") == 0) mode = PersistMode::CLWB;
+    else if (strcmp(name, "nt") == 0 || strcmp(name, "ntstore") == 0) mode = PersistMode::NT_STORE;
+    else if (strcmp(name, "none") == 0 || strcmp(name, "eadr") == 0) mode = PersistMode::NONE;
+    else if (strcmp(name, "clflush") == 0) mode = PersistMode::CLFLUSH;
+    else if (strcmp(name, "lazy") == 0) mode = PersistMode::LAZY;
+    else return false;
+    return true;
+}
+
+namespace persist_detail {
+
+constexpr size_t kLine = 64;
+
+struct CpuFeatures {
+    bool clflushopt = false;
+    bool clwb = false;
+    bool avx2 = false;
+
+    CpuFeatures() {
+        unsigned int eax, ebx, ecx, edx;
+        if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+            clflushopt = ebx & (1u << 23);
+            clwb = ebx & (1u << 24);
+            avx2 = ebx & (1u << 5);
+        }
+    }
+};
+
+inline const CpuFeatures& cpu() {
+    static const CpuFeatures features;
+    return features;
+}
+
+__attribute__((target("clflushopt")))
+inline void flush_lines_clflushopt(uintptr_t start, uintptr_t end) {
+    for (uintptr_t p = start; p < end; p += kLine) _mm_clflushopt(reinterpret_cast<void*>(p));
+}
+
+__attribute__((target("clwb")))
+inline void flush_lines_clwb(uintptr_t start, uintptr_t end) {
+    for (uintptr_t p = start; p < end; p += kLine) _mm_clwb(reinterpret_cast<void*>(p));
+}
+
+inline void flush_lines_clflush(uintptr_t start, uintptr_t end) {
+    for (uintptr_t p = start; p < end; p += kLine) _mm_clflush(reinterpret_cast<void*>(p));
+}
+
+// Stream whole lines; dst must be 64B aligned and n a multiple of 64
+__attribute__((target("avx2")))
+inline void stream_lines_avx2(char* dst, const char* src, size_t n) {
+    for (size_t i = 0; i < n; i += kLine) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 32));
+        _mm256_stream_si256(reinterpret_cast<__m256i*>(dst + i), a);
+        _mm256_stream_si256(reinterpret_cast<__m256i*>(dst + i + 32), b);
+    }
+}
+
+inline void stream_lines_sse2(char* dst, const char* src, size_t n) {
+    for (size_t i = 0; i < n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_stream_si128(reinterpret_cast<__m128i*>(dst + i), v);
+    }
+}
+
+inline void stream_lines(char* dst, const char* src, size_t n) {
+    if (cpu().avx2) stream_lines_avx2(dst, src, n);
+    else stream_lines_sse2(dst, src, n);
+}
+
+} // namespace persist_detail
+
+// Downgrade a mode the CPU cannot execute to the nearest one it can
+inline PersistMode resolve_persist_mode(PersistMode mode) {
+    const auto& cpu = persist_detail::cpu();
+    if (mode == PersistMode::CLWB && !cpu.clwb) mode = PersistMode::CLFLUSHOPT;
+    if (mode == PersistMode::CLFLUSHOPT && !cpu.clflushopt) mode = PersistMode::CLFLUSH;
+    return mode;
+}
+
+// Line write-back behind clwb, nt and lazy: CLWB, else CLFLUSHOPT, else
+// CLFLUSH, whichever the CPU has first; checked once
+inline PersistMode writeback_mode() {
+    static const PersistMode mode = resolve_persist_mode(PersistMode::CLWB);
+    return mode;
+}
+
+// Mode for stores that must be durable on return (metadata, or components
+// without dirty tracking): lazy becomes clwb
+inline PersistMode eager_persist_mode(PersistMode mode) {
+    return mode == PersistMode::LAZY ? resolve_persist_mode(PersistMode::CLWB) : mode;
+}
+
+// Read the mode from an environment variable (default clflushopt)
+inline PersistMode persist_mode_from_env(const char* var = "FIO_DAX_PERSIST",
+                                         PersistMode fallback = PersistMode::CLFLUSHOPT) {
+    PersistMode mode = fallback;
+    if (!parse_persist_mode(getenv(var), mode)) mode = fallback;
+    return resolve_persist_mode(mode);
+}
+
+// Write back every cache line overlapping [addr, addr + n). No fence.
+inline void persist_flush(const void* addr, size_t n, PersistMode mode) {
+    if (n == 0) return;
+    uintptr_t start = reinterpret_cast<uintptr_t>(addr) & ~(persist_detail::kLine - 1);
+    uintptr_t end = reinterpret_cast<uintptr_t>(addr) + n;
+    switch (mode) {
+        case PersistMode::CLFLUSHOPT:
+            // Callers normally pass resolved modes; a raw one must not fault
+            if (persist_detail::cpu().clflushopt) persist_detail::flush_lines_clflushopt(start, end);
+            else persist_detail::flush_lines_clflush(start, end);
+            break;
+        case PersistMode::CLWB:
+        case PersistMode::NT_STORE:
+        case PersistMode::LAZY:
+            switch (writeback_mode()) {
+                case PersistMode::CLWB: persist_detail::flush_lines_clwb(start, end); break;
+                case PersistMode::CLFLUSHOPT: persist_detail::flush_lines_clflushopt(start, end); break;
+                default: persist_detail::flush_lines_clflush(start, end); break;
+            }
+            break;
+        case PersistMode::CLFLUSH:
+            persist_detail::flush_lines_clflush(start, end);
+            break;
+        case PersistMode::NONE:
+            break;
+    }
+}
+
+// Order all preceding flushes and non-temporal stores
+inline void persist_fence(PersistMode mode) {
+    if (mode != PersistMode::NONE) _mm_sfence();
+}
+
+// Copy into persistent memory without the trailing fence; callers batching
+// several copies (vectored I/O) issue one persist_fence() at the end.
+inline void persist_copy_nofence(void* dst, const void* src, size_t n, PersistMode mode) {
+    if (n == 0) return;
+    if (mode == PersistMode::LAZY) {
+        memcpy(dst, src, n);
+        return;
+    }
+    if (mode != PersistMode::NT_STORE || n < 2 * persist_detail::kLine) {
+        memcpy(dst, src, n);
+        persist_flush(dst, n, mode == PersistMode::NT_STORE ? PersistMode::CLWB : mode);
+        return;
+    }
+
+    // Cached stores + write-back for the unaligned head and tail, streaming
+    // stores for every whole line in between
+    char* d = static_cast<char*>(dst);
+    const char* s = static_cast<const char*>(src);
+    size_t head = (persist_detail::kLine - (reinterpret_cast<uintptr_t>(d) & (persist_detail::kLine - 1)))
+                  & (persist_detail::kLine - 1);
+    if (head) {
+        memcpy(d, s, head);
+        persist_flush(d, head, PersistMode::CLWB);
+        d += head;
+        s += head;
+        n -= head;
+    }
+    size_t body = n & ~(persist_detail::kLine - 1);
+    persist_detail::stream_lines(d, s, body);
+    if (n > body) {
+        memcpy(d + body, s + body, n - body);
+        persist_flush(d + body, n - body, PersistMode::CLWB);
+    }
+}
+
+// Copy into persistent memory and make it durable
+inline void persist_copy(void* dst, const void* src, size_t n, PersistMode mode) {
+    persist_copy_nofence(dst, src, n, mode);
+    persist_fence(mode);
+}
+
+} // namespace cxl_ssd
+
+#endif // CXL_PERSIST_HPP
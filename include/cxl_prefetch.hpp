@@ -0,0 +1,119 @@
+#ifndef CXL_PREFETCH_HPP
+#define CXL_PREFETCH_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <immintrin.h>
+
+// Sequential stream detection and software prefetch for the read path
+// (FIO_DAX_PREFETCH). Each fd remembers where a sequential read would start;
+// once `trigger` reads in a row have started there, every read prefetches
+// the `distance` bytes after it before copying, so the next call finds its
+// lines on the way from high-latency CXL memory instead of starting cold.
+// Only lines not already prefetched for the stream are issued, so the
+// steady state is one prefetch per line read.
+//
+// Usefulness: a line counts as useful when a later read of the same stream
+// copies it; lines issued but never read (the stream broke or the file
+// ended) make up the difference.
+
+namespace cxl_intercept {
+
+// Per-fd stream state. Racy updates from threads sharing an fd only cost
+// prefetch accuracy, so plain relaxed loads and stores are enough.
+struct StreamState {
+    std::atomic<uint64_t> next{0};    // offset a sequential read would start at
+    std::atomic<uint64_t> pf_end{0};  // stream prefetched up to here
+    std::atomic<uint32_t> run{0};     // sequential reads in a row
+};
+
+class StreamPrefetcher {
+public:
+    enum Counter { READS, SEQUENTIAL, ISSUED, USEFUL, NUM_COUNTERS };
+
+    // distance in bytes; nta keeps prefetched lines out of the outer
+    // caches, for data copied once
+    void configure(size_t distance, bool nta, unsigned trigger) {
+        distance_ = distance;
+        nta_ = nta;
+        trigger_ = trigger ? trigger : 1;
+    }
+
+    bool enabled() const { return distance_ != 0; }
+    size_t distance() const { return distance_; }
+    bool nta() const { return nta_; }
+
+    // Before copying [offset, offset + n) of a file of size bytes at base
+    void on_read(StreamState& s, const char* base, size_t size, uint64_t offset, size_t n) {
+        uint64_t end = offset + n;
+        uint64_t pf_end = s.pf_end.load(std::memory_order_relaxed);
+        uint32_t run = s.run.load(std::memory_order_relaxed);
+        Shard& c = shards_[shard_index()];
+        c.v[READS].fetch_add(1, std::memory_order_relaxed);
+
+        if (offset == s.next.load(std::memory_order_relaxed)) {
+            if (run < trigger_) run++;
+            c.v[SEQUENTIAL].fetch_add(1, std::memory_order_relaxed);
+        } else {
+            run = 0;
+            pf_end = 0;
+        }
+        s.next.store(end, std::memory_order_relaxed);
+
+        if (pf_end > offset) {
+            uint64_t covered = (pf_end < end ? pf_end : end) - offset;
+            c.v[USEFUL].fetch_add((covered + kLine - 1) / kLine, std::memory_order_relaxed);
+        }
+        if (run >= trigger_) {
+            uint64_t from = pf_end > end ? pf_end : end;
+            uint64_t to = end + distance_ < size ? end + distance_ : size;
+            if (to > from) {
+                c.v[ISSUED].fetch_add(prefetch(base, from, to), std::memory_order_relaxed);
+                pf_end = to;
+            }
+        }
+        s.pf_end.store(pf_end, std::memory_order_relaxed);
+        s.run.store(run, std::memory_order_relaxed);
+    }
+
+    uint64_t total(Counter counter) const {
+        uint64_t sum = 0;
+        for (const Shard& s : shards_) sum += s.v[counter].load(std::memory_order_relaxed);
+        return sum;
+    }
+
+private:
+    static constexpr uint64_t kLine = 64;
+    static constexpr int kShards = 16;
+
+    // Prefetch the lines of [from, to); returns how many were issued
+    uint64_t prefetch(const char* base, uint64_t from, uint64_t to) const {
+        uint64_t first = from & ~(kLine - 1);
+        if (nta_) {
+            for (uint64_t off = first; off < to; off += kLine) _mm_prefetch(base + off, _MM_HINT_NTA);
+        } else {
+            for (uint64_t off = first; off < to; off += kLine) _mm_prefetch(base + off, _MM_HINT_T0);
+        }
+        return (to - first + kLine - 1) / kLine;
+    }
+
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> v[NUM_COUNTERS] = {};
+    };
+
+    static unsigned shard_index() {
+        static std::atomic<unsigned> next{0};
+        static thread_local unsigned index = next.fetch_add(1, std::memory_order_relaxed) % kShards;
+        return index;
+    }
+
+    size_t distance_ = 0;
+    bool nta_ = false;
+    unsigned trigger_ = 2;
+    Shard shards_[kShards];
+};
+
+} // namespace cxl_intercept
+
+#endif // CXL_PREFETCH_HPP
@@ -0,0 +1,372 @@
+#ifndef CXL_QOS_HPP
+#define CXL_QOS_HPP
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <time.h>
+
+// Per-tenant QoS for the intercept read/write paths (FIO_QOS). Each fd
+// belongs to a class, picked at open() by a path substring or by the
+// process's tenant id (FIO_QOS_TENANT); everything else is the "default"
+// class. A class has
+//   - a limit: MB/s and/or IOPS it never exceeds
+//   - a reservation: MB/s and/or IOPS admitted without regard to others
+//   - a weight: its share of the device capacity (FIO_QOS_DEVICE) left
+//     over by the reservations of the classes active in the last 100ms
+// Every bucket is a GCRA virtual clock in CLOCK_MONOTONIC nanoseconds, like
+// the timing model's (cxl_timing_model.hpp): an operation advances it by
+// its cost at the bucket's rate, the larger of bytes / MB/s and 1 / IOPS,
+// and the caller sleeps until the clock, less the burst allowance. An
+// operation the reservation bucket admits skips the weighted share bucket;
+// the limit applies either way.
+//
+// The buckets of a region live in its shared namespace segment, so fio
+// jobs and other processes on the same region throttle each other; a class
+// is found there by the hash of its name. Without the segment every
+// process keeps its own buckets.
+
+namespace cxl_intercept {
+
+constexpr int kMaxQosClasses = 16;  // per process, "default" included
+constexpr int kQosSlots = 32;       // per region, over all processes
+
+struct QosRates {
+    double mbps = 0;
+    double iops = 0;
+
+    bool set() const { return mbps > 0 || iops > 0; }
+
+    // Nanoseconds of the bucket an operation of bytes takes; 0 if unlimited
+    uint64_t cost(size_t bytes) const {
+        double by_bytes = mbps > 0 ? double(bytes) * 1e3 / mbps : 0;
+        double by_ops = iops > 0 ? 1e9 / iops : 0;
+        return uint64_t(by_bytes > by_ops ? by_bytes : by_ops);
+    }
+};
+
+struct QosClass {
+    std::string name;
+    std::string match;   // path substring
+    std::string tenant;  // FIO_QOS_TENANT value
+    QosRates reserve;
+    QosRates limit;
+    double weight = 1;
+
+    // Set one "key=value" parameter; false for an unknown key
+    bool set(const std::string& key, const std::string& value) {
+        double v = strtod(value.c_str(), nullptr);
+        if (key == "match") match = value;
+        else if (key == "tenant") tenant = value;
+        else if (key == "reserve_mbps") reserve.mbps = v;
+        else if (key == "reserve_iops") reserve.iops = v;
+        else if (key == "limit_mbps") limit.mbps = v;
+        else if (key == "limit_iops") limit.iops = v;
+        else if (key == "weight") weight = v > 0 ? v : 1;
+        else return false;
+        return true;
+    }
+};
+
+// One class's buckets in a region, 64 bytes so they pack the segment's
+// QoS area. reserve_* and weight are published by the processes using the
+// class, for the others' share computation.
+struct alignas(64) QosSlot {
+    std::atomic<uint64_t> name_hash;
+    std::atomic<uint64_t> reserve_tat;
+    std::atomic<uint64_t> share_tat;
+    std::atomic<uint64_t> limit_tat;
+    std::atomic<uint64_t> active_ns;  // last operation
+    std::atomic<uint64_t> reserve_bps;
+    std::atomic<uint32_t> reserve_iops;
+    std::atomic<uint32_t> weight_milli;
+};
+static_assert(sizeof(QosSlot) == 64, "QoS slots are a cache line");
+
+constexpr size_t kQosAreaBytes = kQosSlots * sizeof(QosSlot);
+
+// A region's buckets, and each configured class's slot among them
+class QosBuckets {
+public:
+    // Use area (the namespace segment's, zeroed when it was created) or,
+    // with nullptr, slots of this process's own
+    void attach(void* area) { slots_ = area ? static_cast<QosSlot*>(area) : local_; }
+
+    QosSlot* slots() { return slots_ ? slots_ : local_; }
+
+    QosSlot* bound[kMaxQosClasses] = {};
+
+    // Weighted share of one class, recomputed every kShareRefreshNs
+    struct Share {
+        std::atomic<uint64_t> at{0};
+        std::atomic<uint64_t> cost_per_kb{0};  // ns per KB, 0 if unlimited
+        std::atomic<uint64_t> cost_per_op{0};  // ns per op
+    };
+    Share share[kMaxQosClasses];
+
+private:
+    QosSlot* slots_ = nullptr;
+    QosSlot local_[kQosSlots];
+};
+
+class QosPolicy {
+public:
+    enum Counter { OPS, BYTES, RESERVED, DELAYED, DELAY_NS, NUM_COUNTERS };
+
+    // Enable if FIO_QOS names classes: "name:key=value,...;name:..." with
+    // keys match, tenant, reserve_mbps, reserve_iops, limit_mbps,
+    // limit_iops, weight. FIO_QOS_DEVICE ("mbps=...,iops=...,burst_us=...")
+    // is the capacity the weights divide.
+    void init_from_env(const char* source) {
+        const char* env = getenv("FIO_QOS");
+        if (!env || !*env || strcmp(env, "0") == 0) return;
+        count_ = 1;
+        classes_[0].name = "default";
+        parse_classes(env);
+        if (const char* dev = getenv("FIO_QOS_DEVICE")) parse_device(dev);
+        if (const char* t = getenv("FIO_QOS_TENANT")) tenant_ = t;
+        enabled_ = true;
+        fprintf(stderr, "[QOS] %s: %d classes, device %.0f MB/s %.0f IOPS, burst %llu us%s%s\n",
+                source, count_, capacity_.mbps, capacity_.iops, (unsigned long long)(burst_ns_ / 1000),
+                tenant_.empty() ? "" : ", tenant ", tenant_.c_str());
+    }
+
+    bool enabled() const { return enabled_; }
+    int count() const { return count_; }
+    const std::string& name(int cls) const { return classes_[cls].name; }
+
+    // Class of a file opened as path: the first class whose match is in
+    // the path, else the first for this process's tenant, else default
+    int classify(const char* path) const {
+        if (!enabled_) return 0;
+        for (int i = 1; i < count_; i++) {
+            if (!classes_[i].match.empty() && strstr(path, classes_[i].match.c_str())) return i;
+        }
+        for (int i = 1; i < count_; i++) {
+            if (!classes_[i].tenant.empty() && classes_[i].tenant == tenant_) return i;
+        }
+        return 0;
+    }
+
+    // Find or claim the slots of the configured classes in b
+    void bind(QosBuckets& b) {
+        if (!enabled_) return;
+        QosSlot* slots = b.slots();
+        for (int c = 0; c < count_; c++) {
+            uint64_t hash = name_hash(classes_[c].name);
+            QosSlot* found = nullptr;
+            for (int i = 0; i < kQosSlots && !found; i++) {
+                uint64_t h = slots[i].name_hash.load(std::memory_order_acquire);
+                if (h == 0 && slots[i].name_hash.compare_exchange_strong(h, hash, std::memory_order_acq_rel)) {
+                    h = hash;
+                }
+                if (h == hash) found = &slots[i];
+            }
+            if (!found) {
+                fprintf(stderr, "[QOS] No free slot for class %s, not throttled\n", classes_[c].name.c_str());
+                continue;
+            }
+            const QosClass& k = classes_[c];
+            found->reserve_bps.store(uint64_t(k.reserve.mbps * 1e6), std::memory_order_relaxed);
+            found->reserve_iops.store(uint32_t(k.reserve.iops), std::memory_order_relaxed);
+            found->weight_milli.store(uint32_t(k.weight * 1000), std::memory_order_relaxed);
+            b.bound[c] = found;
+        }
+    }
+
+    // Hold the caller until class cls may move bytes on b's region
+    void admit(QosBuckets& b, int cls, size_t bytes) {
+        QosSlot* s = b.bound[cls];
+        if (!s) return;
+        const QosClass& c = classes_[cls];
+        uint64_t now = now_ns();
+        if (now - s->active_ns.load(std::memory_order_relaxed) > kActiveRefreshNs) {
+            s->active_ns.store(now, std::memory_order_relaxed);
+        }
+
+        uint64_t deadline = now;
+        bool reserved = false;
+        if (uint64_t cost = c.reserve.cost(bytes)) reserved = take_if_conforming(s->reserve_tat, cost, now);
+        if (!reserved && capacity_.set()) {
+            uint64_t cost = share_cost(b, cls, bytes, now);
+            if (cost) deadline = max(deadline, take(s->share_tat, cost, now));
+        }
+        if (uint64_t cost = c.limit.cost(bytes)) deadline = max(deadline, take(s->limit_tat, cost, now));
+
+        Shard& sh = shards_[shard_index()];
+        sh.v[cls][OPS].fetch_add(1, std::memory_order_relaxed);
+        sh.v[cls][BYTES].fetch_add(bytes, std::memory_order_relaxed);
+        if (reserved) sh.v[cls][RESERVED].fetch_add(1, std::memory_order_relaxed);
+        if (deadline > now) {
+            sh.v[cls][DELAYED].fetch_add(1, std::memory_order_relaxed);
+            sh.v[cls][DELAY_NS].fetch_add(deadline - now, std::memory_order_relaxed);
+            uint64_t longest = max_delay_[cls].load(std::memory_order_relaxed);
+            while (deadline - now > longest &&
+                   !max_delay_[cls].compare_exchange_weak(longest, deadline - now, std::memory_order_relaxed)) {}
+            struct timespec ts = {time_t(deadline / 1000000000ULL), long(deadline % 1000000000ULL)};
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {}
+        }
+    }
+
+    uint64_t total(int cls, Counter counter) const {
+        uint64_t sum = 0;
+        for (const Shard& s : shards_) sum += s.v[cls][counter].load(std::memory_order_relaxed);
+        return sum;
+    }
+
+    uint64_t max_delay_ns(int cls) const { return max_delay_[cls].load(std::memory_order_relaxed); }
+
+private:
+    static constexpr uint64_t kActiveNs = 100000000;         // active: an op in the last 100ms
+    static constexpr uint64_t kActiveRefreshNs = 1000000;
+    static constexpr uint64_t kShareRefreshNs = 1000000;
+    static constexpr int kShards = 16;
+
+    static uint64_t now_ns() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return uint64_t(ts.tv_sec) * 1000000000ULL + uint64_t(ts.tv_nsec);
+    }
+
+    static uint64_t max(uint64_t a, uint64_t b) { return a > b ? a : b; }
+
+    // FNV-1a, never 0 (an empty slot)
+    static uint64_t name_hash(const std::string& name) {
+        uint64_t h = 0xcbf29ce484222325ULL;
+        for (unsigned char ch : name) h = (h ^ ch) * 0x100000001b3ULL;
+        return h ? h : 1;
+    }
+
+    // GCRA: charge cost and return when the operation may proceed
+    uint64_t take(std::atomic<uint64_t>& tat, uint64_t cost, uint64_t now) const {
+        uint64_t t = tat.load(std::memory_order_relaxed);
+        uint64_t next;
+        do {
+            next = max(t, now) + cost;
+        } while (!tat.compare_exchange_weak(t, next, std::memory_order_relaxed));
+        return next > burst_ns_ + cost ? next - cost - burst_ns_ : 0;
+    }
+
+    // Charge cost only if the bucket admits the operation right now
+    bool take_if_conforming(std::atomic<uint64_t>& tat, uint64_t cost, uint64_t now) const {
+        uint64_t t = tat.load(std::memory_order_relaxed);
+        do {
+            if (t > now + burst_ns_) return false;
+        } while (!tat.compare_exchange_weak(t, max(t, now) + cost, std::memory_order_relaxed));
+        return true;
+    }
+
+    // Cost at cls's weighted share of the capacity the active classes'
+    // reservations leave (at least 1% of it)
+    uint64_t share_cost(QosBuckets& b, int cls, size_t bytes, uint64_t now) {
+        QosBuckets::Share& sh = b.share[cls];
+        if (now - sh.at.load(std::memory_order_relaxed) > kShareRefreshNs) {
+            double weights = 0, reserved_bps = 0, reserved_iops = 0;
+            QosSlot* slots = b.slots();
+            for (int i = 0; i < kQosSlots; i++) {
+                if (!slots[i].name_hash.load(std::memory_order_relaxed)) continue;
+                if (now - slots[i].active_ns.load(std::memory_order_relaxed) > kActiveNs) continue;
+                weights += slots[i].weight_milli.load(std::memory_order_relaxed);
+                reserved_bps += double(slots[i].reserve_bps.load(std::memory_order_relaxed));
+                reserved_iops += slots[i].reserve_iops.load(std::memory_order_relaxed);
+            }
+            double own = double(b.bound[cls]->weight_milli.load(std::memory_order_relaxed));
+            double fraction = weights > 0 ? own / weights : 1;
+            QosRates rate;
+            if (capacity_.mbps > 0) {
+                double left = capacity_.mbps - reserved_bps / 1e6;
+                rate.mbps = fraction * (left > capacity_.mbps / 100 ? left : capacity_.mbps / 100);
+            }
+            if (capacity_.iops > 0) {
+                double left = capacity_.iops - reserved_iops;
+                rate.iops = fraction * (left > capacity_.iops / 100 ? left : capacity_.iops / 100);
+            }
+            sh.cost_per_kb.store(rate.mbps > 0 ? uint64_t(1024 * 1e3 / rate.mbps) : 0, std::memory_order_relaxed);
+            sh.cost_per_op.store(rate.iops > 0 ? uint64_t(1e9 / rate.iops) : 0, std::memory_order_relaxed);
+            sh.at.store(now, std::memory_order_relaxed);
+        }
+        uint64_t by_bytes = sh.cost_per_kb.load(std::memory_order_relaxed) * bytes / 1024;
+        return max(by_bytes, sh.cost_per_op.load(std::memory_order_relaxed));
+    }
+
+    void parse_classes(const std::string& spec) {
+        size_t pos = 0;
+        while (pos < spec.size()) {
+            size_t semi = spec.find(';', pos);
+            if (semi == std::string::npos) semi = spec.size();
+            std::string item = spec.substr(pos, semi - pos);
+            pos = semi + 1;
+            size_t colon = item.find(':');
+            std::string name = item.substr(0, colon);
+            if (name.empty()) continue;
+            int c = 0;
+            while (c < count_ && classes_[c].name != name) c++;
+            if (c == count_) {
+                if (count_ == kMaxQosClasses) {
+                    fprintf(stderr, "[QOS] More than %d classes, ignoring %s\n", kMaxQosClasses, name.c_str());
+                    continue;
+                }
+                classes_[count_++].name = name;
+            }
+            if (colon == std::string::npos) continue;
+            for_each_pair(item.substr(colon + 1), [&](const std::string& key, const std::string& value) {
+                if (!classes_[c].set(key, value)) {
+                    fprintf(stderr, "[QOS] Unknown parameter for class %s: %s\n", name.c_str(), key.c_str());
+                }
+            });
+        }
+    }
+
+    void parse_device(const std::string& spec) {
+        for_each_pair(spec, [&](const std::string& key, const std::string& value) {
+            double v = strtod(value.c_str(), nullptr);
+            if (key == "mbps") capacity_.mbps = v;
+            else if (key == "iops") capacity_.iops = v;
+            else if (key == "burst_us") burst_ns_ = uint64_t(v * 1000);
+            else fprintf(stderr, "[QOS] Unknown device parameter: %s\n", key.c_str());
+        });
+    }
+
+    // Comma-separated key=value pairs
+    template <typename Fn>
+    static void for_each_pair(const std::string& list, Fn&& fn) {
+        size_t pos = 0;
+        while (pos < list.size()) {
+            size_t comma = list.find(',', pos);
+            if (comma == std::string::npos) comma = list.size();
+            std::string pair = list.substr(pos, comma - pos);
+            pos = comma + 1;
+            size_t eq = pair.find('=');
+            if (eq == std::string::npos || eq == 0) continue;
+            fn(pair.substr(0, eq), pair.substr(eq + 1));
+        }
+    }
+
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> v[kMaxQosClasses][NUM_COUNTERS] = {};
+    };
+
+    static unsigned shard_index() {
+        static std::atomic<unsigned> next{0};
+        static thread_local unsigned index = next.fetch_add(1, std::memory_order_relaxed) % kShards;
+        return index;
+    }
+
+    bool enabled_ = false;
+    int count_ = 1;
+    QosClass classes_[kMaxQosClasses];
+    std::string tenant_;
+    QosRates capacity_;
+    uint64_t burst_ns_ = 1000000;  // 1ms
+    std::atomic<uint64_t> max_delay_[kMaxQosClasses] = {};
+    Shard shards_[kShards];
+};
+
+} // namespace cxl_intercept
+
+#endif // CXL_QOS_HPP
@@ -0,0 +1,282 @@
+#ifndef CXL_SHM_NAMESPACE_HPP
+#define CXL_SHM_NAMESPACE_HPP
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Cross-process namespace of a DAX region, in a shared memory segment
+// (/dev/shm/cxl-ns.<dev>.<ino>) that every process using the region maps.
+// It holds:
+//   - a robust, process-shared mutex that serializes catalog updates; a
+//     holder that dies leaves it EOWNERDEAD and the next locker marks it
+//     consistent (catalog updates are crash-ordered, so at worst chunks leak)
+//   - a hash of path -> extent with the number of opens across processes,
+//     so unlink() of a file another process still has open keeps its
+//     chunks until the last close
+//   - the QoS buckets of the region's tenants (cxl_qos.hpp)
+//
+// Every attached process holds a shared flock() on the segment until it
+// exits. An attacher that can take it exclusively is alone: it frees the
+// extents of files unlinked while open and resets the table, so counts
+// left by crashed processes do not outlive them. The last process out does
+// the same and removes the segment. Attach and detach are serialized by
+// the caller (the catalog holds flock() on the device).
+//
+// Raw syscalls: the intercept libraries wrap open()/ftruncate()/mmap().
+
+namespace cxl_intercept {
+
+constexpr char kNamespaceMagic[8] = {'C', 'X', 'L', 'N', 'S', 'P', 'C', 'E'};
+constexpr uint32_t kNamespaceVersion = 2;
+constexpr uint32_t kNamespaceEntries = 8192;
+constexpr size_t kNamespaceQosBytes = 2048;
+
+enum NsEntryState : uint32_t {
+    NS_EMPTY = 0,
+    NS_OPEN = 1,     // path is open in at least one process
+    NS_DELETED = 2,  // tombstone; keeps probe chains intact
+    NS_ORPHAN = 3,   // unlinked while open; freed by the last close
+};
+
+struct NsEntry {
+    uint32_t state;
+    uint32_t refs;       // opens across all processes
+    uint64_t path_hash;
+    uint64_t offset;     // extent start, bytes from region base
+    uint64_t length;
+    char path[224];
+};
+static_assert(sizeof(NsEntry) == 256, "namespace entries are 256 bytes");
+
+struct NsHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t max_entries;
+    uint64_t region_size;
+    pthread_mutex_t mu;
+    alignas(64) unsigned char qos[kNamespaceQosBytes];
+};
+
+class ShmNamespace {
+public:
+    static constexpr size_t kEntriesOffset = 4096;
+    static constexpr size_t kSegmentSize = kEntriesOffset + size_t(kNamespaceEntries) * sizeof(NsEntry);
+    static_assert(sizeof(NsHeader) <= kEntriesOffset, "namespace header fits its page");
+
+    // Map the segment of the region behind dev_fd, creating or resetting it
+    // when no other process has it attached. reset drops the table even
+    // then (the catalog was just formatted). free_extent(offset, length)
+    // receives the extents of files unlinked while open.
+    template <typename FreeExtent>
+    bool attach(int dev_fd, uint64_t region_size, bool reset, FreeExtent&& free_extent) {
+        struct stat st;
+        if (syscall(SYS_fstat, dev_fd, &st) != 0) return false;
+        snprintf(name_, sizeof(name_), "/dev/shm/cxl-ns.%llx.%llx",
+                 (unsigned long long)st.st_dev, (unsigned long long)st.st_ino);
+        fd_ = static_cast<int>(syscall(SYS_openat, AT_FDCWD, name_, O_RDWR | O_CREAT | O_CLOEXEC, 0666));
+        if (fd_ < 0) return false;
+
+        bool alone = flock(fd_, LOCK_EX | LOCK_NB) == 0;
+        if (alone && syscall(SYS_ftruncate, fd_, kSegmentSize) != 0) {
+            close_segment();
+            return false;
+        }
+        void* p = reinterpret_cast<void*>(syscall(SYS_mmap, nullptr, kSegmentSize, PROT_READ | PROT_WRITE,
+                                                  MAP_SHARED, fd_, 0));
+        if (p == MAP_FAILED) {
+            close_segment();
+            return false;
+        }
+        hdr_ = static_cast<NsHeader*>(p);
+        entries_ = reinterpret_cast<NsEntry*>(static_cast<char*>(p) + kEntriesOffset);
+
+        if (alone) {
+            if (valid(region_size) && !reset) free_orphans(free_extent);
+            format(region_size);
+        } else if (!valid(region_size)) {
+            fprintf(stderr, "[NAMESPACE] %s belongs to a different region; files are not shared\n", name_);
+            syscall(SYS_munmap, hdr_, kSegmentSize);
+            close_segment();
+            return false;
+        }
+        flock(fd_, LOCK_SH);
+        alone_ = alone;
+        return true;
+    }
+
+    // Leave the namespace; the last process out frees orphaned extents and
+    // removes the segment
+    template <typename FreeExtent>
+    void detach(FreeExtent&& free_extent) {
+        if (!hdr_) return;
+        if (flock(fd_, LOCK_EX | LOCK_NB) == 0) {
+            free_orphans(free_extent);
+            syscall(SYS_unlinkat, AT_FDCWD, name_, 0);
+        }
+        syscall(SYS_munmap, hdr_, kSegmentSize);
+        close_segment();
+    }
+
+    // In a fork() child: take a lock of our own, so the parent exiting does
+    // not make it look like the last user
+    void reopen_in_child() {
+        if (!hdr_) return;
+        int fd = static_cast<int>(syscall(SYS_openat, AT_FDCWD, name_, O_RDWR | O_CLOEXEC));
+        if (fd < 0) return;
+        syscall(SYS_close, fd_);
+        fd_ = fd;
+        flock(fd_, LOCK_SH);
+    }
+
+    bool attached() const { return hdr_ != nullptr; }
+
+    // No other process had the region attached when this one did
+    bool attached_alone() const { return alone_; }
+
+    // Shared QoS state, zeroed with the segment
+    void* qos_area() const { return hdr_ ? hdr_->qos : nullptr; }
+
+    void lock() {
+        int rc = pthread_mutex_lock(&hdr_->mu);
+        if (rc == EOWNERDEAD) {
+            fprintf(stderr, "[NAMESPACE] Recovered lock from a process that died holding it\n");
+            pthread_mutex_consistent(&hdr_->mu);
+        }
+    }
+
+    void unlock() { pthread_mutex_unlock(&hdr_->mu); }
+
+    // The following run under lock()
+
+    // Open entry for path, taking a reference; -1 if path is not open
+    int32_t ref(const std::string& path, uint64_t hash, uint64_t& offset, uint64_t& length) {
+        int32_t slot = find(path, hash, nullptr);
+        if (slot < 0) return -1;
+        NsEntry& e = entries_[slot];
+        e.refs++;
+        offset = e.offset;
+        length = e.length;
+        return slot;
+    }
+
+    // Record path as open once; -1 if the table is full
+    int32_t insert(const std::string& path, uint64_t hash, uint64_t offset, uint64_t length) {
+        if (path.size() >= sizeof(NsEntry::path)) return -1;
+        int32_t slot = -1;
+        find(path, hash, &slot);
+        if (slot < 0) return -1;
+        NsEntry& e = entries_[slot];
+        e.refs = 1;
+        e.path_hash = hash;
+        e.offset = offset;
+        e.length = length;
+        memset(e.path, 0, sizeof(e.path));
+        memcpy(e.path, path.data(), path.size());
+        e.state = NS_OPEN;
+        return slot;
+    }
+
+    // Drop a reference. True, with the extent, when it was the last one on
+    // a file unlinked while open, whose chunks the caller must now free.
+    bool unref(int32_t slot, uint64_t& offset, uint64_t& length) {
+        if (slot < 0 || uint32_t(slot) >= kNamespaceEntries) return false;
+        NsEntry& e = entries_[slot];
+        if (e.state != NS_OPEN && e.state != NS_ORPHAN) return false;
+        if (e.refs > 1) {
+            e.refs--;
+            return false;
+        }
+        bool orphan = e.state == NS_ORPHAN;
+        offset = e.offset;
+        length = e.length;
+        e.refs = 0;
+        // A slot followed by an empty one ends no probe chain but its own
+        e.state = entries_[(slot + 1) % kNamespaceEntries].state == NS_EMPTY ? NS_EMPTY : NS_DELETED;
+        return orphan;
+    }
+
+    // path was unlinked: if it is open anywhere, keep its extent for the
+    // open fds and return true; the caller frees it otherwise
+    bool orphan(const std::string& path, uint64_t hash) {
+        int32_t slot = find(path, hash, nullptr);
+        if (slot < 0) return false;
+        entries_[slot].state = NS_ORPHAN;
+        return true;
+    }
+
+private:
+    bool valid(uint64_t region_size) const {
+        return memcmp(hdr_->magic, kNamespaceMagic, sizeof(kNamespaceMagic)) == 0 &&
+               hdr_->version == kNamespaceVersion && hdr_->max_entries == kNamespaceEntries &&
+               hdr_->region_size == region_size;
+    }
+
+    void format(uint64_t region_size) {
+        memset(hdr_, 0, kSegmentSize);
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+        pthread_mutex_init(&hdr_->mu, &attr);
+        pthread_mutexattr_destroy(&attr);
+        hdr_->version = kNamespaceVersion;
+        hdr_->max_entries = kNamespaceEntries;
+        hdr_->region_size = region_size;
+        memcpy(hdr_->magic, kNamespaceMagic, sizeof(kNamespaceMagic));
+    }
+
+    template <typename FreeExtent>
+    void free_orphans(FreeExtent&& free_extent) {
+        for (uint32_t i = 0; i < kNamespaceEntries; i++) {
+            if (entries_[i].state == NS_ORPHAN) free_extent(entries_[i].offset, entries_[i].length);
+        }
+    }
+
+    // Linear probing. Returns the open entry for path, and via insert_slot
+    // the first reusable slot on the probe chain (-1 if the table is full).
+    int32_t find(const std::string& path, uint64_t hash, int32_t* insert_slot) const {
+        int32_t reusable = -1;
+        for (uint32_t i = 0; i < kNamespaceEntries; i++) {
+            int32_t slot = static_cast<int32_t>((hash + i) % kNamespaceEntries);
+            const NsEntry& e = entries_[slot];
+            if (e.state == NS_EMPTY) {
+                if (reusable < 0) reusable = slot;
+                break;
+            }
+            if (e.state == NS_DELETED) {
+                if (reusable < 0) reusable = slot;
+                continue;
+            }
+            if (e.state == NS_OPEN && e.path_hash == hash && path.compare(e.path) == 0) return slot;
+        }
+        if (insert_slot) *insert_slot = reusable;
+        return -1;
+    }
+
+    void close_segment() {
+        if (fd_ >= 0) syscall(SYS_close, fd_);
+        fd_ = -1;
+        hdr_ = nullptr;
+        entries_ = nullptr;
+    }
+
+    char name_[64] = {};
+    int fd_ = -1;
+    NsHeader* hdr_ = nullptr;
+    NsEntry* entries_ = nullptr;
+    bool alone_ = false;
+};
+
+} // namespace cxl_intercept
+
+#endif // CXL_SHM_NAMESPACE_HPP
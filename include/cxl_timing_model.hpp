@@ -0,0 +1,219 @@
+#ifndef CXL_TIMING_MODEL_HPP
+#define CXL_TIMING_MODEL_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <x86intrin.h>
+
+#include "cxl_latency_hist.hpp"
+#include "cxl_trace.hpp"
+
+// Emulated CXL-SSD timing for the intercept libraries (FIO_CXL_TIMING), so
+// runs against DRAM, a memfd or tmpfs see device-like latency and queueing.
+// After an operation's copy the calling thread waits until
+//   base + bytes * per_byte (+ miss latency, for a random fraction of reads)
+// has passed since the operation began, and until a device-wide token
+// bucket has admitted its bytes. The bucket is a GCRA virtual clock: each
+// operation advances it by bytes / bandwidth, and completes no earlier than
+// the clock minus the burst allowance, so concurrent streams queue behind
+// each other once they exceed the device bandwidth.
+//
+// Parameters come from scripts/calibrate_timing_model.py, which fits them to
+// the fio results in scripts/cxl_raw.
+
+namespace cxl_intercept {
+
+struct TimingParams {
+    double read_ns = 0;            // fixed cost of a read
+    double write_ns = 0;           // fixed cost of a write
+    double sync_ns = 0;            // fixed cost of fsync/fdatasync
+    double read_ns_per_byte = 0;
+    double write_ns_per_byte = 0;
+    double bandwidth_mbps = 0;     // device-wide MB/s, 0 = unlimited
+    double burst_kb = 0;           // bytes the bucket admits without delay
+    double miss_rate = 0;          // fraction of reads that go to the slow tier
+    double miss_ns = 0;            // extra latency of a slow-tier read
+
+    // Set one "key=value" parameter; false for an unknown key
+    bool set(const std::string& key, double value) {
+        struct Field { const char* name; double TimingParams::*field; };
+        static constexpr Field kFields[] = {
+            {"read_ns", &TimingParams::read_ns},
+            {"write_ns", &TimingParams::write_ns},
+            {"sync_ns", &TimingParams::sync_ns},
+            {"read_ns_per_byte", &TimingParams::read_ns_per_byte},
+            {"write_ns_per_byte", &TimingParams::write_ns_per_byte},
+            {"bandwidth_mbps", &TimingParams::bandwidth_mbps},
+            {"burst_kb", &TimingParams::burst_kb},
+            {"miss_rate", &TimingParams::miss_rate},
+            {"miss_ns", &TimingParams::miss_ns},
+        };
+        for (const Field& f : kFields) {
+            if (key == f.name) {
+                this->*f.field = value;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Apply one "key = value" line; blank lines and # comments are ignored
+    void parse_line(const std::string& raw) {
+        std::string line = raw.substr(0, raw.find('#'));
+        size_t eq = line.find('=');
+        if (eq == std::string::npos) return;
+        auto trim = [](std::string s) {
+            size_t b = s.find_first_not_of(" \t\r\n");
+            size_t e = s.find_last_not_of(" \t\r\n");
+            return b == std::string::npos ? std::string() : s.substr(b, e - b + 1);
+        };
+        std::string key = trim(line.substr(0, eq));
+        if (!set(key, strtod(trim(line.substr(eq + 1)).c_str(), nullptr))) {
+            fprintf(stderr, "[TIMING] Unknown parameter: %s\n", key.c_str());
+        }
+    }
+
+    // Load a file of "key = value" lines
+    bool load(const char* path) {
+        FILE* f = fopen(path, "r");
+        if (!f) {
+            fprintf(stderr, "[TIMING] Failed to open model %s\n", path);
+            return false;
+        }
+        char buf[256];
+        while (fgets(buf, sizeof(buf), f)) parse_line(buf);
+        fclose(f);
+        return true;
+    }
+
+    // Comma-separated list of model files and key=value overrides, applied
+    // in order: "scripts/cxl_timing_model.conf,miss_rate=0"
+    bool parse_spec(const char* spec) {
+        std::string s = spec;
+        size_t pos = 0;
+        while (pos < s.size()) {
+            size_t comma = s.find(',', pos);
+            if (comma == std::string::npos) comma = s.size();
+            std::string item = s.substr(pos, comma - pos);
+            if (item.find('=') != std::string::npos) {
+                parse_line(item);
+            } else if (!item.empty() && !load(item.c_str())) {
+                return false;
+            }
+            pos = comma + 1;
+        }
+        return true;
+    }
+};
+
+class TimingModel {
+public:
+    // Enable if FIO_CXL_TIMING names a model (see TimingParams::parse_spec)
+    void init_from_env(const char* source) {
+        const char* env = getenv("FIO_CXL_TIMING");
+        if (!env || !*env || strcmp(env, "0") == 0) return;
+        TimingParams p;
+        if (!p.parse_spec(env)) return;
+        configure(p);
+        if (enabled_) {
+            fprintf(stderr, "[TIMING] %s: read %.0f ns + %.3f ns/B, write %.0f ns + %.3f ns/B, "
+                    "sync %.0f ns, bandwidth %.0f MB/s (burst %.0f KB), miss %.4f x %.0f ns\n",
+                    source, p.read_ns, p.read_ns_per_byte, p.write_ns, p.write_ns_per_byte, p.sync_ns,
+                    p.bandwidth_mbps, p.burst_kb, p.miss_rate, p.miss_ns);
+        }
+    }
+
+    // Convert the parameters to TSC cycles and enable the model
+    void configure(const TimingParams& p) {
+        tsc_hz_ = calibrate_tsc_hz();
+        if (!tsc_hz_) return;
+        double cpn = double(tsc_hz_) / 1e9;
+        base_[size_t(LatOp::READ)] = uint64_t(p.read_ns * cpn);
+        base_[size_t(LatOp::WRITE)] = uint64_t(p.write_ns * cpn);
+        base_[size_t(LatOp::SYNC)] = uint64_t(p.sync_ns * cpn);
+        per_byte_[size_t(LatOp::READ)] = p.read_ns_per_byte * cpn;
+        per_byte_[size_t(LatOp::WRITE)] = p.write_ns_per_byte * cpn;
+        per_byte_[size_t(LatOp::SYNC)] = 0;
+        bucket_per_byte_ = p.bandwidth_mbps > 0 ? double(tsc_hz_) / (p.bandwidth_mbps * 1e6) : 0;
+        burst_cycles_ = uint64_t(p.burst_kb * 1024 * bucket_per_byte_);
+        double rate = p.miss_rate < 0 ? 0 : p.miss_rate > 1 ? 1 : p.miss_rate;
+        miss_threshold_ = uint64_t(rate * 4294967296.0);
+        miss_cycles_ = uint64_t(p.miss_ns * cpn);
+        tat_.store(0, std::memory_order_relaxed);
+        enabled_ = true;
+    }
+
+    bool enabled() const { return enabled_; }
+
+    // Hold the caller until an operation of bytes that began at TSC t0
+    // would have completed on the emulated device
+    void delay(LatOp op, size_t bytes, uint64_t t0) const {
+        if (!enabled_ || !t0) return;
+        size_t i = size_t(op);
+        uint64_t deadline = t0 + base_[i] + uint64_t(per_byte_[i] * double(bytes));
+        if (op == LatOp::READ && miss_threshold_ && (next_random() >> 32) < miss_threshold_) {
+            deadline += miss_cycles_;
+        }
+        if (bucket_per_byte_ > 0 && bytes) {
+            uint64_t admitted = admit(bytes, t0);
+            if (admitted > deadline) deadline = admitted;
+        }
+        wait_until(deadline);
+    }
+
+private:
+    // GCRA: advance the theoretical arrival time by the bytes' transfer time
+    // and return when the transfer completes, less the burst allowance
+    uint64_t admit(size_t bytes, uint64_t now) const {
+        uint64_t cost = uint64_t(bucket_per_byte_ * double(bytes));
+        uint64_t tat = tat_.load(std::memory_order_relaxed);
+        uint64_t next;
+        do {
+            next = (tat > now ? tat : now) + cost;
+        } while (!tat_.compare_exchange_weak(tat, next, std::memory_order_relaxed));
+        return next > burst_cycles_ ? next - burst_cycles_ : 0;
+    }
+
+    // Sleep through most of a long wait, then spin for the last stretch
+    void wait_until(uint64_t deadline) const {
+        uint64_t now = __rdtsc();
+        if (now >= deadline) return;
+        uint64_t spin_cycles = tsc_hz_ / 20000;  // 50us
+        if (deadline - now > 2 * spin_cycles) {
+            uint64_t ns = (deadline - now - spin_cycles) * 1000000000ULL / tsc_hz_;
+            struct timespec ts = {time_t(ns / 1000000000ULL), long(ns % 1000000000ULL)};
+            nanosleep(&ts, nullptr);
+        }
+        while (__rdtsc() < deadline) _mm_pause();
+    }
+
+    static uint64_t next_random() {
+        thread_local uint64_t state = 0;
+        if (!state) state = (__rdtsc() ^ (static_cast<uint64_t>(syscall(SYS_gettid)) << 32)) | 1;
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+
+    bool enabled_ = false;
+    uint64_t tsc_hz_ = 0;
+    uint64_t base_[size_t(LatOp::COUNT)] = {};
+    double per_byte_[size_t(LatOp::COUNT)] = {};
+    double bucket_per_byte_ = 0;
+    uint64_t burst_cycles_ = 0;
+    uint64_t miss_threshold_ = 0;  // miss when the top 32 random bits are below
+    uint64_t miss_cycles_ = 0;
+    alignas(64) mutable std::atomic<uint64_t> tat_{0};
+};
+
+} // namespace cxl_intercept
+
+#endif // CXL_TIMING_MODEL_HPP
@@ -0,0 +1,468 @@
+#ifndef CXL_TRACE_HPP
+#define CXL_TRACE_HPP
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <x86intrin.h>
+
+// Binary I/O trace for the LD_PRELOAD intercept libraries.
+//
+// Each thread appends fixed-size records to its own lock-free SPSC ring; a
+// background thread drains all rings into a memory-mapped trace file. When
+// tracing is off the hot path costs a single predictable branch. Decode the
+// file with cxl_trace_decode. The recorder is constant-initialized so it can
+// be declared constinit and used from an __attribute__((constructor)).
+
+namespace cxl_intercept {
+
+enum class TraceOp : uint16_t {
+    OPEN = 1,
+    CLOSE,
+    READ,
+    WRITE,
+    PREAD,
+    PWRITE,
+    FSYNC,
+    LSEEK,
+    FTRUNCATE,
+    URING_READ,
+    URING_WRITE,
+    UNLINK,
+    PREADV,
+    PWRITEV,
+    FDATASYNC,
+    FSTAT,
+    MMAP,
+    MUNMAP,
+    MSYNC,
+    AIO_READ,
+    AIO_WRITE,
+    SYNC_FILE_RANGE,
+    COPY_FILE_RANGE,
+    SENDFILE,
+    SPLICE,
+};
+
+inline const char* trace_op_name(uint16_t op) {
+    switch (static_cast<TraceOp>(op)) {
+        case TraceOp::OPEN: return "open";
+        case TraceOp::CLOSE: return "close";
+        case TraceOp::READ: return "read";
+        case TraceOp::WRITE: return "write";
+        case TraceOp::PREAD: return "pread";
+        case TraceOp::PWRITE: return "pwrite";
+        case TraceOp::FSYNC: return "fsync";
+        case TraceOp::LSEEK: return "lseek";
+        case TraceOp::FTRUNCATE: return "ftruncate";
+        case TraceOp::URING_READ: return "uring_read";
+        case TraceOp::URING_WRITE: return "uring_write";
+        case TraceOp::UNLINK: return "unlink";
+        case TraceOp::PREADV: return "preadv";
+        case TraceOp::PWRITEV: return "pwritev";
+        case TraceOp::FDATASYNC: return "fdatasync";
+        case TraceOp::FSTAT: return "fstat";
+        case TraceOp::MMAP: return "mmap";
+        case TraceOp::MUNMAP: return "munmap";
+        case TraceOp::MSYNC: return "msync";
+        case TraceOp::AIO_READ: return "aio_read";
+        case TraceOp::AIO_WRITE: return "aio_write";
+        case TraceOp::SYNC_FILE_RANGE: return "sync_file_range";
+        case TraceOp::COPY_FILE_RANGE: return "copy_file_range";
+        case TraceOp::SENDFILE: return "sendfile";
+        case TraceOp::SPLICE: return "splice";
+    }
+    return "unknown";
+}
+
+// Ops whose result is a byte count
+inline bool trace_op_moves_data(uint16_t op) {
+    switch (static_cast<TraceOp>(op)) {
+        case TraceOp::READ:
+        case TraceOp::WRITE:
+        case TraceOp::PREAD:
+        case TraceOp::PWRITE:
+        case TraceOp::URING_READ:
+        case TraceOp::URING_WRITE:
+        case TraceOp::PREADV:
+        case TraceOp::PWRITEV:
+        case TraceOp::AIO_READ:
+        case TraceOp::AIO_WRITE:
+        case TraceOp::COPY_FILE_RANGE:
+        case TraceOp::SENDFILE:
+        case TraceOp::SPLICE:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// On-disk record, one cache line
+struct TraceRecord {
+    uint64_t tsc;        // rdtsc at operation start
+    uint64_t latency;    // cycles spent in the intercept
+    uint64_t offset;
+    uint64_t length;
+    int64_t result;
+    int32_t fd;
+    uint32_t tid;
+    uint16_t op;         // TraceOp
+    uint16_t reserved[7];
+};
+static_assert(sizeof(TraceRecord) == 64, "trace record must be one cache line");
+
+constexpr char kTraceMagic[8] = {'C', 'X', 'L', 'T', 'R', 'A', 'C', 'E'};
+constexpr uint32_t kTraceVersion = 1;
+constexpr size_t kTraceHeaderSize = 4096;  // records start on the next page
+
+struct TraceFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t tsc_hz;
+    uint64_t start_tsc;
+    uint64_t start_realtime_ns;
+    uint64_t record_count;
+    uint64_t dropped;
+    uint32_t pid;
+    char source[28];
+};
+
+// Estimate the TSC frequency against CLOCK_MONOTONIC over a short interval
+inline uint64_t calibrate_tsc_hz(std::chrono::milliseconds interval = std::chrono::milliseconds(10)) {
+    auto t0 = std::chrono::steady_clock::now();
+    uint64_t c0 = __rdtsc();
+    std::this_thread::sleep_for(interval);
+    uint64_t c1 = __rdtsc();
+    auto t1 = std::chrono::steady_clock::now();
+    double secs = std::chrono::duration<double>(t1 - t0).count();
+    return secs > 0 ? static_cast<uint64_t>((c1 - c0) / secs) : 0;
+}
+
+// Expand %p (pid) and %n (library name) in an output path template
+inline std::string expand_path_template(const std::string& tmpl, const std::string& source) {
+    std::string out;
+    for (size_t i = 0; i < tmpl.size(); i++) {
+        if (tmpl[i] == '%' && i + 1 < tmpl.size()) {
+            char c = tmpl[i + 1];
+            if (c == 'p') { out += std::to_string(getpid()); i++; continue; }
+            if (c == 'n') { out += source; i++; continue; }
+        }
+        out += tmpl[i];
+    }
+    return out;
+}
+
+class TraceRecorder {
+public:
+    static constexpr size_t kDefaultRingRecords = 8192;
+    static constexpr size_t kChunkRecords = 1 << 20;  // file grows 64MB at a time
+
+    // Enable tracing if FIO_TRACE_FILE (or FIO_DEBUG) is set. The path may
+    // contain %p (pid) and %n (library name); default /tmp/%n.%p.trace.
+    void init_from_env(const char* source) {
+        const char* env_file = getenv("FIO_TRACE_FILE");
+        const char* env_debug = getenv("FIO_DEBUG");
+        bool debug = env_debug && strcmp(env_debug, "0") != 0;
+        if (!env_file && !debug) return;
+
+        source_ = source;
+        path_template_ = env_file ? env_file : "/tmp/%n.%p.trace";
+        if (const char* env_ring = getenv("FIO_TRACE_RING_RECORDS")) {
+            size_t n = strtoull(env_ring, nullptr, 0);
+            if (n >= 64) ring_records_ = n;
+        }
+        size_t pow2 = 64;
+        while (pow2 < ring_records_) pow2 <<= 1;
+        ring_records_ = pow2;
+        if (const char* env_ms = getenv("FIO_TRACE_FLUSH_MS")) {
+            flush_interval_ms_ = strtoul(env_ms, nullptr, 0);
+        }
+
+        tsc_hz_ = calibrate_tsc_hz();
+        if (!open_file()) return;
+        start_flusher();
+        enabled_.store(true, std::memory_order_relaxed);
+
+        static TraceRecorder* self = nullptr;
+        self = this;
+        pthread_atfork([] { self->rings_mu_.lock(); },
+                       [] { self->rings_mu_.unlock(); },
+                       [] { self->rings_mu_.unlock(); self->reopen_in_child(); });
+    }
+
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    // Start timestamp for an operation; 0 when tracing is off
+    uint64_t begin() const { return enabled() ? __rdtsc() : 0; }
+
+    void record(TraceOp op, int fd, uint64_t offset, uint64_t length,
+                int64_t result, uint64_t start_tsc) {
+        if (!enabled()) return;
+        Ring* ring = thread_ring();
+        if (!ring) return;
+
+        uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+        if (tail - ring->cached_head >= ring_records_) {
+            ring->cached_head = ring->head.load(std::memory_order_acquire);
+            if (tail - ring->cached_head >= ring_records_) {
+                ring->dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+        TraceRecord& r = ring->records[tail & (ring_records_ - 1)];
+        uint64_t now = __rdtsc();
+        r.tsc = start_tsc;
+        r.latency = now - start_tsc;
+        r.offset = offset;
+        r.length = length;
+        r.result = result;
+        r.fd = fd;
+        r.tid = ring->tid;
+        r.op = static_cast<uint16_t>(op);
+        ring->tail.store(tail + 1, std::memory_order_release);
+    }
+
+    // Stop the flusher, drain every ring and trim the file
+    void shutdown() {
+        if (!enabled()) return;
+        enabled_.store(false, std::memory_order_relaxed);
+        stop_.store(true, std::memory_order_release);
+        if (flusher_running_) pthread_join(flusher_, nullptr);
+        flusher_running_ = false;
+        drain();
+        close_file();
+    }
+
+private:
+    struct Ring {
+        alignas(64) std::atomic<uint64_t> head{0};   // consumer (flusher)
+        alignas(64) std::atomic<uint64_t> tail{0};   // producer (owner thread)
+        uint64_t cached_head = 0;
+        std::atomic<uint64_t> dropped{0};
+        std::atomic<bool> retired{false};
+        uint32_t tid = 0;
+        TraceRecord* records = nullptr;
+    };
+
+    struct ThreadHandle {
+        Ring* ring = nullptr;
+        ~ThreadHandle() {
+            if (ring) ring->retired.store(true, std::memory_order_release);
+        }
+    };
+
+    Ring* thread_ring() {
+        static thread_local ThreadHandle handle;
+        if (!handle.ring) handle.ring = register_ring();
+        return handle.ring;
+    }
+
+    Ring* register_ring() {
+        Ring* ring = new Ring;
+        ring->tid = static_cast<uint32_t>(syscall(SYS_gettid));
+        ring->records = static_cast<TraceRecord*>(
+            aligned_alloc(64, ring_records_ * sizeof(TraceRecord)));
+        if (!ring->records) {
+            delete ring;
+            return nullptr;
+        }
+        std::lock_guard<std::mutex> lock(rings_mu_);
+        rings_.push_back(ring);
+        return ring;
+    }
+
+    std::string expand_path() const { return expand_path_template(path_template_, source_); }
+
+    bool open_file() {
+        std::string path = expand_path();
+        // Raw syscall so the intercept's own open() never sees the trace file
+        fd_ = static_cast<int>(syscall(SYS_openat, AT_FDCWD, path.c_str(),
+                                       O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644));
+        if (fd_ < 0) {
+            fprintf(stderr, "[TRACE] Failed to open %s: %s\n", path.c_str(), strerror(errno));
+            return false;
+        }
+        if (ftruncate(fd_, kTraceHeaderSize) != 0) return false;
+        header_ = static_cast<TraceFileHeader*>(
+            mmap(nullptr, kTraceHeaderSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0));
+        if (header_ == MAP_FAILED) {
+            header_ = nullptr;
+            return false;
+        }
+        memcpy(header_->magic, kTraceMagic, sizeof(kTraceMagic));
+        header_->version = kTraceVersion;
+        header_->record_size = sizeof(TraceRecord);
+        header_->tsc_hz = tsc_hz_;
+        header_->start_tsc = __rdtsc();
+        header_->start_realtime_ns = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count());
+        header_->record_count = 0;
+        header_->dropped = 0;
+        header_->pid = static_cast<uint32_t>(getpid());
+        snprintf(header_->source, sizeof(header_->source), "%s", source_.c_str());
+        file_records_ = 0;
+        fprintf(stderr, "[TRACE] Recording to %s\n", path.c_str());
+        return true;
+    }
+
+    void close_file() {
+        if (chunk_) munmap(chunk_, kChunkRecords * sizeof(TraceRecord));
+        chunk_ = nullptr;
+        if (fd_ >= 0) {
+            if (ftruncate(fd_, kTraceHeaderSize + file_records_ * sizeof(TraceRecord)) != 0) {
+                fprintf(stderr, "[TRACE] Failed to trim trace file\n");
+            }
+        }
+        if (header_) munmap(header_, kTraceHeaderSize);
+        header_ = nullptr;
+        if (fd_ >= 0) ::close(fd_);
+        fd_ = -1;
+    }
+
+    // Map the chunk holding record index idx, growing the file as needed
+    bool map_chunk_for(uint64_t idx) {
+        uint64_t chunk = idx / kChunkRecords;
+        if (chunk_ && chunk == chunk_index_) return true;
+        size_t chunk_bytes = kChunkRecords * sizeof(TraceRecord);
+        if (chunk_) munmap(chunk_, chunk_bytes);
+        chunk_ = nullptr;
+        off_t off = kTraceHeaderSize + static_cast<off_t>(chunk * chunk_bytes);
+        if (ftruncate(fd_, off + chunk_bytes) != 0) return false;
+        void* p = mmap(nullptr, chunk_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, off);
+        if (p == MAP_FAILED) return false;
+        chunk_ = static_cast<TraceRecord*>(p);
+        chunk_index_ = chunk;
+        return true;
+    }
+
+    void drain() {
+        if (fd_ < 0) return;
+        std::vector<Ring*> snapshot;
+        uint64_t dropped;
+        {
+            std::lock_guard<std::mutex> lock(rings_mu_);
+            snapshot = rings_;
+            dropped = retired_dropped_;
+        }
+        for (Ring* ring : snapshot) {
+            uint64_t head = ring->head.load(std::memory_order_relaxed);
+            uint64_t tail = ring->tail.load(std::memory_order_acquire);
+            for (; head != tail; head++) {
+                if (!map_chunk_for(file_records_)) break;
+                chunk_[file_records_ % kChunkRecords] = ring->records[head & (ring_records_ - 1)];
+                file_records_++;
+            }
+            ring->head.store(head, std::memory_order_release);
+            dropped += ring->dropped.load(std::memory_order_relaxed);
+        }
+        if (header_) {
+            header_->record_count = file_records_;
+            header_->dropped = dropped;
+        }
+        reap_retired();
+    }
+
+    // Free rings of exited threads once they are fully drained; their drops
+    // stay counted in the header
+    void reap_retired() {
+        std::lock_guard<std::mutex> lock(rings_mu_);
+        for (size_t i = 0; i < rings_.size();) {
+            Ring* ring = rings_[i];
+            if (ring->retired.load(std::memory_order_acquire) &&
+                ring->head.load(std::memory_order_relaxed) ==
+                    ring->tail.load(std::memory_order_acquire)) {
+                retired_dropped_ += ring->dropped.load(std::memory_order_relaxed);
+                free(ring->records);
+                delete ring;
+                rings_[i] = rings_.back();
+                rings_.pop_back();
+            } else {
+                i++;
+            }
+        }
+    }
+
+    void start_flusher() {
+        stop_.store(false, std::memory_order_relaxed);
+        auto flusher_fn = [](void* arg) -> void* {
+            TraceRecorder* self = static_cast<TraceRecorder*>(arg);
+            while (!self->stop_.load(std::memory_order_acquire)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(self->flush_interval_ms_));
+                self->drain();
+            }
+            return nullptr;
+        };
+        flusher_running_ = pthread_create(&flusher_, nullptr, flusher_fn, this) == 0;
+    }
+
+    // fio forks one process per job: give each child its own file and flusher
+    void reopen_in_child() {
+        if (!enabled()) return;
+        // The parent's flusher does not exist in the child
+        flusher_running_ = false;
+        if (header_) munmap(header_, kTraceHeaderSize);
+        if (chunk_) munmap(chunk_, kChunkRecords * sizeof(TraceRecord));
+        header_ = nullptr;
+        chunk_ = nullptr;
+        ::close(fd_);
+        fd_ = -1;
+        {
+            std::lock_guard<std::mutex> lock(rings_mu_);
+            for (Ring* ring : rings_) {
+                ring->head.store(ring->tail.load(std::memory_order_relaxed),
+                                 std::memory_order_relaxed);
+                ring->cached_head = ring->tail.load(std::memory_order_relaxed);
+                ring->dropped.store(0, std::memory_order_relaxed);
+            }
+            retired_dropped_ = 0;
+        }
+        if (Ring* ring = thread_ring()) {
+            ring->tid = static_cast<uint32_t>(syscall(SYS_gettid));
+        }
+        if (path_template_.find("%p") == std::string::npos) path_template_ += ".%p";
+        if (!open_file()) {
+            enabled_.store(false, std::memory_order_relaxed);
+            return;
+        }
+        start_flusher();
+    }
+
+    std::atomic<bool> enabled_{false};
+    std::string source_;
+    std::string path_template_;
+    size_t ring_records_ = kDefaultRingRecords;
+    unsigned flush_interval_ms_ = 10;
+    uint64_t tsc_hz_ = 0;
+
+    int fd_ = -1;
+    TraceFileHeader* header_ = nullptr;
+    TraceRecord* chunk_ = nullptr;
+    uint64_t chunk_index_ = 0;
+    uint64_t file_records_ = 0;
+
+    std::mutex rings_mu_;
+    std::vector<Ring*> rings_;
+    uint64_t retired_dropped_ = 0;  // drops of reaped rings, under rings_mu_
+    pthread_t flusher_{};
+    bool flusher_running_ = false;
+    std::atomic<bool> stop_{false};
+};
+
+} // namespace cxl_intercept
+
+#endif // CXL_TRACE_HPP
@@ -0,0 +1,302 @@
+#ifndef CXL_WRITE_COMBINE_HPP
+#define CXL_WRITE_COMBINE_HPP
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <vector>
+#include <immintrin.h>
+#include <pthread.h>
+#include <signal.h>
+#include <time.h>
+#include <x86intrin.h>
+
+#include "cxl_aio_pool.hpp"
+#include "cxl_dax_region.hpp"
+#include "cxl_fd_table.hpp"
+#include "cxl_persist.hpp"
+#include "cxl_trace.hpp"
+
+// Per-thread write combining for sub-line writes (FIO_DAX_WRITE_COMBINE).
+// Byte-addressable workloads issue runs of small writes into the same 64B
+// line, and eager persistence pays a CLFLUSHOPT/CLWB + SFENCE for each. A
+// write that fits inside one line is instead stored with cached stores and
+// its line left pending in the thread's buffer; the line is written back
+// once, when the thread writes another line, when the file is synced or
+// closed, or by a background flusher after flush_us.
+//
+// Loads see staged bytes at once (they are in the cache, coherent across
+// threads); only durability is deferred, as it is with a page cache.
+
+namespace cxl_intercept {
+
+class WriteCombiner {
+public:
+    struct Stats {
+        uint64_t writes = 0;    // sub-line writes staged
+        uint64_t combined = 0;  // of those, merged into an already pending line
+        uint64_t flushes = 0;   // line write-backs
+    };
+
+    // Called once, before any writes; epoch guards the flusher's and
+    // drain()'s accesses to windowed regions
+    void configure(uint64_t flush_us, EpochDomain* epoch) {
+        uint64_t hz = calibrate_tsc_hz();
+        if (!hz) return;
+        if (flush_us == 0) flush_us = 1;
+        flush_cycles_ = flush_us * (hz / 1000000);
+        sleep_ns_ = flush_us * 500;
+        epoch_ = epoch;
+        enabled_ = true;
+    }
+
+    bool enabled() const { return enabled_; }
+
+    // True if a write of n bytes at dst stays inside one line
+    static bool fits(const char* dst, size_t n) {
+        uintptr_t a = reinterpret_cast<uintptr_t>(dst);
+        return n != 0 && (a & (kLine - 1)) + n <= kLine;
+    }
+
+    // Store a fits() write and leave its line pending in the calling
+    // thread's buffer; mode is the eager mode the line is written back with
+    void write(DaxRegion* region, char* dst, const void* src, size_t n, cxl_ssd::PersistMode mode) {
+        Buffer* b = local();
+        char* line = reinterpret_cast<char*>(reinterpret_cast<uintptr_t>(dst) & ~(kLine - 1));
+        lock(b);
+        b->writes.store(b->writes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        if (b->line == line && b->mode == mode) {
+            b->combined.store(b->combined.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        } else {
+            if (b->line) flush_line(b);
+            b->line = line;
+            b->region = region;
+            b->mode = mode;
+            b->since = __rdtsc();
+        }
+        memcpy(dst, src, n);
+        unlock(b);
+    }
+
+    // Write back the calling thread's pending line, so a write that is not
+    // combined does not become durable ahead of an earlier one
+    void flush_own() {
+        Buffer* b = tls().buffer;
+        if (!b) return;
+        lock(b);
+        if (b->line) flush_line(b);
+        unlock(b);
+    }
+
+    // Write back every thread's pending lines in [start, start + len)
+    void drain(const char* start, size_t len) {
+        std::lock_guard<std::mutex> lk(mu_);
+        EpochDomain::Guard guard(*epoch_);
+        uintptr_t lo = reinterpret_cast<uintptr_t>(start);
+        for (Buffer* b : buffers_) {
+            lock(b);
+            uintptr_t line = reinterpret_cast<uintptr_t>(b->line);
+            if (line && line + kLine > lo && (line < lo || line - lo < len)) flush_line(b);
+            unlock(b);
+        }
+    }
+
+    void drain_all() {
+        if (enabled_) drain(nullptr, SIZE_MAX);
+    }
+
+    Stats stats() {
+        std::lock_guard<std::mutex> lk(mu_);
+        Stats s = exited_;
+        for (Buffer* b : buffers_) add(s, b);
+        return s;
+    }
+
+    // Stop the flusher and write everything back (library destructor)
+    void shutdown() {
+        if (!enabled_) return;
+        {
+            std::unique_lock<std::mutex> lk(mu_);
+            stop_ = true;
+            wake_.fetch_add(1, std::memory_order_relaxed);
+            futex_wake(&wake_, INT32_MAX);
+            while (flusher_) {
+                uint32_t seq = wake_.load(std::memory_order_relaxed);
+                lk.unlock();
+                futex_wait(&wake_, seq);
+                lk.lock();
+            }
+        }
+        drain_all();
+    }
+
+    // pthread_atfork() handlers. The child keeps the buffers of threads
+    // that did not survive fork(); their lines are still written back.
+    void fork_prepare() { mu_.lock(); }
+    void fork_parent() { mu_.unlock(); }
+    void fork_child() {
+        for (Buffer* b : buffers_) b->busy.store(false, std::memory_order_relaxed);
+        flusher_ = false;
+        mu_.unlock();
+    }
+
+private:
+    static constexpr uintptr_t kLine = 64;
+
+    struct alignas(64) Buffer {
+        std::atomic<bool> busy{false};
+        char* line = nullptr;  // pending line, under busy
+        DaxRegion* region = nullptr;
+        cxl_ssd::PersistMode mode = cxl_ssd::PersistMode::CLFLUSHOPT;
+        uint64_t since = 0;    // TSC when line became pending
+        // Written by the owner only, read by stats()
+        std::atomic<uint64_t> writes{0};
+        std::atomic<uint64_t> combined{0};
+        std::atomic<uint64_t> flushes{0};
+    };
+
+    // Registers the thread's buffer on first use and retires it at exit.
+    // One combiner per intercept library, so a single thread_local suffices.
+    struct ThreadBuffer {
+        WriteCombiner* owner = nullptr;
+        Buffer* buffer = nullptr;
+        ~ThreadBuffer() {
+            if (owner) owner->retire(buffer);
+        }
+    };
+
+    static ThreadBuffer& tls() {
+        static thread_local ThreadBuffer tb;
+        return tb;
+    }
+
+    Buffer* local() {
+        ThreadBuffer& tb = tls();
+        if (tb.buffer) return tb.buffer;
+        Buffer* b = new Buffer;
+        {
+            std::lock_guard<std::mutex> lk(mu_);
+            buffers_.push_back(b);
+            if (!flusher_ && !stop_) start_flusher();
+        }
+        tb.owner = this;
+        tb.buffer = b;
+        return b;
+    }
+
+    void retire(Buffer* b) {
+        std::lock_guard<std::mutex> lk(mu_);
+        {
+            EpochDomain::Guard guard(*epoch_);
+            lock(b);
+            if (b->line) flush_line(b);
+            unlock(b);
+        }
+        add(exited_, b);
+        for (size_t i = 0; i < buffers_.size(); i++) {
+            if (buffers_[i] == b) {
+                buffers_[i] = buffers_.back();
+                buffers_.pop_back();
+                break;
+            }
+        }
+        delete b;
+    }
+
+    static void add(Stats& s, const Buffer* b) {
+        s.writes += b->writes.load(std::memory_order_relaxed);
+        s.combined += b->combined.load(std::memory_order_relaxed);
+        s.flushes += b->flushes.load(std::memory_order_relaxed);
+    }
+
+    static void lock(Buffer* b) {
+        while (b->busy.exchange(true, std::memory_order_acquire)) _mm_pause();
+    }
+
+    static bool try_lock(Buffer* b) {
+        return !b->busy.exchange(true, std::memory_order_acquire);
+    }
+
+    static void unlock(Buffer* b) { b->busy.store(false, std::memory_order_release); }
+
+    // Under the buffer's lock, inside an epoch guard. If the line's window
+    // can no longer be mapped the line is left to the cache to write back:
+    // there is no write left to fail.
+    static void flush_line(Buffer* b) {
+        if (b->region->ensure(b->line, kLine)) {
+            cxl_ssd::persist_flush(b->line, kLine, b->mode);
+            cxl_ssd::persist_fence(b->mode);
+        } else {
+            static std::atomic<bool> warned{false};
+            if (!warned.exchange(true, std::memory_order_relaxed)) {
+                fprintf(stderr, "[WRITE_COMBINE] Cannot map a staged line to flush it: %s\n", strerror(errno));
+            }
+        }
+        b->line = nullptr;
+        b->flushes.store(b->flushes.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    // Under mu_. Detached, like the window reclaimer: nothing joins it
+    // after fork() or at exit.
+    void start_flusher() {
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        pthread_t tid;
+        flusher_ = pthread_create(&tid, &attr, flusher_main, this) == 0;
+        pthread_attr_destroy(&attr);
+    }
+
+    static void* flusher_main(void* arg) {
+        // Leave signal handling to the application's threads
+        sigset_t all;
+        sigfillset(&all);
+        pthread_sigmask(SIG_BLOCK, &all, nullptr);
+        static_cast<WriteCombiner*>(arg)->flush_loop();
+        return nullptr;
+    }
+
+    // Every flush_us / 2, write back lines pending longer than flush_us.
+    // A buffer its owner is using is skipped; the owner is about to flush
+    // or extend it anyway.
+    void flush_loop() {
+        struct timespec ts = {time_t(sleep_ns_ / 1000000000ULL), long(sleep_ns_ % 1000000000ULL)};
+        std::unique_lock<std::mutex> lk(mu_);
+        while (!stop_) {
+            uint32_t seq = wake_.load(std::memory_order_relaxed);
+            lk.unlock();
+            futex_wait(&wake_, seq, &ts);
+            lk.lock();
+            uint64_t now = __rdtsc();
+            EpochDomain::Guard guard(*epoch_);
+            for (Buffer* b : buffers_) {
+                if (!try_lock(b)) continue;
+                if (b->line && now - b->since >= flush_cycles_) flush_line(b);
+                unlock(b);
+            }
+        }
+        flusher_ = false;
+        wake_.fetch_add(1, std::memory_order_relaxed);
+        futex_wake(&wake_, INT32_MAX);
+    }
+
+    bool enabled_ = false;
+    uint64_t flush_cycles_ = 0;
+    uint64_t sleep_ns_ = 0;
+    EpochDomain* epoch_ = nullptr;
+
+    std::mutex mu_;
+    std::vector<Buffer*> buffers_;  // live threads' buffers
+    Stats exited_;                  // counts of threads that have exited
+    std::atomic<uint32_t> wake_{0};
+    bool flusher_ = false;
+    bool stop_ = false;
+};
+
+} // namespace cxl_intercept
+
+#endif // CXL_WRITE_COMBINE_HPP
@@ -0,0 +1,348 @@
+#ifndef CXL_ZERO_MAP_HPP
+#define CXL_ZERO_MAP_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <immintrin.h>
+#include <sched.h>
+
+#include "cxl_persist.hpp"
+
+// Zero-block detection and thin storage of all-zero blocks (FIO_DAX_THIN).
+// Prefill jobs write long runs of zeroes, each copied and flushed line by
+// line onto the device. In thin mode a whole block of zeroes is instead
+// recorded in the region's zero map and not stored at all; reads of a
+// block the map holds as zero are served with zeroes without touching the
+// device, and the first other write to it zero-fills (or overwrites) the
+// block on the device before clearing its state.
+//
+// The map lives in the catalog's metadata (see cxl_dax_catalog.hpp), two
+// bits per block, updated with atomics every process mapping the region
+// sees:
+//   00  normal: the device holds the data
+//   01  zero: the device contents are stale, the block reads as zeroes
+//   11  busy: being filled by a writer; still reads as zeroes
+// A crash leaves at worst a busy block, which still reads as zero (its
+// write was not acknowledged); the first process to attach turns such
+// blocks back into zero blocks.
+
+namespace cxl_intercept {
+
+namespace zero_detail {
+
+__attribute__((target("avx512f")))
+inline bool is_zero_avx512(const char* p, size_t n) {
+    size_t i = 0;
+    for (; i + 256 <= n; i += 256) {
+        __m512i v = _mm512_or_si512(
+            _mm512_or_si512(_mm512_loadu_si512(p + i), _mm512_loadu_si512(p + i + 64)),
+            _mm512_or_si512(_mm512_loadu_si512(p + i + 128), _mm512_loadu_si512(p + i + 192)));
+        if (_mm512_test_epi64_mask(v, v)) return false;
+    }
+    for (; i + 64 <= n; i += 64) {
+        __m512i v = _mm512_loadu_si512(p + i);
+        if (_mm512_test_epi64_mask(v, v)) return false;
+    }
+    for (; i < n; i++) {
+        if (p[i]) return false;
+    }
+    return true;
+}
+
+__attribute__((target("avx2")))
+inline bool is_zero_avx2(const char* p, size_t n) {
+    size_t i = 0;
+    for (; i + 128 <= n; i += 128) {
+        __m256i a = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i)),
+                                    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i + 32)));
+        __m256i b = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i + 64)),
+                                    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i + 96)));
+        __m256i v = _mm256_or_si256(a, b);
+        if (!_mm256_testz_si256(v, v)) return false;
+    }
+    for (; i < n; i++) {
+        if (p[i]) return false;
+    }
+    return true;
+}
+
+inline bool is_zero_scalar(const char* p, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t v;
+        memcpy(&v, p + i, sizeof(v));
+        if (v) return false;
+    }
+    for (; i < n; i++) {
+        if (p[i]) return false;
+    }
+    return true;
+}
+
+enum class Simd { SCALAR, AVX2, AVX512 };
+
+inline Simd simd() {
+    static const Simd level = __builtin_cpu_supports("avx512f") ? Simd::AVX512
+                              : __builtin_cpu_supports("avx2") ? Simd::AVX2
+                                                               : Simd::SCALAR;
+    return level;
+}
+
+} // namespace zero_detail
+
+// True if all n bytes at p are zero; bails out at the first 128/256-byte
+// stride holding a non-zero byte
+inline bool is_zero(const void* p, size_t n) {
+    const char* c = static_cast<const char*>(p);
+    switch (zero_detail::simd()) {
+        case zero_detail::Simd::AVX512: return zero_detail::is_zero_avx512(c, n);
+        case zero_detail::Simd::AVX2: return zero_detail::is_zero_avx2(c, n);
+        default: return zero_detail::is_zero_scalar(c, n);
+    }
+}
+
+class ZeroMap {
+public:
+    // Zero blocks written, zero blocks turned back into data, and blocks
+    // read as zeroes
+    enum Counter { ELIDED, FILLED, ZERO_READS, NUM_COUNTERS };
+
+    // Blocks of block bytes from base, states in words; used is the
+    // catalog's sticky "map has held a zero block" flag. mode persists
+    // map updates and fills.
+    void attach(char* base, size_t block, uint64_t* words, uint64_t* used, cxl_ssd::PersistMode mode) {
+        base_ = base;
+        block_ = block;
+        shift_ = __builtin_ctzll(block);
+        words_ = words;
+        used_ = used;
+        mode_ = mode;
+    }
+
+    void detach() { words_ = nullptr; }
+
+    bool attached() const { return words_ != nullptr; }
+    size_t block() const { return block_; }
+
+    // True once any process marked a block: until then reads and writes
+    // need not consult the map
+    bool in_use() const {
+        return words_ && std::atomic_ref<uint64_t>(*used_).load(std::memory_order_acquire) != 0;
+    }
+
+    const char* block_start(const char* addr) const {
+        return base_ + (static_cast<size_t>(addr - base_) & ~(block_ - 1));
+    }
+
+    // The block holding addr reads as zeroes
+    bool reads_zero(const char* addr) const {
+        size_t i = index(addr);
+        return (word(i).load(std::memory_order_acquire) >> bit(i)) & kZero;
+    }
+
+    // Record the block holding addr as zero instead of storing zeroes to
+    // it. Waits out a writer filling it.
+    void mark_zero(const char* addr) {
+        std::atomic_ref<uint64_t> used(*used_);
+        if (!used.load(std::memory_order_relaxed)) {
+            used.store(1, std::memory_order_release);
+            persist(used_);
+        }
+        size_t i = index(addr);
+        std::atomic_ref<uint64_t> w = word(i);
+        uint64_t old = w.load(std::memory_order_relaxed);
+        for (;;) {
+            uint64_t state = (old >> bit(i)) & kBusy;
+            if (state == kZero) break;
+            if (state == kBusy) {
+                sched_yield();
+                old = w.load(std::memory_order_relaxed);
+                continue;
+            }
+            if (w.compare_exchange_weak(old, old | (kZero << bit(i)), std::memory_order_acq_rel,
+                                        std::memory_order_relaxed)) {
+                persist(&words_[i / kPerWord]);
+                break;
+            }
+        }
+        bump(ELIDED);
+    }
+
+    // Before storing into the block holding addr: if it is a zero block,
+    // claim it (true) so the caller can fill it and release() it; waits
+    // out another writer filling it
+    bool claim(const char* addr) {
+        size_t i = index(addr);
+        std::atomic_ref<uint64_t> w = word(i);
+        uint64_t old = w.load(std::memory_order_acquire);
+        for (;;) {
+            uint64_t state = (old >> bit(i)) & kBusy;
+            if (state == kNormal) return false;
+            if (state == kBusy) {
+                sched_yield();
+                old = w.load(std::memory_order_acquire);
+                continue;
+            }
+            if (w.compare_exchange_weak(old, old | (kBusy << bit(i)), std::memory_order_acq_rel,
+                                        std::memory_order_acquire)) {
+                return true;
+            }
+        }
+    }
+
+    // Zero the device copy of a claimed block, for a write that covers
+    // only part of it
+    void fill(const char* addr) {
+        char* start = const_cast<char*>(block_start(addr));
+        memset(start, 0, block_);
+        cxl_ssd::persist_flush(start, block_, mode_);
+        cxl_ssd::persist_fence(mode_);
+    }
+
+    // The claimed block's data is on the device: it reads from there now
+    void release(const char* addr) {
+        size_t i = index(addr);
+        word(i).fetch_and(~(kBusy << bit(i)), std::memory_order_acq_rel);
+        persist(&words_[i / kPerWord]);
+        bump(FILLED);
+    }
+
+    // Copy n bytes of region memory at src to dst, with zeroes for blocks
+    // held as zero; copy(dst, src, n) copies the runs of other blocks
+    template <typename Copy>
+    void read(const char* src, char* dst, size_t n, Copy&& copy) {
+        while (n > 0) {
+            size_t piece = static_cast<size_t>(block_start(src) + block_ - src);
+            if (piece > n) piece = n;
+            if (reads_zero(src)) {
+                memset(dst, 0, piece);
+                bump(ZERO_READS);
+            } else {
+                copy(dst, src, piece);
+            }
+            src += piece;
+            dst += piece;
+            n -= piece;
+        }
+    }
+
+    // Store n bytes from src at dst. With elide, whole blocks of zeroes are
+    // marked rather than stored; a block held as zero is claimed, zero-filled
+    // unless the store covers it, and released after the store.
+    // store(dst, src, n, claimed) stores a run of blocks; for a claimed
+    // block it must return with the data durable.
+    template <typename Store>
+    void write(char* dst, const char* src, size_t n, bool elide, Store&& store) {
+        char* run = dst;  // blocks stored as they are, not yet handed to store()
+        const char* run_src = src;
+        while (n > 0) {
+            size_t piece = static_cast<size_t>(block_start(dst) + block_ - dst);
+            if (piece > n) piece = n;
+            bool whole = piece == block_;
+            bool zero = elide && whole && is_zero(src, piece);
+            bool claimed = !zero && claim(dst);
+            if (zero || claimed) {
+                if (dst > run) store(run, run_src, static_cast<size_t>(dst - run), false);
+                if (zero) {
+                    mark_zero(dst);
+                } else {
+                    if (!whole) fill(dst);
+                    store(dst, src, piece, true);
+                    release(dst);
+                }
+                run = dst + piece;
+                run_src = src + piece;
+            }
+            dst += piece;
+            src += piece;
+            n -= piece;
+        }
+        if (dst > run) store(run, run_src, static_cast<size_t>(dst - run), false);
+    }
+
+    // Make every zero block in [addr, addr + len) real on the device, for
+    // memory the application reaches directly (mmap). touch(block, n) makes
+    // a block accessible first, or returns false to stop (and make this
+    // return false).
+    template <typename Touch>
+    bool materialize(const char* addr, size_t len, Touch&& touch) {
+        if (!in_use() || len == 0) return true;
+        for (const char* p = block_start(addr); p < addr + len; p += block_) {
+            if (!reads_zero(p)) continue;
+            if (!touch(p, block_)) return false;
+            if (!claim(p)) continue;
+            fill(p);
+            release(p);
+        }
+        return true;
+    }
+
+    // Blocks left busy by a process that died filling them read as zero
+    // again; only when no other process is attached
+    void recover(size_t blocks) {
+        for (size_t w = 0; w < (blocks + kPerWord - 1) / kPerWord; w++) {
+            uint64_t v = words_[w];
+            uint64_t busy = v & (v >> 1) & kLowBits;
+            if (!busy) continue;
+            words_[w] = v & ~(busy << 1);
+            persist(&words_[w]);
+        }
+    }
+
+    uint64_t total(Counter counter) const {
+        uint64_t sum = 0;
+        for (const Shard& s : shards_) sum += s.v[counter].load(std::memory_order_relaxed);
+        return sum;
+    }
+
+    // Bytes of map for blocks of block bytes covering size bytes
+    static size_t map_bytes(size_t size, size_t block) {
+        size_t blocks = (size + block - 1) / block;
+        return (blocks + kPerWord - 1) / kPerWord * sizeof(uint64_t);
+    }
+
+private:
+    static constexpr uint64_t kNormal = 0;
+    static constexpr uint64_t kZero = 1;
+    static constexpr uint64_t kBusy = 3;
+    static constexpr size_t kPerWord = 32;
+    static constexpr uint64_t kLowBits = 0x5555555555555555ULL;
+    static constexpr int kShards = 16;
+
+    size_t index(const char* addr) const { return static_cast<size_t>(addr - base_) >> shift_; }
+    static unsigned bit(size_t i) { return 2 * (i % kPerWord); }
+    std::atomic_ref<uint64_t> word(size_t i) const { return std::atomic_ref<uint64_t>(words_[i / kPerWord]); }
+
+    void persist(const void* addr) {
+        cxl_ssd::persist_flush(addr, sizeof(uint64_t), mode_);
+        cxl_ssd::persist_fence(mode_);
+    }
+
+    void bump(Counter counter) {
+        shards_[shard_index()].v[counter].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> v[NUM_COUNTERS] = {};
+    };
+
+    static unsigned shard_index() {
+        static std::atomic<unsigned> next{0};
+        static thread_local unsigned index = next.fetch_add(1, std::memory_order_relaxed) % kShards;
+        return index;
+    }
+
+    char* base_ = nullptr;
+    size_t block_ = 0;
+    unsigned shift_ = 0;
+    uint64_t* words_ = nullptr;
+    uint64_t* used_ = nullptr;
+    cxl_ssd::PersistMode mode_ = cxl_ssd::PersistMode::CLFLUSHOPT;
+    Shard shards_[kShards];
+};
+
+} // namespace cxl_intercept
+
+#endif // CXL_ZERO_MAP_HPP
@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+"""
+Fit the intercept libraries' CXL-SSD timing model (FIO_CXL_TIMING) to fio
+results from a real device, by default scripts/cxl_raw:
+
+  read_ns, write_ns            fixed cost: QD1 mean latency of small blocks
+                               (raw/blocksize, <= 16k) less their transfer time
+  read/write_ns_per_byte       1 / peak single-stream bandwidth (raw/blocksize)
+  bandwidth_mbps               peak read + write bandwidth of any raw run
+  burst_kb                     bandwidth x read_ns, the bytes in flight during
+                               one fixed latency
+  sync_ns                      fdatasync latency of the smallest writes
+                               (filesystem/byte_addressable)
+  miss_rate, miss_ns           random reads as a mix of sequential-speed hits
+                               and slow-tier misses: miss_ns is randread p90
+                               less the sequential mean, miss_rate makes the
+                               mix match the randread mean (raw/access_pattern)
+
+Usage: calibrate_timing_model.py [results_dir] [-o model.conf]
+"""
+
+import argparse
+import glob
+import json
+import os
+import statistics
+
+def load_fio_json(path):
+    """fio JSON output, skipping the text fio prints before and after it"""
+    with open(path, 'r') as f:
+        text = f.read()
+    start = text.find('{\n')
+    if start < 0:
+        return None
+    try:
+        return json.JSONDecoder().raw_decode(text[start:])[0]
+    except json.JSONDecodeError:
+        return None
+
+def parse_bs(bs):
+    """fio block size string ("4k", "16m", "512") in bytes"""
+    units = {'k': 1 << 10, 'm': 1 << 20, 'g': 1 << 30}
+    bs = bs.lower()
+    if bs[-1] in units:
+        return int(bs[:-1]) * units[bs[-1]]
+    return int(bs)
+
+def job_samples(results_dir, pattern):
+    """(job, bytes per op) for every job in the matching result files"""
+    samples = []
+    for path in sorted(glob.glob(os.path.join(results_dir, pattern))):
+        data = load_fio_json(path)
+        if not data:
+            print(f"Skipping unreadable {path}")
+            continue
+        for job in data.get('jobs', []):
+            samples.append((job, parse_bs(job['job options'].get('bs', '4k'))))
+    return samples
+
+def fit_direction(samples, direction):
+    """Fixed cost (ns) and per-byte cost (ns/B) of one direction"""
+    points = [(bs, job[direction]['clat_ns']['mean'], job[direction]['bw_bytes'])
+              for job, bs in samples if job[direction]['io_bytes']]
+    if not points:
+        return 0.0, 0.0
+    ns_per_byte = 1e9 / max(bw for _, _, bw in points)
+    small = [mean - ns_per_byte * bs for bs, mean, _ in points if bs <= 16 << 10]
+    base = statistics.median(small) if small else min(mean for _, mean, _ in points)
+    return max(base, 0.0), ns_per_byte
+
+def calibrate(results_dir):
+    model = {}
+    blocksize = job_samples(results_dir, 'raw/blocksize/*.json')
+    model['read_ns'], model['read_ns_per_byte'] = fit_direction(blocksize, 'read')
+    model['write_ns'], model['write_ns_per_byte'] = fit_direction(blocksize, 'write')
+
+    peak = max((job['read']['bw_bytes'] + job['write']['bw_bytes']
+                for job, _ in job_samples(results_dir, 'raw/*/*.json')), default=0)
+    model['bandwidth_mbps'] = peak / 1e6
+    model['burst_kb'] = peak * model['read_ns'] / 1e9 / 1024
+
+    syncs = [(bs, job['sync']['lat_ns']['mean'])
+             for job, bs in job_samples(results_dir, 'filesystem/byte_addressable/*.json')
+             if job.get('sync', {}).get('lat_ns', {}).get('N')]
+    model['sync_ns'] = min(syncs)[1] if syncs else 0.0
+
+    pattern = {job['job options'].get('rw'): job
+               for job, _ in job_samples(results_dir, 'raw/access_pattern/*.json')}
+    model['miss_rate'] = model['miss_ns'] = 0.0
+    if 'read' in pattern and 'randread' in pattern:
+        seq = pattern['read']['read']['clat_ns']
+        rnd = pattern['randread']['read']['clat_ns']
+        miss_ns = rnd['percentile']['90.000000'] - seq['mean']
+        if miss_ns > 0:
+            model['miss_ns'] = miss_ns
+            model['miss_rate'] = min(1.0, max(0.0, (rnd['mean'] - seq['mean']) / miss_ns))
+    return model
+
+def write_model(model, results_dir, out):
+    keys = ['read_ns', 'read_ns_per_byte', 'write_ns', 'write_ns_per_byte', 'sync_ns',
+            'bandwidth_mbps', 'burst_kb', 'miss_rate', 'miss_ns']
+    with open(out, 'w') as f:
+        f.write(f"# CXL-SSD timing model fitted to {results_dir}\n")
+        f.write("# by scripts/calibrate_timing_model.py; use with FIO_CXL_TIMING=<this file>\n")
+        for key in keys:
+            f.write(f"{key} = {model[key]:.4f}\n" if key.endswith(('per_byte', 'rate'))
+                    else f"{key} = {model[key]:.0f}\n")
+    print(f"Created timing model: {out}")
+
+def main():
+    script_dir = os.path.dirname(os.path.abspath(__file__))
+    ap = argparse.ArgumentParser(description='Fit the FIO_CXL_TIMING model to fio results')
+    ap.add_argument('results_dir', nargs='?', default=os.path.join(script_dir, 'cxl_raw'))
+    ap.add_argument('-o', '--output', default=os.path.join(script_dir, 'cxl_timing_model.conf'))
+    args = ap.parse_args()
+
+    model = calibrate(args.results_dir)
+    for key, value in model.items():
+        print(f"  {key}: {value:.4f}")
+    write_model(model, os.path.relpath(args.results_dir, script_dir), args.output)
+
+if __name__ == "__main__":
+    main()
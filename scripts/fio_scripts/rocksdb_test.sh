@@ -13,6 +13,8 @@ DB_PATH="${CONFIG_rocksdb_db_path:-${FILESYSTEM_MOUNT}/rocksdb_test}"
 NUM_KEYS="${CONFIG_rocksdb_num_keys:-10000000}"
 VALUE_SIZE="${CONFIG_rocksdb_value_size:-1024}"
 RESULTS_DIR="${RESULTS_BASE_DIR}/rocksdb"
+# Set to libfio_intercept.so to put the WAL on the DAX region in append mode
+WAL_DAX_LIB="${WAL_DAX_LIB:-}"
 
 # Create results directory
 mkdir -p "$RESULTS_DIR"
@@ -63,7 +65,12 @@ run_rocksdb_benchmark() {
     
     log_message "Running RocksDB benchmark: $benchmark_name"
     
-    "$DB_BENCH" \
+    local -a wal_env=()
+    if [[ -n "$WAL_DAX_LIB" ]]; then
+        wal_env=(LD_PRELOAD="$WAL_DAX_LIB" FIO_INTERCEPT_PATTERN="$DB_PATH/wal/" FIO_DAX_WAL="$DB_PATH/wal/")
+    fi
+    
+    env "${wal_env[@]}" "$DB_BENCH" \
         --db="$DB_PATH" \
         --wal_dir="$DB_PATH/wal" \
         --num="$NUM_KEYS" \
@@ -2,21 +2,161 @@
 
 import json
 import csv
+import math
 import os
 import glob
 from pathlib import Path
 
+# Percentiles reported for both fio (end-to-end) and the intercept layer
+# (device-side copy + persist)
+PERCENTILES = [('p90', 90), ('p95', 95), ('p99', 99), ('p99.9', 99.9), ('p99.99', 99.99)]
+
 class FioResultParser:
     def __init__(self, results_dir):
         self.results_dir = results_dir
         self.summary_dir = os.path.join(results_dir, 'summary')
         os.makedirs(self.summary_dir, exist_ok=True)
     
+    def fio_result_files(self, test_type):
+        """FIO JSON outputs, without the intercept-layer files written next to them"""
+        json_files = glob.glob(os.path.join(self.results_dir, test_type, '*.json'))
+        return [f for f in json_files if not any(tag in f for tag in ('.lat.', '.dax.', '.wc.', '.pf.', '.verify.', '.thin.', '.qos.', '.cache.'))]
+
+    def find_device_histograms(self, json_file):
+        """Histograms the intercept libraries wrote for this run
+        (FIO_LAT_HIST_FILE=<result>.lat.%p.json, one per process)"""
+        stem = os.path.splitext(json_file)[0]
+        return sorted(glob.glob(f"{stem}.lat.*.json"))
+
+    @staticmethod
+    def parse_write_combining(json_file):
+        """Share of sub-line writes merged into a pending line, over every
+        process of the run (FIO_WC_STATS_FILE=<result>.wc.%p.json); None
+        when write combining was off"""
+        stem = os.path.splitext(json_file)[0]
+        writes = combined = 0
+        for wc_file in glob.glob(f"{stem}.wc.*.json"):
+            with open(wc_file, 'r') as f:
+                wc = json.load(f)['write_combining']
+            writes += wc['writes']
+            combined += wc['combined']
+        return combined / writes if writes else None
+
+    @staticmethod
+    def parse_prefetch(json_file):
+        """Share of prefetched lines a later read copied, over every process
+        of the run (FIO_PREFETCH_STATS_FILE=<result>.pf.%p.json); None when
+        prefetch was off or never triggered"""
+        stem = os.path.splitext(json_file)[0]
+        issued = useful = 0
+        for pf_file in glob.glob(f"{stem}.pf.*.json"):
+            with open(pf_file, 'r') as f:
+                pf = json.load(f)['prefetch']
+            issued += pf['lines_issued']
+            useful += min(pf['lines_useful'], pf['lines_issued'])
+        return useful / issued if issued else None
+
+    @staticmethod
+    def parse_verify(json_file):
+        """CRC32C mismatches over every process of the run
+        (FIO_VERIFY_STATS_FILE=<result>.verify.%p.json); None when
+        verification was off"""
+        stem = os.path.splitext(json_file)[0]
+        files = glob.glob(f"{stem}.verify.*.json")
+        if not files:
+            return None
+        mismatches = 0
+        for verify_file in files:
+            with open(verify_file, 'r') as f:
+                mismatches += json.load(f)['verify']['mismatches']
+        return mismatches
+
+    @staticmethod
+    def parse_thin(json_file):
+        """MB of zero blocks marked instead of stored over every process of
+        the run (FIO_THIN_STATS_FILE=<result>.thin.%p.json); None when thin
+        mode was off"""
+        stem = os.path.splitext(json_file)[0]
+        files = glob.glob(f"{stem}.thin.*.json")
+        if not files:
+            return None
+        elided = 0
+        for thin_file in files:
+            with open(thin_file, 'r') as f:
+                elided += json.load(f)['thin']['elided_bytes']
+        return elided / (1024 * 1024)
+
+    @staticmethod
+    def parse_cache(json_file):
+        """Share of page accesses the DRAM cache served, over every process
+        of the run (FIO_CACHE_STATS_FILE=<result>.cache.%p.json); None when
+        the cache was off"""
+        stem = os.path.splitext(json_file)[0]
+        hits = accesses = 0
+        for cache_file in glob.glob(f"{stem}.cache.*.json"):
+            with open(cache_file, 'r') as f:
+                cache = json.load(f)['dram_cache']
+            hits += cache['hits']
+            accesses += cache['hits'] + cache['misses']
+        return hits / accesses if accesses else None
+
+    @staticmethod
+    def parse_qos(json_file):
+        """Milliseconds QoS held operations back, per class, over every
+        process of the run (FIO_QOS_STATS_FILE=<result>.qos.%p.json); None
+        when QoS was off"""
+        stem = os.path.splitext(json_file)[0]
+        files = glob.glob(f"{stem}.qos.*.json")
+        if not files:
+            return None
+        delay = {}
+        for qos_file in files:
+            with open(qos_file, 'r') as f:
+                for cls in json.load(f)['qos']:
+                    delay[cls['class']] = delay.get(cls['class'], 0) + cls['delay_ms']
+        return ';'.join(f"{name}={ms:.1f}" for name, ms in sorted(delay.items()))
+
+    @staticmethod
+    def bin_percentile(bins, p):
+        """p-th percentile (ns) of a {ns: count} histogram"""
+        total = sum(bins.values())
+        rank = max(1, math.ceil(p / 100.0 * total))
+        seen = 0
+        for ns in sorted(bins):
+            seen += bins[ns]
+            if seen >= rank:
+                return ns
+        return 0
+
+    def parse_device_histograms(self, hist_files):
+        """Merge the clat_ns bins of every process and file per direction and
+        return device-side percentiles in us"""
+        bins = {}
+        for hist_file in hist_files:
+            with open(hist_file, 'r') as f:
+                data = json.load(f)
+            for entry in data.get('files', []):
+                for direction in ('read', 'write', 'sync'):
+                    if direction not in entry:
+                        continue
+                    merged = bins.setdefault(direction, {})
+                    for ns, count in entry[direction]['clat_ns']['bins'].items():
+                        merged[int(ns)] = merged.get(int(ns), 0) + count
+
+        results = {}
+        for direction, merged in bins.items():
+            results[direction] = {
+                f'dev_lat_{name}': self.bin_percentile(merged, p) / 1000 for name, p in PERCENTILES
+            }
+        return results
+
     def parse_json_file(self, json_file):
         """Parse a single FIO JSON output file"""
         with open(json_file, 'r') as f:
             data = json.load(f)
         
+        device = self.parse_device_histograms(self.find_device_histograms(json_file))
+        no_device = {f'dev_lat_{name}': None for name, _ in PERCENTILES}
         results = {}
         for job in data['jobs']:
             job_name = job['jobname']
@@ -33,6 +173,11 @@ class FioResultParser:
                     'lat_p99.9': read_data['clat_ns']['percentile']['99.900000'] / 1000,
                     'lat_p99.99': read_data['clat_ns']['percentile']['99.990000'] / 1000,
                 }
+                results[f"{job_name}_read"].update(device.get('read', no_device))
+                results[f"{job_name}_read"]['pf_usefulness'] = self.parse_prefetch(json_file)
+                results[f"{job_name}_read"]['verify_mismatches'] = self.parse_verify(json_file)
+                results[f"{job_name}_read"]['qos_delay_ms'] = self.parse_qos(json_file)
+                results[f"{job_name}_read"]['cache_hit_rate'] = self.parse_cache(json_file)
             
             # Extract write metrics
             if 'write' in job:
@@ -46,12 +191,17 @@ class FioResultParser:
                     'lat_p99.9': write_data['clat_ns']['percentile']['99.900000'] / 1000,
                     'lat_p99.99': write_data['clat_ns']['percentile']['99.990000'] / 1000,
                 }
+                results[f"{job_name}_write"].update(device.get('write', no_device))
+                results[f"{job_name}_write"]['wc_combine_rate'] = self.parse_write_combining(json_file)
+                results[f"{job_name}_write"]['thin_elided_mb'] = self.parse_thin(json_file)
+                results[f"{job_name}_write"]['qos_delay_ms'] = self.parse_qos(json_file)
+                results[f"{job_name}_write"]['cache_hit_rate'] = self.parse_cache(json_file)
         
         return results
     
     def create_summary_csv(self, test_type):
         """Create CSV summary for a specific test type"""
-        json_files = glob.glob(os.path.join(self.results_dir, test_type, '*.json'))
+        json_files = self.fio_result_files(test_type)
         
         if not json_files:
             print(f"No JSON files found for {test_type}")
@@ -85,7 +235,7 @@ class FioResultParser:
     
     def generate_human_readable_report(self, test_type):
         """Generate human-readable report"""
-        json_files = glob.glob(os.path.join(self.results_dir, test_type, '*.json'))
+        json_files = self.fio_result_files(test_type)
         
         report_file = os.path.join(self.summary_dir, f"{test_type}_report.txt")
         
@@ -112,22 +262,66 @@ class FioResultParser:
                         f.write(f"      P99:    {metrics['lat_p99']:.2f}\n")
                         f.write(f"      P99.9:  {metrics['lat_p99.9']:.2f}\n")
                         f.write(f"      P99.99: {metrics['lat_p99.99']:.2f}\n")
+                        if metrics['dev_lat_p90'] is not None:
+                            f.write(f"    Device-side Latency Percentiles (μs):\n")
+                            for name, _ in PERCENTILES:
+                                label = f"{name.upper()}:"
+                                f.write(f"      {label:<7} {metrics[f'dev_lat_{name}']:.2f}\n")
                 
                 except Exception as e:
                     f.write(f"\nError parsing {json_file}: {e}\n")
         
         print(f"Created human-readable report: {report_file}")
 
+    def plot_device_vs_fio(self, test_type):
+        """Plot fio's end-to-end percentiles next to the intercept layer's
+        device-side ones for every job that has both"""
+        rows = []
+        for json_file in sorted(self.fio_result_files(test_type)):
+            try:
+                for job_name, metrics in self.parse_json_file(json_file).items():
+                    if metrics['dev_lat_p90'] is not None:
+                        rows.append((f"{Path(json_file).stem}/{job_name}", metrics))
+            except Exception as e:
+                print(f"Error parsing {json_file}: {e}")
+        if not rows:
+            return
+
+        try:
+            import matplotlib
+            matplotlib.use('Agg')
+            import matplotlib.pyplot as plt
+        except ImportError:
+            print("matplotlib not available; skipping device-side latency plot")
+            return
+
+        fig, axes = plt.subplots(len(rows), 1, figsize=(8, 3 * len(rows)), squeeze=False)
+        labels = [name for name, _ in PERCENTILES]
+        for ax, (name, metrics) in zip(axes[:, 0], rows):
+            ax.plot(labels, [metrics[f'lat_{l}'] for l in labels], marker='o', label='fio (end-to-end)')
+            ax.plot(labels, [metrics[f'dev_lat_{l}'] for l in labels], marker='s', label='device-side')
+            ax.set_yscale('log')
+            ax.set_ylabel('Latency (μs)')
+            ax.set_title(name)
+            ax.legend()
+        fig.tight_layout()
+        plot_file = os.path.join(self.summary_dir, f"{test_type}_device_latency.png")
+        fig.savefig(plot_file)
+        plt.close(fig)
+        print(f"Created device-side latency plot: {plot_file}")
+
 def main():
     parser = FioResultParser('./results')
     
     # Process raw device tests
     parser.create_summary_csv('raw')
     parser.generate_human_readable_report('raw')
+    parser.plot_device_vs_fio('raw')
     
     # Process filesystem tests
     parser.create_summary_csv('filesystem')
     parser.generate_human_readable_report('filesystem')
+    parser.plot_device_vs_fio('filesystem')
     
     print("\nAll results parsed successfully!")
 
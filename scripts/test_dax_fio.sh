@@ -9,7 +9,17 @@ MEM_DEVICE=${MEM_DEVICE:-"/dev/mem"}  # Memory device
 MEM_OFFSET=${MEM_OFFSET:-"0x100000000"}  # Memory offset (4GB)
 MEM_SIZE=${MEM_SIZE:-"16G"}
 FIO_FILE_SIZE=${FIO_FILE_SIZE:-"1G"}
+PERSIST_MODE=${PERSIST_MODE:-"clflushopt"}  # clflushopt, clwb, nt, none, lazy
+WRITE_COMBINE=${WRITE_COMBINE:-0}  # combine sub-line writes per thread (0/1)
+PREFETCH=${PREFETCH:-0}  # prefetch distance for sequential reads (0 = off)
+VERIFY=${VERIFY:-0}  # CRC32C-verify every block read (0/1)
+THIN=${THIN:-0}  # mark all-zero blocks instead of storing them (0/1)
+CACHE=${CACHE:-0}  # DRAM page cache in front of the region, e.g. 1G (0 = off)
+QOS=${QOS:-}  # QoS classes, e.g. "bulk:match=bulk,limit_mbps=500" (empty = off)
 INTERCEPT_LIB="./libfio_intercept.so"
+ENGINE=${ENGINE:-intercept}  # intercept (LD_PRELOAD, psync) or external (fio ioengine)
+ENGINE_LIB=${ENGINE_LIB:-"./libfio_cxl_engine.so"}
+IODEPTH=${IODEPTH:-1}  # queue depth for the external engine
 
 # Colors for output
 RED='\033[0;31m'
@@ -19,6 +29,14 @@ NC='\033[0m'
 
 echo -e "${GREEN}Memory Device FIO Test with LD_PRELOAD${NC}"
 echo "========================================"
+echo "Persistence mode: $PERSIST_MODE"
+echo "Write combining: $WRITE_COMBINE"
+echo "Prefetch distance: $PREFETCH"
+echo "Verify: $VERIFY"
+echo "Thin: $THIN"
+echo "DRAM cache: $CACHE"
+echo "QoS: ${QOS:-off}"
+echo "Engine: $ENGINE"
 
 # Check if running as root
 if [ "$EUID" -ne 0 ]; then
@@ -52,13 +70,34 @@ run_fio_test() {
     export FIO_MEM_OFFSET=$MEM_OFFSET
     export FIO_MEM_SIZE=$MEM_SIZE
     export FIO_FILE_SIZE=$FIO_FILE_SIZE
+    export FIO_DAX_PERSIST=$PERSIST_MODE
     export FIO_DEBUG=${FIO_DEBUG:-0}
-    export LD_PRELOAD=$INTERCEPT_LIB
+    export FIO_DAX_METADATA=results_${test_name}.dax.%p.json
+    export FIO_LAT_HIST_FILE=results_${test_name}.lat.%p.json
+    export FIO_DAX_WRITE_COMBINE=$WRITE_COMBINE
+    export FIO_WC_STATS_FILE=results_${test_name}.wc.%p.json
+    export FIO_DAX_PREFETCH=$PREFETCH
+    export FIO_PREFETCH_STATS_FILE=results_${test_name}.pf.%p.json
+    export FIO_DAX_VERIFY=$VERIFY
+    export FIO_VERIFY_STATS_FILE=results_${test_name}.verify.%p.json
+    export FIO_DAX_THIN=$THIN
+    export FIO_THIN_STATS_FILE=results_${test_name}.thin.%p.json
+    export FIO_DAX_CACHE=$CACHE
+    export FIO_CACHE_STATS_FILE=results_${test_name}.cache.%p.json
+    export FIO_QOS=$QOS
+    export FIO_QOS_STATS_FILE=results_${test_name}.qos.%p.json
+    local engine_params="--ioengine=psync"
+    if [ "$ENGINE" = "external" ]; then
+        export FIO_DAX_DEVICE=${FIO_DAX_DEVICE:-$MEM_DEVICE}
+        engine_params="--ioengine=external:$ENGINE_LIB --iodepth=$IODEPTH"
+    else
+        export LD_PRELOAD=$INTERCEPT_LIB
+    fi
 
     # Run FIO test
     fio --name=$test_name \
         --direct=1 \
-        --ioengine=psync \
+        $engine_params \
         --runtime=10 \
         --time_based \
         --group_reporting \
@@ -70,7 +109,7 @@ run_fio_test() {
 
     # Extract and display key metrics
     if command -v jq >/dev/null 2>&1; then
-        echo "Results for $test_name:"
+        echo "Results for $test_name (persist: $PERSIST_MODE):"
         jq '.jobs[0].read | {iops: .iops, bw_mbps: (.bw/1024), lat_usec: .lat_ns.mean/1000}' \
             results_${test_name}.json 2>/dev/null || true
         jq '.jobs[0].write | {iops: .iops, bw_mbps: (.bw/1024), lat_usec: .lat_ns.mean/1000}' \
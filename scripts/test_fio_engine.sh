@@ -0,0 +1,50 @@
+#!/bin/bash
+
+# Smoke test for the fio external engine (libfio_cxl_engine.so) over a
+# file-backed region: random writes verified with CRC32C at a queue depth
+# that goes through the copy workers and at depth 1, then a second run that
+# reopens the file from the catalog and verifies it again.
+#
+# Usage: test_fio_engine.sh [engine library] [fio binary]
+# Exits 77 (skipped) when fio or the engine library is missing.
+
+set -e
+
+ENGINE_LIB=${1:-"./libfio_cxl_engine.so"}
+FIO=${2:-$(command -v fio || true)}
+REGION_SIZE=${REGION_SIZE:-"256M"}
+
+if [ -z "$FIO" ] || [ ! -x "$FIO" ]; then
+    echo "fio not found, skipping"
+    exit 77
+fi
+if [ ! -f "$ENGINE_LIB" ]; then
+    echo "$ENGINE_LIB not built, skipping"
+    exit 77
+fi
+ENGINE_LIB=$(realpath "$ENGINE_LIB")
+
+REGION=$(mktemp /tmp/fio_engine_smoke.XXXXXX)
+trap 'rm -f "$REGION"' EXIT
+truncate -s "$REGION_SIZE" "$REGION"
+
+export FIO_DAX_DEVICE="$REGION"
+export FIO_DAX_FORMAT=1
+
+run_fio() {
+    local name=$1
+    shift
+    echo "== $name"
+    if ! "$FIO" --name="$name" --ioengine="external:$ENGINE_LIB" --filename=/cxl/smoke \
+            --size=16M --bs=4k --thread --group_reporting "$@"; then
+        echo "FAILED: $name"
+        exit 1
+    fi
+}
+
+run_fio qd8-write-verify --rw=randwrite --iodepth=8 --verify=crc32c --do_verify=1
+run_fio qd1-write-verify --rw=randwrite --iodepth=1 --verify=crc32c --do_verify=1 --randseed=7
+export FIO_DAX_FORMAT=0
+run_fio reopen-verify --rw=randwrite --iodepth=4 --verify=crc32c --verify_only=1 --randseed=7
+
+echo "fio engine smoke test passed"
@@ -5,23 +5,40 @@
 #include <unistd.h>
 #include <immintrin.h>
 #include <cpuid.h>
+#include <cstdlib>
 #include <atomic>
 #include <chrono>
 #include <iostream>
 #include <string>
 #include <thread>
 
+#include "../include/cxl_persist.hpp"
+#include "../include/cxl_zero_map.hpp"
+
 namespace cxl_dax {
 
+using cxl_ssd::PersistMode;
+
 class DAXDevice {
 private:
     int fd;
     void* mapped_base;
     size_t mapped_size;
     std::string device_path;
+    PersistMode persist_mode;
+    bool thin;
+
+    static constexpr size_t kZeroBlock = 4096;
+
+    static bool thin_from_env() {
+        const char* env = getenv("FIO_DAX_THIN");
+        return env && strcmp(env, "1") == 0;
+    }
 
 public:
-    DAXDevice() : fd(-1), mapped_base(nullptr), mapped_size(0) {}
+    DAXDevice() : fd(-1), mapped_base(nullptr), mapped_size(0),
+                  persist_mode(cxl_ssd::eager_persist_mode(cxl_ssd::persist_mode_from_env())),
+                  thin(thin_from_env()) {}
 
     ~DAXDevice() {
         cleanup();
@@ -90,6 +107,20 @@ public:
     void* get_base() const { return mapped_base; }
     size_t get_size() const { return mapped_size; }
 
+    // Persistence strategy for write()/store()/flush(); defaults to
+    // FIO_DAX_PERSIST, downgraded if the CPU lacks the instruction.
+    // Writes here are durable on return, so lazy runs as clwb.
+    void set_persist_mode(PersistMode mode) {
+        persist_mode = cxl_ssd::eager_persist_mode(cxl_ssd::resolve_persist_mode(mode));
+    }
+    PersistMode get_persist_mode() const { return persist_mode; }
+
+    // Thin writes (FIO_DAX_THIN): a 4KB block of zeroes is not stored over
+    // a device block that already holds zeroes. The raw device has no
+    // metadata area for a zero map, so the device contents are the record.
+    void set_thin(bool enabled) { thin = enabled; }
+    bool get_thin() const { return thin; }
+
     // Direct load/store operations
     template<typename T>
     T load(size_t offset) const {
@@ -109,8 +140,8 @@ public:
         __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
 
         // Ensure persistence for DAX
-        _mm_clflushopt(ptr);
-        _mm_sfence();
+        cxl_ssd::persist_flush(ptr, sizeof(T), persist_mode);
+        cxl_ssd::persist_fence(persist_mode);
     }
 
     // Bulk operations
@@ -126,14 +157,26 @@ public:
             throw std::out_of_range("DAX write out of bounds");
         }
 
-        void* dest = static_cast<char*>(mapped_base) + offset;
-        memcpy(dest, buffer, size);
-
-        // Flush cache lines for persistence
-        for (size_t i = 0; i < size; i += 64) {
-            _mm_clflushopt(static_cast<char*>(dest) + i);
+        char* dest = static_cast<char*>(mapped_base) + offset;
+        if (!thin) {
+            cxl_ssd::persist_copy(dest, buffer, size, persist_mode);
+            return;
         }
-        _mm_sfence();
+        // Store the runs between whole blocks that are zero on both sides
+        const char* src = static_cast<const char*>(buffer);
+        size_t run = 0;
+        size_t pos = 0;
+        while (pos < size) {
+            size_t piece = kZeroBlock - ((offset + pos) & (kZeroBlock - 1));
+            if (piece > size - pos) piece = size - pos;
+            if (piece == kZeroBlock && cxl_intercept::is_zero(src + pos, piece) &&
+                cxl_intercept::is_zero(dest + pos, piece)) {
+                if (pos > run) cxl_ssd::persist_copy(dest + run, src + run, pos - run, persist_mode);
+                run = pos + piece;
+            }
+            pos += piece;
+        }
+        if (size > run) cxl_ssd::persist_copy(dest + run, src + run, size - run, persist_mode);
     }
 
     // MWAIT support with DAX memory
@@ -194,10 +237,8 @@ public:
 
     // Flush entire mapped region
     void flush() {
-        for (size_t i = 0; i < mapped_size; i += 64) {
-            _mm_clflushopt(static_cast<char*>(mapped_base) + i);
-        }
-        _mm_sfence();
+        cxl_ssd::persist_flush(mapped_base, mapped_size, persist_mode);
+        cxl_ssd::persist_fence(persist_mode);
     }
 };
 
@@ -0,0 +1,131 @@
+// Decoder for the binary traces written by the intercept libraries
+// (FIO_TRACE_FILE). Prints one line per record as text or CSV.
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../include/cxl_trace.hpp"
+
+using cxl_intercept::TraceFileHeader;
+using cxl_intercept::TraceRecord;
+
+namespace {
+
+void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [--csv] [--summary] <trace_file>\n", prog);
+    fprintf(stderr, "  --csv      emit comma-separated values with a header row\n");
+    fprintf(stderr, "  --summary  print per-op counts and mean latency only\n");
+}
+
+struct OpSummary {
+    uint64_t count = 0;
+    uint64_t bytes = 0;
+    double total_ns = 0;
+};
+
+} // anonymous namespace
+
+int main(int argc, char* argv[]) {
+    bool csv = false;
+    bool summary = false;
+    const char* path = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--csv") == 0) csv = true;
+        else if (strcmp(argv[i], "--summary") == 0) summary = true;
+        else if (argv[i][0] == '-') { usage(argv[0]); return 1; }
+        else path = argv[i];
+    }
+    if (!path) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+
+    TraceFileHeader hdr{};
+    if (fread(&hdr, sizeof(hdr), 1, f) != 1 ||
+        memcmp(hdr.magic, cxl_intercept::kTraceMagic, sizeof(hdr.magic)) != 0) {
+        fprintf(stderr, "%s: not a CXL trace file\n", path);
+        fclose(f);
+        return 1;
+    }
+    if (hdr.version != cxl_intercept::kTraceVersion || hdr.record_size != sizeof(TraceRecord)) {
+        fprintf(stderr, "%s: unsupported trace version %u (record size %u)\n",
+                path, hdr.version, hdr.record_size);
+        fclose(f);
+        return 1;
+    }
+    if (fseek(f, cxl_intercept::kTraceHeaderSize, SEEK_SET) != 0) {
+        fclose(f);
+        return 1;
+    }
+
+    double ns_per_cycle = hdr.tsc_hz ? 1e9 / static_cast<double>(hdr.tsc_hz) : 0.0;
+
+    if (!summary) {
+        if (csv) {
+            printf("time_ns,tid,op,fd,offset,length,result,latency_ns\n");
+        } else {
+            printf("# source=%s pid=%u records=%" PRIu64 " dropped=%" PRIu64 " tsc_hz=%" PRIu64 "\n",
+                   hdr.source, hdr.pid, hdr.record_count, hdr.dropped, hdr.tsc_hz);
+        }
+    }
+
+    std::vector<OpSummary> ops;
+    std::vector<TraceRecord> batch(4096);
+    uint64_t remaining = hdr.record_count;
+    while (remaining > 0) {
+        size_t want = remaining < batch.size() ? remaining : batch.size();
+        size_t got = fread(batch.data(), sizeof(TraceRecord), want, f);
+        if (got == 0) break;
+        remaining -= got;
+
+        for (size_t i = 0; i < got; i++) {
+            const TraceRecord& r = batch[i];
+            double t_ns = (r.tsc - hdr.start_tsc) * ns_per_cycle;
+            double lat_ns = r.latency * ns_per_cycle;
+
+            if (summary) {
+                if (r.op >= ops.size()) ops.resize(r.op + 1);
+                ops[r.op].count++;
+                if (r.result > 0 && cxl_intercept::trace_op_moves_data(r.op)) ops[r.op].bytes += r.result;
+                ops[r.op].total_ns += lat_ns;
+                continue;
+            }
+
+            const char* op = cxl_intercept::trace_op_name(r.op);
+            if (csv) {
+                printf("%.0f,%u,%s,%d,%" PRIu64 ",%" PRIu64 ",%" PRId64 ",%.0f\n",
+                       t_ns, r.tid, op, r.fd, r.offset, r.length, r.result, lat_ns);
+            } else {
+                printf("%14.3f us  tid=%-7u %-12s fd=%-6d off=%-12" PRIu64 " len=%-9" PRIu64
+                       " res=%-9" PRId64 " lat=%.0f ns\n",
+                       t_ns / 1000.0, r.tid, op, r.fd, r.offset, r.length, r.result, lat_ns);
+            }
+        }
+    }
+    fclose(f);
+
+    if (summary) {
+        printf("%-12s %12s %16s %14s\n", "op", "count", "bytes", "mean_lat_ns");
+        for (size_t op = 0; op < ops.size(); op++) {
+            if (!ops[op].count) continue;
+            printf("%-12s %12" PRIu64 " %16" PRIu64 " %14.1f\n",
+                   cxl_intercept::trace_op_name(static_cast<uint16_t>(op)),
+                   ops[op].count, ops[op].bytes, ops[op].total_ns / ops[op].count);
+        }
+    }
+
+    if (remaining > 0) {
+        fprintf(stderr, "Warning: trace truncated, %" PRIu64 " records missing\n", remaining);
+    }
+    return 0;
+}
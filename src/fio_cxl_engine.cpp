@@ -0,0 +1,301 @@
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "../include/cxl_aio_pool.hpp"
+#include "../include/cxl_dax_catalog.hpp"
+#include "../include/cxl_dax_region.hpp"
+#include "../include/cxl_engine_core.hpp"
+#include "../include/cxl_fd_table.hpp"
+#include "../include/cxl_persist.hpp"
+
+// fio's headers define min()/max() macros and expect C linkage; include
+// them after everything from the C++ library
+extern "C" {
+#include "fio.h"
+#include "optgroup.h"
+}
+
+// External fio ioengine over the same DAX regions as fio_intercept
+// (ioengine=external:libfio_cxl_engine.so). fio hands the engine its files
+// and I/O units directly, so there is no pathname matching and no
+// interposition on the syscalls fio makes for itself. Regions, catalog and
+// persistence come from the same FIO_DAX_* variables as the intercept.
+// The intercept's other features are not implemented here: a job that sets
+// one of them (or FIO_DAX_PERSIST=lazy) fails to start instead of silently
+// running without it.
+//
+// queue() collects up to iodepth units; commit() hands them to a pool of
+// copy workers (FIO_AIO_WORKERS, default 2, 0 copies inside commit), which
+// post each finished unit to the job's completion ring; getevents() reaps
+// the ring, sleeping on a futex until min units have completed. Placement,
+// the copies and the completion ring live in cxl_engine_core.hpp.
+
+namespace {
+
+// Mapped DAX regions, shared by every job of the process
+constinit cxl_intercept::DaxRegion dax_regions[cxl_intercept::kMaxDaxRegions];
+int dax_region_count = 0;
+constinit cxl_intercept::EpochDomain dax_epoch;
+cxl_ssd::PersistMode persist_mode = cxl_ssd::PersistMode::CLFLUSHOPT;
+std::once_flag regions_once;
+
+// Map the regions named by FIO_DAX_DEVICES / FIO_DAX_DEVICE
+void map_regions() {
+    const char* env_dax = getenv("FIO_DAX_DEVICE");
+    const char* env_devices = getenv("FIO_DAX_DEVICES");
+    const char* env_size = getenv("FIO_DAX_SIZE");
+    const char* env_align = getenv("FIO_DAX_ALIGN");
+    const char* env_window = getenv("FIO_DAX_WINDOW");
+    const char* env_max_windows = getenv("FIO_DAX_MAX_WINDOWS");
+    const char* env_format = getenv("FIO_DAX_FORMAT");
+    bool force_format = env_format && strcmp(env_format, "1") == 0;
+    persist_mode = cxl_ssd::persist_mode_from_env();
+
+    std::vector<cxl_intercept::DaxRegionSpec> specs;
+    if (env_devices) {
+        specs = cxl_intercept::parse_region_list(env_devices);
+    } else if (env_dax) {
+        specs.push_back({env_dax, 0, -1});
+    }
+    for (cxl_intercept::DaxRegionSpec& spec : specs) {
+        if (dax_region_count == cxl_intercept::kMaxDaxRegions) break;
+        if (spec.size == 0 && env_size) spec.size = cxl_intercept::parse_size(env_size);
+        if (env_align) spec.align = cxl_intercept::parse_size(env_align);
+        if (env_window) spec.window = cxl_intercept::parse_size(env_window);
+        if (env_max_windows) spec.max_windows = strtoul(env_max_windows, nullptr, 0);
+
+        cxl_intercept::DaxRegion& region = dax_regions[dax_region_count];
+        if (!region.map(spec, &dax_epoch)) {
+            fprintf(stderr, "[CXL_ENGINE] Failed to map DAX device %s: %s\n", spec.path.c_str(), strerror(errno));
+            continue;
+        }
+        if (!region.attach_catalog(cxl_ssd::eager_persist_mode(persist_mode), force_format)) {
+            region.unmap();
+            continue;
+        }
+        fprintf(stderr, "[CXL_ENGINE] DAX device mapped: %s (size: %zu, node: %d, persist: %s)\n",
+                region.path.c_str(), region.size, region.node,
+                cxl_ssd::persist_mode_name(cxl_ssd::eager_persist_mode(persist_mode)));
+        dax_region_count++;
+    }
+}
+
+__attribute__((destructor))
+void unmap_regions() {
+    for (int i = 0; i < dax_region_count; i++) dax_regions[i].unmap();
+}
+
+using cxl_intercept::EngineFile;
+
+// fio_intercept settings the engine does not implement, rejected by init()
+// when set to anything but empty or "0"
+constexpr struct {
+    const char* env;
+    const char* feature;
+} intercept_only[] = {
+    {"FIO_DAX_VERIFY", "block verification"},
+    {"FIO_DAX_CACHE", "the DRAM cache"},
+    {"FIO_CXL_TIMING", "timing emulation"},
+    {"FIO_QOS", "QoS"},
+    {"FIO_DAX_WAL", "WAL mode"},
+    {"FIO_DAX_THIN", "thin mode"},
+    {"FIO_DAX_SPARSE", "sparse files"},
+    {"FIO_DAX_WRITE_COMBINE", "write combining"},
+    {"FIO_DAX_PREFETCH", "prefetch"},
+};
+
+bool unsupported_settings() {
+    bool found = false;
+    for (const auto& setting : intercept_only) {
+        const char* env = getenv(setting.env);
+        if (!env || !*env || strcmp(env, "0") == 0) continue;
+        log_err("cxl: %s (%s) is not supported by the engine; use fio_intercept\n", setting.env,
+                setting.feature);
+        found = true;
+    }
+    if (persist_mode == cxl_ssd::PersistMode::LAZY) {
+        log_err("cxl: FIO_DAX_PERSIST=lazy is not supported by the engine; use an eager mode\n");
+        found = true;
+    }
+    return found;
+}
+
+// Per-job state, td->io_ops_data
+struct EngineData {
+    cxl_intercept::CopyWorkerPool* pool = nullptr;
+    cxl_intercept::EngineCompletions<struct io_u> done;
+    std::vector<struct io_u*> queued;
+    std::vector<struct io_u*> events;
+    unsigned depth;                  // td->o.iodepth, the most units queued at once
+
+    explicit EngineData(unsigned depth) : done(depth), depth(depth) {
+        queued.reserve(depth);
+        events.reserve(depth);
+    }
+};
+
+// Copy one I/O unit; runs on a copy worker, or inside commit()
+void engine_execute(struct io_u* io_u) {
+    auto* file = static_cast<EngineFile*>(io_u->file->engine_data);
+    io_u->error = cxl_intercept::engine_copy(dax_epoch, file, io_u->ddir == DDIR_READ, io_u->offset,
+                                             io_u->xfer_buf, io_u->xfer_buflen,
+                                             cxl_ssd::eager_persist_mode(persist_mode));
+    if (!io_u->error) io_u->resid = 0;
+}
+
+void engine_complete(void* ctx, void* arg) {
+    auto* data = static_cast<EngineData*>(ctx);
+    auto* io_u = static_cast<struct io_u*>(arg);
+    engine_execute(io_u);
+    data->done.complete(io_u);
+}
+
+int engine_init(struct thread_data* td) {
+    std::call_once(regions_once, map_regions);
+    if (dax_region_count == 0) {
+        log_err("cxl: no DAX region mapped; set FIO_DAX_DEVICE or FIO_DAX_DEVICES\n");
+        return 1;
+    }
+    if (unsupported_settings()) return 1;
+    unsigned depth = td->o.iodepth ? td->o.iodepth : 1;
+    auto* data = new EngineData(depth);
+    const char* env_workers = getenv("FIO_AIO_WORKERS");
+    unsigned workers = env_workers ? strtoul(env_workers, nullptr, 0) : 2;
+    if (workers && depth > 1) {
+        cpu_set_t cpus;
+        bool pin = cxl_intercept::node_cpuset(cxl_intercept::cached_numa_node(), &cpus);
+        data->pool = new cxl_intercept::CopyWorkerPool(workers, 2 * depth, pin ? &cpus : nullptr);
+    }
+    td->io_ops_data = data;
+    return 0;
+}
+
+void engine_cleanup(struct thread_data* td) {
+    auto* data = static_cast<EngineData*>(td->io_ops_data);
+    if (!data) return;
+    delete data->pool;
+    delete data;
+    td->io_ops_data = nullptr;
+}
+
+enum fio_q_status engine_queue(struct thread_data* td, struct io_u* io_u) {
+    auto* data = static_cast<EngineData*>(td->io_ops_data);
+    fio_ro_check(td, io_u);
+
+    switch (io_u->ddir) {
+        case DDIR_READ:
+        case DDIR_WRITE:
+            if (data->queued.size() >= data->depth) return FIO_Q_BUSY;
+            data->queued.push_back(io_u);
+            return FIO_Q_QUEUED;
+        case DDIR_SYNC:
+        case DDIR_DATASYNC:
+        case DDIR_SYNC_FILE_RANGE:
+            // Completed writes are already durable
+            cxl_ssd::persist_fence(cxl_ssd::eager_persist_mode(persist_mode));
+            io_u->error = 0;
+            return FIO_Q_COMPLETED;
+        default:
+            io_u->error = 0;  // trim: extents stay allocated
+            return FIO_Q_COMPLETED;
+    }
+}
+
+int engine_commit(struct thread_data* td) {
+    auto* data = static_cast<EngineData*>(td->io_ops_data);
+    for (struct io_u* io_u : data->queued) {
+        if (data->pool) data->pool->submit(engine_complete, data, io_u);
+        else engine_complete(data, io_u);
+    }
+    data->queued.clear();
+    return 0;
+}
+
+int engine_getevents(struct thread_data* td, unsigned int min, unsigned int max, const struct timespec* t) {
+    auto* data = static_cast<EngineData*>(td->io_ops_data);
+    data->events.clear();
+    return static_cast<int>(data->done.reap(data->events, min, max, t));
+}
+
+struct io_u* engine_event(struct thread_data* td, int event) {
+    return static_cast<EngineData*>(td->io_ops_data)->events[event];
+}
+
+// Files already in a catalog report their extent size; new ones get the
+// size fio computed for them
+int engine_get_file_size(struct thread_data*, struct fio_file* f) {
+    if (fio_file_size_known(f)) return 0;
+    std::call_once(regions_once, map_regions);
+    std::string key = cxl_intercept::catalog_path_key(f->file_name);
+    cxl_intercept::DaxExtent extent;
+    for (int i = 0; i < dax_region_count; i++) {
+        if (dax_regions[i].catalog.open_extent(key, 0, false, extent)) {
+            f->real_file_size = extent.length;
+            break;
+        }
+    }
+    fio_file_set_size_known(f);
+    return 0;
+}
+
+// Place the file on a region local to the job's NUMA node when it has room,
+// as fio_intercept does without placement rules
+int engine_open_file(struct thread_data* td, struct fio_file* f) {
+    std::string key = cxl_intercept::catalog_path_key(f->file_name);
+    uint64_t want = f->real_file_size ? f->real_file_size : 1ULL << 30;
+    EngineFile* file = cxl_intercept::engine_place_file(dax_regions, dax_region_count,
+                                                        cxl_intercept::cached_numa_node(), key, want);
+    if (!file) {
+        td_verror(td, errno, errno == EOPNOTSUPP ? "cxl open_file: sparse file" : "cxl open_file");
+        return 1;
+    }
+    f->engine_data = file;
+    if (file->size < want) f->real_file_size = file->size;
+    return 0;
+}
+
+int engine_close_file(struct thread_data*, struct fio_file* f) {
+    auto* file = static_cast<EngineFile*>(f->engine_data);
+    if (file) {
+        cxl_intercept::engine_release_file(file);
+        f->engine_data = nullptr;
+    }
+    return 0;
+}
+
+struct cxl_ioengine : public ioengine_ops {
+    cxl_ioengine() : ioengine_ops({}) {
+        name = "cxl";
+        version = FIO_IOOPS_VERSION;
+        flags = FIO_DISKLESSIO | FIO_NODISKUTIL;
+        init = engine_init;
+        cleanup = engine_cleanup;
+        queue = engine_queue;
+        commit = engine_commit;
+        getevents = engine_getevents;
+        event = engine_event;
+        open_file = engine_open_file;
+        close_file = engine_close_file;
+        get_file_size = engine_get_file_size;
+    }
+};
+
+} // anonymous namespace
+
+extern "C" {
+
+// fio looks this up when the engine has no static ioengine_ops to export
+void get_ioengine(struct ioengine_ops** ioengine_ptr) {
+    static cxl_ioengine ioengine;
+    *ioengine_ptr = &ioengine;
+}
+
+} // extern "C"
@@ -5,17 +5,40 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#include <linux/aio_abi.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <limits.h>
 #include <cstring>
 #include <cstdio>
 #include <cstdlib>
 #include <cstdarg>
 #include <string>
-#include <map>
-#include <mutex>
 #include <atomic>
-#include <immintrin.h>
+#include <concepts>
+#include <memory>
+#include <mutex>
+#include <vector>
 #include <errno.h>
 
+#include "../include/cxl_aio_pool.hpp"
+#include "../include/cxl_dax_catalog.hpp"
+#include "../include/cxl_dax_region.hpp"
+#include "../include/cxl_dirty_tracker.hpp"
+#include "../include/cxl_dram_cache.hpp"
+#include "../include/cxl_fd_table.hpp"
+#include "../include/cxl_latency_hist.hpp"
+#include "../include/cxl_persist.hpp"
+#include "../include/cxl_prefetch.hpp"
+#include "../include/cxl_qos.hpp"
+#include "../include/cxl_timing_model.hpp"
+#include "../include/cxl_trace.hpp"
+#include "../include/cxl_write_combine.hpp"
+
 // LD_PRELOAD library to intercept fio's read/write/fsync syscalls
 // and redirect them to memory-mapped DAX device operations
 
@@ -31,6 +54,29 @@ using pwrite_fn = ssize_t(*)(int, const void*, size_t, off_t);
 using fsync_fn = int(*)(int);
 using lseek_fn = off_t(*)(int, off_t, int);
 using ftruncate_fn = int(*)(int, off_t);
+using unlink_fn = int(*)(const char*);
+using unlinkat_fn = int(*)(int, const char*, int);
+using openat_fn = int(*)(int, const char*, int, ...);
+using iov_fn = ssize_t(*)(int, const struct iovec*, int);
+using piov_fn = ssize_t(*)(int, const struct iovec*, int, off_t);
+using piov2_fn = ssize_t(*)(int, const struct iovec*, int, off_t, int);
+using fstat_fn = int(*)(int, struct stat*);
+using stat_fn = int(*)(const char*, struct stat*);
+using fstatat_fn = int(*)(int, const char*, struct stat*, int);
+using statx_fn = int(*)(int, const char*, int, unsigned int, struct statx*);
+using mmap_fn = void*(*)(void*, size_t, int, int, int, off_t);
+using munmap_fn = int(*)(void*, size_t);
+using msync_fn = int(*)(void*, size_t, int);
+using sync_file_range_fn = int(*)(int, off64_t, off64_t, unsigned int);
+using copy_range_fn = ssize_t(*)(int, off64_t*, int, off64_t*, size_t, unsigned int);
+using sendfile_fn = ssize_t(*)(int, int, off_t*, size_t);
+
+// libaio entry points; like libaio they return -errno on failure
+using io_setup_fn = int(*)(int, aio_context_t*);
+using io_destroy_fn = int(*)(aio_context_t);
+using io_submit_fn = int(*)(aio_context_t, long, struct iocb**);
+using io_getevents_fn = int(*)(aio_context_t, long, long, struct io_event*, struct timespec*);
+using io_cancel_fn = int(*)(aio_context_t, struct iocb*, struct io_event*);
 
 // Original function pointers
 open_fn real_open = nullptr;
@@ -42,26 +88,248 @@ pwrite_fn real_pwrite = nullptr;
 fsync_fn real_fsync = nullptr;
 lseek_fn real_lseek = nullptr;
 ftruncate_fn real_ftruncate = nullptr;
+unlink_fn real_unlink = nullptr;
+unlinkat_fn real_unlinkat = nullptr;
+open_fn real_open64 = nullptr;
+openat_fn real_openat = nullptr;
+openat_fn real_openat64 = nullptr;
+pread_fn real_pread64 = nullptr;
+pwrite_fn real_pwrite64 = nullptr;
+lseek_fn real_lseek64 = nullptr;
+ftruncate_fn real_ftruncate64 = nullptr;
+iov_fn real_readv = nullptr;
+iov_fn real_writev = nullptr;
+piov_fn real_preadv = nullptr;
+piov_fn real_pwritev = nullptr;
+piov2_fn real_preadv2 = nullptr;
+piov2_fn real_pwritev2 = nullptr;
+fsync_fn real_fdatasync = nullptr;
+fstat_fn real_fstat = nullptr;
+stat_fn real_stat = nullptr;
+stat_fn real_lstat = nullptr;
+fstatat_fn real_fstatat = nullptr;
+statx_fn real_statx = nullptr;
+mmap_fn real_mmap = nullptr;
+mmap_fn real_mmap64 = nullptr;
+munmap_fn real_munmap = nullptr;
+msync_fn real_msync = nullptr;
+sync_file_range_fn real_sync_file_range = nullptr;
+copy_range_fn real_copy_file_range = nullptr;
+sendfile_fn real_sendfile = nullptr;
+sendfile_fn real_sendfile64 = nullptr;
+copy_range_fn real_splice = nullptr;
+io_setup_fn real_io_setup = nullptr;
+io_destroy_fn real_io_destroy = nullptr;
+io_submit_fn real_io_submit = nullptr;
+io_getevents_fn real_io_getevents = nullptr;
+io_cancel_fn real_io_cancel = nullptr;
+
+// Lazy persistence state for one file, shared by every fd open on it. A
+// windowed region keeps the file pinned: write-back reaches its lines
+// outside any I/O call.
+struct DirtyFile {
+    cxl_intercept::DirtyTracker tracker;
+    cxl_intercept::DaxRegion* region;
+    char* base;
+    size_t size;
+    int refs = 1;
+
+    DirtyFile(cxl_intercept::DaxRegion* r, char* b, size_t n, unsigned shift)
+        : tracker(b, n, shift), region(r), base(b), size(n) {}
+};
+
+// A sparse file's view, shared by every fd open on it: an anonymous
+// read-only reservation, whose chunks read as zero pages until the device
+// chunk the catalog's map names for them is mapped over them. Chunks are
+// mapped on first write here, or on the first read after another process
+// allocated them.
+struct SparseFile {
+    cxl_intercept::DaxRegion* region;
+    uint32_t* map;  // the file's chunk map in the catalog
+    char* view;
+    size_t size;
+    size_t chunk;
+    std::unique_ptr<std::atomic<bool>[]> mapped;
+    std::mutex mu;  // serializes mapping chunks over the view
+    int refs = 1;
 
-// DAX device management
+    SparseFile(cxl_intercept::DaxRegion* r, uint32_t* m, char* v, size_t n, size_t c)
+        : region(r), map(m), view(v), size(n), chunk(c), mapped(new std::atomic<bool>[n / c]()) {}
+};
+
+// DAX device management. Everything but current_offset and stream is
+// immutable once the mapping is published; those two get their own cache
+// line because only the threads driving this fd touch them.
 struct DAXMapping {
     void* base;
     size_t size;
-    off_t current_offset;
     std::string path;
     int real_fd;
+    cxl_intercept::DaxRegion* region;  // region holding the extent
+    DirtyFile* dirty;  // set when the file was opened in lazy mode
+    uint32_t lat_id;   // latency histogram id, 0 when not recording
+    int32_t ns_slot;   // shared namespace entry counting this open
+    pid_t opener;      // only the opening process drops the count
+    int qos_class;     // QoS class of the path (FIO_QOS), 0 = default
+    cxl_intercept::CatalogEntry* wal_entry;  // append mode (FIO_DAX_WAL), else nullptr
+    SparseFile* sparse;  // chunk-mapped file (FIO_DAX_SPARSE), else nullptr
+    uint64_t extent;     // catalog offset of the file
+    alignas(64) off_t current_offset;
+    mutable cxl_intercept::StreamState stream;  // read-ahead (FIO_DAX_PREFETCH)
+    std::atomic<uint32_t> refs{1};  // the fd's, plus transfers blocked on the other side
 };
 
-std::map<int, DAXMapping> dax_mappings;
-std::mutex mappings_mutex;
-std::atomic<int> fake_fd_counter{10000}; // Start from high FD numbers
+// Fake fds start from high FD numbers and index straight into the table
+constexpr int kFakeFdBase = 10000;
+constexpr size_t kMaxFakeFds = 65536;
+
+// constinit: the library constructor may run before dynamic initialization
+constinit cxl_intercept::FakeFdTable<DAXMapping, kMaxFakeFds> dax_fds{kFakeFdBase};
+constinit cxl_intercept::EpochDomain dax_epoch;
+using EpochGuard = cxl_intercept::EpochDomain::Guard;
+
+// Binary I/O trace (FIO_TRACE_FILE / FIO_DEBUG)
+constinit cxl_intercept::TraceRecorder trace;
+using cxl_intercept::TraceOp;
+
+// Device-side latency histograms (FIO_LAT_HIST_FILE)
+constinit cxl_intercept::LatencyRecorder latency;
+using cxl_intercept::LatOp;
+
+// Emulated CXL-SSD latency and bandwidth (FIO_CXL_TIMING)
+constinit cxl_intercept::TimingModel timing;
+
+// Per-thread combining of sub-line writes (FIO_DAX_WRITE_COMBINE)
+constinit cxl_intercept::WriteCombiner write_combiner;
+
+// Sequential stream detection and software prefetch (FIO_DAX_PREFETCH)
+constinit cxl_intercept::StreamPrefetcher prefetcher;
+
+// Per-tenant token-bucket QoS (FIO_QOS)
+constinit cxl_intercept::QosPolicy qos;
+
+// DRAM write-back page cache in front of the regions (FIO_DAX_CACHE);
+// its pages are filled and written back through the owning mapping
+constinit cxl_intercept::DramCache dram_cache;
+bool dax_cache_fill(void* owner, const char* dev, char* page);
+bool dax_cache_write_back(void* owner, char* dev, const char* page);
 
 // Configuration from environment
 bool intercept_enabled = false;
-std::string dax_device_path;
-size_t dax_device_size = 0;
-void* global_dax_base = nullptr;
-int global_dax_fd = -1;
+
+// Mapped DAX regions (FIO_DAX_DEVICES, or the single FIO_DAX_DEVICE), each
+// with its own catalog at its head. Files are created on a region local to
+// the opening thread's NUMA node unless a FIO_NUMA_PLACEMENT rule names a
+// node for the path; re-opens find the file in whichever region holds it.
+constinit cxl_intercept::DaxRegion dax_regions[cxl_intercept::kMaxDaxRegions];
+int dax_region_count = 0;
+
+struct PlacementRule {
+    std::string pattern;
+    int node;
+};
+std::vector<PlacementRule> placement_rules;
+
+// Write-ahead logs (FIO_DAX_WAL): files whose path contains one of these
+// substrings are append-mode files. Appends go out with non-temporal
+// stores and no fence, their end is kept as the file's logical size in its
+// catalog entry (the persisted tail marker), and fdatasync() is one fence.
+std::vector<std::string> wal_patterns;
+
+// Application mappings of fake fds that are separate VMAs over the DAX fd
+// (MAP_FIXED, read-only or private); msync() flushes these by address.
+// Direct mappings into a region need no tracking.
+struct AppMapping {
+    uintptr_t start;
+    uintptr_t end;
+};
+std::mutex app_maps_mu;
+std::vector<AppMapping> app_maps;
+
+// Direct mappings (see mmap_dax_file()) and the parts of each still mapped.
+// Their windows are pinned when the mapping is made and unpinned once
+// munmap() has removed all of it.
+struct PinnedMapping {
+    cxl_intercept::DaxRegion* region;
+    uintptr_t start;
+    uintptr_t end;
+    std::vector<AppMapping> live;
+};
+std::mutex pinned_maps_mu;
+std::vector<PinnedMapping> pinned_maps;
+
+// File ranges mmap() has exposed, by address in the region (or a sparse
+// file's view): stores through the mapping bypass the DRAM cache, so reads
+// and writes of these ranges do too. Kept until exit.
+std::mutex uncached_mu;
+std::vector<AppMapping> uncached;
+std::atomic<bool> any_uncached{false};
+
+// libaio emulation. Each io_setup() context completes DAX iocbs on pools
+// of copy workers (FIO_AIO_WORKERS per pool, default 2; 0 completes inline
+// in io_submit) and forwards other iocbs to a lazily created kernel context.
+// There is one pool per NUMA node that holds a region, pinned to that
+// node's CPUs; an iocb goes to the pool of the region its file lives in.
+constexpr unsigned kDefaultAioWorkers = 2;
+
+struct AioContext {
+    std::atomic<bool> destroyed{false};  // set by io_destroy
+    std::atomic<uint32_t> users{0};      // io_* calls holding an AioRef
+    long max_events;
+    cxl_intercept::MpmcRing<struct io_event> completions;
+    std::atomic<long> queued{0};        // emulated iocbs submitted and not yet reaped
+    std::atomic<long> running{0};       // emulated iocbs not yet completed
+    std::atomic<long> real_inflight{0}; // iocbs outstanding on the kernel context
+    std::mutex real_mu;
+    aio_context_t real_ctx = 0;
+    alignas(64) std::atomic<uint32_t> completion_seq{0};
+    std::atomic<uint32_t> waiters{0};
+
+    explicit AioContext(long n) : max_events(n), completions(n) {}
+};
+
+// Live contexts. An aio_context_t is a slot of this table, so an id that
+// was destroyed is rejected with -EINVAL instead of dereferenced; ids
+// outside it go to the kernel, which rejects those it did not set up.
+constexpr int kAioContextBase = 0x0A10000;
+constexpr size_t kMaxAioContexts = 1024;
+constinit cxl_intercept::FakeFdTable<AioContext, kMaxAioContexts> aio_contexts{kAioContextBase};
+
+bool aio_own_id(aio_context_t id) {
+    return intercept_enabled && id >= static_cast<aio_context_t>(kAioContextBase) &&
+           id < kAioContextBase + kMaxAioContexts;
+}
+
+std::mutex aio_pool_mu;
+std::atomic<cxl_intercept::CopyWorkerPool*> aio_pools[cxl_intercept::kMaxDaxRegions];
+
+// How writes are made durable (FIO_DAX_PERSIST or fio_intercept_set_persist_mode)
+cxl_ssd::PersistMode persist_mode = cxl_ssd::PersistMode::CLFLUSHOPT;
+
+// Lazy mode: dirty granule size (FIO_DAX_DIRTY_GRANULE, 64B default) and
+// the dirty bytes per file that force a synchronous write-back
+// (FIO_DAX_DIRTY_LIMIT, 64MB default, 0 for no limit)
+unsigned dirty_granule_shift = 6;
+size_t dirty_limit = 64ULL << 20;
+std::mutex dirty_files_mu;
+std::vector<DirtyFile*> dirty_files;
+
+// CRC32C verification block size (FIO_DAX_VERIFY, FIO_DAX_VERIFY_BLOCK);
+// 0 when off. The first mismatches are logged, all are counted.
+size_t verify_block = 0;
+constexpr int kMaxMismatchLogs = 16;
+std::atomic<int> mismatch_logs{0};
+
+// Thin mode (FIO_DAX_THIN): whole blocks of zeroes are marked in the
+// catalog's zero map instead of stored. Every process honours a map in use.
+bool thin_mode = false;
+
+// Sparse mode (FIO_DAX_SPARSE): files created by this process get a chunk
+// map rather than an extent and take their chunks from the region on first
+// write. Every process reads and writes sparse files it finds.
+bool sparse_mode = false;
+std::mutex sparse_files_mu;
+std::vector<SparseFile*> sparse_files;
 
 // Initialize interception
 __attribute__((constructor))
@@ -76,60 +344,447 @@ void init_intercept() {
     real_fsync = (fsync_fn)dlsym(RTLD_NEXT, "fsync");
     real_lseek = (lseek_fn)dlsym(RTLD_NEXT, "lseek");
     real_ftruncate = (ftruncate_fn)dlsym(RTLD_NEXT, "ftruncate");
+    real_unlink = (unlink_fn)dlsym(RTLD_NEXT, "unlink");
+    real_unlinkat = (unlinkat_fn)dlsym(RTLD_NEXT, "unlinkat");
+    real_open64 = (open_fn)dlsym(RTLD_NEXT, "open64");
+    real_openat = (openat_fn)dlsym(RTLD_NEXT, "openat");
+    real_openat64 = (openat_fn)dlsym(RTLD_NEXT, "openat64");
+    real_pread64 = (pread_fn)dlsym(RTLD_NEXT, "pread64");
+    real_pwrite64 = (pwrite_fn)dlsym(RTLD_NEXT, "pwrite64");
+    real_lseek64 = (lseek_fn)dlsym(RTLD_NEXT, "lseek64");
+    real_ftruncate64 = (ftruncate_fn)dlsym(RTLD_NEXT, "ftruncate64");
+    real_readv = (iov_fn)dlsym(RTLD_NEXT, "readv");
+    real_writev = (iov_fn)dlsym(RTLD_NEXT, "writev");
+    real_preadv = (piov_fn)dlsym(RTLD_NEXT, "preadv");
+    real_pwritev = (piov_fn)dlsym(RTLD_NEXT, "pwritev");
+    real_preadv2 = (piov2_fn)dlsym(RTLD_NEXT, "preadv2");
+    real_pwritev2 = (piov2_fn)dlsym(RTLD_NEXT, "pwritev2");
+    real_fdatasync = (fsync_fn)dlsym(RTLD_NEXT, "fdatasync");
+    real_fstat = (fstat_fn)dlsym(RTLD_NEXT, "fstat");
+    real_stat = (stat_fn)dlsym(RTLD_NEXT, "stat");
+    real_lstat = (stat_fn)dlsym(RTLD_NEXT, "lstat");
+    real_fstatat = (fstatat_fn)dlsym(RTLD_NEXT, "fstatat");
+    real_statx = (statx_fn)dlsym(RTLD_NEXT, "statx");
+    real_mmap = (mmap_fn)dlsym(RTLD_NEXT, "mmap");
+    real_mmap64 = (mmap_fn)dlsym(RTLD_NEXT, "mmap64");
+    real_munmap = (munmap_fn)dlsym(RTLD_NEXT, "munmap");
+    real_msync = (msync_fn)dlsym(RTLD_NEXT, "msync");
+    real_sync_file_range = (sync_file_range_fn)dlsym(RTLD_NEXT, "sync_file_range");
+    real_copy_file_range = (copy_range_fn)dlsym(RTLD_NEXT, "copy_file_range");
+    real_sendfile = (sendfile_fn)dlsym(RTLD_NEXT, "sendfile");
+    real_sendfile64 = (sendfile_fn)dlsym(RTLD_NEXT, "sendfile64");
+    real_splice = (copy_range_fn)dlsym(RTLD_NEXT, "splice");
+    real_io_setup = (io_setup_fn)dlsym(RTLD_NEXT, "io_setup");
+    real_io_destroy = (io_destroy_fn)dlsym(RTLD_NEXT, "io_destroy");
+    real_io_submit = (io_submit_fn)dlsym(RTLD_NEXT, "io_submit");
+    real_io_getevents = (io_getevents_fn)dlsym(RTLD_NEXT, "io_getevents");
+    real_io_cancel = (io_cancel_fn)dlsym(RTLD_NEXT, "io_cancel");
 
     // Check environment for configuration
     const char* env_dax = getenv("FIO_DAX_DEVICE");
+    const char* env_devices = getenv("FIO_DAX_DEVICES");
     const char* env_size = getenv("FIO_DAX_SIZE");
+    const char* env_align = getenv("FIO_DAX_ALIGN");
+    const char* env_window = getenv("FIO_DAX_WINDOW");
+    const char* env_max_windows = getenv("FIO_DAX_MAX_WINDOWS");
     const char* env_enable = getenv("FIO_INTERCEPT_ENABLE");
 
     if (env_enable && strcmp(env_enable, "1") == 0) {
         intercept_enabled = true;
-
-        if (env_dax) {
-            dax_device_path = env_dax;
-
-            // Open and map the global DAX device
-            global_dax_fd = real_open(dax_device_path.c_str(), O_RDWR | O_SYNC);
-            if (global_dax_fd >= 0) {
-                // Get size
-                if (env_size) {
-                    dax_device_size = std::stoull(env_size);
-                } else {
-                    struct stat st;
-                    if (fstat(global_dax_fd, &st) == 0) {
-                        dax_device_size = st.st_size;
-                    }
+        // Worker threads do not survive fork(); the child builds its own pools
+        pthread_atfork(
+            []() {
+                // The child starts with an empty cache; its dirty pages
+                // must be in the region it shares
+                if (dram_cache.enabled()) {
+                    EpochGuard guard(dax_epoch);
+                    dram_cache.write_back_all();
                 }
-
-                if (dax_device_size > 0) {
-                    global_dax_base = mmap(nullptr, dax_device_size,
-                                          PROT_READ | PROT_WRITE,
-                                          MAP_SHARED | MAP_SYNC,
-                                          global_dax_fd, 0);
-
-                    if (global_dax_base != MAP_FAILED) {
-                        fprintf(stderr, "[FIO_INTERCEPT] DAX device mapped: %s (size: %zu)\n",
-                               dax_device_path.c_str(), dax_device_size);
-                        madvise(global_dax_base, dax_device_size, MADV_HUGEPAGE);
-                    } else {
-                        fprintf(stderr, "[FIO_INTERCEPT] Failed to map DAX device\n");
-                        intercept_enabled = false;
-                    }
+                write_combiner.fork_prepare();
+                for (int i = 0; i < dax_region_count; i++) dax_regions[i].fork_prepare();
+            },
+            []() {
+                for (int i = 0; i < dax_region_count; i++) dax_regions[i].fork_parent();
+                write_combiner.fork_parent();
+            },
+            []() {
+                for (auto& pool : aio_pools) pool.store(nullptr, std::memory_order_relaxed);
+                for (int i = 0; i < dax_region_count; i++) dax_regions[i].fork_child();
+                write_combiner.fork_child();
+                dram_cache.fork_child();
+            });
+        trace.init_from_env("fio_intercept");
+        latency.init_from_env("fio_intercept");
+        timing.init_from_env("fio_intercept");
+        qos.init_from_env("fio_intercept");
+        persist_mode = cxl_ssd::persist_mode_from_env();
+        if (const char* env = getenv("FIO_DAX_DIRTY_GRANULE")) {
+            unsigned long granule = strtoul(env, nullptr, 0);
+            if (granule >= 64 && (granule & (granule - 1)) == 0) {
+                dirty_granule_shift = __builtin_ctzl(granule);
+            }
+        }
+        if (const char* env = getenv("FIO_DAX_DIRTY_LIMIT")) {
+            dirty_limit = strtoull(env, nullptr, 0);
+        }
+        const char* env_wc = getenv("FIO_DAX_WRITE_COMBINE");
+        if (env_wc && strcmp(env_wc, "1") == 0) {
+            const char* env_flush = getenv("FIO_DAX_WC_FLUSH_US");
+            write_combiner.configure(env_flush ? strtoull(env_flush, nullptr, 0) : 100, &dax_epoch);
+        }
+        const char* env_thin = getenv("FIO_DAX_THIN");
+        thin_mode = env_thin && strcmp(env_thin, "1") == 0;
+        const char* env_thin_block = getenv("FIO_DAX_THIN_BLOCK");
+        const char* env_sparse = getenv("FIO_DAX_SPARSE");
+        sparse_mode = env_sparse && strcmp(env_sparse, "1") == 0;
+        const char* env_sparse_max = getenv("FIO_DAX_SPARSE_MAX");
+        const char* env_verify = getenv("FIO_DAX_VERIFY");
+        if (env_verify && strcmp(env_verify, "1") == 0) {
+            const char* env_block = getenv("FIO_DAX_VERIFY_BLOCK");
+            verify_block = env_block ? cxl_intercept::parse_size(env_block) : 4096;
+            if (verify_block < 512 || verify_block > cxl_intercept::kHugePageSize ||
+                (verify_block & (verify_block - 1)) != 0) {
+                verify_block = 4096;
+            }
+        }
+        if (thin_mode && verify_block) {
+            // A marked block's checksum would describe the stale device copy
+            fprintf(stderr, "[FIO_INTERCEPT] FIO_DAX_VERIFY is set: zero blocks are stored, not marked\n");
+        }
+        if (const char* env = getenv("FIO_DAX_PREFETCH")) {
+            const char* hint = getenv("FIO_DAX_PREFETCH_HINT");
+            const char* trigger = getenv("FIO_DAX_PREFETCH_TRIGGER");
+            prefetcher.configure(cxl_intercept::parse_size(env), hint && strcmp(hint, "nta") == 0,
+                                 trigger ? strtoul(trigger, nullptr, 0) : 2);
+        }
+        size_t cache_size = 0;
+        if (const char* env = getenv("FIO_DAX_CACHE")) cache_size = cxl_intercept::parse_size(env);
+        if (cache_size) {
+            const char* ways = getenv("FIO_DAX_CACHE_WAYS");
+            if (!dram_cache.configure(cache_size, ways ? strtoul(ways, nullptr, 0) : 8,
+                                      &dax_cache_fill, &dax_cache_write_back)) {
+                fprintf(stderr, "[FIO_INTERCEPT] FIO_DAX_CACHE: cannot allocate %zu bytes, no DRAM cache\n",
+                        cache_size);
+            }
+        }
+        // "pattern[,pattern...]"
+        if (const char* env = getenv("FIO_DAX_WAL")) {
+            std::string list = env;
+            size_t pos = 0;
+            while (pos < list.size()) {
+                size_t comma = list.find(',', pos);
+                if (comma == std::string::npos) comma = list.size();
+                if (comma > pos) wal_patterns.push_back(list.substr(pos, comma - pos));
+                pos = comma + 1;
+            }
+        }
+        // "pattern=node[,pattern=node...]"
+        if (const char* env = getenv("FIO_NUMA_PLACEMENT")) {
+            std::string rules = env;
+            size_t pos = 0;
+            while (pos < rules.size()) {
+                size_t comma = rules.find(',', pos);
+                if (comma == std::string::npos) comma = rules.size();
+                std::string rule = rules.substr(pos, comma - pos);
+                size_t eq = rule.rfind('=');
+                if (eq != std::string::npos && eq > 0) {
+                    placement_rules.push_back({rule.substr(0, eq), atoi(rule.c_str() + eq + 1)});
                 }
+                pos = comma + 1;
+            }
+        }
+
+        std::vector<cxl_intercept::DaxRegionSpec> specs;
+        if (env_devices) {
+            specs = cxl_intercept::parse_region_list(env_devices);
+        } else if (env_dax) {
+            specs.push_back({env_dax, 0, -1});
+        }
+
+        const char* env_format = getenv("FIO_DAX_FORMAT");
+        bool force_format = env_format && strcmp(env_format, "1") == 0;
+        for (cxl_intercept::DaxRegionSpec& spec : specs) {
+            if (dax_region_count == cxl_intercept::kMaxDaxRegions) {
+                fprintf(stderr, "[FIO_INTERCEPT] Ignoring %s: at most %d regions\n",
+                        spec.path.c_str(), cxl_intercept::kMaxDaxRegions);
+                break;
+            }
+            if (spec.size == 0 && env_size) spec.size = cxl_intercept::parse_size(env_size);
+            if (env_align) spec.align = cxl_intercept::parse_size(env_align);
+            if (env_window) spec.window = cxl_intercept::parse_size(env_window);
+            if (env_max_windows) spec.max_windows = strtoul(env_max_windows, nullptr, 0);
+
+            cxl_intercept::DaxRegion& region = dax_regions[dax_region_count];
+            if (!region.map(spec, &dax_epoch)) {
+                fprintf(stderr, "[FIO_INTERCEPT] Failed to map DAX device %s: %s\n",
+                        spec.path.c_str(), strerror(errno));
+                continue;
             }
+            if (!region.attach_catalog(cxl_ssd::eager_persist_mode(persist_mode), force_format,
+                                       env_thin_block ? cxl_intercept::parse_size(env_thin_block) : 0,
+                                       env_sparse_max ? cxl_intercept::parse_size(env_sparse_max) : 0)) {
+                region.unmap();
+                continue;
+            }
+            qos.bind(region.qos);
+            if (verify_block && !region.integrity.attach(region.base, region.size, verify_block)) {
+                fprintf(stderr, "[FIO_INTERCEPT] No checksum table for %s, not verifying it: %s\n",
+                        region.path.c_str(), strerror(errno));
+            }
+            if (thin_mode && !region.catalog.has_zero_map()) {
+                fprintf(stderr, "[FIO_INTERCEPT] %s: catalog predates the zero map, zero blocks are "
+                        "stored; FIO_DAX_FORMAT=1 reformats\n", region.path.c_str());
+            }
+            if (sparse_mode && !region.catalog.has_chunk_maps()) {
+                fprintf(stderr, "[FIO_INTERCEPT] %s: catalog predates chunk maps, new files get whole "
+                        "extents; FIO_DAX_FORMAT=1 reformats\n", region.path.c_str());
+            }
+            fprintf(stderr, "[FIO_INTERCEPT] DAX device mapped: %s (size: %zu, node: %d, align: %zu KB, "
+                    "page: %zu KB, persist: %s)\n",
+                    region.path.c_str(), region.size, region.node, region.align >> 10,
+                    region.page_size >> 10, cxl_ssd::persist_mode_name(persist_mode));
+            dax_region_count++;
+        }
+        if (dax_region_count == 0) {
+            intercept_enabled = false;
+        } else if (const char* env = getenv("FIO_DAX_METADATA")) {
+            cxl_intercept::write_region_metadata(cxl_intercept::expand_path_template(env, "fio_intercept"),
+                                                 "fio_intercept", cxl_ssd::persist_mode_name(persist_mode),
+                                                 dax_regions, dax_region_count);
+        }
+    }
+}
+
+// One value in a stats file, rendered as JSON
+struct StatField {
+    StatField(const char* key, std::integral auto value) : key(key), json(std::to_string(value)) {}
+    StatField(const char* key, double value) : key(key) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.4f", value);
+        json = buf;
+    }
+    StatField(const char* key, const std::string& value) : key(key), json("\"" + value + "\"") {}
+
+    const char* key;
+    std::string json;
+};
+
+using StatRow = std::vector<StatField>;
+
+// Write the counters a report_*() printed at exit as JSON to the file the
+// environment variable env names (%p expands to the pid), if it is set:
+// {"section": {fields}}, or for per-region and per-class counts
+// {"section": [{fields}, ...]}
+void write_stats(const char* env, const char* section, const std::vector<StatRow>& rows, bool list) {
+    const char* tmpl = getenv(env);
+    if (!tmpl) return;
+    FILE* json = fopen(cxl_intercept::expand_path_template(tmpl, "fio_intercept").c_str(), "w");
+    if (!json) return;
+    fprintf(json, "{\n  \"%s\": %s", section, list ? "[" : "");
+    for (size_t r = 0; r < rows.size(); r++) {
+        fprintf(json, "%s{", list ? (r ? ",\n    " : "\n    ") : "");
+        for (size_t f = 0; f < rows[r].size(); f++) {
+            fprintf(json, "%s\"%s\": %s", f ? ", " : "", rows[r][f].key, rows[r][f].json.c_str());
         }
+        fprintf(json, "}");
+    }
+    fprintf(json, "%s\n}\n", list ? "\n  ]" : "");
+    fclose(json);
+}
+
+void write_stats(const char* env, const char* section, StatRow fields) {
+    write_stats(env, section, {std::move(fields)}, false);
+}
+
+// Per-region byte counts split by local and remote accessors
+// (FIO_NUMA_STATS_FILE)
+void report_numa_traffic() {
+    using Traffic = cxl_intercept::RegionTraffic;
+    uint64_t any = 0;
+    for (int i = 0; i < dax_region_count; i++) {
+        any += dax_regions[i].traffic.total(Traffic::READ) + dax_regions[i].traffic.total(Traffic::WRITE);
+    }
+    if (!any) return;
+
+    std::vector<StatRow> rows;
+    for (int i = 0; i < dax_region_count; i++) {
+        const cxl_intercept::DaxRegion& region = dax_regions[i];
+        uint64_t rd = region.traffic.total(Traffic::READ);
+        uint64_t wr = region.traffic.total(Traffic::WRITE);
+        uint64_t remote_rd = region.traffic.total(Traffic::REMOTE_READ);
+        uint64_t remote_wr = region.traffic.total(Traffic::REMOTE_WRITE);
+        fprintf(stderr, "[FIO_INTERCEPT] NUMA traffic %s (node %d): read %.1f MB (%.1f%% remote), "
+                "write %.1f MB (%.1f%% remote)\n",
+                region.path.c_str(), region.node,
+                rd / 1048576.0, rd ? 100.0 * remote_rd / rd : 0.0,
+                wr / 1048576.0, wr ? 100.0 * remote_wr / wr : 0.0);
+        rows.push_back({{"region", region.path}, {"node", region.node}, {"read_bytes", rd},
+                        {"write_bytes", wr}, {"remote_read_bytes", remote_rd},
+                        {"remote_write_bytes", remote_wr}});
+    }
+    write_stats("FIO_NUMA_STATS_FILE", "numa_traffic", rows, true);
+}
+
+// Write-combining counts (FIO_WC_STATS_FILE): the combine rate is the share
+// of sub-line writes that joined a line already pending, i.e. the line
+// write-backs and fences saved
+void report_write_combining() {
+    cxl_intercept::WriteCombiner::Stats st = write_combiner.stats();
+    if (!st.writes) return;
+    double rate = 100.0 * st.combined / st.writes;
+    fprintf(stderr, "[FIO_INTERCEPT] Write combining: %llu sub-line writes, %llu combined (%.1f%%), "
+            "%llu line write-backs\n",
+            (unsigned long long)st.writes, (unsigned long long)st.combined, rate,
+            (unsigned long long)st.flushes);
+    write_stats("FIO_WC_STATS_FILE", "write_combining",
+                {{"writes", st.writes}, {"combined", st.combined}, {"line_writebacks", st.flushes},
+                 {"combine_rate", rate / 100.0}});
+}
+
+// Prefetch counts (FIO_PREFETCH_STATS_FILE): usefulness is the share of
+// prefetched lines that a later read of the same stream copied
+void report_prefetch() {
+    using P = cxl_intercept::StreamPrefetcher;
+    uint64_t reads = prefetcher.total(P::READS);
+    if (!prefetcher.enabled() || !reads) return;
+    uint64_t sequential = prefetcher.total(P::SEQUENTIAL);
+    uint64_t issued = prefetcher.total(P::ISSUED);
+    uint64_t useful = prefetcher.total(P::USEFUL);
+    double usefulness = issued ? 100.0 * (useful < issued ? useful : issued) / issued : 0.0;
+    fprintf(stderr, "[FIO_INTERCEPT] Prefetch: %llu reads, %llu sequential, %llu lines prefetched, "
+            "%llu useful (%.1f%%)\n",
+            (unsigned long long)reads, (unsigned long long)sequential,
+            (unsigned long long)issued, (unsigned long long)useful, usefulness);
+    write_stats("FIO_PREFETCH_STATS_FILE", "prefetch",
+                {{"distance", prefetcher.distance()}, {"hint", std::string(prefetcher.nta() ? "nta" : "t0")},
+                 {"reads", reads}, {"sequential", sequential}, {"lines_issued", issued},
+                 {"lines_useful", useful}, {"usefulness", usefulness / 100.0}});
+}
+
+// DRAM cache counts (FIO_CACHE_STATS_FILE)
+void report_dram_cache() {
+    using C = cxl_intercept::DramCache;
+    uint64_t hits = dram_cache.total(C::HITS);
+    uint64_t misses = dram_cache.total(C::MISSES);
+    if (!dram_cache.enabled() || !(hits + misses)) return;
+    uint64_t evictions = dram_cache.total(C::EVICTIONS);
+    uint64_t writebacks = dram_cache.total(C::WRITEBACKS);
+    double rate = 100.0 * hits / (hits + misses);
+    fprintf(stderr, "[FIO_INTERCEPT] DRAM cache: %llu page hits, %llu misses (%.1f%% hits), "
+            "%llu evictions, %llu write-backs\n",
+            (unsigned long long)hits, (unsigned long long)misses, rate,
+            (unsigned long long)evictions, (unsigned long long)writebacks);
+    write_stats("FIO_CACHE_STATS_FILE", "dram_cache",
+                {{"size", dram_cache.size()}, {"ways", dram_cache.ways()}, {"hits", hits}, {"misses", misses},
+                 {"evictions", evictions}, {"writebacks", writebacks}, {"hit_rate", rate / 100.0}});
+}
+
+// Per-class QoS counts (FIO_QOS_STATS_FILE)
+void report_qos() {
+    if (!qos.enabled()) return;
+    using Q = cxl_intercept::QosPolicy;
+    std::vector<StatRow> rows;
+    for (int c = 0; c < qos.count(); c++) {
+        uint64_t ops = qos.total(c, Q::OPS);
+        if (!ops) continue;
+        uint64_t bytes = qos.total(c, Q::BYTES);
+        uint64_t reserved = qos.total(c, Q::RESERVED);
+        uint64_t delayed = qos.total(c, Q::DELAYED);
+        double delay_ms = qos.total(c, Q::DELAY_NS) / 1e6;
+        double max_us = qos.max_delay_ns(c) / 1e3;
+        fprintf(stderr, "[FIO_INTERCEPT] QoS class %s: %llu ops, %.1f MB, %llu within reservation, "
+                "%llu delayed (%.1f ms total, max %.1f us)\n",
+                qos.name(c).c_str(), (unsigned long long)ops, bytes / (1024.0 * 1024.0),
+                (unsigned long long)reserved, (unsigned long long)delayed, delay_ms, max_us);
+        rows.push_back({{"class", qos.name(c)}, {"ops", ops}, {"bytes", bytes}, {"reserved_ops", reserved},
+                        {"delayed_ops", delayed}, {"delay_ms", delay_ms}, {"max_delay_us", max_us}});
+    }
+    write_stats("FIO_QOS_STATS_FILE", "qos", rows, true);
+}
+
+// Zero-map counts over all regions (FIO_THIN_STATS_FILE)
+void report_thin() {
+    using Z = cxl_intercept::ZeroMap;
+    uint64_t v[Z::NUM_COUNTERS] = {};
+    uint64_t elided_bytes = 0;
+    for (int i = 0; i < dax_region_count; i++) {
+        const Z& zeros = dax_regions[i].catalog.zero_map;
+        for (int c = 0; c < Z::NUM_COUNTERS; c++) v[c] += zeros.total(Z::Counter(c));
+        elided_bytes += zeros.total(Z::ELIDED) * zeros.block();
+    }
+    if (!thin_mode && !v[Z::FILLED] && !v[Z::ZERO_READS]) return;
+    fprintf(stderr, "[FIO_INTERCEPT] Thin zero blocks: %llu written as marks (%.1f MB not stored), "
+            "%llu filled, %llu read as zeroes\n",
+            (unsigned long long)v[Z::ELIDED], elided_bytes / (1024.0 * 1024.0),
+            (unsigned long long)v[Z::FILLED], (unsigned long long)v[Z::ZERO_READS]);
+    write_stats("FIO_THIN_STATS_FILE", "thin",
+                {{"elided_blocks", v[Z::ELIDED]}, {"elided_bytes", elided_bytes},
+                 {"filled_blocks", v[Z::FILLED]}, {"zero_reads", v[Z::ZERO_READS]}});
+}
+
+// Verification counts over all regions (FIO_VERIFY_STATS_FILE). Unverified
+// blocks had no checksum (never written by this process tree, or mmap()ed
+// writable) or were written during the check.
+void report_integrity() {
+    using I = cxl_intercept::DaxIntegrity;
+    if (!verify_block) return;
+    uint64_t v[I::NUM_COUNTERS] = {};
+    for (int i = 0; i < dax_region_count; i++) {
+        for (int c = 0; c < I::NUM_COUNTERS; c++) v[c] += dax_regions[i].integrity.total(I::Counter(c));
     }
+    fprintf(stderr, "[FIO_INTERCEPT] CRC32C verify (%zu-byte blocks): %llu checksummed, %llu verified, "
+            "%llu mismatches, %llu unverified\n", verify_block,
+            (unsigned long long)v[I::CHECKSUMMED], (unsigned long long)v[I::VERIFIED],
+            (unsigned long long)v[I::MISMATCHES], (unsigned long long)v[I::UNVERIFIED]);
+    write_stats("FIO_VERIFY_STATS_FILE", "verify",
+                {{"block", verify_block}, {"checksummed", v[I::CHECKSUMMED]}, {"verified", v[I::VERIFIED]},
+                 {"mismatches", v[I::MISMATCHES]}, {"unverified", v[I::UNVERIFIED]}});
+}
+
+// Drop the namespace count of an open; fds inherited over fork() leave it
+// to the process that opened them
+void release_dax_extent(DAXMapping& mapping) {
+    if (mapping.opener != getpid()) return;
+    mapping.region->catalog.release_extent(mapping.ns_slot);
+    mapping.ns_slot = -1;
 }
 
 // Cleanup
 __attribute__((destructor))
 void cleanup_intercept() {
-    if (global_dax_base && global_dax_base != MAP_FAILED) {
-        munmap(global_dax_base, dax_device_size);
+    for (int i = 0; i < cxl_intercept::kMaxDaxRegions; i++) {
+        cxl_intercept::CopyWorkerPool* pool = aio_pools[i].exchange(nullptr);
+        if (!pool) continue;
+        // Regions on one node share a pool
+        for (int j = i + 1; j < cxl_intercept::kMaxDaxRegions; j++) {
+            cxl_intercept::CopyWorkerPool* shared = pool;
+            aio_pools[j].compare_exchange_strong(shared, nullptr);
+        }
+        delete pool;
+    }
+    if (dram_cache.enabled()) {
+        // Pages of files still open; lazy mode persists what this stores
+        EpochGuard guard(dax_epoch);
+        dram_cache.write_back_all();
     }
-    if (global_dax_fd >= 0) {
-        real_close(global_dax_fd);
+    {
+        // Write back what lazy mode still holds, as the kernel would at exit
+        std::lock_guard<std::mutex> lk(dirty_files_mu);
+        for (DirtyFile* file : dirty_files) file->tracker.flush(cxl_ssd::PersistMode::LAZY);
     }
+    write_combiner.shutdown();
+    // Files left open count as closed for the other processes
+    dax_fds.for_each([](int, DAXMapping* mapping) { release_dax_extent(*mapping); });
+    report_numa_traffic();
+    report_write_combining();
+    report_prefetch();
+    report_dram_cache();
+    report_integrity();
+    report_thin();
+    report_qos();
+    latency.shutdown();
+    trace.shutdown();
+    for (int i = 0; i < dax_region_count; i++) dax_regions[i].unmap();
 }
 
 // Check if path should be intercepted
@@ -156,276 +811,2249 @@ bool should_intercept(const char* path) {
     return false;
 }
 
-// Allocate space in DAX device
-size_t allocate_dax_space(size_t requested_size) {
-    static std::atomic<size_t> allocated{0};
+// Remove path from the catalogs; returns false if it was never intercepted
+bool unlink_dax_file(const char* path) {
+    uint64_t t0 = trace.begin();
+    std::string key = cxl_intercept::catalog_path_key(path);
+    bool found = false;
+    for (int i = 0; i < dax_region_count; i++) {
+        if (dax_regions[i].catalog.remove(key)) found = true;
+    }
+    if (!found) return false;
+    trace.record(TraceOp::UNLINK, -1, 0, 0, 0, t0);
+    return true;
+}
 
-    size_t offset = allocated.fetch_add(requested_size);
-    if (offset + requested_size > dax_device_size) {
-        // Wrap around or fail
-        allocated.store(0);
-        return 0;
+// Share one view between all fds open on the sparse file whose chunk map
+// is map. The view is chunk-aligned so device chunks map over it with
+// huge pages.
+SparseFile* acquire_sparse_file(cxl_intercept::DaxRegion* region, uint32_t* map, size_t size) {
+    std::lock_guard<std::mutex> lk(sparse_files_mu);
+    for (SparseFile* file : sparse_files) {
+        if (file->map == map) {
+            file->refs++;
+            return file;
+        }
     }
-    return offset;
+    size_t chunk = region->catalog.chunk_size();
+    char* hole = reinterpret_cast<char*>(syscall(SYS_mmap, nullptr, size + chunk, PROT_READ,
+                                                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0));
+    if (hole == MAP_FAILED) return nullptr;
+    char* view = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(hole) + chunk - 1) & ~(chunk - 1));
+    if (view > hole) syscall(SYS_munmap, hole, view - hole);
+    if (hole + chunk > view) syscall(SYS_munmap, view + size, hole + chunk - view);
+    SparseFile* file = new SparseFile(region, map, view, size, chunk);
+    sparse_files.push_back(file);
+    return file;
 }
 
-} // anonymous namespace
+void release_sparse_file(SparseFile* file) {
+    if (!file) return;
+    std::lock_guard<std::mutex> lk(sparse_files_mu);
+    if (--file->refs > 0) return;
+    syscall(SYS_munmap, file->view, file->size);
+    for (size_t i = 0; i < sparse_files.size(); i++) {
+        if (sparse_files[i] == file) {
+            sparse_files[i] = sparse_files.back();
+            sparse_files.pop_back();
+            break;
+        }
+    }
+    delete file;
+}
 
-// Intercepted functions
-extern "C" {
+// Map chunk i of a sparse file over its view, allocating it first if alloc
+// is set and no process has; false if it stays unbacked. A new chunk reads
+// as zeroes, like the hole it fills, before any process can see it.
+bool sparse_map_chunk(SparseFile* file, size_t i, bool alloc) {
+    std::lock_guard<std::mutex> lk(file->mu);
+    if (file->mapped[i].load(std::memory_order_relaxed)) return true;
+    char* at = file->view + i * file->chunk;
+    bool filled = false;
+    auto zero = [&](uint64_t offset) {
+        if (!file->region->map_at(at, file->chunk, offset)) return false;
+        cxl_ssd::PersistMode mode = cxl_ssd::eager_persist_mode(persist_mode);
+        memset(at, 0, file->chunk);
+        cxl_ssd::persist_flush(at, file->chunk, mode);
+        cxl_ssd::persist_fence(mode);
+        filled = true;
+        return true;
+    };
+    uint64_t offset = alloc ? file->region->catalog.map_chunk(file->map, i, zero)
+                            : std::atomic_ref<uint32_t>(file->map[i]).load(std::memory_order_acquire) *
+                                  uint64_t(file->chunk);
+    if (!offset || (!filled && !file->region->map_at(at, file->chunk, offset))) return false;
+    file->mapped[i].store(true, std::memory_order_release);
+    return true;
+}
 
-int open(const char* pathname, int flags, ...) {
-    mode_t mode = 0;
-    if (flags & O_CREAT) {
-        va_list args;
-        va_start(args, flags);
-        mode = va_arg(args, mode_t);
-        va_end(args);
+// Map the chunks of [offset, offset + n) of a sparse file that some process
+// allocated, and with alloc allocate the others; returns the bytes from
+// offset that are backed
+size_t dax_sparse_map(const DAXMapping& mapping, off_t offset, size_t n, bool alloc) {
+    SparseFile* file = mapping.sparse;
+    size_t end = static_cast<size_t>(offset) + n;
+    for (size_t i = offset / file->chunk; i * file->chunk < end; i++) {
+        if (file->mapped[i].load(std::memory_order_acquire)) continue;
+        if (!alloc && !std::atomic_ref<uint32_t>(file->map[i]).load(std::memory_order_relaxed)) continue;
+        if (!sparse_map_chunk(file, i, alloc)) {
+            size_t start = i * file->chunk;
+            return start > static_cast<size_t>(offset) ? start - offset : 0;
+        }
     }
+    return n;
+}
 
-    if (should_intercept(pathname)) {
-        std::lock_guard<std::mutex> lock(mappings_mutex);
+// Make [offset, offset + n) of the file readable: a sparse file's chunks
+// written since by other processes, a windowed region's windows. False
+// with errno set (ENOMEM, else EIO) if they cannot be mapped.
+bool dax_ensure(const DAXMapping& mapping, off_t offset, size_t n) {
+    if (!mapping.sparse) return mapping.region->ensure(static_cast<const char*>(mapping.base) + offset, n);
+    if (dax_sparse_map(mapping, offset, n, false) == n) return true;
+    if (errno != ENOMEM) errno = EIO;
+    return false;
+}
 
-        int fake_fd = fake_fd_counter.fetch_add(1);
+// The region's checksum table and zero map are indexed by region address;
+// a sparse file's view lies outside the region and has neither
+bool dax_verifying(const DAXMapping& mapping) {
+    return !mapping.sparse && mapping.region->integrity.enabled();
+}
 
-        // Allocate space in DAX device (default 1GB per file)
-        size_t file_size = 1ULL << 30; // 1GB
-        const char* env_file_size = getenv("FIO_FILE_SIZE");
-        if (env_file_size) {
-            file_size = std::stoull(env_file_size);
-        }
+bool dax_zero_mapped(const DAXMapping& mapping) {
+    return !mapping.sparse && mapping.region->catalog.zero_map.in_use();
+}
 
-        size_t offset = allocate_dax_space(file_size);
+// Account n bytes moved by this thread to or from the mapping's region
+void note_traffic(const DAXMapping& mapping, bool write, size_t n) {
+    cxl_intercept::DaxRegion* region = mapping.region;
+    bool remote = region->node >= 0 && cxl_intercept::cached_numa_node() != region->node;
+    region->traffic.add(write, remote, n);
+}
 
-        DAXMapping mapping;
-        mapping.base = static_cast<char*>(global_dax_base) + offset;
-        mapping.size = file_size;
-        mapping.current_offset = 0;
-        mapping.path = pathname;
-        mapping.real_fd = -1; // No real file
+void log_mismatch(const DAXMapping& mapping, const char* block) {
+    if (mismatch_logs.fetch_add(1, std::memory_order_relaxed) >= kMaxMismatchLogs) return;
+    fprintf(stderr, "[FIO_INTERCEPT] CRC32C mismatch: %s, %zu-byte block at offset %lld\n",
+            mapping.path.c_str(), verify_block,
+            (long long)(block - static_cast<const char*>(mapping.base)));
+}
 
-        dax_mappings[fake_fd] = mapping;
+// Copy block by block, checking each block the copy touched against its
+// checksum; a mismatch is reported, the data still returned
+void dax_load_verified(const DAXMapping& mapping, const char* src, char* dst, size_t n) {
+    cxl_intercept::DaxIntegrity& integrity = mapping.region->integrity;
+    size_t block = integrity.block();
+    while (n > 0) {
+        const char* start = integrity.block_start(src);
+        size_t piece = static_cast<size_t>(start + block - src);
+        if (piece > n) piece = n;
+        uint64_t seen = integrity.begin_read(src);
+        memcpy(dst, src, piece);
+        if (!integrity.end_read(src, seen, piece == block ? dst : nullptr)) log_mismatch(mapping, start);
+        src += piece;
+        dst += piece;
+        n -= piece;
+    }
+}
 
-        if (getenv("FIO_DEBUG")) {
-            fprintf(stderr, "[INTERCEPT] open(%s) -> DAX fd=%d\n", pathname, fake_fd);
-        }
+void dax_copy_out(const DAXMapping& mapping, const char* src, char* dst, size_t n) {
+    if (dax_verifying(mapping)) dax_load_verified(mapping, src, dst, n);
+    else memcpy(dst, src, n);
+}
 
-        return fake_fd;
+// Load n bytes at offset into dst from the region; blocks the zero map
+// holds read as zeroes. False with errno set if the region cannot be
+// mapped.
+bool dax_load_device(const DAXMapping& mapping, off_t offset, void* dst, size_t n) {
+    const char* src = static_cast<const char*>(mapping.base) + offset;
+    if (!dax_ensure(mapping, offset, n)) return false;
+    cxl_intercept::ZeroMap& zeros = mapping.region->catalog.zero_map;
+    if (dax_zero_mapped(mapping)) {
+        zeros.read(src, static_cast<char*>(dst), n, [&](char* to, const char* from, size_t len) {
+            dax_copy_out(mapping, from, to, len);
+        });
+    } else {
+        dax_copy_out(mapping, src, static_cast<char*>(dst), n);
     }
+    note_traffic(mapping, false, n);
+    return true;
+}
 
-    return real_open(pathname, flags, mode);
+bool dax_cache_fill(void* owner, const char* dev, char* page) {
+    const DAXMapping& mapping = *static_cast<const DAXMapping*>(owner);
+    return dax_load_device(mapping, dev - static_cast<const char*>(mapping.base), page, dram_cache.kPage);
 }
 
-int close(int fd) {
-    {
-        std::lock_guard<std::mutex> lock(mappings_mutex);
-        auto it = dax_mappings.find(fd);
-        if (it != dax_mappings.end()) {
-            if (getenv("FIO_DEBUG")) {
-                fprintf(stderr, "[INTERCEPT] close(DAX fd=%d)\n", fd);
-            }
-            dax_mappings.erase(it);
-            return 0;
-        }
+// True if accesses to [addr, addr + n) go through the DRAM cache
+bool dax_cached(const char* addr, size_t n) {
+    if (!dram_cache.enabled()) return false;
+    if (!any_uncached.load(std::memory_order_acquire)) return true;
+    uintptr_t start = reinterpret_cast<uintptr_t>(addr);
+    std::lock_guard<std::mutex> lk(uncached_mu);
+    for (const AppMapping& m : uncached) {
+        if (start < m.end && start + n > m.start) return false;
     }
-    return real_close(fd);
+    return true;
 }
 
-ssize_t read(int fd, void* buf, size_t count) {
-    {
-        std::lock_guard<std::mutex> lock(mappings_mutex);
-        auto it = dax_mappings.find(fd);
-        if (it != dax_mappings.end()) {
-            DAXMapping& mapping = it->second;
-
-            size_t to_read = count;
-            if (mapping.current_offset + to_read > mapping.size) {
-                to_read = mapping.size - mapping.current_offset;
-            }
+// Load n bytes at offset into dst, through the DRAM cache when there is
+// one; returns the bytes that came from the region, or -1 with errno set
+ssize_t dax_load(const DAXMapping& mapping, off_t offset, void* dst, size_t n) {
+    const char* src = static_cast<const char*>(mapping.base) + offset;
+    if (!dax_cached(src, n)) return dax_load_device(mapping, offset, dst, n) ? static_cast<ssize_t>(n) : -1;
+    return dram_cache.read(const_cast<DAXMapping*>(&mapping), src, static_cast<char*>(dst), n);
+}
 
-            if (to_read > 0) {
-                memcpy(buf, static_cast<char*>(mapping.base) + mapping.current_offset, to_read);
-                mapping.current_offset += to_read;
-            }
+// Clamp an access of count bytes at offset to the end of the mapping
+size_t clamp_to_mapping(const DAXMapping& mapping, off_t offset, size_t count) {
+    if (offset < 0 || static_cast<size_t>(offset) >= mapping.size) return 0;
+    size_t remaining = mapping.size - static_cast<size_t>(offset);
+    return count < remaining ? count : remaining;
+}
 
-            if (getenv("FIO_DEBUG")) {
-                fprintf(stderr, "[INTERCEPT] read(DAX fd=%d, size=%zu) -> %zu\n",
-                       fd, count, to_read);
-            }
+// Bytes of a write of count at offset the file has room for: inside the
+// mapping and, for a sparse file, in chunks it has or could allocate. -1
+// (ENOSPC) if the region cannot back any of it.
+ssize_t clamp_to_space(const DAXMapping& mapping, off_t offset, size_t count) {
+    size_t n = clamp_to_mapping(mapping, offset, count);
+    if (!mapping.sparse || n == 0) return n;
+    n = dax_sparse_map(mapping, offset, n, true);
+    if (n == 0) {
+        errno = ENOSPC;
+        return -1;
+    }
+    return n;
+}
 
-            return to_read;
+// Persisted tail marker of an append-mode file, or nullptr
+uint64_t* dax_wal_marker(const DAXMapping& mapping) {
+    if (!mapping.wal_entry) return nullptr;
+    return cxl_intercept::DaxCatalog::logical_size(mapping.wal_entry, mapping.extent);
+}
+
+// Size of the file: its extent, or an append-mode file's tail
+size_t dax_file_size(const DAXMapping& mapping) {
+    uint64_t* marker = dax_wal_marker(mapping);
+    if (!marker) return mapping.size;
+    uint64_t tail = std::atomic_ref<uint64_t>(*marker).load(std::memory_order_relaxed);
+    return tail < mapping.size ? tail : mapping.size;
+}
+
+// Bytes of a read of count at offset that lie inside the file
+size_t clamp_to_file(const DAXMapping& mapping, off_t offset, size_t count) {
+    size_t n = clamp_to_mapping(mapping, offset, count);
+    if (!mapping.wal_entry || n == 0) return n;
+    size_t size = dax_file_size(mapping);
+    if (static_cast<size_t>(offset) >= size) return 0;
+    return n < size - offset ? n : size - offset;
+}
+
+// Total length of an iovec array, or -1 (EINVAL) if it is malformed
+ssize_t iov_total(const struct iovec* iov, int iovcnt) {
+    if (iovcnt < 0 || iovcnt > IOV_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+    size_t total = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        total += iov[i].iov_len;
+        if (total > SSIZE_MAX) {
+            errno = EINVAL;
+            return -1;
         }
     }
-    return real_read(fd, buf, count);
+    return static_cast<ssize_t>(total);
 }
 
-ssize_t write(int fd, const void* buf, size_t count) {
-    {
-        std::lock_guard<std::mutex> lock(mappings_mutex);
-        auto it = dax_mappings.find(fd);
-        if (it != dax_mappings.end()) {
-            DAXMapping& mapping = it->second;
-
-            size_t to_write = count;
-            if (mapping.current_offset + to_write > mapping.size) {
-                to_write = mapping.size - mapping.current_offset;
-            }
+// Start timestamp shared by the timing model and the latency histograms
+inline uint64_t op_begin() {
+    return timing.enabled() || latency.enabled() ? __rdtsc() : 0;
+}
 
-            if (to_write > 0) {
-                void* dest = static_cast<char*>(mapping.base) + mapping.current_offset;
-                memcpy(dest, buf, to_write);
+// Waits owed by an intercepted call: emulated device time, the latency
+// samples timed across it and QoS admission. They are queued while the
+// call is inside its epoch read-side section and taken by DaxGuard once it
+// has left, so an emulated-slow device or a throttled tenant never stalls
+// synchronize() (close, window eviction, unlink). Outside a DaxGuard they
+// are taken at once.
+struct PendingWait {
+    enum Kind : uint8_t { DELAY, RECORD, ADMIT } kind;
+    LatOp op;
+    int qos_class;
+    uint32_t lat_id;
+    size_t bytes;
+    uint64_t l0;
+    cxl_intercept::QosBuckets* buckets;  // the region's; regions outlive every fd
+};
 
-                // Flush for persistence
-                for (size_t i = 0; i < to_write; i += 64) {
-                    _mm_clflushopt(static_cast<char*>(dest) + i);
-                }
-                _mm_sfence();
+struct PendingWaits {
+    static constexpr unsigned kMax = 8;  // a copy queues five
 
-                mapping.current_offset += to_write;
-            }
+    unsigned depth = 0;
+    unsigned count = 0;
+    PendingWait waits[kMax];
 
-            if (getenv("FIO_DEBUG")) {
-                fprintf(stderr, "[INTERCEPT] write(DAX fd=%d, size=%zu) -> %zu\n",
-                       fd, count, to_write);
-            }
+    void push(const PendingWait& w) {
+        if (depth == 0 || count == kMax) run(w);
+        else waits[count++] = w;
+    }
 
-            return to_write;
+    // Device time and latency samples in order, then QoS, so the
+    // histograms leave the QoS wait out
+    void leave() {
+        if (--depth > 0) return;
+        for (unsigned i = 0; i < count; i++) {
+            if (waits[i].kind != PendingWait::ADMIT) run(waits[i]);
+        }
+        for (unsigned i = 0; i < count; i++) {
+            if (waits[i].kind == PendingWait::ADMIT) run(waits[i]);
         }
+        count = 0;
     }
-    return real_write(fd, buf, count);
-}
 
-ssize_t pread(int fd, void* buf, size_t count, off_t offset) {
-    {
-        std::lock_guard<std::mutex> lock(mappings_mutex);
-        auto it = dax_mappings.find(fd);
-        if (it != dax_mappings.end()) {
-            DAXMapping& mapping = it->second;
-
-            size_t to_read = count;
-            if (offset + to_read > mapping.size) {
-                to_read = mapping.size - offset;
-            }
+    static void run(const PendingWait& w) {
+        switch (w.kind) {
+            case PendingWait::DELAY: timing.delay(w.op, w.bytes, w.l0); break;
+            case PendingWait::RECORD: latency.record(w.lat_id, w.op, w.l0); break;
+            case PendingWait::ADMIT: qos.admit(*w.buckets, w.qos_class, w.bytes); break;
+        }
+    }
+};
 
-            if (to_read > 0 && offset >= 0) {
-                memcpy(buf, static_cast<char*>(mapping.base) + offset, to_read);
-            }
+thread_local PendingWaits pending_waits;
 
-            if (getenv("FIO_DEBUG")) {
-                fprintf(stderr, "[INTERCEPT] pread(DAX fd=%d, off=%ld, size=%zu) -> %zu\n",
-                       fd, offset, count, to_read);
-            }
+// Epoch read-side section of an intercepted I/O call: mappings looked up
+// inside stay valid until it ends, and the waits the call owes are taken
+// after it
+class DaxGuard {
+public:
+    DaxGuard() {
+        pending_waits.depth++;
+        dax_epoch.enter();
+    }
+    ~DaxGuard() {
+        dax_epoch.leave();
+        pending_waits.leave();
+    }
+    DaxGuard(const DaxGuard&) = delete;
+    DaxGuard& operator=(const DaxGuard&) = delete;
+};
 
-            return to_read;
-        }
+// The same deferral for a call that leaves its epoch section before it
+// blocks on a pipe or socket: the waits it owes are taken at its end
+class DaxWaitScope {
+public:
+    DaxWaitScope() { pending_waits.depth++; }
+    ~DaxWaitScope() { pending_waits.leave(); }
+    DaxWaitScope(const DaxWaitScope&) = delete;
+    DaxWaitScope& operator=(const DaxWaitScope&) = delete;
+};
+
+// Charge an operation of n bytes to the fd's QoS class. The class is paced
+// after the operation, once the call leaves its DaxGuard; the latency
+// histograms leave the wait out.
+inline void dax_admit(const DAXMapping& mapping, size_t n) {
+    if (qos.enabled()) {
+        pending_waits.push({PendingWait::ADMIT, LatOp::READ, mapping.qos_class, 0, n, 0, &mapping.region->qos});
     }
-    return real_pread(fd, buf, count, offset);
 }
 
-ssize_t pwrite(int fd, const void* buf, size_t count, off_t offset) {
-    {
-        std::lock_guard<std::mutex> lock(mappings_mutex);
-        auto it = dax_mappings.find(fd);
-        if (it != dax_mappings.end()) {
-            DAXMapping& mapping = it->second;
-
-            size_t to_write = count;
-            if (offset + to_write > mapping.size) {
-                to_write = mapping.size - offset;
-            }
+// Emulated device time of an operation started at l0, taken once the call
+// leaves its DaxGuard
+inline void dax_delay(LatOp op, size_t bytes, uint64_t l0) {
+    if (timing.enabled()) pending_waits.push({PendingWait::DELAY, op, 0, 0, bytes, l0, nullptr});
+}
 
-            if (to_write > 0 && offset >= 0) {
-                void* dest = static_cast<char*>(mapping.base) + offset;
-                memcpy(dest, buf, to_write);
+// Latency sample of an operation started at l0, taken after its device time
+inline void dax_record(uint32_t lat_id, LatOp op, uint64_t l0) {
+    if (latency.enabled()) pending_waits.push({PendingWait::RECORD, op, 0, lat_id, 0, l0, nullptr});
+}
 
-                // Flush for persistence
-                for (size_t i = 0; i < to_write; i += 64) {
-                    _mm_clflushopt(static_cast<char*>(dest) + i);
-                }
-                _mm_sfence();
-            }
+// Feed a read of [offset, offset + n) to the fd's stream detector, which
+// prefetches ahead of it once the stream is sequential
+inline void dax_read_ahead(const DAXMapping& mapping, off_t offset, size_t n) {
+    if (!prefetcher.enabled() || n == 0) return;
+    prefetcher.on_read(mapping.stream, static_cast<const char*>(mapping.base), mapping.size, offset, n);
+}
 
-            if (getenv("FIO_DEBUG")) {
-                fprintf(stderr, "[INTERCEPT] pwrite(DAX fd=%d, off=%ld, size=%zu) -> %zu\n",
-                       fd, offset, count, to_write);
-            }
+// Scatter the mapping at offset into iov; bounds are checked once for the
+// whole vector. -1 with errno set if the region cannot be mapped.
+ssize_t dax_readv_at(const DAXMapping& mapping, const struct iovec* iov, int iovcnt,
+                    size_t total, off_t offset) {
+    size_t to_read = clamp_to_file(mapping, offset, total);
+    dax_admit(mapping, to_read);
+    uint64_t l0 = op_begin();
+    dax_read_ahead(mapping, offset, to_read);
+    size_t done = 0, device = 0;
+    for (int i = 0; i < iovcnt && done < to_read; i++) {
+        size_t n = iov[i].iov_len < to_read - done ? iov[i].iov_len : to_read - done;
+        ssize_t loaded = dax_load(mapping, offset + done, iov[i].iov_base, n);
+        if (loaded < 0) return -1;
+        device += loaded;
+        done += n;
+    }
+    if (to_read > 0) {
+        if (device) dax_delay(LatOp::READ, device, l0);
+        dax_record(mapping.lat_id, LatOp::READ, l0);
+    }
+    return to_read;
+}
 
-            return to_write;
+// Share one dirty tracker between all fds open on the file at base
+DirtyFile* acquire_dirty_file(cxl_intercept::DaxRegion* region, char* base, size_t size) {
+    std::lock_guard<std::mutex> lk(dirty_files_mu);
+    for (DirtyFile* file : dirty_files) {
+        if (file->base == base) {
+            file->refs++;
+            return file;
         }
     }
-    return real_pwrite(fd, buf, count, offset);
+    DirtyFile* file = new DirtyFile(region, base, size, dirty_granule_shift);
+    if (!file->tracker.valid() || !region->pin(base, size)) {
+        delete file;
+        return nullptr;
+    }
+    dirty_files.push_back(file);
+    return file;
 }
 
-int fsync(int fd) {
-    {
-        std::lock_guard<std::mutex> lock(mappings_mutex);
-        auto it = dax_mappings.find(fd);
-        if (it != dax_mappings.end()) {
-            // DAX memory is already persistent after clflush
-            if (getenv("FIO_DEBUG")) {
-                fprintf(stderr, "[INTERCEPT] fsync(DAX fd=%d) -> 0\n", fd);
-            }
-            return 0;
+// Drop a reference; the last close writes the file back
+void release_dirty_file(DirtyFile* file) {
+    if (!file) return;
+    std::lock_guard<std::mutex> lk(dirty_files_mu);
+    if (--file->refs > 0) return;
+    file->tracker.flush(cxl_ssd::PersistMode::LAZY);
+    file->region->unpin(file->base, file->size);
+    for (size_t i = 0; i < dirty_files.size(); i++) {
+        if (dirty_files[i] == file) {
+            dirty_files[i] = dirty_files.back();
+            dirty_files.pop_back();
+            break;
         }
     }
-    return real_fsync(fd);
+    delete file;
 }
 
-off_t lseek(int fd, off_t offset, int whence) {
-    {
-        std::lock_guard<std::mutex> lock(mappings_mutex);
-        auto it = dax_mappings.find(fd);
-        if (it != dax_mappings.end()) {
-            DAXMapping& mapping = it->second;
+// Eager modes make the data durable (bar the final fence, see
+// dax_store_fence); lazy mode copies with cached stores and marks the
+// granules for the next fsync, writing the whole set back first if it has
+// grown past dirty_limit.
+void dax_copy_nofence(const DAXMapping& mapping, off_t offset, const void* src, size_t n) {
+    char* dst = static_cast<char*>(mapping.base) + offset;
+    if (persist_mode == cxl_ssd::PersistMode::LAZY && mapping.dirty) {
+        memcpy(dst, src, n);
+        size_t dirty = mapping.dirty->tracker.mark(offset, n);
+        if (dirty_limit && dirty > dirty_limit) mapping.dirty->tracker.flush(persist_mode);
+        return;
+    }
+    cxl_ssd::persist_copy_nofence(dst, src, n, cxl_ssd::eager_persist_mode(persist_mode));
+}
 
-            off_t new_offset = 0;
-            switch (whence) {
-                case SEEK_SET:
-                    new_offset = offset;
-                    break;
-                case SEEK_CUR:
-                    new_offset = mapping.current_offset + offset;
-                    break;
-                case SEEK_END:
-                    new_offset = mapping.size + offset;
-                    break;
-                default:
-                    errno = EINVAL;
-                    return -1;
-            }
+// When verifying, store block by block so each block's checksum is taken
+// after its own stores
+void dax_store_checked(const DAXMapping& mapping, off_t offset, const void* src, size_t n) {
+    char* dst = static_cast<char*>(mapping.base) + offset;
+    cxl_intercept::DaxIntegrity& integrity = mapping.region->integrity;
+    if (!dax_verifying(mapping)) {
+        dax_copy_nofence(mapping, offset, src, n);
+        return;
+    }
+    const char* from = static_cast<const char*>(src);
+    size_t block = integrity.block();
+    while (n > 0) {
+        size_t piece = static_cast<size_t>(integrity.block_start(dst) + block - dst);
+        if (piece > n) piece = n;
+        uint32_t ticket = integrity.begin_write(dst);
+        dax_copy_nofence(mapping, offset, from, piece);
+        integrity.end_write(dst, ticket, piece == block ? from : nullptr);
+        dst += piece;
+        from += piece;
+        offset += piece;
+        n -= piece;
+    }
+}
 
-            if (new_offset < 0) {
-                errno = EINVAL;
-                return -1;
-            }
+void dax_store_fence() {
+    if (persist_mode != cxl_ssd::PersistMode::LAZY) cxl_ssd::persist_fence(persist_mode);
+}
+
+// Store n bytes at offset. In thin mode whole zero blocks are only marked;
+// a block the zero map holds is filled, and its data made durable before
+// the map lets reads reach it. False with errno set if the region cannot be
+// mapped.
+bool dax_store_device(const DAXMapping& mapping, off_t offset, const void* src, size_t n) {
+    if (write_combiner.enabled()) write_combiner.flush_own();
+    char* dst = static_cast<char*>(mapping.base) + offset;
+    if (!mapping.region->ensure(dst, n)) return false;
+    note_traffic(mapping, true, n);
+    cxl_intercept::ZeroMap& zeros = mapping.region->catalog.zero_map;
+    bool elide = thin_mode && !verify_block && !mapping.sparse && zeros.attached();
+    if (!elide && !dax_zero_mapped(mapping)) {
+        dax_store_checked(mapping, offset, src, n);
+        return true;
+    }
+    char* base = static_cast<char*>(mapping.base);
+    zeros.write(dst, static_cast<const char*>(src), n, elide,
+                [&](char* to, const char* from, size_t len, bool claimed) {
+        dax_store_checked(mapping, to - base, from, len);
+        if (claimed) dax_store_fence();
+    });
+    return true;
+}
 
-            mapping.current_offset = new_offset;
+// An evicted or synced page, made as durable as an uncached write
+bool dax_cache_write_back(void* owner, char* dev, const char* page) {
+    const DAXMapping& mapping = *static_cast<const DAXMapping*>(owner);
+    if (!dax_store_device(mapping, dev - static_cast<char*>(mapping.base), page, dram_cache.kPage)) {
+        fprintf(stderr, "[FIO_INTERCEPT] Cannot write back a cached page of %s: %s\n", mapping.path.c_str(),
+                strerror(errno));
+        return false;
+    }
+    dax_store_fence();
+    return true;
+}
 
-            if (getenv("FIO_DEBUG")) {
-                fprintf(stderr, "[INTERCEPT] lseek(DAX fd=%d, off=%ld, whence=%d) -> %ld\n",
-                       fd, offset, whence, new_offset);
-            }
+// Store n bytes at offset: into the DRAM cache when there is one, which
+// writes them back later, else straight to the region. False with errno
+// set if the region cannot be mapped.
+bool dax_store_nofence(const DAXMapping& mapping, off_t offset, const void* src, size_t n) {
+    char* dst = static_cast<char*>(mapping.base) + offset;
+    if (!dax_cached(dst, n)) return dax_store_device(mapping, offset, src, n);
+    return dram_cache.write(const_cast<DAXMapping*>(&mapping), dst, static_cast<const char*>(src), n) >= 0;
+}
 
-            return new_offset;
-        }
+// Store a write that fits inside one cache line through the thread's
+// write-combining line; false if it must take the eager path instead (which
+// also reports a region that cannot be mapped)
+bool dax_store_combined(const DAXMapping& mapping, off_t offset, const void* src, size_t n) {
+    char* dst = static_cast<char*>(mapping.base) + offset;
+    if (!write_combiner.enabled() || dram_cache.enabled() || persist_mode == cxl_ssd::PersistMode::LAZY ||
+        persist_mode == cxl_ssd::PersistMode::NONE || !cxl_intercept::WriteCombiner::fits(dst, n)) {
+        return false;
     }
-    return real_lseek(fd, offset, whence);
+    // A zero block must be filled first, on the eager path
+    cxl_intercept::ZeroMap& zeros = mapping.region->catalog.zero_map;
+    if (dax_zero_mapped(mapping) && zeros.reads_zero(dst)) return false;
+    if (!mapping.region->ensure(dst, n)) return false;
+    note_traffic(mapping, true, n);
+    cxl_intercept::DaxIntegrity& integrity = mapping.region->integrity;
+    if (!dax_verifying(mapping)) {
+        write_combiner.write(mapping.region, dst, src, n, persist_mode);
+        return true;
+    }
+    uint32_t ticket = integrity.begin_write(dst);
+    write_combiner.write(mapping.region, dst, src, n, persist_mode);
+    integrity.end_write(dst, ticket, nullptr);
+    return true;
 }
 
-int ftruncate(int fd, off_t length) {
-    {
-        std::lock_guard<std::mutex> lock(mappings_mutex);
-        auto it = dax_mappings.find(fd);
-        if (it != dax_mappings.end()) {
-            // DAX mapping size is fixed, just return success
-            if (getenv("FIO_DEBUG")) {
-                fprintf(stderr, "[INTERCEPT] ftruncate(DAX fd=%d, len=%ld) -> 0\n",
-                       fd, length);
-            }
-            return 0;
-        }
+// Move an append-mode file's tail to end if that grows it. The marker is
+// a cached store, written back by the next fdatasync()
+void dax_wal_extend(const DAXMapping& mapping, uint64_t end) {
+    uint64_t* marker = dax_wal_marker(mapping);
+    if (!marker) return;
+    std::atomic_ref<uint64_t> tail(*marker);
+    uint64_t cur = tail.load(std::memory_order_relaxed);
+    while (cur < end && !tail.compare_exchange_weak(cur, end, std::memory_order_relaxed)) {}
+}
+
+// Stores of append-mode files and bulk copies: streaming, or plain ones
+// where nothing is persisted
+cxl_ssd::PersistMode streaming_persist_mode() {
+    return persist_mode == cxl_ssd::PersistMode::NONE
+               ? cxl_ssd::PersistMode::NONE
+               : cxl_ssd::resolve_persist_mode(cxl_ssd::PersistMode::NT_STORE);
+}
+
+// Append-mode files skip the generic store path unless the region checks
+// every store (verification) or may hold zero blocks, or writes are cached
+bool dax_wal_direct(const DAXMapping& mapping) {
+    return mapping.wal_entry && !dram_cache.enabled() && !dax_verifying(mapping) &&
+           !dax_zero_mapped(mapping);
+}
+
+// Non-temporal stores for whole lines and write-back of partial ones, no
+// fence; append-mode files leave the fence to fdatasync()
+bool dax_store_streaming(const DAXMapping& mapping, off_t offset, const void* src, size_t n) {
+    if (write_combiner.enabled()) write_combiner.flush_own();
+    char* dst = static_cast<char*>(mapping.base) + offset;
+    if (!mapping.region->ensure(dst, n)) return false;
+    note_traffic(mapping, true, n);
+    cxl_ssd::persist_copy_nofence(dst, src, n, streaming_persist_mode());
+    return true;
+}
+
+// Single-buffer read and write; the latency histograms time exactly the
+// copy and its persistence, plus any emulated device time. False with
+// errno set (ENOMEM, EIO) if the region cannot be mapped.
+bool dax_read_at(const DAXMapping& mapping, off_t offset, void* dst, size_t n) {
+    dax_admit(mapping, n);
+    uint64_t l0 = op_begin();
+    dax_read_ahead(mapping, offset, n);
+    ssize_t device = dax_load(mapping, offset, dst, n);
+    if (device < 0) return false;
+    if (device) dax_delay(LatOp::READ, device, l0);
+    dax_record(mapping.lat_id, LatOp::READ, l0);
+    return true;
+}
+
+bool dax_write_at(const DAXMapping& mapping, off_t offset, const void* src, size_t n) {
+    dax_admit(mapping, n);
+    uint64_t l0 = op_begin();
+    bool stored = true;
+    if (dax_wal_direct(mapping)) {
+        stored = dax_store_streaming(mapping, offset, src, n);
+    } else if (!dax_store_combined(mapping, offset, src, n)) {
+        stored = dax_store_nofence(mapping, offset, src, n);
+        dax_store_fence();
     }
-    return real_ftruncate(fd, length);
+    if (!stored) return false;
+    if (mapping.wal_entry) dax_wal_extend(mapping, offset + n);
+    if (!dram_cache.enabled()) dax_delay(LatOp::WRITE, n, l0);
+    dax_record(mapping.lat_id, LatOp::WRITE, l0);
+    return true;
+}
+
+// fsync()/fdatasync()/sync_file_range(): write back cached pages, lazily
+// persisted granules and combined lines in [offset, offset + len); returns
+// the bytes written back by the cache and lazy mode. For an append-mode
+// file, write back the tail marker and fence it together with the appends'
+// streaming stores.
+size_t dax_sync(const DAXMapping& mapping, size_t offset = 0, size_t len = SIZE_MAX) {
+    uint64_t l0 = op_begin();
+    size_t flushed = 0;
+    if (dram_cache.enabled() && offset < mapping.size) {
+        size_t n = len < mapping.size - offset ? len : mapping.size - offset;
+        flushed = dram_cache.write_back(static_cast<char*>(mapping.base) + offset, n, false) * dram_cache.kPage;
+    }
+    if (write_combiner.enabled() && offset < mapping.size) {
+        write_combiner.drain(static_cast<char*>(mapping.base) + offset,
+                             len < mapping.size - offset ? len : mapping.size - offset);
+    }
+    if (mapping.dirty) flushed += mapping.dirty->tracker.flush(cxl_ssd::PersistMode::LAZY, offset, len);
+    if (mapping.wal_entry) {
+        cxl_ssd::PersistMode mode = streaming_persist_mode();
+        if (uint64_t* marker = dax_wal_marker(mapping)) cxl_ssd::persist_flush(marker, sizeof(*marker), mode);
+        cxl_ssd::persist_fence(mode);
+    }
+    dax_delay(LatOp::SYNC, 0, l0);
+    dax_record(mapping.lat_id, LatOp::SYNC, l0);
+    return flushed;
+}
+
+// Gather iov into the mapping at offset with a single persistence fence;
+// -1 with errno set if a sparse file finds no chunk for it (ENOSPC) or the
+// region cannot be mapped
+ssize_t dax_writev_at(const DAXMapping& mapping, const struct iovec* iov, int iovcnt,
+                      size_t total, off_t offset) {
+    ssize_t space = clamp_to_space(mapping, offset, total);
+    if (space < 0) return -1;
+    size_t to_write = space;
+    dax_admit(mapping, to_write);
+    uint64_t l0 = op_begin();
+    bool wal = dax_wal_direct(mapping);
+    size_t done = 0;
+    for (int i = 0; i < iovcnt && done < to_write; i++) {
+        size_t n = iov[i].iov_len < to_write - done ? iov[i].iov_len : to_write - done;
+        bool stored = wal ? dax_store_streaming(mapping, offset + done, iov[i].iov_base, n)
+                          : dax_store_nofence(mapping, offset + done, iov[i].iov_base, n);
+        if (!stored) {
+            if (!wal) dax_store_fence();
+            return -1;
+        }
+        done += n;
+    }
+    if (to_write > 0) {
+        if (!wal) dax_store_fence();
+        if (mapping.wal_entry) dax_wal_extend(mapping, offset + to_write);
+        if (!dram_cache.enabled()) dax_delay(LatOp::WRITE, to_write, l0);
+        dax_record(mapping.lat_id, LatOp::WRITE, l0);
+    }
+    return to_write;
+}
+
+// Bytes moved per step by copies that need a buffer
+constexpr size_t kCopyChunk = 1 << 20;
+
+// True if the file's bytes can be read straight out of the region: no
+// cached pages that may be newer, no checksums to verify and no zero blocks
+// to substitute
+bool dax_readable_in_place(const DAXMapping& mapping) {
+    return !dram_cache.enabled() && !dax_verifying(mapping) && !dax_zero_mapped(mapping);
+}
+
+// True if a copy into the file can be one streaming copy: eager
+// persistence, no cache, no checksums, no zero blocks to fill or elide
+bool dax_streamable(const DAXMapping& mapping) {
+    cxl_intercept::ZeroMap& zeros = mapping.region->catalog.zero_map;
+    return !mapping.dirty && !dram_cache.enabled() && persist_mode != cxl_ssd::PersistMode::LAZY && !dax_verifying(mapping) &&
+           !dax_zero_mapped(mapping) && !(thin_mode && !mapping.sparse && zeros.attached());
+}
+
+// copy_file_range()/sendfile()/splice() between two DAX files: one
+// streaming copy from region to region and one fence, else a bounded
+// buffer when either side needs the generic path. Returns the bytes copied,
+// or -1 with errno set (ENOSPC, or a region that cannot be mapped).
+ssize_t dax_copy_range(const DAXMapping& src, off_t src_off, const DAXMapping& dst, off_t dst_off,
+                       size_t count) {
+    ssize_t space = clamp_to_space(dst, dst_off, clamp_to_file(src, src_off, count));
+    if (space <= 0) return space;
+    size_t n = space;
+    dax_admit(src, n);
+    dax_admit(dst, n);
+    uint64_t l0 = op_begin();
+    if (dax_readable_in_place(src)) {
+        const char* from = static_cast<const char*>(src.base) + src_off;
+        if (!dax_ensure(src, src_off, n)) return -1;
+        note_traffic(src, false, n);
+        bool stored;
+        if (dax_streamable(dst)) {
+            stored = dax_store_streaming(dst, dst_off, from, n);
+            if (!dst.wal_entry) cxl_ssd::persist_fence(streaming_persist_mode());
+        } else {
+            stored = dax_store_nofence(dst, dst_off, from, n);
+            dax_store_fence();
+        }
+        if (!stored) return -1;
+    } else {
+        std::vector<char> buf(n < kCopyChunk ? n : kCopyChunk);
+        for (size_t done = 0; done < n; done += buf.size()) {
+            size_t piece = n - done < buf.size() ? n - done : buf.size();
+            if (dax_load(src, src_off + done, buf.data(), piece) < 0 ||
+                !dax_store_nofence(dst, dst_off + done, buf.data(), piece)) {
+                dax_store_fence();
+                return -1;
+            }
+        }
+        dax_store_fence();
+    }
+    if (dst.wal_entry) dax_wal_extend(dst, dst_off + n);
+    dax_delay(LatOp::WRITE, n, l0);
+    dax_record(src.lat_id, LatOp::READ, l0);
+    dax_record(dst.lat_id, LatOp::WRITE, l0);
+    return n;
+}
+
+// Write to a real fd at out_off, or at its own offset if out_off is -1
+ssize_t real_write_at(int out_fd, const void* buf, size_t n, off_t out_off) {
+    return out_off < 0 ? real_write(out_fd, buf, n) : real_pwrite(out_fd, buf, n, out_off);
+}
+
+// sendfile()/splice()/copy_file_range() from a DAX file to a real fd
+// (socket, pipe, file): one write straight from the region, outside the
+// epoch section as it may block. Returns its result.
+ssize_t dax_send(const DAXMapping& src, off_t src_off, int out_fd, off_t out_off, size_t count) {
+    size_t n = clamp_to_file(src, src_off, count);
+    if (n == 0) return 0;
+    if (!dax_readable_in_place(src)) {
+        std::vector<char> buf(n < kCopyChunk ? n : kCopyChunk);
+        {
+            DaxGuard guard;
+            if (!dax_read_at(src, src_off, buf.data(), buf.size())) return -1;
+        }
+        return real_write_at(out_fd, buf.data(), buf.size(), out_off);
+    }
+    dax_admit(src, n);
+    uint64_t l0 = op_begin();
+    const char* from = static_cast<const char*>(src.base) + src_off;
+    // The write may block on the peer: keep the range mapped without
+    // holding the epoch. A sparse file's chunks stay mapped while src does.
+    if (src.sparse) {
+        if (!dax_ensure(src, src_off, n)) return -1;
+    } else if (!src.region->pin(from, n)) {
+        errno = ENOMEM;
+        return -1;
+    }
+    ssize_t ret = real_write_at(out_fd, from, n, out_off);
+    if (!src.sparse) src.region->unpin(from, n);
+    if (ret > 0) {
+        note_traffic(src, false, ret);
+        dax_delay(LatOp::READ, ret, l0);
+        dax_record(src.lat_id, LatOp::READ, l0);
+    }
+    return ret;
+}
+
+// The same from a real fd into a DAX file, through a bounded buffer read
+// outside the epoch section; in_off is the position to read at, or -1 for the fd's own. A sparse
+// file gets chunks only for the bytes the read returned; what it has no
+// room for is handed back to the fd's offset (a pipe's is lost). Returns
+// the bytes stored, or -1.
+ssize_t dax_receive(int in_fd, off_t in_off, const DAXMapping& dst, off_t dst_off, size_t count) {
+    size_t n = clamp_to_mapping(dst, dst_off, count);
+    if (n == 0) return 0;
+    std::vector<char> buf(n < kCopyChunk ? n : kCopyChunk);
+    ssize_t got = in_off < 0 ? real_read(in_fd, buf.data(), buf.size())
+                             : real_pread(in_fd, buf.data(), buf.size(), in_off);
+    if (got <= 0) return got;
+    DaxGuard guard;
+    ssize_t space = clamp_to_space(dst, dst_off, got);
+    if (space < got && in_off < 0) {
+        int saved = errno;
+        real_lseek(in_fd, (space > 0 ? space : 0) - got, SEEK_CUR);
+        errno = saved;
+    }
+    if (space > 0 && !dax_write_at(dst, dst_off, buf.data(), space)) return -1;
+    return space;
+}
+
+// NUMA node new files named path should live on: the first matching
+// FIO_NUMA_PLACEMENT rule, else the calling thread's node
+int placement_node(const char* path) {
+    for (const PlacementRule& rule : placement_rules) {
+        if (strstr(path, rule.pattern.c_str())) return rule.node;
+    }
+    return cxl_intercept::current_numa_node();
+}
+
+// Find path's extent in the region that holds it, or create it on the
+// preferred node's regions first and spill to the others when they are full
+// (as a sparse file in sparse mode). The open is counted in the region's
+// shared namespace.
+cxl_intercept::DaxRegion* place_dax_file(const char* path, size_t file_size,
+                                         cxl_intercept::DaxExtent& extent) {
+    std::string key = cxl_intercept::catalog_path_key(path);
+    for (int i = 0; i < dax_region_count; i++) {
+        if (dax_regions[i].catalog.acquire_extent(key, file_size, false, extent)) return &dax_regions[i];
+        if (errno != ENOENT) return nullptr;
+    }
+
+    int node = placement_node(path);
+    for (int pass = 0; pass < 2; pass++) {
+        for (int i = 0; i < dax_region_count; i++) {
+            if ((dax_regions[i].node == node) != (pass == 0)) continue;
+            if (dax_regions[i].catalog.acquire_extent(key, file_size, true, extent, sparse_mode)) {
+                return &dax_regions[i];
+            }
+            if (errno != ENOSPC) return nullptr;
+        }
+    }
+    return nullptr;
+}
+
+// True if path names an append-mode file (FIO_DAX_WAL)
+bool is_wal_path(const char* path) {
+    for (const std::string& pattern : wal_patterns) {
+        if (strstr(path, pattern.c_str())) return true;
+    }
+    return false;
+}
+
+// An append-mode file starts empty when created or truncated by open();
+// the reset tail is durable before any append can land
+void dax_wal_open(DAXMapping& mapping, const cxl_intercept::DaxExtent& extent, int flags) {
+    uint64_t* marker = cxl_intercept::DaxCatalog::logical_size(extent.entry, extent.offset);
+    if (!marker) return;
+    std::atomic_ref<uint64_t> tail(*marker);
+    if (extent.created || (flags & O_TRUNC)) {
+        tail.store(0, std::memory_order_relaxed);
+        cxl_ssd::PersistMode mode = streaming_persist_mode();
+        cxl_ssd::persist_flush(marker, sizeof(*marker), mode);
+        cxl_ssd::persist_fence(mode);
+    }
+    mapping.wal_entry = extent.entry;
+}
+
+// Map an intercepted path to a fake fd, creating its extent on first use
+int open_dax_file(const char* pathname, int flags) {
+    uint64_t t0 = trace.begin();
+
+    // Size of newly created files (default 1GB); existing files keep
+    // the extent recorded in the catalog
+    size_t file_size = 1ULL << 30; // 1GB
+    const char* env_file_size = getenv("FIO_FILE_SIZE");
+    if (env_file_size) {
+        file_size = std::stoull(env_file_size);
+    }
+
+    cxl_intercept::DaxExtent extent;
+    cxl_intercept::DaxRegion* region = place_dax_file(pathname, file_size, extent);
+    if (!region) return -1;
+    size_t offset = extent.offset;
+
+    DAXMapping* mapping = new DAXMapping;
+    mapping->sparse = nullptr;
+    if (extent.chunk_map) {
+        mapping->sparse = acquire_sparse_file(region, extent.chunk_map, extent.length);
+        if (!mapping->sparse) {
+            region->catalog.release_extent(extent.ns_slot);
+            delete mapping;
+            errno = ENOMEM;
+            return -1;
+        }
+        mapping->base = mapping->sparse->view;
+    } else {
+        mapping->base = region->base + offset;
+    }
+    mapping->extent = offset;
+    mapping->region = region;
+    mapping->size = extent.length;
+    mapping->path = pathname;
+    mapping->real_fd = -1; // No real file
+    mapping->dirty = nullptr;
+    if (persist_mode == cxl_ssd::PersistMode::LAZY) {
+        mapping->dirty = acquire_dirty_file(region, static_cast<char*>(mapping->base), mapping->size);
+    }
+    mapping->lat_id = 0;
+    mapping->ns_slot = extent.ns_slot;
+    mapping->opener = getpid();
+    mapping->qos_class = qos.classify(pathname);
+    mapping->wal_entry = nullptr;
+    mapping->current_offset = 0;
+    if (is_wal_path(pathname)) dax_wal_open(*mapping, extent, flags);
+
+    int fake_fd = dax_fds.install(mapping);
+    if (fake_fd < 0) {
+        release_dirty_file(mapping->dirty);
+        release_sparse_file(mapping->sparse);
+        release_dax_extent(*mapping);
+        delete mapping;
+        errno = EMFILE;
+        return -1;
+    }
+    // Nobody else knows fake_fd until we return it
+    mapping->lat_id = latency.register_file(fake_fd, mapping->path);
+
+    trace.record(TraceOp::OPEN, fake_fd, offset, extent.length, fake_fd, t0);
+
+    return fake_fd;
+}
+
+// openat()-family names are intercepted when they resolve against the cwd
+bool should_intercept_at(int dirfd, const char* path) {
+    return path && (path[0] == '/' || dirfd == AT_FDCWD) && should_intercept(path);
+}
+
+// An AT_EMPTY_PATH path: "" or, since Linux 6.11, NULL. glibc declares
+// these parameters nonnull, so the pointer goes through an empty asm to
+// keep the compiler from dropping the NULL check.
+bool empty_path(const char* path) {
+    asm("" : "+r"(path));
+    return !path || path[0] == '\0';
+}
+
+// Describe a DAX file as a regular file the size of its extent, so fio
+// sees it as already laid out; its blocks are the bytes it holds in the
+// region (all of them, but for a sparse file)
+void fill_dax_stat(struct stat* st, uint64_t size, uint64_t ino, uint64_t allocated) {
+    memset(st, 0, sizeof(*st));
+    st->st_ino = ino;
+    st->st_mode = S_IFREG | 0644;
+    st->st_nlink = 1;
+    st->st_uid = getuid();
+    st->st_gid = getgid();
+    st->st_size = static_cast<off_t>(size);
+    st->st_blksize = 4096;
+    st->st_blocks = static_cast<blkcnt_t>((allocated + 511) / 512);
+}
+
+void fill_dax_statx(struct statx* stx, uint64_t size, uint64_t ino, uint64_t allocated) {
+    struct stat st;
+    fill_dax_stat(&st, size, ino, allocated);
+    memset(stx, 0, sizeof(*stx));
+    stx->stx_mask = STATX_BASIC_STATS;
+    stx->stx_blksize = st.st_blksize;
+    stx->stx_nlink = st.st_nlink;
+    stx->stx_uid = st.st_uid;
+    stx->stx_gid = st.st_gid;
+    stx->stx_mode = st.st_mode;
+    stx->stx_ino = st.st_ino;
+    stx->stx_size = st.st_size;
+    stx->stx_blocks = st.st_blocks;
+}
+
+// Inode number of an extent: its region index above its offset
+uint64_t dax_ino(const cxl_intercept::DaxRegion* region, size_t offset) {
+    return (static_cast<uint64_t>(region - dax_regions) << 48) | offset;
+}
+
+uint64_t dax_ino(const DAXMapping& mapping) {
+    return dax_ino(mapping.region, mapping.extent);
+}
+
+// Bytes a file of size bytes holds in its region: a sparse file's chunks
+uint64_t dax_allocated(const DAXMapping& mapping, uint64_t size) {
+    if (!mapping.sparse) return size;
+    return mapping.region->catalog.mapped_chunks(mapping.sparse->map) * mapping.sparse->chunk;
+}
+
+// stat() of an intercepted path: 0 if a catalog knows it, -1 (ENOENT) if
+// not, so fio lays the file out through the intercepted open/write
+int stat_dax_path(const char* path, uint64_t* size, uint64_t* ino, uint64_t* allocated) {
+    std::string key = cxl_intercept::catalog_path_key(path);
+    cxl_intercept::DaxExtent extent;
+    for (int i = 0; i < dax_region_count; i++) {
+        if (dax_regions[i].catalog.open_extent(key, 0, false, extent)) {
+            *size = extent.length;
+            if (is_wal_path(path)) {
+                uint64_t* marker = cxl_intercept::DaxCatalog::logical_size(extent.entry, extent.offset);
+                if (marker && *marker < extent.length) *size = *marker;
+            }
+            *ino = dax_ino(&dax_regions[i], extent.offset);
+            *allocated = extent.chunk_map ? dax_regions[i].catalog.mapped_chunks(extent.chunk_map) *
+                                                dax_regions[i].catalog.chunk_size()
+                                          : *size;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+// True if [addr, addr + len) lies inside one region's mapping
+bool in_region_mapping(const void* addr, size_t len) {
+    for (int i = 0; i < dax_region_count; i++) {
+        if (dax_regions[i].contains(addr, len)) return true;
+    }
+    return false;
+}
+
+// True if [addr, addr + len) lies inside one tracked application mapping
+bool in_app_mapping(const void* addr, size_t len) {
+    uintptr_t start = reinterpret_cast<uintptr_t>(addr);
+    std::lock_guard<std::mutex> lk(app_maps_mu);
+    for (const AppMapping& m : app_maps) {
+        if (start >= m.start && start + len <= m.end) return true;
+    }
+    return false;
+}
+
+// Drop [start, end) from the tracked application mappings, splitting
+// entries that are only partially unmapped
+void forget_app_mapping(uintptr_t start, uintptr_t end) {
+    std::lock_guard<std::mutex> lk(app_maps_mu);
+    std::vector<AppMapping> kept;
+    for (const AppMapping& m : app_maps) {
+        if (m.end <= start || m.start >= end) {
+            kept.push_back(m);
+            continue;
+        }
+        if (m.start < start) kept.push_back({m.start, start});
+        if (m.end > end) kept.push_back({end, m.end});
+    }
+    app_maps.swap(kept);
+}
+
+// Track a shared mapping of a fake fd for msync()
+void track_app_mapping(void* p, size_t length) {
+    uintptr_t start = reinterpret_cast<uintptr_t>(p);
+    forget_app_mapping(start, start + length);
+    std::lock_guard<std::mutex> lk(app_maps_mu);
+    app_maps.push_back({start, start + length});
+}
+
+// Track a direct mapping whose windows mmap() pinned
+void track_pinned_mapping(cxl_intercept::DaxRegion* region, const char* p, size_t length) {
+    uintptr_t start = reinterpret_cast<uintptr_t>(p);
+    std::lock_guard<std::mutex> lk(pinned_maps_mu);
+    pinned_maps.push_back({region, start, start + length, {{start, start + length}}});
+}
+
+// munmap() of direct mappings: cut [start, end) out of them, newest first,
+// and unpin those left with nothing mapped. Mapping a file range twice
+// returns the same address twice, so a range inside one live part of a
+// mapping is taken to unmap that mapping alone.
+void unmap_pinned(uintptr_t start, uintptr_t end) {
+    std::lock_guard<std::mutex> lk(pinned_maps_mu);
+    for (size_t i = pinned_maps.size(); i-- > 0;) {
+        PinnedMapping& m = pinned_maps[i];
+        bool overlaps = false, inside = false;
+        std::vector<AppMapping> kept;
+        for (const AppMapping& part : m.live) {
+            if (part.end <= start || part.start >= end) {
+                kept.push_back(part);
+                continue;
+            }
+            overlaps = true;
+            inside = inside || (start >= part.start && end <= part.end);
+            if (part.start < start) kept.push_back({part.start, start});
+            if (part.end > end) kept.push_back({end, part.end});
+        }
+        if (!overlaps) continue;
+        m.live.swap(kept);
+        if (m.live.empty()) {
+            m.region->unpin(reinterpret_cast<const void*>(m.start), m.end - m.start);
+            pinned_maps.erase(pinned_maps.begin() + i);
+        }
+        if (inside) return;
+    }
+}
+
+// mmap() of a sparse file: the chunks the range covers are allocated, then
+// mapped piece by piece into one reservation (at addr with MAP_FIXED)
+void* mmap_sparse_file(const DAXMapping& mapping, void* addr, size_t length, int prot,
+                       int flags, off_t offset) {
+    if (clamp_to_space(mapping, offset, length) != static_cast<ssize_t>(length)) {
+        errno = ENOMEM;
+        return MAP_FAILED;
+    }
+    const cxl_intercept::DaxRegion& region = *mapping.region;
+    int type = flags & MAP_TYPE;
+    bool shared = type == MAP_SHARED || type == MAP_SHARED_VALIDATE;
+    if (!region.map_sync) {
+        flags &= ~MAP_SYNC;
+        if (type == MAP_SHARED_VALIDATE) flags = (flags & ~MAP_TYPE) | MAP_SHARED;
+    }
+    char* p = static_cast<char*>(real_mmap(addr, length, PROT_NONE,
+                                           (flags & (MAP_FIXED | MAP_FIXED_NOREPLACE)) | MAP_PRIVATE |
+                                               MAP_ANONYMOUS | MAP_NORESERVE, -1, 0));
+    if (p == MAP_FAILED) return p;
+    SparseFile* file = mapping.sparse;
+    for (size_t done = 0; done < length;) {
+        size_t pos = offset + done;
+        size_t in = pos % file->chunk;
+        size_t piece = file->chunk - in < length - done ? file->chunk - in : length - done;
+        uint64_t at = std::atomic_ref<uint32_t>(file->map[pos / file->chunk]).load(std::memory_order_acquire) *
+                      uint64_t(file->chunk) + in;
+        if (real_mmap(p + done, piece, prot, (flags & ~MAP_FIXED_NOREPLACE) | MAP_FIXED, region.fd, at) ==
+            MAP_FAILED) {
+            int err = errno;
+            real_munmap(p, length);
+            errno = err;
+            return MAP_FAILED;
+        }
+        done += piece;
+    }
+    if (shared) track_app_mapping(p, length);
+    return p;
+}
+
+// mmap() of a fake fd. Shared read/write mappings return a pointer straight
+// into the region's mapping, whose windows then stay mapped until munmap();
+// anything else (MAP_FIXED, other protections, MAP_PRIVATE) maps the DAX fd
+// at the extent offset. A sparse file's chunks always get a new mapping.
+// Either way the mapping sees the region, so the range leaves the DRAM
+// cache for good: its cached pages are written back and dropped first.
+void* mmap_dax_file(const DAXMapping& mapping, void* addr, size_t length, int prot,
+                    int flags, off_t offset) {
+    long page = sysconf(_SC_PAGESIZE);
+    if (length == 0 || offset < 0 || (offset & (page - 1)) != 0) {
+        errno = EINVAL;
+        return MAP_FAILED;
+    }
+    // Never expose a neighbouring file's extent
+    if (static_cast<size_t>(offset) > mapping.size || length > mapping.size - offset) {
+        errno = ENXIO;
+        return MAP_FAILED;
+    }
+
+    if (dram_cache.enabled()) {
+        char* start = static_cast<char*>(mapping.base) + offset;
+        {
+            std::lock_guard<std::mutex> lk(uncached_mu);
+            uintptr_t lo = reinterpret_cast<uintptr_t>(start);
+            uncached.push_back({lo, lo + length});
+            any_uncached.store(true, std::memory_order_release);
+        }
+        dram_cache.write_back(start, length, true);
+    }
+    if (mapping.sparse) return mmap_sparse_file(mapping, addr, length, prot, flags, offset);
+
+    char* target = static_cast<char*>(mapping.base) + offset;
+    int type = flags & MAP_TYPE;
+    bool shared = type == MAP_SHARED || type == MAP_SHARED_VALIDATE;
+    // Stores through the mapping bypass the checksums
+    if (shared && (prot & PROT_WRITE) && mapping.region->integrity.enabled()) {
+        mapping.region->integrity.exclude(target, length);
+    }
+    // and the zero map, and loads would see the stale device copy
+    cxl_intercept::DaxRegion* region_ptr = mapping.region;
+    if (!region_ptr->catalog.zero_map.materialize(target, length, [region_ptr](const char* p, size_t n) {
+            return region_ptr->ensure(p, n);
+        })) {
+        return MAP_FAILED;
+    }
+    if (shared && !(flags & (MAP_FIXED | MAP_FIXED_NOREPLACE)) &&
+        prot == (PROT_READ | PROT_WRITE)) {
+        if (!mapping.region->pin(target, length)) {
+            errno = ENOMEM;
+            return MAP_FAILED;
+        }
+        track_pinned_mapping(mapping.region, target, length);
+        return target;
+    }
+
+    // MAP_SYNC is only valid on a real DAX device
+    const cxl_intercept::DaxRegion& region = *mapping.region;
+    if (!region.map_sync) {
+        flags &= ~MAP_SYNC;
+        if (type == MAP_SHARED_VALIDATE) flags = (flags & ~MAP_TYPE) | MAP_SHARED;
+    }
+    off_t region_offset = target - region.base;
+    void* p = real_mmap(addr, length, prot, flags, region.fd, region_offset);
+    if (p != MAP_FAILED && shared) track_app_mapping(p, length);
+    return p;
+}
+
+// Kernel AIO through libaio when it is loaded, raw syscalls otherwise
+int sys_io_setup(int nr, aio_context_t* ctx) {
+    if (real_io_setup) return real_io_setup(nr, ctx);
+    return syscall(SYS_io_setup, nr, ctx) < 0 ? -errno : 0;
+}
+
+int sys_io_destroy(aio_context_t ctx) {
+    if (real_io_destroy) return real_io_destroy(ctx);
+    return syscall(SYS_io_destroy, ctx) < 0 ? -errno : 0;
+}
+
+int sys_io_submit(aio_context_t ctx, long nr, struct iocb** iocbs) {
+    if (real_io_submit) return real_io_submit(ctx, nr, iocbs);
+    long ret = syscall(SYS_io_submit, ctx, nr, iocbs);
+    return ret < 0 ? -errno : static_cast<int>(ret);
+}
+
+int sys_io_getevents(aio_context_t ctx, long min_nr, long nr, struct io_event* events,
+                     struct timespec* timeout) {
+    if (real_io_getevents) return real_io_getevents(ctx, min_nr, nr, events, timeout);
+    long ret = syscall(SYS_io_getevents, ctx, min_nr, nr, events, timeout);
+    return ret < 0 ? -errno : static_cast<int>(ret);
+}
+
+int sys_io_cancel(aio_context_t ctx, struct iocb* iocb, struct io_event* result) {
+    if (real_io_cancel) return real_io_cancel(ctx, iocb, result);
+    return syscall(SYS_io_cancel, ctx, iocb, result) < 0 ? -errno : 0;
+}
+
+// The context behind id, held for one io_* call: io_destroy() waits for
+// the call to return before it frees the context
+class AioRef {
+public:
+    explicit AioRef(aio_context_t id) {
+        if (!aio_own_id(id)) return;
+        EpochGuard guard(dax_epoch);
+        ctx_ = aio_contexts.lookup(static_cast<int>(id));
+        // io_destroy() waits for users only after this section ends
+        if (ctx_) ctx_->users.fetch_add(1, std::memory_order_relaxed);
+    }
+    ~AioRef() {
+        if (ctx_) ctx_->users.fetch_sub(1, std::memory_order_release);
+    }
+    AioRef(const AioRef&) = delete;
+    AioRef& operator=(const AioRef&) = delete;
+
+    AioContext* get() const { return ctx_; }
+
+private:
+    AioContext* ctx_ = nullptr;
+};
+
+// Copy workers for a region, created on first use and shared with the
+// other regions on its node
+cxl_intercept::CopyWorkerPool* get_aio_pool(int region) {
+    cxl_intercept::CopyWorkerPool* pool = aio_pools[region].load(std::memory_order_acquire);
+    if (pool) return pool;
+
+    std::lock_guard<std::mutex> lk(aio_pool_mu);
+    pool = aio_pools[region].load(std::memory_order_relaxed);
+    if (pool) return pool;
+    int node = dax_regions[region].node;
+    for (int i = 0; i < dax_region_count && !pool; i++) {
+        if (dax_regions[i].node == node) pool = aio_pools[i].load(std::memory_order_relaxed);
+    }
+    if (!pool) {
+        unsigned workers = kDefaultAioWorkers;
+        if (const char* env = getenv("FIO_AIO_WORKERS")) workers = strtoul(env, nullptr, 0);
+        cpu_set_t cpus;
+        bool pin = cxl_intercept::node_cpuset(node, &cpus);
+        pool = new cxl_intercept::CopyWorkerPool(workers, 4096, pin ? &cpus : nullptr);
+    }
+    aio_pools[region].store(pool, std::memory_order_release);
+    return pool;
+}
+
+// Index of the region an iocb's file lives in, or -1 for non-DAX fds
+int iocb_region(const struct iocb* cb) {
+    int fd = static_cast<int>(cb->aio_fildes);
+    if (!dax_fds.in_range(fd)) return -1;
+    DaxGuard guard;
+    DAXMapping* mapping = dax_fds.lookup(fd);
+    return mapping ? static_cast<int>(mapping->region - dax_regions) : -1;
+}
+
+// Execute one DAX iocb; returns the io_event result (bytes or -errno)
+long aio_execute(const struct iocb* cb) {
+    int fd = static_cast<int>(cb->aio_fildes);
+    DaxGuard guard;
+    DAXMapping* mapping = dax_fds.lookup(fd);
+    if (!mapping) return -EBADF;
+
+    off_t offset = static_cast<off_t>(cb->aio_offset);
+    void* buf = reinterpret_cast<void*>(static_cast<uintptr_t>(cb->aio_buf));
+    switch (cb->aio_lio_opcode) {
+        case IOCB_CMD_PREAD: {
+            size_t n = clamp_to_file(*mapping, offset, cb->aio_nbytes);
+            if (n && !dax_read_at(*mapping, offset, buf, n)) return -errno;
+            return static_cast<long>(n);
+        }
+        case IOCB_CMD_PWRITE: {
+            ssize_t n = clamp_to_space(*mapping, offset, cb->aio_nbytes);
+            if (n < 0) return -errno;
+            if (n && !dax_write_at(*mapping, offset, buf, n)) return -errno;
+            return static_cast<long>(n);
+        }
+        case IOCB_CMD_PREADV:
+        case IOCB_CMD_PWRITEV: {
+            const struct iovec* iov = static_cast<const struct iovec*>(buf);
+            int iovcnt = static_cast<int>(cb->aio_nbytes);
+            ssize_t total = iov_total(iov, iovcnt);
+            if (total < 0) return -EINVAL;
+            if (offset < 0) return -EINVAL;
+            ssize_t n = cb->aio_lio_opcode == IOCB_CMD_PREADV
+                ? dax_readv_at(*mapping, iov, iovcnt, total, offset)
+                : dax_writev_at(*mapping, iov, iovcnt, total, offset);
+            return n < 0 ? -errno : static_cast<long>(n);
+        }
+        case IOCB_CMD_FSYNC:
+        case IOCB_CMD_FDSYNC:
+            // Eager writes are durable when they complete; lazy ones are
+            // written back here
+            dax_sync(*mapping);
+            return 0;
+        case IOCB_CMD_NOOP:
+            return 0;
+        default:
+            return -EINVAL;
+    }
+}
+
+// Copy-worker task: run the iocb and post its completion
+void aio_complete(void* ctx_ptr, void* cb_ptr) {
+    AioContext* ctx = static_cast<AioContext*>(ctx_ptr);
+    struct iocb* cb = static_cast<struct iocb*>(cb_ptr);
+
+    uint64_t t0 = trace.begin();
+    long res = aio_execute(cb);
+    bool is_write = cb->aio_lio_opcode == IOCB_CMD_PWRITE || cb->aio_lio_opcode == IOCB_CMD_PWRITEV;
+    trace.record(is_write ? TraceOp::AIO_WRITE : TraceOp::AIO_READ, static_cast<int>(cb->aio_fildes),
+                 cb->aio_offset, cb->aio_nbytes, res, t0);
+
+    struct io_event ev{};
+    ev.data = cb->aio_data;
+    ev.obj = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(cb));
+    ev.res = res;
+    // queued <= max_events <= ring capacity, so this cannot stay full
+    while (!ctx->completions.try_push(ev)) _mm_pause();
+
+    if (cb->aio_flags & IOCB_FLAG_RESFD) {
+        uint64_t one = 1;
+        real_write(static_cast<int>(cb->aio_resfd), &one, sizeof(one));
+    }
+
+    ctx->completion_seq.fetch_add(1, std::memory_order_release);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (ctx->waiters.load(std::memory_order_relaxed) > 0) {
+        cxl_intercept::futex_wake(&ctx->completion_seq, INT32_MAX);
+    }
+    // Last touch of ctx: io_destroy() may free it once running drains
+    ctx->running.fetch_sub(1, std::memory_order_release);
+}
+
+// Forward non-DAX iocbs to the kernel context, creating it on first use
+int aio_submit_passthrough(AioContext* ctx, long nr, struct iocb** iocbs) {
+    {
+        std::lock_guard<std::mutex> lk(ctx->real_mu);
+        if (!ctx->real_ctx) {
+            int ret = sys_io_setup(static_cast<int>(ctx->max_events), &ctx->real_ctx);
+            if (ret < 0) return ret;
+        }
+    }
+    int ret = sys_io_submit(ctx->real_ctx, nr, iocbs);
+    if (ret > 0) ctx->real_inflight.fetch_add(ret, std::memory_order_release);
+    return ret;
+}
+
+long aio_reap(AioContext* ctx, struct io_event* events, long nr) {
+    long got = 0;
+    while (got < nr && ctx->completions.try_pop(events[got])) got++;
+    if (got) ctx->queued.fetch_sub(got, std::memory_order_relaxed);
+    return got;
+}
+
+int64_t monotonic_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// copy_file_range()/sendfile()/splice() with a DAX file on one or both
+// sides, each held by a DaxRef. A side given no offset works at, and
+// advances, its fd's own.
+ssize_t dax_transfer(TraceOp op, int in_fd, DAXMapping* in, off64_t* in_off,
+                     int out_fd, DAXMapping* out, off64_t* out_off, size_t len) {
+    uint64_t t0 = trace.begin();
+    if ((in_off && *in_off < 0) || (out_off && *out_off < 0)) {
+        errno = EINVAL;
+        return -1;
+    }
+    off_t src = in_off ? *in_off : in ? in->current_offset : -1;
+    off_t dst = out_off ? *out_off : out ? out->current_offset : -1;
+    ssize_t ret;
+    if (in && out) {
+        // Like the kernel, refuse overlapping ranges of one file
+        if (in->base == out->base && static_cast<size_t>(src < dst ? dst - src : src - dst) < len) {
+            errno = EINVAL;
+            return -1;
+        }
+        DaxGuard guard;
+        ret = dax_copy_range(*in, src, *out, dst, len);
+    } else if (in) {
+        ret = dax_send(*in, src, out_fd, dst, len);
+    } else {
+        ret = dax_receive(in_fd, src, *out, dst, len);
+    }
+    if (ret > 0) {
+        if (in_off) *in_off += ret;
+        else if (in) in->current_offset = src + ret;
+        if (out_off) *out_off += ret;
+        else if (out) out->current_offset = dst + ret;
+    }
+    trace.record(op, out ? out_fd : in_fd, out ? dst : src, len, ret, t0);
+    return ret;
+}
+
+// Drop a reference to a mapping no longer in the fd table; the last one
+// writes back its cached pages and frees it. Called outside any epoch
+// section.
+void put_mapping(DAXMapping* mapping) {
+    if (mapping->refs.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+    if (dram_cache.enabled()) {
+        // Its pages may be filled or written back through this mapping
+        EpochGuard guard(dax_epoch);
+        dram_cache.write_back(static_cast<char*>(mapping->base), mapping->size, true);
+    }
+    release_dirty_file(mapping->dirty);
+    release_sparse_file(mapping->sparse);
+    release_dax_extent(*mapping);
+    delete mapping;
+}
+
+// The DAX file behind fd, held past the epoch section for a transfer that
+// blocks on a pipe or socket: a close() meanwhile only drops the fd
+class DaxRef {
+public:
+    explicit DaxRef(int fd) {
+        if (!dax_fds.in_range(fd)) return;
+        EpochGuard guard(dax_epoch);
+        mapping_ = dax_fds.lookup(fd);
+        // close() frees it only after this section ends
+        if (mapping_) mapping_->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+    ~DaxRef() {
+        if (mapping_) put_mapping(mapping_);
+    }
+    DaxRef(const DaxRef&) = delete;
+    DaxRef& operator=(const DaxRef&) = delete;
+
+    DAXMapping* get() const { return mapping_; }
+
+private:
+    DAXMapping* mapping_ = nullptr;
+};
+
+} // anonymous namespace
+
+// Intercepted functions
+extern "C" {
+
+int open(const char* pathname, int flags, ...) {
+    mode_t mode = 0;
+    if (flags & O_CREAT) {
+        va_list args;
+        va_start(args, flags);
+        mode = va_arg(args, mode_t);
+        va_end(args);
+    }
+
+    if (should_intercept(pathname)) {
+        return open_dax_file(pathname, flags);
+    }
+
+    return real_open(pathname, flags, mode);
+}
+
+int open64(const char* pathname, int flags, ...) {
+    mode_t mode = 0;
+    if (flags & O_CREAT) {
+        va_list args;
+        va_start(args, flags);
+        mode = va_arg(args, mode_t);
+        va_end(args);
+    }
+
+    if (should_intercept(pathname)) {
+        return open_dax_file(pathname, flags);
+    }
+
+    return real_open64(pathname, flags, mode);
+}
+
+int openat(int dirfd, const char* pathname, int flags, ...) {
+    mode_t mode = 0;
+    if (flags & O_CREAT) {
+        va_list args;
+        va_start(args, flags);
+        mode = va_arg(args, mode_t);
+        va_end(args);
+    }
+
+    if (should_intercept_at(dirfd, pathname)) {
+        return open_dax_file(pathname, flags);
+    }
+
+    return real_openat(dirfd, pathname, flags, mode);
+}
+
+int openat64(int dirfd, const char* pathname, int flags, ...) {
+    mode_t mode = 0;
+    if (flags & O_CREAT) {
+        va_list args;
+        va_start(args, flags);
+        mode = va_arg(args, mode_t);
+        va_end(args);
+    }
+
+    if (should_intercept_at(dirfd, pathname)) {
+        return open_dax_file(pathname, flags);
+    }
+
+    return real_openat64(dirfd, pathname, flags, mode);
+}
+
+int close(int fd) {
+    DAXMapping* mapping = dax_fds.remove(fd);
+    if (mapping) {
+        uint64_t t0 = trace.begin();
+        if (write_combiner.enabled()) write_combiner.drain(static_cast<char*>(mapping->base), mapping->size);
+        // Readers may still hold the pointer; free it after a grace period,
+        // or once the last transfer holding it returns
+        dax_epoch.synchronize();
+        put_mapping(mapping);
+        trace.record(TraceOp::CLOSE, fd, 0, 0, 0, t0);
+        return 0;
+    }
+    return real_close(fd);
+}
+
+ssize_t read(int fd, void* buf, size_t count) {
+    if (dax_fds.in_range(fd)) {
+        DaxGuard guard;
+        DAXMapping* mapping = dax_fds.lookup(fd);
+        if (mapping) {
+            uint64_t t0 = trace.begin();
+            off_t pos = mapping->current_offset;
+            size_t to_read = clamp_to_file(*mapping, pos, count);
+
+            if (to_read > 0) {
+                if (!dax_read_at(*mapping, pos, buf, to_read)) return -1;
+                mapping->current_offset = pos + to_read;
+            }
+
+            trace.record(TraceOp::READ, fd, pos, count, to_read, t0);
+
+            return to_read;
+        }
+    }
+    return real_read(fd, buf, count);
+}
+
+ssize_t write(int fd, const void* buf, size_t count) {
+    if (dax_fds.in_range(fd)) {
+        DaxGuard guard;
+        DAXMapping* mapping = dax_fds.lookup(fd);
+        if (mapping) {
+            uint64_t t0 = trace.begin();
+            off_t pos = mapping->current_offset;
+            ssize_t to_write = clamp_to_space(*mapping, pos, count);
+            if (to_write < 0) return -1;
+
+            if (to_write > 0) {
+                if (!dax_write_at(*mapping, pos, buf, to_write)) return -1;
+                mapping->current_offset = pos + to_write;
+            }
+
+            trace.record(TraceOp::WRITE, fd, pos, count, to_write, t0);
+
+            return to_write;
+        }
+    }
+    return real_write(fd, buf, count);
+}
+
+ssize_t pread(int fd, void* buf, size_t count, off_t offset) {
+    if (dax_fds.in_range(fd)) {
+        DaxGuard guard;
+        DAXMapping* mapping = dax_fds.lookup(fd);
+        if (mapping) {
+            uint64_t t0 = trace.begin();
+            size_t to_read = clamp_to_file(*mapping, offset, count);
+
+            if (to_read > 0 && !dax_read_at(*mapping, offset, buf, to_read)) return -1;
+
+            trace.record(TraceOp::PREAD, fd, offset, count, to_read, t0);
+
+            return to_read;
+        }
+    }
+    return real_pread(fd, buf, count, offset);
+}
+
+ssize_t pwrite(int fd, const void* buf, size_t count, off_t offset) {
+    if (dax_fds.in_range(fd)) {
+        DaxGuard guard;
+        DAXMapping* mapping = dax_fds.lookup(fd);
+        if (mapping) {
+            uint64_t t0 = trace.begin();
+            ssize_t to_write = clamp_to_space(*mapping, offset, count);
+            if (to_write < 0) return -1;
+
+            if (to_write > 0 && !dax_write_at(*mapping, offset, buf, to_write)) return -1;
+
+            trace.record(TraceOp::PWRITE, fd, offset, count, to_write, t0);
+
+            return to_write;
+        }
+    }
+    return real_pwrite(fd, buf, count, offset);
+}
+
+ssize_t pread64(int fd, void* buf, size_t count, off64_t offset) {
+    if (dax_fds.in_range(fd)) return pread(fd, buf, count, offset);
+    return real_pread64(fd, buf, count, offset);
+}
+
+ssize_t pwrite64(int fd, const void* buf, size_t count, off64_t offset) {
+    if (dax_fds.in_range(fd)) return pwrite(fd, buf, count, offset);
+    return real_pwrite64(fd, buf, count, offset);
+}
+
+ssize_t readv(int fd, const struct iovec* iov, int iovcnt) {
+    if (dax_fds.in_range(fd)) {
+        DaxGuard guard;
+        DAXMapping* mapping = dax_fds.lookup(fd);
+        if (mapping) {
+            uint64_t t0 = trace.begin();
+            ssize_t total = iov_total(iov, iovcnt);
+            if (total < 0) return -1;
+            off_t pos = mapping->current_offset;
+            ssize_t done = dax_readv_at(*mapping, iov, iovcnt, total, pos);
+            if (done < 0) return -1;
+            mapping->current_offset = pos + done;
+            trace.record(TraceOp::PREADV, fd, pos, total, done, t0);
+            return done;
+        }
+    }
+    return real_readv(fd, iov, iovcnt);
+}
+
+ssize_t writev(int fd, const struct iovec* iov, int iovcnt) {
+    if (dax_fds.in_range(fd)) {
+        DaxGuard guard;
+        DAXMapping* mapping = dax_fds.lookup(fd);
+        if (mapping) {
+            uint64_t t0 = trace.begin();
+            ssize_t total = iov_total(iov, iovcnt);
+            if (total < 0) return -1;
+            off_t pos = mapping->current_offset;
+            ssize_t done = dax_writev_at(*mapping, iov, iovcnt, total, pos);
+            if (done < 0) return -1;
+            mapping->current_offset = pos + done;
+            trace.record(TraceOp::PWRITEV, fd, pos, total, done, t0);
+            return done;
+        }
+    }
+    return real_writev(fd, iov, iovcnt);
+}
+
+ssize_t preadv2(int fd, const struct iovec* iov, int iovcnt, off_t offset, int flags) {
+    if (dax_fds.in_range(fd)) {
+        DaxGuard guard;
+        DAXMapping* mapping = dax_fds.lookup(fd);
+        if (mapping) {
+            uint64_t t0 = trace.begin();
+            ssize_t total = iov_total(iov, iovcnt);
+            if (total < 0) return -1;
+            // RWF_* hints have no meaning for a mapping; offset -1 means
+            // "use and advance the file position"
+            off_t pos = offset == -1 ? mapping->current_offset : offset;
+            if (pos < 0) {
+                errno = EINVAL;
+                return -1;
+            }
+            ssize_t done = dax_readv_at(*mapping, iov, iovcnt, total, pos);
+            if (done < 0) return -1;
+            if (offset == -1) mapping->current_offset = pos + done;
+            trace.record(TraceOp::PREADV, fd, pos, total, done, t0);
+            return done;
+        }
+    }
+    return real_preadv2(fd, iov, iovcnt, offset, flags);
+}
+
+ssize_t pwritev2(int fd, const struct iovec* iov, int iovcnt, off_t offset, int flags) {
+    if (dax_fds.in_range(fd)) {
+        DaxGuard guard;
+        DAXMapping* mapping = dax_fds.lookup(fd);
+        if (mapping) {
+            uint64_t t0 = trace.begin();
+            ssize_t total = iov_total(iov, iovcnt);
+            if (total < 0) return -1;
+            off_t pos = offset == -1 ? mapping->current_offset : offset;
+            if (pos < 0) {
+                errno = EINVAL;
+                return -1;
+            }
+            ssize_t done = dax_writev_at(*mapping, iov, iovcnt, total, pos);
+            if (done < 0) return -1;
+            if (offset == -1) mapping->current_offset = pos + done;
+            trace.record(TraceOp::PWRITEV, fd, pos, total, done, t0);
+            return done;
+        }
+    }
+    return real_pwritev2(fd, iov, iovcnt, offset, flags);
+}
+
+ssize_t preadv(int fd, const struct iovec* iov, int iovcnt, off_t offset) {
+    if (dax_fds.in_range(fd)) {
+        if (offset < 0) {
+            errno = EINVAL;
+            return -1;
+        }
+        return preadv2(fd, iov, iovcnt, offset, 0);
+    }
+    return real_preadv(fd, iov, iovcnt, offset);
+}
+
+ssize_t pwritev(int fd, const struct iovec* iov, int iovcnt, off_t offset) {
+    if (dax_fds.in_range(fd)) {
+        if (offset < 0) {
+            errno = EINVAL;
+            return -1;
+        }
+        return pwritev2(fd, iov, iovcnt, offset, 0);
+    }
+    return real_pwritev(fd, iov, iovcnt, offset);
+}
+
+// On LP64 the *64 variants are the same calls under another name
+ssize_t preadv64(int fd, const struct iovec* iov, int iovcnt, off64_t offset) {
+    return preadv(fd, iov, iovcnt, offset);
+}
+
+ssize_t pwritev64(int fd, const struct iovec* iov, int iovcnt, off64_t offset) {
+    return pwritev(fd, iov, iovcnt, offset);
+}
+
+ssize_t preadv64v2(int fd, const struct iovec* iov, int iovcnt, off64_t offset, int flags) {
+    return preadv2(fd, iov, iovcnt, offset, flags);
+}
+
+ssize_t pwritev64v2(int fd, const struct iovec* iov, int iovcnt, off64_t offset, int flags) {
+    return pwritev2(fd, iov, iovcnt, offset, flags);
+}
+
+int fsync(int fd) {
+    if (dax_fds.in_range(fd)) {
+        DaxGuard guard;
+        DAXMapping* mapping = dax_fds.lookup(fd);
+        if (mapping) {
+            uint64_t t0 = trace.begin();
+            // Eager writes are already durable; lazy ones are written back now
+            size_t flushed = dax_sync(*mapping);
+            trace.record(TraceOp::FSYNC, fd, 0, flushed, 0, t0);
+            return 0;
+        }
+    }
+    return real_fsync(fd);
+}
+
+int fdatasync(int fd) {
+    if (dax_fds.in_range(fd)) {
+        DaxGuard guard;
+        DAXMapping* mapping = dax_fds.lookup(fd);
+        if (mapping) {
+            uint64_t t0 = trace.begin();
+            size_t flushed = dax_sync(*mapping);
+            trace.record(TraceOp::FDATASYNC, fd, 0, flushed, 0, t0);
+            return 0;
+        }
+    }
+    return real_fdatasync(fd);
+}
+
+int sync_file_range(int fd, off64_t offset, off64_t nbytes, unsigned int flags) {
+    if (dax_fds.in_range(fd)) {
+        DaxGuard guard;
+        DAXMapping* mapping = dax_fds.lookup(fd);
+        if (mapping) {
+            if (offset < 0 || nbytes < 0) {
+                errno = EINVAL;
+                return -1;
+            }
+            uint64_t t0 = trace.begin();
+            size_t flushed = 0;
+            if (flags & SYNC_FILE_RANGE_WRITE) {
+                flushed = dax_sync(*mapping, offset, nbytes == 0 ? SIZE_MAX : static_cast<size_t>(nbytes));
+            }
+            trace.record(TraceOp::SYNC_FILE_RANGE, fd, offset, nbytes, flushed, t0);
+            return 0;
+        }
+    }
+    return real_sync_file_range(fd, offset, nbytes, flags);
+}
+
+ssize_t copy_file_range(int fd_in, off64_t* off_in, int fd_out, off64_t* off_out, size_t len,
+                        unsigned int flags) {
+    if (dax_fds.in_range(fd_in) || dax_fds.in_range(fd_out)) {
+        DaxWaitScope waits;
+        DaxRef in(fd_in), out(fd_out);
+        if (in.get() || out.get()) {
+            if (flags) {
+                errno = EINVAL;
+                return -1;
+            }
+            return dax_transfer(TraceOp::COPY_FILE_RANGE, fd_in, in.get(), off_in, fd_out, out.get(), off_out, len);
+        }
+    }
+    return real_copy_file_range(fd_in, off_in, fd_out, off_out, len, flags);
+}
+
+ssize_t sendfile(int out_fd, int in_fd, off_t* offset, size_t count) {
+    if (dax_fds.in_range(in_fd) || dax_fds.in_range(out_fd)) {
+        DaxWaitScope waits;
+        DaxRef in(in_fd), out(out_fd);
+        if (in.get() || out.get()) {
+            return dax_transfer(TraceOp::SENDFILE, in_fd, in.get(), offset, out_fd, out.get(), nullptr, count);
+        }
+    }
+    return real_sendfile(out_fd, in_fd, offset, count);
+}
+
+ssize_t sendfile64(int out_fd, int in_fd, off64_t* offset, size_t count) {
+    if (dax_fds.in_range(in_fd) || dax_fds.in_range(out_fd)) return sendfile(out_fd, in_fd, offset, count);
+    return real_sendfile64(out_fd, in_fd, offset, count);
+}
+
+// One side is a pipe; the DAX side is read or written directly, the pipe
+// through read()/write()
+ssize_t splice(int fd_in, off64_t* off_in, int fd_out, off64_t* off_out, size_t len, unsigned int flags) {
+    if (dax_fds.in_range(fd_in) || dax_fds.in_range(fd_out)) {
+        DaxWaitScope waits;
+        DaxRef in(fd_in), out(fd_out);
+        if (in.get() || out.get()) {
+            if ((!in.get() && off_in) || (!out.get() && off_out)) {
+                errno = ESPIPE;
+                return -1;
+            }
+            return dax_transfer(TraceOp::SPLICE, fd_in, in.get(), off_in, fd_out, out.get(), off_out, len);
+        }
+    }
+    return real_splice(fd_in, off_in, fd_out, off_out, len, flags);
+}
+
+off_t lseek(int fd, off_t offset, int whence) {
+    if (dax_fds.in_range(fd)) {
+        DaxGuard guard;
+        DAXMapping* mapping = dax_fds.lookup(fd);
+        if (mapping) {
+            uint64_t t0 = trace.begin();
+            off_t new_offset = 0;
+            switch (whence) {
+                case SEEK_SET:
+                    new_offset = offset;
+                    break;
+                case SEEK_CUR:
+                    new_offset = mapping->current_offset + offset;
+                    break;
+                case SEEK_END:
+                    new_offset = dax_file_size(*mapping) + offset;
+                    break;
+                default:
+                    errno = EINVAL;
+                    return -1;
+            }
+
+            if (new_offset < 0) {
+                errno = EINVAL;
+                return -1;
+            }
+
+            mapping->current_offset = new_offset;
+
+            trace.record(TraceOp::LSEEK, fd, offset, whence, new_offset, t0);
+
+            return new_offset;
+        }
+    }
+    return real_lseek(fd, offset, whence);
+}
+
+int ftruncate(int fd, off_t length) {
+    if (dax_fds.in_range(fd)) {
+        DaxGuard guard;
+        DAXMapping* mapping = dax_fds.lookup(fd);
+        if (mapping) {
+            uint64_t t0 = trace.begin();
+            // DAX mapping size is fixed; an append-mode file moves its tail
+            if (uint64_t* marker = dax_wal_marker(*mapping)) {
+                uint64_t size = length < 0 ? 0 : static_cast<uint64_t>(length);
+                if (size > mapping->size) size = mapping->size;
+                std::atomic_ref<uint64_t>(*marker).store(size, std::memory_order_relaxed);
+                cxl_ssd::PersistMode mode = streaming_persist_mode();
+                cxl_ssd::persist_flush(marker, sizeof(*marker), mode);
+                cxl_ssd::persist_fence(mode);
+            }
+            trace.record(TraceOp::FTRUNCATE, fd, length, 0, 0, t0);
+            return 0;
+        }
+    }
+    return real_ftruncate(fd, length);
+}
+
+off64_t lseek64(int fd, off64_t offset, int whence) {
+    if (dax_fds.in_range(fd)) return lseek(fd, offset, whence);
+    return real_lseek64(fd, offset, whence);
+}
+
+int ftruncate64(int fd, off64_t length) {
+    if (dax_fds.in_range(fd)) return ftruncate(fd, length);
+    return real_ftruncate64(fd, length);
+}
+
+int fstat(int fd, struct stat* st) {
+    if (dax_fds.in_range(fd)) {
+        DaxGuard guard;
+        DAXMapping* mapping = dax_fds.lookup(fd);
+        if (mapping) {
+            uint64_t t0 = trace.begin();
+            size_t size = dax_file_size(*mapping);
+            fill_dax_stat(st, size, dax_ino(*mapping), dax_allocated(*mapping, size));
+            trace.record(TraceOp::FSTAT, fd, 0, 0, size, t0);
+            return 0;
+        }
+    }
+    return real_fstat(fd, st);
+}
+
+int fstat64(int fd, struct stat64* st) {
+    return fstat(fd, reinterpret_cast<struct stat*>(st));
+}
+
+int stat(const char* pathname, struct stat* st) {
+    if (should_intercept(pathname)) {
+        uint64_t size, ino, allocated;
+        if (stat_dax_path(pathname, &size, &ino, &allocated) == 0) {
+            fill_dax_stat(st, size, ino, allocated);
+            return 0;
+        }
+    }
+    return real_stat(pathname, st);
+}
+
+int stat64(const char* pathname, struct stat64* st) {
+    return stat(pathname, reinterpret_cast<struct stat*>(st));
+}
+
+int lstat(const char* pathname, struct stat* st) {
+    if (should_intercept(pathname)) {
+        uint64_t size, ino, allocated;
+        if (stat_dax_path(pathname, &size, &ino, &allocated) == 0) {
+            fill_dax_stat(st, size, ino, allocated);
+            return 0;
+        }
+    }
+    return real_lstat(pathname, st);
+}
+
+int lstat64(const char* pathname, struct stat64* st) {
+    return lstat(pathname, reinterpret_cast<struct stat*>(st));
+}
+
+int fstatat(int dirfd, const char* pathname, struct stat* st, int flags) {
+    if ((flags & AT_EMPTY_PATH) && empty_path(pathname)) {
+        if (dax_fds.in_range(dirfd)) return fstat(dirfd, st);
+    } else if (should_intercept_at(dirfd, pathname)) {
+        uint64_t size, ino, allocated;
+        if (stat_dax_path(pathname, &size, &ino, &allocated) == 0) {
+            fill_dax_stat(st, size, ino, allocated);
+            return 0;
+        }
+    }
+    return real_fstatat(dirfd, pathname, st, flags);
+}
+
+int fstatat64(int dirfd, const char* pathname, struct stat64* st, int flags) {
+    return fstatat(dirfd, pathname, reinterpret_cast<struct stat*>(st), flags);
+}
+
+int statx(int dirfd, const char* pathname, int flags, unsigned int mask, struct statx* stx) {
+    if ((flags & AT_EMPTY_PATH) && empty_path(pathname)) {
+        if (dax_fds.in_range(dirfd)) {
+            DaxGuard guard;
+            DAXMapping* mapping = dax_fds.lookup(dirfd);
+            if (mapping) {
+                size_t size = dax_file_size(*mapping);
+                fill_dax_statx(stx, size, dax_ino(*mapping), dax_allocated(*mapping, size));
+                return 0;
+            }
+        }
+    } else if (should_intercept_at(dirfd, pathname)) {
+        uint64_t size, ino, allocated;
+        if (stat_dax_path(pathname, &size, &ino, &allocated) == 0) {
+            fill_dax_statx(stx, size, ino, allocated);
+            return 0;
+        }
+    }
+    return real_statx(dirfd, pathname, flags, mask, stx);
+}
+
+int unlink(const char* pathname) {
+    if (should_intercept(pathname) && unlink_dax_file(pathname)) return 0;
+    return real_unlink(pathname);
+}
+
+int unlinkat(int dirfd, const char* pathname, int flags) {
+    if (!(flags & AT_REMOVEDIR) && should_intercept_at(dirfd, pathname) &&
+        unlink_dax_file(pathname)) {
+        return 0;
+    }
+    return real_unlinkat(dirfd, pathname, flags);
+}
+
+void* mmap(void* addr, size_t length, int prot, int flags, int fd, off_t offset) {
+    if (dax_fds.in_range(fd)) {
+        DaxGuard guard;
+        DAXMapping* mapping = dax_fds.lookup(fd);
+        if (mapping) {
+            uint64_t t0 = trace.begin();
+            void* p = mmap_dax_file(*mapping, addr, length, prot, flags, offset);
+            trace.record(TraceOp::MMAP, fd, offset, length, p == MAP_FAILED ? -1 : 0, t0);
+            return p;
+        }
+    }
+    return real_mmap(addr, length, prot, flags, fd, offset);
+}
+
+void* mmap64(void* addr, size_t length, int prot, int flags, int fd, off64_t offset) {
+    if (dax_fds.in_range(fd)) return mmap(addr, length, prot, flags, fd, offset);
+    return real_mmap64(addr, length, prot, flags, fd, offset);
+}
+
+int munmap(void* addr, size_t length) {
+    // Direct mappings share a region's mapping, which stays; only the
+    // windows they pinned are released
+    if (in_region_mapping(addr, length)) {
+        uintptr_t start = reinterpret_cast<uintptr_t>(addr);
+        unmap_pinned(start, start + length);
+        trace.record(TraceOp::MUNMAP, -1, 0, length, 0, trace.begin());
+        return 0;
+    }
+    int ret = real_munmap(addr, length);
+    if (ret == 0) {
+        uintptr_t start = reinterpret_cast<uintptr_t>(addr);
+        forget_app_mapping(start, start + length);
+    }
+    return ret;
+}
+
+int msync(void* addr, size_t length, int flags) {
+    if (in_region_mapping(addr, length) || in_app_mapping(addr, length)) {
+        uint64_t t0 = trace.begin();
+        // Stores through the mapping reach the media once their lines are
+        // written back, so msync() is a flush of the range
+        if (write_combiner.enabled()) write_combiner.drain(static_cast<const char*>(addr), length);
+        cxl_ssd::persist_flush(addr, length, persist_mode);
+        cxl_ssd::persist_fence(persist_mode);
+        trace.record(TraceOp::MSYNC, -1, 0, length, 0, t0);
+        return 0;
+    }
+    return real_msync(addr, length, flags);
+}
+
+int io_setup(int maxevents, aio_context_t* ctxp) {
+    if (!intercept_enabled) return sys_io_setup(maxevents, ctxp);
+    if (maxevents <= 0 || !ctxp) return -EINVAL;
+
+    for (int i = 0; i < dax_region_count; i++) get_aio_pool(i);
+    AioContext* ctx = new AioContext(maxevents);
+    int id = aio_contexts.install(ctx);
+    if (id < 0) {
+        delete ctx;
+        return -EAGAIN;
+    }
+    *ctxp = static_cast<aio_context_t>(id);
+    return 0;
+}
+
+int io_destroy(aio_context_t ctx_id) {
+    if (!aio_own_id(ctx_id)) return sys_io_destroy(ctx_id);
+    AioContext* ctx = aio_contexts.remove(static_cast<int>(ctx_id));
+    if (!ctx) return -EINVAL;
+
+    // Wake io_getevents() callers, which return -EINVAL, and the kernel
+    // context's, then wait for every call that found ctx to return
+    ctx->destroyed.store(true, std::memory_order_release);
+    ctx->completion_seq.fetch_add(1, std::memory_order_release);
+    cxl_intercept::futex_wake(&ctx->completion_seq, INT32_MAX);
+    {
+        std::lock_guard<std::mutex> lk(ctx->real_mu);
+        if (ctx->real_ctx) sys_io_destroy(ctx->real_ctx);
+    }
+    dax_epoch.synchronize();
+    while (ctx->users.load(std::memory_order_acquire) > 0) sched_yield();
+    // Outstanding DAX iocbs cannot be cancelled; let them finish
+    while (ctx->running.load(std::memory_order_acquire) > 0) sched_yield();
+    delete ctx;
+    return 0;
+}
+
+int io_submit(aio_context_t ctx_id, long nr, struct iocb** iocbs) {
+    AioRef ref(ctx_id);
+    AioContext* ctx = ref.get();
+    if (!ctx) return aio_own_id(ctx_id) ? -EINVAL : sys_io_submit(ctx_id, nr, iocbs);
+    if (nr < 0 || ctx->destroyed.load(std::memory_order_acquire)) return -EINVAL;
+    if (nr > 0 && !iocbs) return -EFAULT;
+
+    long submitted = 0;
+    while (submitted < nr) {
+        // As the kernel: a bad iocb ends the batch
+        if (!iocbs[submitted]) {
+            if (submitted == 0) return -EFAULT;
+            break;
+        }
+        int region = iocb_region(iocbs[submitted]);
+        if (region >= 0) {
+            if (ctx->queued.fetch_add(1, std::memory_order_relaxed) >= ctx->max_events) {
+                ctx->queued.fetch_sub(1, std::memory_order_relaxed);
+                break;
+            }
+            ctx->running.fetch_add(1, std::memory_order_relaxed);
+            get_aio_pool(region)->submit(&aio_complete, ctx, iocbs[submitted]);
+            submitted++;
+            continue;
+        }
+
+        // Hand each run of consecutive non-DAX iocbs to the kernel at once
+        long end = submitted + 1;
+        while (end < nr && iocbs[end] && iocb_region(iocbs[end]) < 0) end++;
+        int ret = aio_submit_passthrough(ctx, end - submitted, iocbs + submitted);
+        if (ret < 0) {
+            if (submitted == 0) return ret;
+            break;
+        }
+        submitted += ret;
+        if (submitted < end) break;
+    }
+    if (submitted == 0 && nr > 0) return -EAGAIN;
+    return static_cast<int>(submitted);
+}
+
+int io_getevents(aio_context_t ctx_id, long min_nr, long nr, struct io_event* events,
+                 struct timespec* timeout) {
+    AioRef ref(ctx_id);
+    AioContext* ctx = ref.get();
+    if (!ctx) return aio_own_id(ctx_id) ? -EINVAL : sys_io_getevents(ctx_id, min_nr, nr, events, timeout);
+    if (min_nr < 0 || nr < 0 || min_nr > nr) return -EINVAL;
+
+    int64_t deadline = -1;
+    if (timeout) deadline = monotonic_ns() + timeout->tv_sec * 1000000000LL + timeout->tv_nsec;
+
+    long got = 0;
+    for (;;) {
+        uint32_t seq = ctx->completion_seq.load(std::memory_order_acquire);
+        if (ctx->destroyed.load(std::memory_order_acquire)) return -EINVAL;
+        got += aio_reap(ctx, events + got, nr - got);
+        if (got < nr && ctx->real_inflight.load(std::memory_order_acquire) > 0) {
+            struct timespec zero{0, 0};
+            int ret = sys_io_getevents(ctx->real_ctx, 0, nr - got, events + got, &zero);
+            if (ret > 0) {
+                got += ret;
+                ctx->real_inflight.fetch_sub(ret, std::memory_order_relaxed);
+            }
+        }
+        if (got >= min_nr) return static_cast<int>(got);
+
+        int64_t remaining = -1;
+        if (deadline >= 0) {
+            remaining = deadline - monotonic_ns();
+            if (remaining <= 0) return static_cast<int>(got);
+        }
+
+        long real_inflight = ctx->real_inflight.load(std::memory_order_acquire);
+        if (real_inflight > 0 && ctx->queued.load(std::memory_order_acquire) == 0) {
+            // Only kernel I/O is outstanding: block in the kernel
+            struct timespec ts, *tsp = nullptr;
+            if (remaining >= 0) {
+                ts.tv_sec = remaining / 1000000000LL;
+                ts.tv_nsec = remaining % 1000000000LL;
+                tsp = &ts;
+            }
+            int ret = sys_io_getevents(ctx->real_ctx, min_nr - got, nr - got, events + got, tsp);
+            if (ret > 0) {
+                got += ret;
+                ctx->real_inflight.fetch_sub(ret, std::memory_order_relaxed);
+            }
+            return got > 0 || ret >= 0 ? static_cast<int>(got) : ret;
+        }
+
+        // Spin briefly for copy workers, then sleep until the next completion
+        // (polling the kernel context every 50us if it also has I/O)
+        for (int i = 0; i < 2000 && ctx->completion_seq.load(std::memory_order_acquire) == seq; i++) {
+            _mm_pause();
+        }
+        if (ctx->completion_seq.load(std::memory_order_acquire) != seq) continue;
+
+        int64_t wait_ns = remaining;
+        if (real_inflight > 0 && (wait_ns < 0 || wait_ns > 50000)) wait_ns = 50000;
+        struct timespec ts, *tsp = nullptr;
+        if (wait_ns >= 0) {
+            ts.tv_sec = wait_ns / 1000000000LL;
+            ts.tv_nsec = wait_ns % 1000000000LL;
+            tsp = &ts;
+        }
+        ctx->waiters.fetch_add(1, std::memory_order_seq_cst);
+        if (ctx->completion_seq.load(std::memory_order_acquire) == seq) {
+            cxl_intercept::futex_wait(&ctx->completion_seq, seq, tsp);
+        }
+        ctx->waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
+
+int io_cancel(aio_context_t ctx_id, struct iocb* iocb, struct io_event* result) {
+    AioRef ref(ctx_id);
+    AioContext* ctx = ref.get();
+    if (!ctx) return aio_own_id(ctx_id) ? -EINVAL : sys_io_cancel(ctx_id, iocb, result);
+    // DAX copies run to completion; only kernel iocbs can be cancelled
+    if (iocb_region(iocb) >= 0 || !ctx->real_ctx) return -EAGAIN;
+    int ret = sys_io_cancel(ctx->real_ctx, iocb, result);
+    if (ret == 0) ctx->real_inflight.fetch_sub(1, std::memory_order_relaxed);
+    return ret;
+}
+
+// libaio helpers that would otherwise reach the kernel without io_setup()
+int io_queue_init(int maxevents, aio_context_t* ctxp) {
+    if (!ctxp) return -EINVAL;
+    *ctxp = 0;
+    return io_setup(maxevents, ctxp);
+}
+
+int io_queue_release(aio_context_t ctx_id) {
+    return io_destroy(ctx_id);
+}
+
+// Runtime control of the persistence strategy; returns 0 or -1 (EINVAL)
+int fio_intercept_set_persist_mode(const char* mode) {
+    cxl_ssd::PersistMode parsed;
+    if (!cxl_ssd::parse_persist_mode(mode, parsed)) {
+        errno = EINVAL;
+        return -1;
+    }
+    // Combined lines are written back in the mode they were stored under
+    write_combiner.drain_all();
+    persist_mode = cxl_ssd::resolve_persist_mode(parsed);
+    return 0;
+}
+
+const char* fio_intercept_get_persist_mode(void) {
+    return cxl_ssd::persist_mode_name(persist_mode);
 }
 
-} // extern "C"
\ No newline at end of file
+} // extern "C"
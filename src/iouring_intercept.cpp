@@ -10,6 +10,7 @@
 #include <pthread.h>
 #include <stdarg.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
@@ -18,16 +19,20 @@
 #include <unistd.h>
 
 #include <atomic>
-#include <map>
-#include <mutex>
 #include <string>
-#include <vector>
 
 #include <immintrin.h>
-#include <condition_variable>
-#include <deque>
 
+#include "../include/cxl_aio_pool.hpp"
+#include "../include/cxl_dax_catalog.hpp"
+#include "../include/cxl_dax_region.hpp"
+#include "../include/cxl_fd_table.hpp"
+#include "../include/cxl_latency_hist.hpp"
 #include "../include/cxl_mwait.hpp"
+#include "../include/cxl_persist.hpp"
+#include "../include/cxl_qos.hpp"
+#include "../include/cxl_timing_model.hpp"
+#include "../include/cxl_trace.hpp"
 
 // Use cxl primitives for MONITOR/MWAIT
 namespace cxl = cxl_ssd;
@@ -36,8 +41,13 @@ using cxl::primitives::mwait;
 
 extern "C" {
 
-// Forward declarations to match liburing ABI
-struct io_uring {};
+// Forward declarations to match liburing ABI. The shim keeps its ring
+// context in the first word of the application's struct io_uring (where
+// liburing keeps sq.khead), written by io_uring_queue_init, so every call
+// reaches it with one load.
+struct io_uring {
+    void* ctx;
+};
 struct io_uring_sqe {
     uint8_t opcode;
     uint8_t flags;
@@ -70,123 +80,227 @@ static pwrite_fn real_pwrite = nullptr;
 // Intercepted open/close to hand out fake FDs that map into a DAX region
 using open_fn = int(*)(const char*, int, ...);
 using close_fn = int(*)(int);
+using unlink_fn = int(*)(const char*);
 static open_fn real_open = nullptr;
 static close_fn real_close = nullptr;
+static unlink_fn real_unlink = nullptr;
 
 struct DAXMapping {
     void* base{nullptr};
     size_t size{0};
     off_t current_offset{0};
     std::string path;
+    uint32_t lat_id{0};  // latency histogram id, 0 when not recording
+    int32_t ns_slot{-1}; // shared namespace entry counting this open
+    pid_t opener{0};     // only the opening process drops the count
+    int qos_class{0};    // QoS class of the path (FIO_QOS)
 };
 
-static std::map<int, DAXMapping> g_dax_fds;
-static std::mutex g_dax_mu;
-static std::atomic<int> g_fake_fd{20000};
+// Fake fds index straight into a lock-free table, as in fio_intercept;
+// close() frees a mapping after an epoch grace period
+static constexpr int kFakeFdBase = 20000;
+static constexpr size_t kMaxFakeFds = 65536;
+static constinit cxl_intercept::FakeFdTable<DAXMapping, kMaxFakeFds> g_dax_fds{kFakeFdBase};
+static constinit cxl_intercept::EpochDomain g_dax_epoch;
+using EpochGuard = cxl_intercept::EpochDomain::Guard;
 
-// Global DAX device info
+// Global DAX device info; its catalog is shared with fio_intercept through
+// the region head
 static bool g_intercept_enabled = false;
-static std::string g_dax_device_path;
-static size_t g_dax_device_size = 0;
-static void* g_dax_base = nullptr;
-static int g_dax_fd = -1;
-
-// Userspace ring context keyed by the app-provided ring pointer value
+static constinit cxl_intercept::DaxRegion g_region;
+static cxl_ssd::PersistMode g_persist_mode = cxl_ssd::PersistMode::CLFLUSHOPT;
+
+// Userspace ring: SQEs are filled in place in the SQ by the application
+// thread and executed by the ring's worker thread, which posts CQEs to the
+// CQ. Each ring has one producer and one consumer, as with the kernel's
+// rings, so neither side takes a lock.
+static constexpr uint64_t kRingMagic = 0xC1A10A1B5C0FFEEULL;
 struct RingCtx {
-    unsigned capacity;
-    std::mutex mu;
-    std::vector<io_uring_sqe*> pending; // collected SQEs since last submit
-    std::vector<io_uring_cqe> cqes;     // completion queue
-
-    // Worker queue for async processing
-    std::mutex wq_mu;
-    std::condition_variable wq_cv;
-    std::deque<io_uring_sqe*> wq;
+    std::atomic<uint64_t> magic{kRingMagic};   // cleared by io_uring_queue_exit
+    cxl_intercept::SpscRing<io_uring_sqe> sq;  // application -> worker
+    cxl_intercept::SpscRing<io_uring_cqe> cq;  // worker -> application
+    unsigned sqe_pending = 0;                  // handed out, not yet submitted
     std::atomic<bool> stop{false};
+    std::atomic<uint32_t> worker_sleeping{0};
+    std::atomic<uint32_t> doorbell{0};         // futex the idle worker sleeps on
     pthread_t worker_thr{};
 
-    // Wait primitive: a 64B aligned counter to monitor
-    alignas(64) std::atomic<uint32_t> cqe_tail{0};
+    explicit RingCtx(unsigned entries) : sq(entries), cq(2 * entries) {}
 };
 
-static std::map<const io_uring*, RingCtx*> g_rings;
-static std::mutex g_rings_mu;
+// Largest ring, as the kernel's IORING_MAX_ENTRIES
+static constexpr unsigned kMaxRingEntries = 32768;
+// Empty polls of the SQ before the worker sleeps
+static constexpr int kWorkerSpin = 2000;
+
+// The context of a ring set up by io_uring_queue_init; nullptr for a
+// zeroed or exited ring, or one liburing set up itself (whose first word
+// is sq.khead)
+static inline RingCtx* ring_ctx(const io_uring* ring) {
+    if (!ring) return nullptr;
+    auto* ctx = static_cast<RingCtx*>(ring->ctx);
+    if (!ctx || reinterpret_cast<uintptr_t>(ctx) % alignof(RingCtx) != 0) return nullptr;
+    return ctx->magic.load(std::memory_order_acquire) == kRingMagic ? ctx : nullptr;
+}
+
+// wait_cqe falls back to polling without MONITOR/MWAIT
+static bool g_mwait = false;
+
+// Binary I/O trace (FIO_TRACE_FILE / FIO_DEBUG)
+static constinit cxl_intercept::TraceRecorder g_trace;
+using cxl_intercept::TraceOp;
+
+// Device-side latency histograms (FIO_LAT_HIST_FILE)
+static constinit cxl_intercept::LatencyRecorder g_latency;
+using cxl_intercept::LatOp;
+
+// Emulated CXL-SSD latency and bandwidth (FIO_CXL_TIMING)
+static constinit cxl_intercept::TimingModel g_timing;
+
+// Per-tenant token-bucket QoS (FIO_QOS)
+static constinit cxl_intercept::QosPolicy g_qos;
 
-// Utility: check whether fd is our fake DAX fd
-static inline bool is_dax_fd(int fd) {
-    std::lock_guard<std::mutex> lk(g_dax_mu);
-    return g_dax_fds.find(fd) != g_dax_fds.end();
+static inline uint64_t op_begin() {
+    return g_timing.enabled() || g_latency.enabled() ? __rdtsc() : 0;
 }
 
-// Utility: copy to/from DAX mapping
-static ssize_t dax_pread(int fd, void* buf, size_t count, off_t offset) {
-    std::lock_guard<std::mutex> lk(g_dax_mu);
-    auto it = g_dax_fds.find(fd);
-    if (it == g_dax_fds.end()) return -1;
-    auto& m = it->second;
+// Whole zero blocks are marked in the catalog's zero map (FIO_DAX_THIN)
+static bool g_thin = false;
+
+// Copy from the mapping; the caller holds an EpochGuard. -1 with errno set
+// if a window cannot be mapped.
+static ssize_t dax_pread(const DAXMapping& m, void* buf, size_t count, off_t offset) {
     if (offset < 0 || (size_t)offset >= m.size) return 0;
     size_t to_read = count;
     if (offset + (off_t)to_read > (off_t)m.size) to_read = m.size - offset;
-    memcpy(buf, static_cast<char*>(m.base) + offset, to_read);
+    const char* src = static_cast<char*>(m.base) + offset;
+    if (!g_region.ensure(src, to_read)) return -1;
+    cxl_intercept::ZeroMap& zeros = g_region.catalog.zero_map;
+    if (zeros.in_use()) {
+        zeros.read(src, static_cast<char*>(buf), to_read,
+                   [](char* d, const char* s, size_t n) { memcpy(d, s, n); });
+    } else {
+        memcpy(buf, src, to_read);
+    }
     return (ssize_t)to_read;
 }
-static ssize_t dax_pwrite(int fd, const void* buf, size_t count, off_t offset) {
-    std::lock_guard<std::mutex> lk(g_dax_mu);
-    auto it = g_dax_fds.find(fd);
-    if (it == g_dax_fds.end()) return -1;
-    auto& m = it->second;
+
+// Copy to the mapping; the caller holds an EpochGuard. -1 with errno set
+// if a window cannot be mapped.
+static ssize_t dax_pwrite(const DAXMapping& m, const void* buf, size_t count, off_t offset) {
     if (offset < 0 || (size_t)offset >= m.size) return 0;
     size_t to_write = count;
     if (offset + (off_t)to_write > (off_t)m.size) to_write = m.size - offset;
     void* dest = static_cast<char*>(m.base) + offset;
-    memcpy(dest, buf, to_write);
-    // persist via CLFLUSHOPT
-    for (size_t i = 0; i < to_write; i += 64) {
-        _mm_clflushopt(static_cast<char*>(dest) + i);
+    if (!g_region.ensure(dest, to_write)) return -1;
+    cxl_intercept::ZeroMap& zeros = g_region.catalog.zero_map;
+    if ((g_thin && zeros.attached()) || zeros.in_use()) {
+        zeros.write(static_cast<char*>(dest), static_cast<const char*>(buf), to_write, g_thin,
+                    [](char* d, const char* s, size_t n, bool) {
+            cxl_ssd::persist_copy(d, s, n, g_persist_mode);
+        });
+    } else {
+        cxl_ssd::persist_copy(dest, buf, to_write, g_persist_mode);
     }
-    _mm_sfence();
     return (ssize_t)to_write;
 }
 
+// Read or write a fake fd: the mapping is looked up once, and QoS waits and
+// emulated device time are taken after the epoch guard is dropped, so they
+// never hold up close() or window eviction
+static ssize_t dax_rw(int fd, bool write, void* buf, size_t count, off_t offset) {
+    uint64_t l0 = op_begin();
+    ssize_t done;
+    uint32_t lat_id;
+    int qos_class;
+    {
+        EpochGuard guard(g_dax_epoch);
+        const DAXMapping* m = g_dax_fds.lookup(fd);
+        if (!m) return -EBADF;
+        done = write ? dax_pwrite(*m, buf, count, offset) : dax_pread(*m, buf, count, offset);
+        lat_id = m->lat_id;
+        qos_class = m->qos_class;
+    }
+    if (done < 0) return -errno;
+    if (done == 0) return 0;
+    LatOp op = write ? LatOp::WRITE : LatOp::READ;
+    // QoS paces the class after the copy
+    g_qos.admit(g_region.qos, qos_class, done);
+    g_timing.delay(op, done, l0);
+    g_latency.record(lat_id, op, l0);
+    return done;
+}
+
 // Environment config and real function pointers
 __attribute__((constructor)) static void iouring_intercept_init() {
     real_open = (open_fn)dlsym(RTLD_NEXT, "open");
     real_close = (close_fn)dlsym(RTLD_NEXT, "close");
+    real_unlink = (unlink_fn)dlsym(RTLD_NEXT, "unlink");
     real_pread = (pread_fn)dlsym(RTLD_NEXT, "pread");
     real_pwrite = (pwrite_fn)dlsym(RTLD_NEXT, "pwrite");
 
+    g_mwait = cxl::primitives::check_mwait_support();
+
     const char* env_enable = getenv("IOURING_INTERCEPT_ENABLE");
     if (env_enable && strcmp(env_enable, "1") == 0) {
         g_intercept_enabled = true;
+        g_trace.init_from_env("iouring_intercept");
+        g_latency.init_from_env("iouring_intercept");
+        g_timing.init_from_env("iouring_intercept");
+        g_qos.init_from_env("iouring_intercept");
+        // No dirty tracking here, so lazy runs as clwb
+        g_persist_mode = cxl_ssd::eager_persist_mode(cxl_ssd::persist_mode_from_env());
         const char* env_dax = getenv("FIO_DAX_DEVICE");
         const char* env_size = getenv("FIO_DAX_SIZE");
-        if (env_dax) g_dax_device_path = env_dax;
-        if (env_size) g_dax_device_size = strtoull(env_size, nullptr, 0);
-
-        if (!g_dax_device_path.empty()) {
-            g_dax_fd = real_open(g_dax_device_path.c_str(), O_RDWR | O_SYNC);
-            if (g_dax_fd >= 0) {
-                if (g_dax_device_size == 0) {
-                    struct stat st{};
-                    if (fstat(g_dax_fd, &st) == 0) g_dax_device_size = st.st_size;
-                }
-                if (g_dax_device_size) {
-                    g_dax_base = mmap(nullptr, g_dax_device_size,
-                                      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_SYNC,
-                                      g_dax_fd, 0);
-                    if (g_dax_base == MAP_FAILED) {
-                        g_dax_base = nullptr;
-                        g_intercept_enabled = false;
-                    }
+        const char* env_align = getenv("FIO_DAX_ALIGN");
+
+        if (env_dax) {
+            cxl_intercept::DaxRegionSpec spec;
+            spec.path = env_dax;
+            if (env_size) spec.size = cxl_intercept::parse_size(env_size);
+            if (env_align) spec.align = cxl_intercept::parse_size(env_align);
+            if (const char* env = getenv("FIO_DAX_WINDOW")) spec.window = cxl_intercept::parse_size(env);
+            if (const char* env = getenv("FIO_DAX_MAX_WINDOWS")) spec.max_windows = strtoul(env, nullptr, 0);
+            const char* env_format = getenv("FIO_DAX_FORMAT");
+            const char* env_thin = getenv("FIO_DAX_THIN");
+            const char* env_thin_block = getenv("FIO_DAX_THIN_BLOCK");
+            g_thin = env_thin && strcmp(env_thin, "1") == 0;
+            if (!g_region.map(spec, &g_dax_epoch)) {
+                g_intercept_enabled = false;
+            } else if (!g_region.attach_catalog(g_persist_mode, env_format && strcmp(env_format, "1") == 0,
+                                                env_thin_block ? cxl_intercept::parse_size(env_thin_block) : 0)) {
+                g_region.unmap();
+                g_intercept_enabled = false;
+            } else {
+                g_qos.bind(g_region.qos);
+                pthread_atfork([] { g_region.fork_prepare(); }, [] { g_region.fork_parent(); },
+                               [] { g_region.fork_child(); });
+                fprintf(stderr, "[IOURING_INTERCEPT] DAX device mapped: %s (size: %zu, align: %zu KB, "
+                        "page: %zu KB, persist: %s)\n",
+                        g_region.path.c_str(), g_region.size, g_region.align >> 10,
+                        g_region.page_size >> 10, cxl_ssd::persist_mode_name(g_persist_mode));
+                if (const char* env = getenv("FIO_DAX_METADATA")) {
+                    cxl_intercept::write_region_metadata(
+                        cxl_intercept::expand_path_template(env, "iouring_intercept"), "iouring_intercept",
+                        cxl_ssd::persist_mode_name(g_persist_mode), &g_region, 1);
                 }
             }
         }
     }
 }
 
+// Drop the namespace count of an open; fds inherited over fork() leave it
+// to the process that opened them
+static void release_dax_extent(const DAXMapping& m) {
+    if (m.opener == getpid()) g_region.catalog.release_extent(m.ns_slot);
+}
+
 __attribute__((destructor)) static void iouring_intercept_fini() {
-    if (g_dax_base && g_dax_base != MAP_FAILED) munmap(g_dax_base, g_dax_device_size);
-    if (g_dax_fd >= 0) real_close(g_dax_fd);
+    // Files left open count as closed for the other processes
+    g_dax_fds.for_each([](int, DAXMapping* m) { release_dax_extent(*m); });
+    g_latency.shutdown();
+    g_trace.shutdown();
+    g_region.unmap();
 }
 
 // Simple path matching to decide whether to hand out fake fds
@@ -203,96 +317,156 @@ int open(const char* pathname, int flags, ...) {
     mode_t mode = 0;
     if (flags & O_CREAT) { va_list ap; va_start(ap, flags); mode = va_arg(ap, mode_t); va_end(ap); }
     if (should_intercept_path(pathname)) {
-        if (!g_dax_base) return -1;
-        int fd = g_fake_fd.fetch_add(1);
-        size_t file_size = 1ULL << 30; // default 1GB chunk
+        if (!g_region.base) return -1;
+        size_t file_size = 1ULL << 30; // default 1GB for new files
         const char* env_file_size = getenv("FIO_FILE_SIZE");
         if (env_file_size) file_size = strtoull(env_file_size, nullptr, 0);
-        static std::atomic<size_t> allocated{0};
-        size_t offset = allocated.fetch_add(file_size) % g_dax_device_size;
-        std::lock_guard<std::mutex> lk(g_dax_mu);
-        g_dax_fds[fd] = DAXMapping{static_cast<char*>(g_dax_base) + offset, file_size, 0, pathname};
+        uint64_t t0 = g_trace.begin();
+        cxl_intercept::DaxExtent extent;
+        if (!g_region.catalog.acquire_extent(cxl_intercept::catalog_path_key(pathname), file_size, true, extent)) {
+            return -1;
+        }
+        if (extent.chunk_map) {
+            // A sparse file (fio_intercept FIO_DAX_SPARSE) has no contiguous extent
+            g_region.catalog.release_extent(extent.ns_slot);
+            errno = EOPNOTSUPP;
+            return -1;
+        }
+        auto* m = new DAXMapping{g_region.base + extent.offset, extent.length, 0, pathname, 0,
+                                 extent.ns_slot, getpid(), g_qos.classify(pathname)};
+        int fd = g_dax_fds.install(m);
+        if (fd < 0) {
+            release_dax_extent(*m);
+            delete m;
+            errno = EMFILE;
+            return -1;
+        }
+        // Nobody else knows fd until we return it
+        m->lat_id = g_latency.register_file(fd, pathname);
+        g_trace.record(TraceOp::OPEN, fd, extent.offset, extent.length, fd, t0);
         return fd;
     }
     return real_open ? real_open(pathname, flags, mode) : -1;
 }
 
 int close(int fd) {
-    {
-        std::lock_guard<std::mutex> lk(g_dax_mu);
-        auto it = g_dax_fds.find(fd);
-        if (it != g_dax_fds.end()) { g_dax_fds.erase(it); return 0; }
+    DAXMapping* m = g_dax_fds.remove(fd);
+    if (m) {
+        uint64_t t0 = g_trace.begin();
+        // Ring workers may still hold the pointer; free it after a grace period
+        g_dax_epoch.synchronize();
+        release_dax_extent(*m);
+        delete m;
+        g_trace.record(TraceOp::CLOSE, fd, 0, 0, 0, t0);
+        return 0;
     }
     return real_close ? real_close(fd) : -1;
 }
 
-// io_uring minimal API
-int io_uring_queue_init(unsigned entries, struct io_uring* ring, unsigned /*flags*/) {
-    std::lock_guard<std::mutex> lk(g_rings_mu);
-    if (g_rings.count(ring)) return 0;
-    auto* ctx = new RingCtx();
-    ctx->capacity = entries ? entries : 64;
-    g_rings[ring] = ctx;
-
-    // Launch worker thread to process SQEs asynchronously
-    auto worker_fn = [](void* arg) -> void* {
-        RingCtx* c = static_cast<RingCtx*>(arg);
-        for (;;) {
-            io_uring_sqe* sqe = nullptr;
-            {
-                std::unique_lock<std::mutex> ul(c->wq_mu);
-                c->wq_cv.wait(ul, [&]{ return c->stop.load(std::memory_order_acquire) || !c->wq.empty(); });
-                if (c->stop.load(std::memory_order_acquire) && c->wq.empty()) break;
-                sqe = c->wq.front();
-                c->wq.pop_front();
-            }
+int unlink(const char* pathname) {
+    if (should_intercept_path(pathname) && g_region.base &&
+        g_region.catalog.remove(cxl_intercept::catalog_path_key(pathname))) {
+        g_trace.record(TraceOp::UNLINK, -1, 0, 0, 0, g_trace.begin());
+        return 0;
+    }
+    return real_unlink ? real_unlink(pathname) : -1;
+}
 
-            int fd = sqe->fd; ssize_t res = -EINVAL;
-            if (sqe->opcode == IORING_OP_READ || sqe->opcode == IORING_OP_READV) {
-                if (is_dax_fd(fd)) res = dax_pread(fd, (void*)sqe->addr, sqe->len, sqe->off);
-                else if (real_pread) res = real_pread(fd, (void*)sqe->addr, sqe->len, sqe->off);
-            } else if (sqe->opcode == IORING_OP_WRITE || sqe->opcode == IORING_OP_WRITEV) {
-                if (is_dax_fd(fd)) res = dax_pwrite(fd, (const void*)sqe->addr, sqe->len, sqe->off);
-                else if (real_pwrite) res = real_pwrite(fd, (const void*)sqe->addr, sqe->len, sqe->off);
-            } else {
-                res = -EOPNOTSUPP;
-            }
+// Execute one SQE; returns the CQE result
+static int32_t ring_execute(const io_uring_sqe* sqe) {
+    int fd = sqe->fd; ssize_t res = -EINVAL;
+    uint64_t t0 = g_trace.begin();
+    if (sqe->opcode == IORING_OP_READ || sqe->opcode == IORING_OP_READV) {
+        if (g_dax_fds.in_range(fd)) {
+            res = dax_rw(fd, false, (void*)sqe->addr, sqe->len, sqe->off);
+            g_trace.record(TraceOp::URING_READ, fd, sqe->off, sqe->len, res, t0);
+        }
+        else if (real_pread) res = real_pread(fd, (void*)sqe->addr, sqe->len, sqe->off);
+    } else if (sqe->opcode == IORING_OP_WRITE || sqe->opcode == IORING_OP_WRITEV) {
+        if (g_dax_fds.in_range(fd)) {
+            res = dax_rw(fd, true, (void*)sqe->addr, sqe->len, sqe->off);
+            g_trace.record(TraceOp::URING_WRITE, fd, sqe->off, sqe->len, res, t0);
+        }
+        else if (real_pwrite) res = real_pwrite(fd, (const void*)sqe->addr, sqe->len, sqe->off);
+    } else {
+        res = -EOPNOTSUPP;
+    }
+    return (int32_t)res;
+}
 
-            io_uring_cqe cqe{}; cqe.user_data = sqe->user_data; cqe.res = (int32_t)res; cqe.flags = 0;
-            {
-                std::lock_guard<std::mutex> lk2(c->mu);
-                c->cqes.push_back(cqe);
-                c->cqe_tail.fetch_add(1, std::memory_order_release);
+// Ring worker: drain the SQ in order, posting one CQE per SQE. Spins
+// briefly on an empty SQ, then sleeps until io_uring_submit rings the
+// doorbell.
+static void* ring_worker(void* arg) {
+    RingCtx* c = static_cast<RingCtx*>(arg);
+    int idle = 0;
+    for (;;) {
+        io_uring_sqe* sqe = c->sq.front();
+        if (!sqe) {
+            if (c->stop.load(std::memory_order_acquire)) break;
+            if (++idle < kWorkerSpin) {
+                _mm_pause();
+                continue;
             }
-            free(sqe);
+            uint32_t seen = c->doorbell.load(std::memory_order_acquire);
+            c->worker_sleeping.store(1, std::memory_order_relaxed);
+            // Pairs with the submitter's publish-then-check in io_uring_submit
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!c->sq.front() && !c->stop.load(std::memory_order_acquire)) {
+                cxl_intercept::futex_wait(&c->doorbell, seen);
+            }
+            c->worker_sleeping.store(0, std::memory_order_relaxed);
+            idle = 0;
+            continue;
         }
-        return nullptr;
-    };
-    pthread_create(&ctx->worker_thr, nullptr, worker_fn, ctx);
-    return 0;
+        idle = 0;
+
+        io_uring_cqe cqe{}; cqe.user_data = sqe->user_data; cqe.res = ring_execute(sqe); cqe.flags = 0;
+        // The CQ holds twice the SQ; it only fills if completions are not reaped
+        io_uring_cqe* slot;
+        while (!(slot = c->cq.claim())) {
+            if (c->stop.load(std::memory_order_acquire)) return nullptr;
+            sched_yield();
+        }
+        *slot = cqe;
+        c->cq.publish();
+        c->sq.pop();
+    }
+    return nullptr;
 }
 
-void io_uring_queue_exit(struct io_uring* ring) {
-    std::lock_guard<std::mutex> lk(g_rings_mu);
-    auto it = g_rings.find(ring);
-    if (it != g_rings.end()) {
-        RingCtx* ctx = it->second;
-        ctx->stop.store(true, std::memory_order_release);
-        ctx->wq_cv.notify_all();
-        if (ctx->worker_thr) pthread_join(ctx->worker_thr, nullptr);
+// io_uring minimal API
+int io_uring_queue_init(unsigned entries, struct io_uring* ring, unsigned /*flags*/) {
+    if (!ring || entries == 0 || entries > kMaxRingEntries) return -EINVAL;
+    auto* ctx = new RingCtx(entries);
+    if (pthread_create(&ctx->worker_thr, nullptr, ring_worker, ctx) != 0) {
         delete ctx;
-        g_rings.erase(it);
+        return -EAGAIN;
     }
+    ring->ctx = ctx;
+    return 0;
+}
+
+void io_uring_queue_exit(struct io_uring* ring) {
+    RingCtx* ctx = ring_ctx(ring);
+    if (!ctx) return;
+    ctx->stop.store(true, std::memory_order_release);
+    ctx->doorbell.fetch_add(1, std::memory_order_release);
+    cxl_intercept::futex_wake(&ctx->doorbell, 1);
+    pthread_join(ctx->worker_thr, nullptr);
+    ctx->magic.store(0, std::memory_order_release);
+    delete ctx;
+    ring->ctx = nullptr;
 }
 
+// Next free SQ slot, zeroed; nullptr when the SQ is full
 struct io_uring_sqe* io_uring_get_sqe(struct io_uring* ring) {
-    std::lock_guard<std::mutex> lk(g_rings_mu);
-    auto it = g_rings.find(ring);
-    if (it == g_rings.end()) return nullptr;
-    // Allocate a fresh SQE owned by the ring ctx until submit
-    auto* sqe = (io_uring_sqe*)aligned_alloc(64, sizeof(io_uring_sqe));
+    RingCtx* ctx = ring_ctx(ring);
+    if (!ctx) return nullptr;
+    io_uring_sqe* sqe = ctx->sq.claim(ctx->sqe_pending);
+    if (!sqe) return nullptr;
     memset(sqe, 0, sizeof(io_uring_sqe));
-    it->second->pending.push_back(sqe);
+    ctx->sqe_pending++;
     return sqe;
 }
 
@@ -316,75 +490,65 @@ void io_uring_prep_write(struct io_uring_sqe* sqe, int fd, const void* buf, unsi
 
 // Submit all pending SQEs; return count submitted
 int io_uring_submit(struct io_uring* ring) {
-    RingCtx* ctx = nullptr; {
-        std::lock_guard<std::mutex> lk(g_rings_mu);
-        auto it = g_rings.find(ring); if (it == g_rings.end()) return -EINVAL; ctx = it->second;
-    }
-
-    std::vector<io_uring_sqe*> to_process;
-    {
-        std::lock_guard<std::mutex> lk(ctx->mu);
-        to_process.swap(ctx->pending);
-    }
-
-    int submitted = 0;
-    if (!to_process.empty()) {
-        {
-            std::lock_guard<std::mutex> ul(ctx->wq_mu);
-            for (auto* sqe : to_process) ctx->wq.push_back(sqe);
-        }
-        ctx->wq_cv.notify_all();
-        submitted = (int)to_process.size();
+    RingCtx* ctx = ring_ctx(ring);
+    if (!ctx) return -EINVAL;
+    unsigned submitted = ctx->sqe_pending;
+    if (submitted == 0) return 0;
+    ctx->sqe_pending = 0;
+    ctx->sq.publish(submitted);
+    // Pairs with the worker's flag-then-recheck before it sleeps
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (ctx->worker_sleeping.load(std::memory_order_relaxed)) {
+        ctx->doorbell.fetch_add(1, std::memory_order_release);
+        cxl_intercept::futex_wake(&ctx->doorbell, 1);
     }
-    return submitted;
+    return (int)submitted;
 }
 
 int io_uring_peek_cqe(struct io_uring* ring, struct io_uring_cqe** cqe_ptr) {
-    RingCtx* ctx = nullptr; { std::lock_guard<std::mutex> lk(g_rings_mu); auto it=g_rings.find(ring); if (it==g_rings.end()) return -EINVAL; ctx=it->second; }
-    std::lock_guard<std::mutex> lk(ctx->mu);
-    if (ctx->cqes.empty()) { *cqe_ptr = nullptr; return -EAGAIN; }
-    *cqe_ptr = &ctx->cqes.front(); return 0;
+    RingCtx* ctx = ring_ctx(ring);
+    if (!ctx) return -EINVAL;
+    *cqe_ptr = ctx->cq.front();
+    return *cqe_ptr ? 0 : -EAGAIN;
 }
 
-int io_uring_wait_cqe(struct io_uring* ring, struct io_uring_cqe** cqe_ptr) {
-    RingCtx* ctx = nullptr; { std::lock_guard<std::mutex> lk(g_rings_mu); auto it=g_rings.find(ring); if (it==g_rings.end()) return -EINVAL; ctx=it->second; }
-    // Fast path
-    {
-        std::lock_guard<std::mutex> lk(ctx->mu);
-        if (!ctx->cqes.empty()) { *cqe_ptr = &ctx->cqes.front(); return 0; }
+// Wait until the CQ holds at least nr CQEs by monitoring its tail's cache
+// line and MWAITing until the worker moves it
+static void wait_cqes(RingCtx* ctx, unsigned nr) {
+    if (!g_mwait) {
+        while (ctx->cq.ready() < nr) sched_yield();
+        return;
     }
-
-    // Monitor the cqe_tail cache line and mwait until it changes
-    uint32_t before = ctx->cqe_tail.load(std::memory_order_acquire);
-    monitor((void*)&ctx->cqe_tail, 0, 0);
-    for (;;) {
-        // mwait extensions=0, hint=C1 (0x01)
+    while (ctx->cq.ready() < nr) {
+        monitor((void*)ctx->cq.tail_word(), 0, 0);
+        if (ctx->cq.ready() >= nr) break;
+        // mwait extensions=0, hint=C1 (0x01); wakes on a store to the line,
+        // or spuriously, and the loop re-arms the monitor
         mwait(0, (uint32_t)cxl::MWaitHint::C1);
-        uint32_t now = ctx->cqe_tail.load(std::memory_order_acquire);
-        if (now != before) break;
-        // Re-arm monitor if spurious wake
-        monitor((void*)&ctx->cqe_tail, 0, 0);
     }
-    // Now there should be at least one cqe
-    std::lock_guard<std::mutex> lk2(ctx->mu);
-    if (ctx->cqes.empty()) return -EAGAIN; // should not happen
-    *cqe_ptr = &ctx->cqes.front();
+}
+
+int io_uring_wait_cqe(struct io_uring* ring, struct io_uring_cqe** cqe_ptr) {
+    RingCtx* ctx = ring_ctx(ring);
+    if (!ctx) return -EINVAL;
+    wait_cqes(ctx, 1);
+    *cqe_ptr = ctx->cq.front();
     return 0;
 }
 
 void io_uring_cqe_seen(struct io_uring* ring, struct io_uring_cqe* cqe) {
-    (void)cqe;
-    RingCtx* ctx = nullptr; { std::lock_guard<std::mutex> lk(g_rings_mu); auto it=g_rings.find(ring); if (it==g_rings.end()) return; ctx=it->second; }
-    std::lock_guard<std::mutex> lk(ctx->mu);
-    if (!ctx->cqes.empty()) ctx->cqes.erase(ctx->cqes.begin());
+    RingCtx* ctx = ring_ctx(ring);
+    if (!ctx || !cqe) return;
+    ctx->cq.pop();
 }
 
-// Convenience: submit and wait for at least one cqe
+// Convenience: submit and wait for at least wait_nr CQEs
 int io_uring_submit_and_wait(struct io_uring* ring, unsigned wait_nr) {
-    (void)wait_nr; // treat as 1
     int sub = io_uring_submit(ring);
-    struct io_uring_cqe* cqe = nullptr;
-    (void)io_uring_wait_cqe(ring, &cqe);
+    if (sub < 0) return sub;
+    RingCtx* ctx = ring_ctx(ring);
+    unsigned room = (unsigned)ctx->cq.capacity();
+    wait_cqes(ctx, wait_nr < room ? wait_nr : room);
     return sub;
 }
 
@@ -0,0 +1,1862 @@
+#include <algorithm>
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/sendfile.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/aio_abi.h>
+
+#include "../include/cxl_crc32c.hpp"
+#include "../include/cxl_dax_region.hpp"
+#include "../include/cxl_dirty_tracker.hpp"
+#include "../include/cxl_engine_core.hpp"
+#include "../include/cxl_latency_hist.hpp"
+#include "../include/cxl_shm_namespace.hpp"
+#include "../include/cxl_timing_model.hpp"
+#include "../include/cxl_zero_map.hpp"
+#include <sys/wait.h>
+
+// Exercises libfio_intercept.so. The test links against the library, so its
+// own open/read/write calls are interposed; the constructor reads the
+// environment at load time, so main() sets it up and re-executes itself.
+
+// libaio entry points exported by the intercept library
+extern "C" {
+int io_setup(int maxevents, aio_context_t* ctxp);
+int io_destroy(aio_context_t ctx);
+int io_submit(aio_context_t ctx, long nr, struct iocb** iocbs);
+int io_getevents(aio_context_t ctx, long min_nr, long nr, struct io_event* events,
+                 struct timespec* timeout);
+int fio_intercept_set_persist_mode(const char* mode);
+const char* fio_intercept_get_persist_mode(void);
+}
+
+namespace {
+
+constexpr size_t kRegionSize = 256ULL << 20;  // backing file per DAX region
+constexpr size_t kFileSize = 16ULL << 20;     // FIO_FILE_SIZE per fake file
+
+int failures = 0;
+
+void report(const std::string& name, bool ok) {
+    std::cout << name << ": " << (ok ? "PASSED" : "FAILED") << std::endl;
+    if (!ok) failures++;
+}
+
+std::string fake_path(const std::string& name) {
+    return "/tmp/fio-intercept-test." + name;
+}
+
+// A finished re-executed child
+struct Child {
+    pid_t pid;
+    int status;
+
+    bool exited(int code = 0) const { return WIFEXITED(status) && WEXITSTATUS(status) == code; }
+
+    // A FIO_*_FILE template as the child expanded it
+    std::string path(std::string tmpl) const {
+        size_t at = tmpl.find("%p");
+        if (at != std::string::npos) tmpl.replace(at, 2, std::to_string(pid));
+        return tmpl;
+    }
+};
+
+// Re-execute this binary as `--test name` with env applied (a null value
+// unsets the variable) and, if log is given, stderr sent there; waits for
+// it. The library reads its configuration at load time, hence the exec.
+Child run_child(const char* name, std::initializer_list<std::pair<const char*, const char*>> env,
+                const std::string& log = "") {
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid == 0) {
+        for (const auto& [key, value] : env) {
+            if (value) setenv(key, value, 1);
+            else unsetenv(key);
+        }
+        if (!log.empty()) {
+            int lfd = ::open(log.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (lfd >= 0) dup2(lfd, STDERR_FILENO);
+        }
+        char* args[] = {const_cast<char*>("/proc/self/exe"), const_cast<char*>("--test"),
+                        const_cast<char*>(name), nullptr};
+        execv("/proc/self/exe", args);
+        _exit(2);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return {pid, status};
+}
+
+std::string read_file(const std::string& path) {
+    std::ifstream in(path);
+    std::stringstream text;
+    text << in.rdbuf();
+    return text.str();
+}
+
+// The number after "key": in a JSON stats file, searching from the first
+// occurrence of after if one is given; 0 if there is none
+unsigned long long read_stats(const std::string& path, const std::string& key, const std::string& after = "") {
+    std::string text = read_file(path);
+    size_t at = after.empty() ? 0 : text.find(after);
+    if (at != std::string::npos) at = text.find("\"" + key + "\": ", at);
+    if (at == std::string::npos) return 0;
+    return strtoull(text.c_str() + at + key.size() + 4, nullptr, 10);
+}
+
+void test_basic() {
+    std::cout << "\n=== Basic Interception Test ===" << std::endl;
+
+    int fd = open(fake_path("basic").c_str(), O_RDWR | O_CREAT, 0644);
+    report("open returns fake fd", fd >= 10000);
+
+    const char msg[] = "Hello DAX World!";
+    report("pwrite", pwrite(fd, msg, sizeof(msg), 4096) == (ssize_t)sizeof(msg));
+
+    char buf[64] = {0};
+    report("pread", pread(fd, buf, sizeof(msg), 4096) == (ssize_t)sizeof(msg) &&
+                    strcmp(buf, msg) == 0);
+
+    report("lseek SEEK_SET", lseek(fd, 4096, SEEK_SET) == 4096);
+    memset(buf, 0, sizeof(buf));
+    report("read advances offset", read(fd, buf, 4) == 4 && lseek(fd, 0, SEEK_CUR) == 4100);
+    report("write at offset", write(fd, "XY", 2) == 2 && pread(fd, buf, 3, 4100) == 3 &&
+                              memcmp(buf, "XYD", 3) == 0);
+
+    report("pread past end", pread(fd, buf, sizeof(buf), kFileSize) == 0);
+    report("pread clamps at end", pread(fd, buf, sizeof(buf), kFileSize - 8) == 8);
+    report("fsync", fsync(fd) == 0);
+    report("close", close(fd) == 0);
+    report("read after close fails", read(fd, buf, 1) < 0);
+
+    int real_fd = open("/proc/self/stat", O_RDONLY);
+    report("non-matching path passes through", real_fd >= 0 && real_fd < 10000 &&
+                                                read(real_fd, buf, sizeof(buf)) > 0);
+    if (real_fd >= 0) close(real_fd);
+}
+
+void test_threads() {
+    std::cout << "\n=== Concurrent IO with Open/Close Churn Test ===" << std::endl;
+
+    const int num_threads = 8;
+    const int rounds = 200;
+    std::atomic<int> errors{0};
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> workers;
+
+    // Opens and closes descriptors while the workers are mid-I/O
+    std::thread churn([&]() {
+        while (!stop.load()) {
+            int fd = open(fake_path("churn").c_str(), O_RDWR | O_CREAT, 0644);
+            if (fd < 0 || close(fd) != 0) errors++;
+        }
+    });
+
+    for (int t = 0; t < num_threads; t++) {
+        workers.emplace_back([t, &errors]() {
+            std::vector<char> out(4096, static_cast<char>('a' + t));
+            std::vector<char> in(4096);
+            int fd = open(fake_path("mt" + std::to_string(t)).c_str(), O_RDWR | O_CREAT, 0644);
+            if (fd < 0) { errors++; return; }
+            for (int r = 0; r < rounds; r++) {
+                for (int i = 0; i < 16; i++) {
+                    off_t off = (off_t)i * 4096;
+                    if (pwrite(fd, out.data(), out.size(), off) != (ssize_t)out.size() ||
+                        pread(fd, in.data(), in.size(), off) != (ssize_t)in.size() ||
+                        in != out) {
+                        errors++;
+                    }
+                }
+            }
+            close(fd);
+        });
+    }
+    for (auto& w : workers) w.join();
+    stop = true;
+    churn.join();
+
+    report("threads x rounds without errors", errors.load() == 0);
+}
+
+void test_vectored() {
+    std::cout << "\n=== Vectored, 64-bit and *at() Entry Points Test ===" << std::endl;
+
+    int fd = open64(fake_path("vec").c_str(), O_RDWR | O_CREAT, 0644);
+    report("open64 returns fake fd", fd >= 10000);
+    int fd2 = openat(AT_FDCWD, fake_path("vec").c_str(), O_RDWR);
+    report("openat returns fake fd", fd2 >= 10000);
+
+    char a[] = "alpha-", b[] = "beta-", c[] = "gamma";
+    struct iovec out[3] = {{a, 6}, {b, 5}, {c, 5}};
+    report("pwritev", pwritev(fd, out, 3, 1000) == 16);
+
+    char in1[4] = {0}, in2[12] = {0};
+    struct iovec in[2] = {{in1, 4}, {in2, 12}};
+    report("preadv scatters", preadv(fd2, in, 2, 1000) == 16 &&
+                              memcmp(in1, "alph", 4) == 0 && memcmp(in2, "a-beta-gamma", 12) == 0);
+
+    struct stat st;
+    report("fstat reports extent size", fstat(fd, &st) == 0 && S_ISREG(st.st_mode) &&
+                                        st.st_size == lseek64(fd, 0, SEEK_END));
+    off_t size = st.st_size;
+    report("preadv clamps whole vector at end", preadv(fd, in, 2, size - 6) == 6);
+
+    lseek(fd, 2000, SEEK_SET);
+    report("writev advances offset", writev(fd, out, 3) == 16 && lseek(fd, 0, SEEK_CUR) == 2016);
+    lseek(fd, 2000, SEEK_SET);
+    memset(in2, 0, sizeof(in2));
+    report("preadv2 at -1 uses file position", preadv2(fd, in, 2, -1, 0) == 16 &&
+                                               lseek(fd, 0, SEEK_CUR) == 2016 &&
+                                               memcmp(in2, "a-beta-gamma", 12) == 0);
+
+    char buf[8] = {0};
+    report("pwrite64/pread64", pwrite64(fd, "64bit", 5, 3000) == 5 && pread64(fd2, buf, 5, 3000) == 5 &&
+                               memcmp(buf, "64bit", 5) == 0);
+    report("fdatasync", fdatasync(fd) == 0);
+
+    struct stat pst;
+    report("stat of catalog file", stat(fake_path("vec").c_str(), &pst) == 0 && pst.st_size == size);
+    struct statx stx;
+    report("statx by fd", statx(fd, "", AT_EMPTY_PATH, STATX_SIZE, &stx) == 0 &&
+                          (off_t)stx.stx_size == size);
+    // Opaque to the nonnull checks glibc declares for these
+    const char* volatile no_path = nullptr;
+    report("statx by fd with NULL path", statx(fd, no_path, AT_EMPTY_PATH, STATX_SIZE, &stx) == 0 &&
+                                         (off_t)stx.stx_size == size);
+    report("fstatat by fd with NULL path", fstatat(fd, no_path, &pst, AT_EMPTY_PATH) == 0 &&
+                                           pst.st_size == size);
+    report("stat of unknown file fails", stat(fake_path("vec-missing").c_str(), &pst) < 0 && errno == ENOENT);
+
+
+    close(fd2);
+    close(fd);
+    unlink(fake_path("vec").c_str());
+}
+
+void test_mmap() {
+    std::cout << "\n=== mmap of Fake Files Test ===" << std::endl;
+
+    int fd = open(fake_path("mmap").c_str(), O_RDWR | O_CREAT, 0644);
+    const size_t len = 1 << 20;
+    char* p = static_cast<char*>(mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 4096));
+    report("mmap shared", p != MAP_FAILED);
+    memcpy(p + 100, "direct-store", 12);
+    report("msync", msync(p, 4096, MS_SYNC) == 0);
+
+    char buf[16] = {0};
+    report("stores visible to pread", pread(fd, buf, 12, 4096 + 100) == 12 &&
+                                      memcmp(buf, "direct-store", 12) == 0);
+    pwrite(fd, "via-pwrite", 10, 8192);
+    report("pwrite visible through mapping", memcmp(p + 4096, "via-pwrite", 10) == 0);
+    report("munmap", munmap(p, len) == 0);
+    report("file usable after munmap", pread(fd, buf, 10, 8192) == 10 && memcmp(buf, "via-pwrite", 10) == 0);
+
+    // MAP_FIXED over a reserved range is a separate VMA on the same media
+    void* resv = mmap(nullptr, len, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    char* f = static_cast<char*>(mmap(resv, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0));
+    report("mmap MAP_FIXED", f == resv);
+    memcpy(f + 200, "fixed-store", 11);
+    report("msync MAP_FIXED", msync(f, len, MS_SYNC) == 0);
+    report("MAP_FIXED stores visible to pread", pread(fd, buf, 11, 200) == 11 &&
+                                                memcmp(buf, "fixed-store", 11) == 0);
+    report("munmap MAP_FIXED", munmap(f, len) == 0);
+
+    char* priv = static_cast<char*>(mmap(nullptr, 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0));
+    report("mmap private", priv != MAP_FAILED);
+    memcpy(priv + 200, "PRIVATE", 7);
+    report("private stores stay private", pread(fd, buf, 11, 200) == 11 &&
+                                          memcmp(buf, "fixed-store", 11) == 0);
+    munmap(priv, 4096);
+
+    struct stat st;
+    fstat(fd, &st);
+    report("mmap past extent fails", mmap(nullptr, 8192, PROT_READ, MAP_SHARED, fd, st.st_size) == MAP_FAILED &&
+                                     errno == ENXIO);
+    report("unaligned offset fails", mmap(nullptr, 4096, PROT_READ, MAP_SHARED, fd, 100) == MAP_FAILED &&
+                                     errno == EINVAL);
+    close(fd);
+    unlink(fake_path("mmap").c_str());
+}
+
+void test_aio() {
+    std::cout << "\n=== libaio Emulation Test ===" << std::endl;
+
+    constexpr int kDepth = 64;
+    constexpr size_t kBlock = 4096;
+    int fd = open(fake_path("aio").c_str(), O_RDWR | O_CREAT, 0644);
+    aio_context_t ctx = 0;
+    report("io_setup", io_setup(kDepth, &ctx) == 0 && ctx != 0);
+
+    std::vector<std::vector<char>> bufs(kDepth, std::vector<char>(kBlock));
+    std::vector<struct iocb> cbs(kDepth);
+    std::vector<struct iocb*> ptrs(kDepth);
+    for (int i = 0; i < kDepth; i++) {
+        memset(bufs[i].data(), 'A' + (i % 26), kBlock);
+        cbs[i] = {};
+        cbs[i].aio_data = i;
+        cbs[i].aio_lio_opcode = IOCB_CMD_PWRITE;
+        cbs[i].aio_fildes = fd;
+        cbs[i].aio_buf = reinterpret_cast<uintptr_t>(bufs[i].data());
+        cbs[i].aio_nbytes = kBlock;
+        cbs[i].aio_offset = i * kBlock;
+        ptrs[i] = &cbs[i];
+    }
+    report("io_submit full queue depth", io_submit(ctx, kDepth, ptrs.data()) == kDepth);
+
+    std::vector<struct io_event> events(kDepth);
+    bool ok = io_getevents(ctx, kDepth, kDepth, events.data(), nullptr) == kDepth;
+    std::vector<bool> seen(kDepth, false);
+    for (int i = 0; ok && i < kDepth; i++) {
+        ok = events[i].res == (int64_t)kBlock && events[i].data < (uint64_t)kDepth &&
+             events[i].obj == reinterpret_cast<uintptr_t>(&cbs[events[i].data]);
+        if (ok) seen[events[i].data] = true;
+    }
+    for (int i = 0; ok && i < kDepth; i++) ok = seen[i];
+    report("io_getevents reaps every write", ok);
+
+    char check[kBlock];
+    ok = true;
+    for (int i = 0; ok && i < kDepth; i++) {
+        ok = pread(fd, check, kBlock, i * kBlock) == (ssize_t)kBlock && memcmp(check, bufs[i].data(), kBlock) == 0;
+    }
+    report("aio writes land in the extent", ok);
+
+    // Vectored read back through the same context
+    char lo[100], hi[4000];
+    struct iovec iov[2] = {{lo, sizeof(lo)}, {hi, sizeof(hi)}};
+    struct iocb rv{};
+    rv.aio_lio_opcode = IOCB_CMD_PREADV;
+    rv.aio_fildes = fd;
+    rv.aio_buf = reinterpret_cast<uintptr_t>(iov);
+    rv.aio_nbytes = 2;
+    rv.aio_offset = kBlock;
+    struct iocb* rvp = &rv;
+    report("aio preadv", io_submit(ctx, 1, &rvp) == 1 && io_getevents(ctx, 1, 1, events.data(), nullptr) == 1 &&
+                         events[0].res == 4100 && lo[0] == 'B' && hi[3995] == 'B' && hi[3996] == 'C');
+
+    struct timespec ts{0, 10 * 1000 * 1000};
+    report("io_getevents times out when idle", io_getevents(ctx, 1, 1, events.data(), &ts) == 0);
+
+    // Submissions beyond the context's capacity are refused
+    aio_context_t small = 0;
+    io_setup(4, &small);
+    int accepted = io_submit(small, 8, ptrs.data());
+    report("io_submit caps at maxevents", accepted == 4);
+    io_getevents(small, accepted, accepted, events.data(), nullptr);
+    report("io_destroy", io_destroy(small) == 0);
+    report("destroyed context is rejected", io_submit(small, 1, ptrs.data()) == -EINVAL &&
+                                            io_getevents(small, 0, 1, events.data(), &ts) == -EINVAL &&
+                                            io_destroy(small) == -EINVAL);
+
+    // io_destroy wakes a caller blocked in io_getevents (which would
+    // return 0 after 5s if it were not woken)
+    aio_context_t waited = 0;
+    io_setup(4, &waited);
+    std::atomic<int> woken{1};
+    std::thread blocked([&] {
+        struct timespec patience{5, 0};
+        woken = io_getevents(waited, 1, 1, events.data(), &patience);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    report("io_destroy wakes io_getevents", io_destroy(waited) == 0 && (blocked.join(), woken == -EINVAL));
+
+    // A NULL iocb ends the batch: -EFAULT if first, else the count so far
+    struct iocb* holes[2] = {ptrs[0], nullptr};
+    report("io_submit NULL iocb first", io_submit(ctx, 1, &holes[1]) == -EFAULT);
+    bool partial = io_submit(ctx, 2, holes) == 1;
+    report("io_submit stops at NULL iocb", partial && io_getevents(ctx, 1, 1, events.data(), nullptr) == 1);
+
+    // Non-DAX iocbs go to the kernel when it supports AIO
+    aio_context_t probe = 0;
+    if (syscall(SYS_io_setup, 1, &probe) == 0) {
+        syscall(SYS_io_destroy, probe);
+        char path[] = "/tmp/aio_passthrough.XXXXXX";
+        int real_fd = mkstemp(path);
+        struct iocb mixed[2] = {};
+        mixed[0].aio_lio_opcode = IOCB_CMD_PWRITE;
+        mixed[0].aio_fildes = real_fd;
+        mixed[0].aio_buf = reinterpret_cast<uintptr_t>(bufs[0].data());
+        mixed[0].aio_nbytes = kBlock;
+        mixed[1] = cbs[1];
+        struct iocb* mp[2] = {&mixed[0], &mixed[1]};
+        bool mixed_ok = io_submit(ctx, 2, mp) == 2 && io_getevents(ctx, 2, 2, events.data(), nullptr) == 2 &&
+                        events[0].res == (int64_t)kBlock && events[1].res == (int64_t)kBlock;
+        report("mixed DAX and kernel iocbs", mixed_ok && ::pread(real_fd, check, kBlock, 0) == (ssize_t)kBlock &&
+                                             check[0] == 'A');
+        ::close(real_fd);
+        unlink(path);
+    }
+
+    report("io_destroy with kernel context", io_destroy(ctx) == 0);
+    close(fd);
+    unlink(fake_path("aio").c_str());
+}
+
+void test_lazy() {
+    std::cout << "\n=== Lazy Persistence Test ===" << std::endl;
+
+    // Tracker accounting on a private buffer
+    std::vector<char> mem(1 << 20);
+    cxl_intercept::DirtyTracker lines(mem.data(), mem.size(), 6);
+    lines.mark(10, 1);
+    lines.mark(60, 10);      // spans two lines
+    lines.mark(128, 64);
+    lines.mark(100000, 5000);
+    size_t expected = (3 + ((100000 + 5000 - 1) / 64 - 100000 / 64 + 1)) * 64;
+    report("dirty lines counted once", lines.dirty_bytes() == expected && lines.mark(10, 1) == expected);
+    report("ranged flush takes only its lines", lines.flush(cxl_ssd::PersistMode::LAZY, 0, 4096) == 192 &&
+                                                 lines.dirty_bytes() == expected - 192);
+    report("full flush drains the set", lines.flush(cxl_ssd::PersistMode::LAZY) == expected - 192 &&
+                                        lines.dirty_bytes() == 0 &&
+                                        lines.flush(cxl_ssd::PersistMode::LAZY) == 0);
+
+    cxl_intercept::DirtyTracker pages(mem.data(), mem.size(), 12);
+    pages.mark(4095, 2);
+    report("page granule", pages.dirty_bytes() == 8192);
+
+    // Intercepted writes in lazy mode
+    const char* previous = fio_intercept_get_persist_mode();
+    std::string restore = previous;
+    report("switch to lazy", fio_intercept_set_persist_mode("lazy") == 0 &&
+                             strcmp(fio_intercept_get_persist_mode(), "lazy") == 0);
+    int fd = open(fake_path("lazy").c_str(), O_RDWR | O_CREAT, 0644);
+    int fd2 = open(fake_path("lazy").c_str(), O_RDWR);
+    char buf[32] = {0};
+    bool ok = true;
+    for (int i = 0; i < 256; i++) ok = ok && pwrite(fd, "record", 6, i * 100) == 6;
+    report("lazy pwrite", ok && pread(fd2, buf, 6, 25500) == 6 && memcmp(buf, "record", 6) == 0);
+    report("fdatasync on another fd", fdatasync(fd2) == 0);
+    report("sync_file_range", pwrite(fd, "tail", 4, 1 << 20) == 4 &&
+                              sync_file_range(fd, 1 << 20, 4096, SYNC_FILE_RANGE_WRITE) == 0);
+    report("fsync", fsync(fd) == 0);
+    close(fd2);
+    close(fd);
+    fio_intercept_set_persist_mode(restore.c_str());
+    unlink(fake_path("lazy").c_str());
+}
+
+void test_catalog() {
+    std::cout << "\n=== Extent Catalog Test ===" << std::endl;
+
+    const char marker[] = "catalog-marker";
+    char buf[64] = {0};
+
+    int a = open(fake_path("cat-a").c_str(), O_RDWR | O_CREAT, 0644);
+    int b = open(fake_path("cat-b").c_str(), O_RDWR | O_CREAT, 0644);
+    report("pwrite to two files", pwrite(a, "AAAA", 4, 0) == 4 && pwrite(b, "BBBB", 4, 0) == 4);
+    report("files have disjoint extents", pread(a, buf, 4, 0) == 4 && memcmp(buf, "AAAA", 4) == 0);
+    report("extent is chunk aligned", lseek(a, 0, SEEK_END) % (2 << 20) == 0);
+    void* direct = mmap(nullptr, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, a, 0);
+    report("extent is hugepage aligned in memory", direct != MAP_FAILED &&
+                                                   reinterpret_cast<uintptr_t>(direct) % (2 << 20) == 0);
+    munmap(direct, 4096);
+
+    // Startup recorded how the regions were mapped
+    std::string meta_path = "/tmp/fio_dax_meta." + std::to_string(getpid()) + ".json";
+    std::ifstream meta_in(meta_path);
+    std::stringstream meta;
+    meta << meta_in.rdbuf();
+    report("run metadata records alignment and page size",
+           meta.str().find("\"align\": 2097152") != std::string::npos &&
+           meta.str().find("\"chunk_size\": 2097152") != std::string::npos &&
+           meta.str().find("\"page_size\": ") != std::string::npos);
+    unlink(meta_path.c_str());
+    pwrite(a, marker, sizeof(marker), 8192);
+    close(a);
+    close(b);
+
+    a = open(fake_path("cat-a").c_str(), O_RDWR);
+    memset(buf, 0, sizeof(buf));
+    report("re-open finds existing extent", pread(a, buf, sizeof(marker), 8192) == (ssize_t)sizeof(marker) &&
+                                            strcmp(buf, marker) == 0);
+    close(a);
+
+    // Another process sees files created through the shared catalog
+    pid_t pid = fork();
+    if (pid == 0) {
+        int fd = open(fake_path("cat-child").c_str(), O_RDWR | O_CREAT, 0644);
+        _exit(fd >= 0 && pwrite(fd, marker, sizeof(marker), 0) == (ssize_t)sizeof(marker) ? 0 : 1);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    int c = open(fake_path("cat-child").c_str(), O_RDWR);
+    memset(buf, 0, sizeof(buf));
+    report("file created by child process", WIFEXITED(status) && WEXITSTATUS(status) == 0 &&
+                                            pread(c, buf, sizeof(marker), 0) == (ssize_t)sizeof(marker) &&
+                                            strcmp(buf, marker) == 0);
+    close(c);
+
+    // Fill the region, then check unlink returns space to the allocator
+    int filled = 0;
+    while (filled < 64) {
+        int fd = open(fake_path("fill" + std::to_string(filled)).c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0) break;
+        close(fd);
+        filled++;
+    }
+    report("full region fails with ENOSPC", filled > 0 && filled < 64 && errno == ENOSPC);
+    report("unlink reclaims extent", unlink(fake_path("fill0").c_str()) == 0);
+    int fd = open(fake_path("fill-new").c_str(), O_RDWR | O_CREAT, 0644);
+    report("open succeeds after unlink", fd >= 0);
+    close(fd);
+    report("unlink of unknown file fails", unlink(fake_path("missing").c_str()) < 0 && errno == ENOENT);
+
+    unlink(fake_path("fill-new").c_str());
+    for (int i = 1; i < filled; i++) unlink(fake_path("fill" + std::to_string(i)).c_str());
+    for (const char* name : {"cat-a", "cat-b", "cat-child"}) unlink(fake_path(name).c_str());
+}
+
+void test_numa() {
+    std::cout << "\n=== NUMA Placement Test ===" << std::endl;
+
+    auto specs = cxl_intercept::parse_region_list("/dev/dax0.0,/dev/dax1.0:4G@1");
+    report("region list parsing", specs.size() == 2 && specs[0].path == "/dev/dax0.0" &&
+                                  specs[0].size == 0 && specs[0].node == -1 &&
+                                  specs[1].path == "/dev/dax1.0" && specs[1].size == (4ULL << 30) &&
+                                  specs[1].node == 1);
+
+    // main() maps two regions pinned to nodes 0 and 1; st_ino carries the
+    // region index in its top bits
+    auto region_of = [](int fd) {
+        struct stat st;
+        return fstat(fd, &st) == 0 ? static_cast<int>(st.st_ino >> 48) : -1;
+    };
+    int near_fd = open(fake_path("numa-near").c_str(), O_RDWR | O_CREAT, 0644);
+    int far_fd = open(fake_path("numa-far").c_str(), O_RDWR | O_CREAT, 0644);
+    report("placement rule node 0", region_of(near_fd) == 0);
+    report("placement rule node 1", region_of(far_fd) == 1);
+
+    int node = cxl_intercept::current_numa_node();
+    int local_fd = open(fake_path("numa-local").c_str(), O_RDWR | O_CREAT, 0644);
+    report("new file on the opener's node", region_of(local_fd) == (node == 1 ? 1 : 0));
+
+    const char msg[] = "far-region";
+    char buf[32] = {0};
+    report("I/O on the second region", pwrite(far_fd, msg, sizeof(msg), 4096) == (ssize_t)sizeof(msg) &&
+                                       pread(far_fd, buf, sizeof(msg), 4096) == (ssize_t)sizeof(msg) &&
+                                       strcmp(buf, msg) == 0);
+    close(far_fd);
+    far_fd = open(fake_path("numa-far").c_str(), O_RDWR);
+    memset(buf, 0, sizeof(buf));
+    report("re-open finds the second region", region_of(far_fd) == 1 &&
+                                              pread(far_fd, buf, sizeof(msg), 4096) == (ssize_t)sizeof(msg) &&
+                                              strcmp(buf, msg) == 0);
+
+    // The per-region breakdown is written when a process exits
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid == 0) {
+        setenv("FIO_NUMA_STATS_FILE", "/tmp/fio_numa_stats.%p.json", 1);
+        std::vector<char> block(1 << 20, 'n');
+        bool ok = pwrite(far_fd, block.data(), block.size(), 0) == (ssize_t)block.size();
+        exit(ok ? 0 : 1);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    std::string stats_path = "/tmp/fio_numa_stats." + std::to_string(pid) + ".json";
+    unsigned long long written = read_stats(stats_path, "write_bytes", "\"node\": 1");
+    unsigned long long remote = read_stats(stats_path, "remote_write_bytes", "\"node\": 1");
+    report("per-node traffic at exit", WIFEXITED(status) && WEXITSTATUS(status) == 0 &&
+                                       written >= (1 << 20) && (node == 1 || remote >= (1 << 20)));
+    unlink(stats_path.c_str());
+
+    close(near_fd);
+    close(far_fd);
+    close(local_fd);
+    for (const char* name : {"numa-near", "numa-far", "numa-local"}) unlink(fake_path(name).c_str());
+}
+
+// Runs in a re-executed child with FIO_LAT_HIST_FILE set; the histograms
+// are written when it exits
+void latency_child() {
+    int fd = open(fake_path("latency").c_str(), O_RDWR | O_CREAT, 0644);
+    char buf[4096];
+    memset(buf, 'l', sizeof(buf));
+    for (int i = 0; i < 100; i++) pwrite(fd, buf, sizeof(buf), i * sizeof(buf));
+    for (int i = 0; i < 50; i++) pread(fd, buf, sizeof(buf), i * sizeof(buf));
+    fsync(fd);
+    close(fd);
+}
+
+void test_namespace() {
+    std::cout << "\n=== Shared Namespace Test ===" << std::endl;
+
+    const char marker[] = "namespace-marker";
+    char buf[64] = {0};
+    struct stat st_old, st_new;
+
+    // Unlinked while open: the fd keeps the data, the name is free for a new file
+    int fd = open(fake_path("ns-open").c_str(), O_RDWR | O_CREAT, 0644);
+    pwrite(fd, marker, sizeof(marker), 0);
+    bool unlinked = unlink(fake_path("ns-open").c_str()) == 0;
+    report("unlinked name is gone while open", unlinked && stat(fake_path("ns-open").c_str(), &st_old) < 0);
+    int fd2 = open(fake_path("ns-open").c_str(), O_RDWR | O_CREAT, 0644);
+    pwrite(fd2, "XXXXXXXXXXXXXXXX", 16, 0);
+    report("re-created name gets a new extent", fstat(fd, &st_old) == 0 && fstat(fd2, &st_new) == 0 &&
+                                                st_old.st_ino != st_new.st_ino);
+    report("open fd still reads unlinked data", pread(fd, buf, sizeof(marker), 0) == (ssize_t)sizeof(marker) &&
+                                                strcmp(buf, marker) == 0);
+    close(fd);
+    close(fd2);
+    unlink(fake_path("ns-open").c_str());
+
+    // Another process keeps a file open across our unlink and re-create
+    fd = open(fake_path("ns-shared").c_str(), O_RDWR | O_CREAT, 0644);
+    pwrite(fd, marker, sizeof(marker), 0);
+    close(fd);
+    int opened[2], go[2];
+    if (pipe(opened) != 0 || pipe(go) != 0) {
+        report("pipe", false);
+        return;
+    }
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid == 0) {
+        char c = 0, got[64] = {0};
+        int cfd = open(fake_path("ns-shared").c_str(), O_RDWR);
+        if (write(opened[1], "o", 1) != 1 || read(go[0], &c, 1) != 1) _exit(2);
+        bool ok = pread(cfd, got, sizeof(marker), 0) == (ssize_t)sizeof(marker) && strcmp(got, marker) == 0;
+        close(cfd);
+        _exit(ok ? 0 : 1);
+    }
+    char c = 0;
+    bool synced = read(opened[0], &c, 1) == 1;
+    unlink(fake_path("ns-shared").c_str());
+    fd = open(fake_path("ns-shared").c_str(), O_RDWR | O_CREAT, 0644);
+    std::vector<char> fill(kFileSize, 'Z');
+    bool refilled = pwrite(fd, fill.data(), fill.size(), 0) == (ssize_t)fill.size();
+    synced = synced && write(go[1], "g", 1) == 1;
+    int status = 0;
+    waitpid(pid, &status, 0);
+    report("unlink defers to the other process's close", synced && refilled && WIFEXITED(status) &&
+                                                         WEXITSTATUS(status) == 0);
+    close(fd);
+    unlink(fake_path("ns-shared").c_str());
+    for (int p : {opened[0], opened[1], go[0], go[1]}) close(p);
+
+    // Namespace primitives on a scratch segment
+    char path[] = "/tmp/fio_ns_scratch.XXXXXX";
+    int dev = mkstemp(path);
+    cxl_intercept::ShmNamespace ns;
+    uint64_t freed_offset = 0, freed_length = 0;
+    auto on_free = [&](uint64_t offset, uint64_t length) {
+        freed_offset = offset;
+        freed_length = length;
+    };
+    if (dev < 0 || !ns.attach(dev, 1 << 20, false, on_free)) {
+        report("scratch namespace attaches", false);
+        return;
+    }
+    std::cout.flush();
+    pid = fork();
+    if (pid == 0) {
+        ns.lock();
+        _exit(0);  // dies holding the lock
+    }
+    waitpid(pid, &status, 0);
+    ns.lock();
+    report("lock recovered from a dead holder", true);
+
+    uint64_t offset = 0, length = 0, unref_offset = 0, unref_length = 0;
+    int32_t slot = ns.insert("/x/a", 7, 4 << 20, 2 << 20);
+    bool counted = slot >= 0 && ns.ref("/x/a", 7, offset, length) == slot && offset == (4 << 20) &&
+                   ns.orphan("/x/a", 7) && ns.ref("/x/a", 7, offset, length) < 0 &&
+                   !ns.unref(slot, unref_offset, unref_length) &&
+                   ns.unref(slot, unref_offset, unref_length) && unref_offset == (4 << 20);
+    report("last unref of an orphan frees it", counted);
+
+    // An orphan left open is freed by the last process out
+    slot = ns.insert("/x/b", 9, 8 << 20, 2 << 20);
+    ns.orphan("/x/b", 9);
+    ns.unlock();
+    ns.detach(on_free);
+    struct stat seg;
+    std::string seg_path = "/dev/shm/cxl-ns.";
+    if (fstat(dev, &seg) == 0) {
+        char id[48];
+        snprintf(id, sizeof(id), "%llx.%llx", (unsigned long long)seg.st_dev, (unsigned long long)seg.st_ino);
+        seg_path += id;
+    }
+    report("last detach frees orphans and removes the segment",
+           freed_offset == (8 << 20) && freed_length == (2 << 20) && access(seg_path.c_str(), F_OK) != 0);
+    ::close(dev);
+    unlink(path);
+}
+
+void test_latency() {
+    std::cout << "\n=== Latency Histogram Test ===" << std::endl;
+
+    using cxl_intercept::LatencyHistogram;
+    bool bounds_ok = true;
+    for (uint64_t v : {0ULL, 1ULL, 63ULL, 64ULL, 65ULL, 1000ULL, 123456ULL, 1ULL << 40, (1ULL << 44) + 7}) {
+        unsigned b = LatencyHistogram::bucket_of(v);
+        bounds_ok = bounds_ok && LatencyHistogram::bucket_low(b) <= v && v <= LatencyHistogram::bucket_high(b) &&
+                    (b == 0 || LatencyHistogram::bucket_high(b - 1) + 1 == LatencyHistogram::bucket_low(b));
+    }
+    report("buckets cover values contiguously", bounds_ok);
+
+    LatencyHistogram h;
+    for (uint64_t v = 1; v <= 10000; v++) h.record(v);
+    uint64_t p50 = h.percentile(50), p99 = h.percentile(99);
+    report("percentiles within bucket error", h.count() == 10000 && h.min() == 1 && h.max() == 10000 &&
+                                              p50 > 5000 * 0.96 && p50 < 5000 * 1.04 &&
+                                              p99 > 9900 * 0.96 && p99 <= 10000);
+
+    const char* hist = "/tmp/fio_lat_hist.%p.json";
+    Child child = run_child("latency-child", {{"FIO_LAT_HIST_FILE", hist}});
+    std::string path = child.path(hist);
+    std::string text = read_file(path);
+    auto op_count = [&](const char* op) {
+        return read_stats(path, "N", std::string("\"") + op + "\": {\"clat_ns\"");
+    };
+    report("histograms written at exit", child.exited() &&
+                                         text.find(fake_path("latency")) != std::string::npos &&
+                                         text.find("\"99.990000\"") != std::string::npos &&
+                                         text.find("\"bins\"") != std::string::npos);
+    report("per-op sample counts", op_count("write") == 100 && op_count("read") == 50 && op_count("sync") == 1);
+    unlink(path.c_str());
+    unlink(fake_path("latency").c_str());
+}
+
+// Slowest close() of another file while a thread makes `writes` pwrite()s
+// to path, which the child's configuration makes slow
+double slowest_close_ms(const std::string& path, int writes) {
+    std::vector<char> block(4096, 's');
+    int slow = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    std::atomic<bool> writing{true};
+    std::thread writer([&]() {
+        for (int i = 0; i < writes; i++) pwrite(slow, block.data(), block.size(), i * block.size());
+        writing = false;
+    });
+    double slowest = 0;
+    for (int i = 0; i < 10 && writing; i++) {
+        int fd = open(fake_path("close-churn").c_str(), O_RDWR | O_CREAT, 0644);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        auto start = std::chrono::steady_clock::now();
+        if (close(fd) != 0) slowest = 1e9;
+        slowest = std::max(slowest,
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+    writer.join();
+    close(slow);
+    unlink(path.c_str());
+    unlink(fake_path("close-churn").c_str());
+    return slowest;
+}
+
+// Runs in a re-executed child with 40ms emulated writes: a writer waiting
+// out its device time holds no epoch, so close() of another file does not
+// wait for it
+void timing_child() {
+    exit(slowest_close_ms(fake_path("timing-slow"), 5) < 25 ? 0 : 1);
+}
+
+void test_timing() {
+    std::cout << "\n=== Timing Model Test ===" << std::endl;
+
+    using cxl_intercept::LatOp;
+    using cxl_intercept::TimingModel;
+    using cxl_intercept::TimingParams;
+
+    std::string conf = "/tmp/fio_timing_model." + std::to_string(getpid()) + ".conf";
+    {
+        std::ofstream out(conf);
+        out << "# fitted\nread_ns = 9000\nwrite_ns_per_byte = 0.25\nmiss_rate = 0.5\n";
+    }
+    TimingParams p;
+    bool parsed = p.parse_spec((conf + ",miss_rate=0,bandwidth_mbps=4000").c_str());
+    report("model file and overrides parsed", parsed && p.read_ns == 9000 && p.write_ns_per_byte == 0.25 &&
+                                              p.miss_rate == 0 && p.bandwidth_mbps == 4000);
+    report("missing model file rejected", !TimingParams().parse_spec("/nonexistent/model.conf"));
+    unlink(conf.c_str());
+
+    auto elapsed_us = [](auto start) {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    TimingModel base;
+    TimingParams bp;
+    bp.read_ns = 200000;
+    bp.write_ns_per_byte = 100;
+    base.configure(bp);
+    auto start = std::chrono::steady_clock::now();
+    base.delay(LatOp::READ, 4096, __rdtsc());
+    double read_us = elapsed_us(start);
+    start = std::chrono::steady_clock::now();
+    base.delay(LatOp::WRITE, 4096, __rdtsc());
+    double write_us = elapsed_us(start);
+    report("fixed and per-byte latency", read_us >= 200 * 0.98 && write_us >= 409.6 * 0.98);
+
+    // 100 MB/s: two back-to-back 1MB transfers take 2 x 10.5ms
+    TimingModel bw;
+    TimingParams wp;
+    wp.bandwidth_mbps = 100;
+    bw.configure(wp);
+    start = std::chrono::steady_clock::now();
+    uint64_t t0 = __rdtsc();
+    bw.delay(LatOp::WRITE, 1 << 20, t0);
+    bw.delay(LatOp::WRITE, 1 << 20, t0);
+    report("bandwidth queues transfers", elapsed_us(start) >= 2 * 10485.76 * 0.98);
+
+    TimingModel miss;
+    TimingParams mp;
+    mp.miss_rate = 1;
+    mp.miss_ns = 300000;
+    miss.configure(mp);
+    start = std::chrono::steady_clock::now();
+    miss.delay(LatOp::READ, 4096, __rdtsc());
+    report("slow-tier miss latency", elapsed_us(start) >= 300 * 0.98);
+
+    Child child = run_child("timing-child", {{"FIO_CXL_TIMING", "write_ns=40000000"}});
+    report("close not held up by emulated device time", child.exited());
+}
+
+// Runs in a re-executed child tracing into 64-record rings that drain every
+// 500ms: a thread overflows its ring and exits, its ring is reaped, then
+// the main thread traces a few more ops
+void trace_child() {
+    int fd = open(fake_path("trace").c_str(), O_RDWR | O_CREAT, 0644);
+    char buf[4096];
+    memset(buf, 't', sizeof(buf));
+    std::thread burst([&]() {
+        for (int i = 0; i < 200; i++) pwrite(fd, buf, sizeof(buf), i * sizeof(buf));
+    });
+    burst.join();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1200));
+    for (int i = 0; i < 3; i++) pwrite(fd, buf, sizeof(buf), i * sizeof(buf));
+    for (int i = 0; i < 2; i++) pread(fd, buf, sizeof(buf), i * sizeof(buf));
+    fsync(fd);
+    close(fd);
+    unlink(fake_path("trace").c_str());
+}
+
+// Output of cxl_trace_decode with args, split into lines
+std::vector<std::string> trace_decode(const std::string& decoder, const std::string& args) {
+    std::vector<std::string> lines;
+    FILE* p = popen((decoder + " " + args).c_str(), "r");
+    if (!p) return lines;
+    char line[512];
+    while (fgets(line, sizeof(line), p)) lines.emplace_back(line);
+    pclose(p);
+    return lines;
+}
+
+size_t count_containing(const std::vector<std::string>& lines, const std::string& needle) {
+    return std::count_if(lines.begin(), lines.end(),
+                         [&](const std::string& l) { return l.find(needle) != std::string::npos; });
+}
+
+void test_trace() {
+    std::cout << "\n=== Trace Round-Trip Test ===" << std::endl;
+
+    // The decoder is built next to the test
+    char exe[4096] = {0};
+    ssize_t len = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+    std::string decoder = std::string(exe, len > 0 ? len : 0);
+    decoder = decoder.substr(0, decoder.rfind('/') + 1) + "cxl_trace_decode";
+    if (access(decoder.c_str(), X_OK) != 0) {
+        std::cout << "cxl_trace_decode not built, skipping" << std::endl;
+        return;
+    }
+
+    const char* trace = "/tmp/fio_trace_test.%p.trace";
+    Child child = run_child("trace-child", {{"FIO_TRACE_FILE", trace},
+                                            {"FIO_TRACE_RING_RECORDS", "64"},
+                                            {"FIO_TRACE_FLUSH_MS", "500"}});
+    std::string path = child.path(trace);
+
+    // open, 64 of 200 pwrites, 3 pwrites, 2 preads, fsync, close, unlink
+    std::vector<std::string> text = trace_decode(decoder, path);
+    report("trace written at exit", child.exited() && text.size() == 74);
+    report("drops of a reaped ring still counted",
+           !text.empty() && text[0].find("records=73 dropped=136 ") != std::string::npos);
+    report("text records", count_containing(text, " pwrite ") == 67 && count_containing(text, " pread ") == 2 &&
+                           count_containing(text, " open ") == 1 && count_containing(text, " fsync ") == 1);
+
+    std::vector<std::string> csv = trace_decode(decoder, "--csv " + path);
+    report("csv records", csv.size() == 74 && csv[0].rfind("time_ns,tid,op,fd,", 0) == 0 &&
+                          count_containing(csv, ",pwrite,") == 67 && count_containing(csv, ",close,") == 1);
+
+    std::vector<std::string> summary = trace_decode(decoder, "--summary " + path);
+    unsigned long long count = 0, bytes = 0;
+    for (const std::string& line : summary) {
+        if (line.rfind("pwrite ", 0) == 0) sscanf(line.c_str(), "pwrite %llu %llu", &count, &bytes);
+    }
+    report("summary totals", count == 67 && bytes == 67 * 4096);
+    unlink(path.c_str());
+}
+
+// Runs in a re-executed child whose regions are mapped in 64MB windows, at
+// most two live; the exit status says whether every byte read back intact
+void windows_child() {
+    // A direct mapping pins its windows only until munmap(), so mapping
+    // every file first leaves their windows free to be evicted below
+    std::atomic<int> bad{0};
+    for (int i = 0; i < 8; i++) {
+        int f = open(fake_path("window" + std::to_string(i)).c_str(), O_RDWR | O_CREAT, 0644);
+        char* m = static_cast<char*>(mmap(nullptr, kFileSize, PROT_READ | PROT_WRITE, MAP_SHARED, f, 0));
+        char c = 0;
+        if (m != MAP_FAILED) {
+            m[kFileSize / 2] = 'M';
+            munmap(m, kFileSize);
+        }
+        if (m == MAP_FAILED || pread(f, &c, 1, kFileSize / 2) != 1 || c != 'M') bad++;
+        close(f);
+    }
+
+    // Threads write and verify files in different windows, so each access
+    // evicts a window another thread may still be copying from
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([t, &bad] {
+            int fds[2];
+            for (int f = 0; f < 2; f++) {
+                fds[f] = open(fake_path("window" + std::to_string(t * 2 + f)).c_str(), O_RDWR | O_CREAT, 0644);
+                if (fds[f] < 0) bad++;
+            }
+            std::vector<char> buf(1 << 20), check(1 << 20);
+            for (int pass = 0; pass < 3 && !bad; pass++) {
+                for (size_t off = 0; off < kFileSize; off += buf.size()) {
+                    for (int f = 0; f < 2; f++) {
+                        memset(buf.data(), 'A' + t * 6 + pass * 2 + f, buf.size());
+                        if (pwrite(fds[f], buf.data(), buf.size(), off) != (ssize_t)buf.size()) bad++;
+                    }
+                }
+                for (size_t off = 0; off < kFileSize; off += buf.size()) {
+                    for (int f = 0; f < 2; f++) {
+                        memset(buf.data(), 'A' + t * 6 + pass * 2 + f, buf.size());
+                        if (pread(fds[f], check.data(), check.size(), off) != (ssize_t)check.size() ||
+                            memcmp(buf.data(), check.data(), buf.size()) != 0) {
+                            bad++;
+                        }
+                    }
+                }
+            }
+            for (int f = 0; f < 2; f++) close(fds[f]);
+        });
+    }
+    for (auto& th : threads) th.join();
+
+    // A direct mapping keeps its window while others come and go
+    int fd = open(fake_path("window0").c_str(), O_RDWR, 0644);
+    char* p = static_cast<char*>(mmap(nullptr, kFileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+    char buf[4096];
+    int other = open(fake_path("window7").c_str(), O_RDWR, 0644);
+    for (size_t off = 0; off < kFileSize; off += sizeof(buf)) pread(other, buf, sizeof(buf), off);
+    if (p == MAP_FAILED || p[0] != 'A' + 4 || p[kFileSize - 1] != 'A' + 4) bad++;
+    munmap(p, kFileSize);
+    close(other);
+    close(fd);
+
+    // With the regions' fds gone a window can no longer be mapped: reads
+    // that need one fail with EIO instead of taking the process down
+    std::vector<std::string> paths;
+    for (const auto& spec : cxl_intercept::parse_region_list(getenv("FIO_TEST_REGION"))) {
+        char* real = realpath(spec.path.c_str(), nullptr);
+        if (real) paths.push_back(real);
+        free(real);
+    }
+    for (int rfd = 3; rfd < 1024; rfd++) {
+        char link[PATH_MAX];
+        ssize_t len = readlink(("/proc/self/fd/" + std::to_string(rfd)).c_str(), link, sizeof(link) - 1);
+        if (len <= 0) continue;
+        link[len] = '\0';
+        if (std::find(paths.begin(), paths.end(), link) != paths.end()) syscall(SYS_close, rfd);
+    }
+    bool failed = false;
+    for (int i = 0; i < 8 && !failed; i++) {
+        int f = open(fake_path("window" + std::to_string(i)).c_str(), O_RDWR, 0644);
+        for (size_t off = 0; off < kFileSize && !failed; off += sizeof(buf)) {
+            ssize_t got = pread(f, buf, sizeof(buf), off);
+            if (got < 0) failed = errno == EIO;
+            else if (got != (ssize_t)sizeof(buf)) bad++;
+        }
+        close(f);
+    }
+
+    for (int i = 0; i < 8; i++) unlink(fake_path("window" + std::to_string(i)).c_str());
+    exit(bad ? 1 : failed ? 0 : 3);
+}
+
+void test_windows() {
+    std::cout << "\n=== Windowed Mapping Test ===" << std::endl;
+
+    std::string log = "/tmp/fio_windows." + std::to_string(getpid()) + ".log";
+    Child child = run_child("windows-child", {{"FIO_DAX_WINDOW", "64M"},
+                                              {"FIO_DAX_MAX_WINDOWS", "2"},
+                                              {"FIO_DAX_PERSIST", nullptr}},  // lazy mode pins open files
+                            log);
+
+    // "[DAX_REGION] <path>: <maps> window maps, <evictions> evictions, peak <n> live"
+    std::ifstream in(log);
+    std::string line;
+    bool windowed = false;
+    unsigned long long evictions = 0;
+    size_t peak = 0;
+    while (std::getline(in, line)) {
+        if (line.find("mapping 64 MB windows on demand, at most 2 live") != std::string::npos) windowed = true;
+        size_t at = line.find(" window maps, ");
+        if (at == std::string::npos) continue;
+        unsigned long long e = 0;
+        size_t n = 0;
+        if (sscanf(line.c_str() + at, " window maps, %llu evictions, peak %zu live", &e, &n) == 2) {
+            evictions += e;
+            if (n > peak) peak = n;
+        }
+    }
+    unlink(log.c_str());
+    report("regions mapped in windows", windowed);
+    report("data intact across evictions", child.exited() || child.exited(3));
+    report("unmappable window fails the read with EIO", child.exited());
+    report("windows evicted and remapped", evictions > 0);
+    // The catalog's window and the direct mapping's are pinned
+    report("live windows stay bounded", peak > 0 && peak <= 3);
+}
+
+// Runs in a re-executed child with write combining on; the exit status
+// says whether every combined write read back intact
+void write_combine_child() {
+    int fd = open(fake_path("wc").c_str(), O_RDWR | O_CREAT, 0644);
+    bool ok = fd >= 0;
+
+    // 8 bytes at a time: 8 lines, each written 8 times
+    for (uint64_t i = 0; i < 64; i++) ok = ok && pwrite(fd, &i, sizeof(i), i * sizeof(i)) == sizeof(i);
+
+    // Staged bytes are visible to other threads before any write-back
+    std::thread reader([&] {
+        uint64_t v[64];
+        ok = ok && pread(fd, v, sizeof(v), 0) == (ssize_t)sizeof(v);
+        for (uint64_t i = 0; i < 64; i++) ok = ok && v[i] == i;
+    });
+    reader.join();
+
+    // The last line is written back by the flusher once it has waited
+    // FIO_DAX_WC_FLUSH_US; a write across two lines is not combined
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    const char edge[] = "edge-wc";
+    ok = ok && pwrite(fd, edge, sizeof(edge), 60) == (ssize_t)sizeof(edge);
+    char back[sizeof(edge)];
+    ok = ok && pread(fd, back, sizeof(back), 60) == (ssize_t)sizeof(back) && memcmp(back, edge, sizeof(edge)) == 0;
+    ok = ok && fsync(fd) == 0;
+    close(fd);
+    unlink(fake_path("wc").c_str());
+    exit(ok ? 0 : 1);
+}
+
+void test_write_combine() {
+    std::cout << "\n=== Write Combining Test ===" << std::endl;
+
+    const char* stats = "/tmp/fio_wc_stats.%p.json";
+    Child child = run_child("write-combine-child", {{"FIO_DAX_WRITE_COMBINE", "1"},
+                                                    {"FIO_DAX_WC_FLUSH_US", "100000"},
+                                                    {"FIO_WC_STATS_FILE", stats},
+                                                    {"FIO_DAX_PERSIST", nullptr}});  // lazy mode does not combine
+    std::string path = child.path(stats);
+    report("combined writes read back", child.exited());
+    report("adjacent writes share a line", read_stats(path, "writes") == 64 && read_stats(path, "combined") == 56);
+    report("one write-back per line", read_stats(path, "line_writebacks") == 8);
+    unlink(path.c_str());
+}
+
+// Runs in a re-executed child with a 16KB prefetch distance: 16
+// sequential 4KB reads of a 64KB pattern, then a seek back that breaks the
+// stream; the exit status says whether the data read back intact
+void prefetch_child() {
+    int fd = open(fake_path("prefetch").c_str(), O_RDWR | O_CREAT, 0644);
+    bool ok = fd >= 0;
+    std::vector<char> data(64 * 1024);
+    for (size_t i = 0; i < data.size(); i++) data[i] = static_cast<char>(i * 7 + 3);
+    ok = ok && pwrite(fd, data.data(), data.size(), 0) == (ssize_t)data.size();
+
+    char buf[4096];
+    for (size_t off = 0; ok && off < data.size(); off += sizeof(buf)) {
+        ok = read(fd, buf, sizeof(buf)) == (ssize_t)sizeof(buf) && memcmp(buf, &data[off], sizeof(buf)) == 0;
+    }
+    ok = ok && pread(fd, buf, sizeof(buf), 0) == (ssize_t)sizeof(buf) && memcmp(buf, data.data(), sizeof(buf)) == 0;
+    close(fd);
+    unlink(fake_path("prefetch").c_str());
+    exit(ok ? 0 : 1);
+}
+
+void test_prefetch() {
+    std::cout << "\n=== Stream Prefetch Test ===" << std::endl;
+
+    const char* stats = "/tmp/fio_prefetch_stats.%p.json";
+    Child child = run_child("prefetch-child", {{"FIO_DAX_PREFETCH", "16K"},
+                                               {"FIO_DAX_PREFETCH_HINT", "nta"},
+                                               {"FIO_PREFETCH_STATS_FILE", stats}});
+    std::string path = child.path(stats);
+    report("prefetched reads intact", child.exited());
+    report("seek back breaks the stream", read_stats(path, "reads") == 17 && read_stats(path, "sequential") == 16);
+    // From the third read on, [8KB, 80KB): the last 16KB lie past what is read
+    report("each line prefetched once", read_stats(path, "lines_issued") == (72 * 1024) / 64);
+    report("lines read after prefetch count as useful", read_stats(path, "lines_useful") == (56 * 1024) / 64);
+    unlink(path.c_str());
+}
+
+// Runs in a re-executed child with verification on. Writes full and
+// partial blocks, reads them back, reads a block never written, then flips
+// a byte of the file in the backing region behind the library's back.
+void verify_child() {
+    std::string path = fake_path("verify");
+    int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    bool ok = fd >= 0;
+    std::string magic = "verify-child-" + std::to_string(getpid());
+    std::vector<char> data(64 * 1024);
+    for (size_t i = 0; i < data.size(); i++) data[i] = static_cast<char>(i * 13 + 5);
+    memcpy(data.data(), magic.data(), magic.size());
+    ok = ok && pwrite(fd, data.data(), data.size(), 0) == (ssize_t)data.size();
+    const char tail[] = "partial block write";
+    ok = ok && pwrite(fd, tail, sizeof(tail), 70000) == (ssize_t)sizeof(tail);
+
+    std::vector<char> back(data.size());
+    ok = ok && pread(fd, back.data(), back.size(), 0) == (ssize_t)back.size() && back == data;
+    char small[sizeof(tail)];
+    ok = ok && pread(fd, small, sizeof(small), 70000) == (ssize_t)sizeof(small) &&
+         memcmp(small, tail, sizeof(tail)) == 0;
+    char block[4096];
+    ok = ok && pread(fd, block, sizeof(block), 1 << 20) == (ssize_t)sizeof(block);
+
+    // Find the file in the backing regions and corrupt its second block
+    bool corrupted = false;
+    for (const auto& spec : cxl_intercept::parse_region_list(getenv("FIO_TEST_REGION"))) {
+        int rfd = static_cast<int>(syscall(SYS_openat, AT_FDCWD, spec.path.c_str(), O_RDWR));
+        if (rfd < 0) continue;
+        char* p = static_cast<char*>(reinterpret_cast<void*>(
+            syscall(SYS_mmap, nullptr, kRegionSize, PROT_READ | PROT_WRITE, MAP_SHARED, rfd, 0)));
+        if (p != MAP_FAILED) {
+            char* hit = static_cast<char*>(memmem(p, kRegionSize, magic.data(), magic.size()));
+            if (hit) {
+                hit[5000] ^= 0x5a;
+                corrupted = true;
+            }
+            syscall(SYS_munmap, p, kRegionSize);
+        }
+        syscall(SYS_close, rfd);
+    }
+    ok = ok && corrupted && pread(fd, block, sizeof(block), 4096) == (ssize_t)sizeof(block);
+    close(fd);
+    unlink(path.c_str());
+    exit(ok ? 0 : 1);
+}
+
+void test_verify() {
+    std::cout << "\n=== CRC32C Verification Test ===" << std::endl;
+
+    // The three-lane path against the byte-wise table
+    std::vector<unsigned char> buf(20000);
+    for (size_t i = 0; i < buf.size(); i++) buf[i] = static_cast<unsigned char>(i * 31 + (i >> 7));
+    bool same = cxl_intercept::crc32c("123456789", 9) == 0xe3069283;
+    for (size_t n : {0, 1, 7, 8, 383, 384, 385, 3071, 3072, 3073, 4096, 19999}) {
+        for (size_t off : {0, 3}) {
+            same = same && cxl_intercept::crc32c(buf.data() + off, n, 7) ==
+                           cxl_intercept::crc32c_sw(buf.data() + off, n, 7);
+        }
+    }
+    report("crc32c matches the reference", same);
+
+    const char* stats = "/tmp/fio_verify_stats.%p.json";
+    Child child = run_child("verify-child", {{"FIO_DAX_VERIFY", "1"}, {"FIO_VERIFY_STATS_FILE", stats}});
+    std::string path = child.path(stats);
+    report("verified reads intact", child.exited());
+    // 16 full blocks and one partial one
+    report("written blocks checksummed", read_stats(path, "checksummed") == 17);
+    report("read blocks verified", read_stats(path, "verified") == 17 && read_stats(path, "unverified") == 1);
+    report("corruption detected", read_stats(path, "mismatches") == 1);
+    unlink(path.c_str());
+}
+
+// Runs in a re-executed child in thin mode. Overwrites 64KB of data with
+// zeroes, writes into two of the zero blocks, reads everything back and
+// finally maps the file, which must see zeroes rather than the old data.
+void thin_child() {
+    std::string path = fake_path("thin");
+    int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    bool ok = fd >= 0;
+    const size_t len = 64 * 1024;
+    std::vector<char> data(len, 'x');
+    std::vector<char> expect(len, 0);
+    ok = ok && pwrite(fd, data.data(), len, 0) == (ssize_t)len;
+    ok = ok && pwrite(fd, expect.data(), len, 0) == (ssize_t)len;
+    const char note[] = "partial write into a zero block";
+    ok = ok && pwrite(fd, note, sizeof(note), 4096 + 100) == (ssize_t)sizeof(note);
+    memcpy(expect.data() + 4096 + 100, note, sizeof(note));
+    std::vector<char> block(4096, 'y');
+    ok = ok && pwrite(fd, block.data(), block.size(), 8192) == (ssize_t)block.size();
+    memcpy(expect.data() + 8192, block.data(), block.size());
+
+    std::vector<char> back(len, 1);
+    ok = ok && pread(fd, back.data(), len, 0) == (ssize_t)len && back == expect;
+    void* m = mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0);
+    ok = ok && m != MAP_FAILED && memcmp(m, expect.data(), len) == 0;
+    if (m != MAP_FAILED) munmap(m, len);
+    close(fd);
+    unlink(path.c_str());
+    exit(ok ? 0 : 1);
+}
+
+void test_thin() {
+    std::cout << "\n=== Thin Zero Block Test ===" << std::endl;
+
+    std::vector<char> buf(8192 + 3, 0);
+    bool detect = cxl_intercept::is_zero(buf.data(), buf.size()) && cxl_intercept::is_zero(buf.data(), 0);
+    for (size_t at : {0, 63, 64, 255, 4096, 8194}) {
+        buf[at] = 1;
+        detect = detect && !cxl_intercept::is_zero(buf.data(), buf.size()) &&
+                 cxl_intercept::is_zero(buf.data() + at + 1, buf.size() - at - 1);
+        buf[at] = 0;
+    }
+    report("zero blocks detected", detect);
+
+    const char* stats = "/tmp/fio_thin_stats.%p.json";
+    Child child = run_child("thin-child", {{"FIO_DAX_THIN", "1"},
+                                           {"FIO_DAX_VERIFY", nullptr},
+                                           {"FIO_THIN_STATS_FILE", stats}});
+    std::string path = child.path(stats);
+    report("thin file reads back", child.exited());
+    report("zero blocks marked", read_stats(path, "elided_blocks") == 16);
+    // Two written into, the other 14 when the file was mapped
+    report("zero blocks filled", read_stats(path, "filled_blocks") == 16);
+    report("zero blocks read as zeroes", read_stats(path, "zero_reads") == 14);
+    unlink(path.c_str());
+}
+
+// Runs in a re-executed child with two QoS classes: 100 4KB writes to a
+// file whose path puts it in a 500 IOPS class, then 100 to one in this
+// process's tenant class, which has no limit. Exits 0 if the limited file
+// was paced and the other was not.
+void qos_child() {
+    std::vector<char> block(4096, 'q');
+    double elapsed_ms[2] = {};
+    bool ok = true;
+    const char* names[2] = {"qos-slow", "qos-fast"};
+    for (int f = 0; f < 2; f++) {
+        int fd = open(fake_path(names[f]).c_str(), O_RDWR | O_CREAT, 0644);
+        ok = ok && fd >= 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; ok && i < 100; i++) {
+            ok = pwrite(fd, block.data(), block.size(), i * block.size()) == (ssize_t)block.size();
+        }
+        elapsed_ms[f] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        close(fd);
+        unlink(fake_path(names[f]).c_str());
+    }
+    // 99 gaps of 2ms, less scheduling slack
+    ok = ok && elapsed_ms[0] >= 190 && elapsed_ms[1] < 100;
+
+    // A writer waiting out its 50ms gaps holds no epoch, so close() of
+    // another file does not wait for it
+    ok = ok && slowest_close_ms(fake_path("qos-crawl"), 8) < 25;
+    exit(ok ? 0 : 1);
+}
+
+void test_qos() {
+    std::cout << "\n=== Tenant QoS Test ===" << std::endl;
+
+    const char* stats = "/tmp/fio_qos_stats.%p.json";
+    Child child = run_child("qos-child", {{"FIO_QOS", "slow:match=qos-slow,limit_iops=500;"
+                                                      "crawl:match=qos-crawl,limit_iops=20;"
+                                                      "fast:tenant=t1,reserve_iops=100"},
+                                          {"FIO_QOS_DEVICE", "burst_us=0"},
+                                          {"FIO_QOS_TENANT", "t1"},
+                                          {"FIO_QOS_STATS_FILE", stats}});
+    std::string path = child.path(stats);
+    auto slow = [&](const char* key) { return read_stats(path, key, "\"class\": \"slow\""); };
+    auto fast = [&](const char* key) { return read_stats(path, key, "\"class\": \"fast\""); };
+    report("limited class paced, other class not, close not held up", child.exited());
+    report("classes by path and by tenant", slow("ops") == 100 && fast("ops") == 100 && slow("bytes") == 100 * 4096);
+    report("limited class delayed", slow("delayed_ops") >= 95 && slow("reserved_ops") == 0);
+    report("reservation admits without delay", fast("delayed_ops") == 0 && fast("reserved_ops") >= 1);
+    unlink(path.c_str());
+}
+
+// Runs in a re-executed child with *.wal files in append mode: a log
+// opened with O_TRUNC starts empty, grows with each append, reads back to
+// its tail and no further, and keeps its tail across opens until
+// ftruncate() or another O_TRUNC moves it. Exits 0 if all of that holds.
+void wal_child() {
+    std::string path = fake_path("db.wal");
+    int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    bool ok = fd >= 0;
+    struct stat st;
+    ok = ok && fstat(fd, &st) == 0 && st.st_size == 0;
+    char record[100];
+    for (int i = 0; ok && i < 100; i++) {
+        memset(record, 'a' + i % 26, sizeof(record));
+        ok = write(fd, record, sizeof(record)) == (ssize_t)sizeof(record);
+    }
+    ok = ok && fstat(fd, &st) == 0 && st.st_size == 10000;
+    ok = ok && lseek(fd, 0, SEEK_END) == 10000;
+    ok = ok && fdatasync(fd) == 0;
+    close(fd);
+
+    fd = open(path.c_str(), O_RDONLY);
+    ok = ok && fd >= 0;
+    std::vector<char> back(16384, 0);
+    ok = ok && read(fd, back.data(), back.size()) == 10000 && read(fd, back.data(), back.size()) == 0;
+    for (int i = 0; ok && i < 100; i++) ok = back[i * 100] == 'a' + i % 26 && back[i * 100 + 99] == 'a' + i % 26;
+    close(fd);
+    ok = ok && stat(path.c_str(), &st) == 0 && st.st_size == 10000;
+
+    fd = open(path.c_str(), O_RDWR);
+    ok = ok && fd >= 0 && ftruncate(fd, 5000) == 0 && fstat(fd, &st) == 0 && st.st_size == 5000;
+    ok = ok && pread(fd, back.data(), back.size(), 4000) == 1000;
+    close(fd);
+    fd = open(path.c_str(), O_RDWR | O_TRUNC);
+    ok = ok && fd >= 0 && fstat(fd, &st) == 0 && st.st_size == 0;
+    close(fd);
+    unlink(path.c_str());
+    exit(ok ? 0 : 1);
+}
+
+void test_wal() {
+    std::cout << "\n=== WAL Append Mode Test ===" << std::endl;
+
+    Child child = run_child("wal-child", {{"FIO_DAX_WAL", ".wal"}});
+    report("log size follows its appended tail", child.exited());
+}
+
+void test_copy() {
+    std::cout << "\n=== copy_file_range/sendfile/splice Test ===" << std::endl;
+
+    int src = open(fake_path("copy-src").c_str(), O_RDWR | O_CREAT, 0644);
+    int dst = open(fake_path("copy-dst").c_str(), O_RDWR | O_CREAT, 0644);
+    const size_t len = 1 << 20;
+    std::vector<char> data(len);
+    for (size_t i = 0; i < len; i++) data[i] = static_cast<char>(i * 7 + i / 4096);
+    pwrite(src, data.data(), len, 0);
+
+    off64_t in = 0, out = 4096;
+    std::vector<char> back(len, 0);
+    report("copy_file_range DAX to DAX", copy_file_range(src, &in, dst, &out, len, 0) == (ssize_t)len &&
+                                         in == (off64_t)len && out == (off64_t)(4096 + len) &&
+                                         pread(dst, back.data(), len, 4096) == (ssize_t)len && back == data);
+    lseek(src, 100, SEEK_SET);
+    lseek(dst, 0, SEEK_SET);
+    report("copy_file_range at file positions", copy_file_range(src, nullptr, dst, nullptr, 1000, 0) == 1000 &&
+                                                lseek(src, 0, SEEK_CUR) == 1100 && lseek(dst, 0, SEEK_CUR) == 1000 &&
+                                                pread(dst, back.data(), 1000, 0) == 1000 &&
+                                                memcmp(back.data(), data.data() + 100, 1000) == 0);
+    in = 0;
+    out = 100;
+    report("overlapping copy in one file refused",
+           copy_file_range(src, &in, src, &out, 4096, 0) < 0 && errno == EINVAL);
+
+    int p[2];
+    bool piped = pipe(p) == 0;
+    off_t offset = 5000;
+    std::vector<char> got(4096, 0);
+    report("sendfile DAX to pipe", piped && sendfile(p[1], src, &offset, 4000) == 4000 && offset == 9000 &&
+                                   read(p[0], got.data(), got.size()) == 4000 &&
+                                   memcmp(got.data(), data.data() + 5000, 4000) == 0);
+    off64_t at = 8192;
+    report("splice pipe to DAX", piped && write(p[1], "spliced-in", 10) == 10 &&
+                                 splice(p[0], nullptr, dst, &at, 10, 0) == 10 && at == 8202 &&
+                                 pread(dst, got.data(), 10, 8192) == 10 && memcmp(got.data(), "spliced-in", 10) == 0);
+    at = 8192;
+    report("splice DAX to pipe", piped && splice(dst, &at, p[1], nullptr, 10, 0) == 10 &&
+                                 read(p[0], got.data(), got.size()) == 10 && memcmp(got.data(), "spliced-in", 10) == 0);
+    report("splice with a pipe offset refused", splice(p[0], &at, dst, nullptr, 10, 0) < 0 && errno == ESPIPE);
+    if (piped) {
+        close(p[0]);
+        close(p[1]);
+    }
+
+    char real_path[] = "/tmp/fio-copy-real.XXXXXX";
+    int real = mkstemp(real_path);
+    bool real_ok = real >= 0 && write(real, "from a real file", 16) == 16;
+    offset = 0;
+    report("sendfile real file to DAX", real_ok && sendfile(dst, real, &offset, 16) == 16 && offset == 16 &&
+                                        pread(dst, got.data(), 16, 1000) == 16 &&
+                                        memcmp(got.data(), "from a real file", 16) == 0);
+    if (real >= 0) {
+        close(real);
+        unlink(real_path);
+    }
+
+    // A splice blocked on an empty pipe must not hold up close(), of
+    // another file or of the one it writes to; the writer gives up on the
+    // closes after 2s so a regression fails instead of hanging
+    int blocked[2];
+    bool blocked_pipe = pipe(blocked) == 0;
+    int sink = open(fake_path("copy-sink").c_str(), O_RDWR | O_CREAT, 0644);
+    int other = open(fake_path("copy-other").c_str(), O_RDWR | O_CREAT, 0644);
+    std::atomic<ssize_t> spliced{-2};
+    std::atomic<bool> closed{false};
+    std::thread reader([&] { spliced = splice(blocked[0], nullptr, sink, nullptr, 10, 0); });
+    std::thread writer([&] {
+        for (int i = 0; i < 200 && !closed; i++) std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        if (write(blocked[1], "unblocked!", 10) != 10) spliced = -3;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    auto start = std::chrono::steady_clock::now();
+    bool closes = close(other) == 0 && close(sink) == 0;
+    auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    closed = true;
+    writer.join();
+    reader.join();
+    report("close not held up by a blocked splice", blocked_pipe && closes && waited.count() < 1000 && spliced == 10);
+    if (blocked_pipe) {
+        close(blocked[0]);
+        close(blocked[1]);
+    }
+    unlink(fake_path("copy-sink").c_str());
+    unlink(fake_path("copy-other").c_str());
+
+    close(dst);
+    close(src);
+    unlink(fake_path("copy-src").c_str());
+    unlink(fake_path("copy-dst").c_str());
+}
+
+// Runs in a re-executed child in sparse mode. Creates 24 files of 16MB,
+// more than a whole region, writes 4KB into one chunk of each, and
+// checks each file holds exactly that chunk. Then a forked child writes a
+// second chunk of one file, which the parent must see, and a shared mmap()
+// of another allocates the chunk it covers.
+void sparse_child() {
+    constexpr int kFiles = 24;
+    constexpr size_t kChunk = 2ULL << 20;
+    std::vector<char> data(4096);
+    std::vector<char> back(4096);
+    int fds[kFiles];
+    bool ok = true;
+    for (int i = 0; i < kFiles; i++) {
+        fds[i] = open(fake_path("sparse-" + std::to_string(i)).c_str(), O_RDWR | O_CREAT, 0644);
+        memset(data.data(), 'a' + i % 26, data.size());
+        ok = ok && fds[i] >= 0 && pwrite(fds[i], data.data(), data.size(), (i % 8) * kChunk + 100) == 4096;
+    }
+    for (int i = 0; ok && i < kFiles; i++) {
+        struct stat st;
+        memset(data.data(), 'a' + i % 26, data.size());
+        ok = fstat(fds[i], &st) == 0 && st.st_size == (off_t)kFileSize && st.st_blocks == (blkcnt_t)(kChunk / 512) &&
+             pread(fds[i], back.data(), back.size(), (i % 8) * kChunk + 100) == 4096 && back == data &&
+             pread(fds[i], back.data(), back.size(), ((i + 1) % 8) * kChunk) == 4096 &&
+             std::all_of(back.begin(), back.end(), [](char c) { return c == 0; });
+    }
+
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid == 0) {
+        memset(data.data(), 'F', data.size());
+        _exit(pwrite(fds[0], data.data(), data.size(), 7 * kChunk) == 4096 ? 0 : 1);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    struct stat st;
+    memset(data.data(), 'F', data.size());
+    ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0 &&
+         pread(fds[0], back.data(), back.size(), 7 * kChunk) == 4096 && back == data &&
+         fstat(fds[0], &st) == 0 && st.st_blocks == (blkcnt_t)(2 * kChunk / 512);
+
+    char* m = static_cast<char*>(mmap(nullptr, 2 * kChunk, PROT_READ | PROT_WRITE, MAP_SHARED, fds[1], 0));
+    ok = ok && m != MAP_FAILED && m[kChunk + 100] == 'b' && m[0] == 0;
+    if (m != MAP_FAILED) {
+        memcpy(m, "mapped", 6);
+        ok = msync(m, 2 * kChunk, MS_SYNC) == 0 && munmap(m, 2 * kChunk) == 0 && ok;
+    }
+    ok = ok && pread(fds[1], back.data(), 6, 0) == 6 && memcmp(back.data(), "mapped", 6) == 0 &&
+         fstat(fds[1], &st) == 0 && st.st_blocks == (blkcnt_t)(2 * kChunk / 512);
+
+    // Receiving from a short file allocates chunks for the bytes read only
+    char real_path[] = "/tmp/fio-sparse-recv.XXXXXX";
+    int real = mkstemp(real_path);
+    int recv = open(fake_path("sparse-recv").c_str(), O_RDWR | O_CREAT, 0644);
+    off_t offset = 0;
+    ok = ok && real >= 0 && recv >= 0 && write(real, "short", 5) == 5 &&
+         sendfile(recv, real, &offset, 3 * kChunk) == 5 && offset == 5 &&
+         fstat(recv, &st) == 0 && st.st_blocks == (blkcnt_t)(kChunk / 512) &&
+         lseek(recv, 4 * kChunk, SEEK_SET) == (off_t)(4 * kChunk) && sendfile(recv, real, &offset, kChunk) == 0 &&
+         lseek(real, 0, SEEK_SET) == 0 && splice(real, nullptr, recv, nullptr, kChunk, 0) == 5 &&
+         fstat(recv, &st) == 0 && st.st_blocks == (blkcnt_t)(2 * kChunk / 512) &&
+         pread(recv, back.data(), 5, 4 * kChunk) == 5 && memcmp(back.data(), "short", 5) == 0;
+    close(recv);
+    unlink(fake_path("sparse-recv").c_str());
+    if (real >= 0) close(real);
+    unlink(real_path);
+
+    for (int i = 0; i < kFiles; i++) {
+        close(fds[i]);
+        unlink(fake_path("sparse-" + std::to_string(i)).c_str());
+    }
+    exit(ok ? 0 : 1);
+}
+
+void test_sparse() {
+    std::cout << "\n=== Sparse File Test ===" << std::endl;
+
+    Child child = run_child("sparse-child", {{"FIO_DAX_SPARSE", "1"}});
+    report("sparse files hold only the chunks written", child.exited());
+}
+
+// Runs in a re-executed child with a 1MB, 4-way DRAM cache. A 64KB
+// pattern is read back twice from the cache, then 4MB of unaligned writes
+// evict it; everything must read back, from a forked child with an empty
+// cache too, and after a close() and reopen.
+void cache_child() {
+    constexpr size_t kMB = 1 << 20;
+    std::vector<char> first(64 * 1024);
+    std::vector<char> second(4 * kMB);
+    std::vector<char> back(4 * kMB);
+    for (size_t i = 0; i < first.size(); i++) first[i] = static_cast<char>(i * 13 + 1);
+    for (size_t i = 0; i < second.size(); i++) second[i] = static_cast<char>(i * 7 + 5);
+
+    int fd = open(fake_path("cache").c_str(), O_RDWR | O_CREAT, 0644);
+    bool ok = fd >= 0 && pwrite(fd, first.data(), first.size(), 0) == (ssize_t)first.size();
+    for (int pass = 0; ok && pass < 2; pass++) {
+        ok = pread(fd, back.data(), first.size(), 0) == (ssize_t)first.size() &&
+             memcmp(back.data(), first.data(), first.size()) == 0;
+    }
+    for (size_t off = 0; ok && off < second.size(); off += 4196) {
+        size_t n = second.size() - off < 4196 ? second.size() - off : 4196;
+        ok = pwrite(fd, &second[off], n, kMB + off) == (ssize_t)n;
+    }
+    auto intact = [&](int f) {
+        return pread(f, back.data(), first.size(), 0) == (ssize_t)first.size() &&
+               memcmp(back.data(), first.data(), first.size()) == 0 &&
+               pread(f, back.data(), second.size(), kMB) == (ssize_t)second.size() && back == second;
+    };
+    ok = ok && intact(fd);
+
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid == 0) _exit(intact(fd) ? 0 : 1);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+
+    memcpy(first.data(), "synced", 6);
+    ok = ok && pwrite(fd, "synced", 6, 0) == 6 && fsync(fd) == 0;
+    close(fd);
+    fd = open(fake_path("cache").c_str(), O_RDWR);
+    ok = ok && fd >= 0 && intact(fd);
+    close(fd);
+    unlink(fake_path("cache").c_str());
+    exit(ok ? 0 : 1);
+}
+
+void test_cache() {
+    std::cout << "\n=== DRAM Cache Test ===" << std::endl;
+
+    const char* stats = "/tmp/fio_cache_stats.%p.json";
+    Child child = run_child("cache-child", {{"FIO_DAX_CACHE", "1M"},
+                                            {"FIO_DAX_CACHE_WAYS", "4"},
+                                            {"FIO_CACHE_STATS_FILE", stats}});
+    std::string path = child.path(stats);
+    report("cached writes read back after eviction, fork and reopen", child.exited());
+    report("re-reads hit the cache", read_stats(path, "hits") >= 32);
+    report("evicted dirty pages are written back", read_stats(path, "evictions") > 0 &&
+                                                   read_stats(path, "writebacks") > 0);
+    unlink(path.c_str());
+}
+
+// The fio engine's placement, copies and completion ring, over two scratch
+// regions of their own: a 32MB one on node 0 and a 96MB one on node 1
+void test_engine() {
+    std::cout << "\n=== fio Engine Core Test ===" << std::endl;
+
+    using cxl_intercept::EngineCompletions;
+    using cxl_intercept::EngineFile;
+    using Clock = std::chrono::steady_clock;
+
+    // Completions: reap without waiting, time out, and wake on a completion
+    EngineCompletions<int> done(4);
+    std::vector<int*> out;
+    int units[4] = {0, 1, 2, 3};
+    report("reap with min 0 returns at once", done.reap(out, 0, 4, nullptr) == 0);
+    struct timespec timeout = {0, 20 * 1000 * 1000};
+    auto start = Clock::now();
+    size_t got = done.reap(out, 1, 4, &timeout);
+    auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+    report("reap times out with nothing completed", got == 0 && waited >= 15);
+
+    done.complete(&units[0]);
+    done.complete(&units[1]);
+    done.complete(&units[2]);
+    bool ok = done.reap(out, 1, 2, nullptr) == 2 && out[0] == &units[0] && out[1] == &units[1];
+    out.clear();
+    ok = ok && done.reap(out, 1, 4, nullptr) == 1 && out[0] == &units[2];
+    report("reap stops at max and keeps the rest in order", ok);
+
+    out.clear();
+    std::thread worker([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        done.complete(&units[3]);
+    });
+    got = done.reap(out, 1, 4, nullptr);
+    worker.join();
+    report("reap sleeps until a worker completes", got == 1 && out[0] == &units[3]);
+
+    out.clear();
+    timeout = {5, 0};
+    worker = std::thread([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        done.complete(&units[0]);
+    });
+    start = Clock::now();
+    got = done.reap(out, 1, 4, &timeout);
+    waited = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+    worker.join();
+    report("completion ends a timed wait early", got == 1 && waited < 1000);
+
+    // Placement
+    static constinit cxl_intercept::EpochDomain epoch;
+    auto* regions = new cxl_intercept::DaxRegion[2];
+    std::string paths[2];
+    const size_t sizes[2] = {32ULL << 20, 96ULL << 20};
+    cxl_ssd::PersistMode mode = cxl_ssd::eager_persist_mode(cxl_ssd::persist_mode_from_env());
+    int mapped = 0;
+    for (int i = 0; i < 2; i++) {
+        char path[] = "/tmp/fio_engine_region.XXXXXX";
+        int rfd = mkstemp(path);
+        paths[i] = path;
+        if (rfd < 0 || ftruncate(rfd, sizes[i]) != 0) break;
+        ::close(rfd);
+        cxl_intercept::DaxRegionSpec spec;
+        spec.path = path;
+        spec.node = i;
+        if (!regions[i].map(spec, &epoch)) break;
+        if (!regions[i].attach_catalog(mode, true)) {
+            regions[i].unmap();
+            break;
+        }
+        mapped++;
+    }
+    report("scratch regions map", mapped == 2);
+
+    if (mapped == 2) {
+        EngineFile* near = cxl_intercept::engine_place_file(regions, 2, 1, "/engine/near", 4 << 20);
+        EngineFile* local = cxl_intercept::engine_place_file(regions, 2, 0, "/engine/local", 4 << 20);
+        report("file lands on the job's node", near && near->region == &regions[1] && local &&
+                                               local->region == &regions[0] && local->size >= (4 << 20));
+        EngineFile* spill = cxl_intercept::engine_place_file(regions, 2, 0, "/engine/spill", 48ULL << 20);
+        report("full local region spills to the other node", spill && spill->region == &regions[1]);
+        errno = 0;
+        EngineFile* none = cxl_intercept::engine_place_file(regions, 2, 0, "/engine/huge", 1ULL << 30);
+        report("no room anywhere is ENOSPC", !none && errno == ENOSPC);
+
+        // A sparse file fio_intercept left behind has no contiguous extent
+        cxl_intercept::DaxExtent extent;
+        bool sparse = regions[0].catalog.acquire_extent("/engine/sparse", 4 << 20, true, extent, true) &&
+                      extent.chunk_map;
+        if (sparse) regions[0].catalog.release_extent(extent.ns_slot);
+        errno = 0;
+        EngineFile* rejected = cxl_intercept::engine_place_file(regions, 2, 0, "/engine/sparse", 4 << 20);
+        report("sparse file is rejected", sparse && !rejected && errno == EOPNOTSUPP);
+
+        // Copies round-trip and stay inside the file
+        std::vector<char> pattern(64 * 1024), back(pattern.size());
+        for (size_t i = 0; i < pattern.size(); i++) pattern[i] = static_cast<char>(i * 11 + 3);
+        ok = local && cxl_intercept::engine_copy(epoch, local, false, 4096, pattern.data(), pattern.size(), mode) == 0 &&
+             cxl_intercept::engine_copy(epoch, local, true, 4096, back.data(), back.size(), mode) == 0 &&
+             back == pattern;
+        report("engine copy round-trips", ok);
+        ok = local && cxl_intercept::engine_copy(epoch, local, true, local->size - 8, back.data(), 16, mode) == EINVAL &&
+             cxl_intercept::engine_copy(epoch, local, false, local->size + 1, back.data(), 0, mode) == EINVAL &&
+             cxl_intercept::engine_copy(epoch, nullptr, true, 0, back.data(), 16, mode) == EINVAL &&
+             cxl_intercept::engine_copy(epoch, local, true, local->size, back.data(), 0, mode) == 0;
+        report("engine copy rejects ranges past the file", ok);
+
+        for (EngineFile* file : {near, local, spill}) {
+            if (file) cxl_intercept::engine_release_file(file);
+        }
+    }
+    for (int i = 0; i < mapped; i++) regions[i].unmap();
+    delete[] regions;
+    for (const std::string& path : paths) {
+        if (!path.empty()) unlink(path.c_str());
+    }
+}
+
+} // anonymous namespace
+
+int main(int argc, char* argv[]) {
+    std::string test_type = (argc > 2 && std::string(argv[1]) == "--test") ? argv[2] : "all";
+
+    if (!getenv("FIO_INTERCEPT_ENABLE")) {
+        // Two regions, claimed to sit on nodes 0 and 1
+        std::string regions[2];
+        for (std::string& region : regions) {
+            char path[] = "/tmp/fio_intercept_region.XXXXXX";
+            int rfd = mkstemp(path);
+            if (rfd < 0 || ftruncate(rfd, kRegionSize) != 0) {
+                std::cerr << "Failed to create backing region" << std::endl;
+                return 1;
+            }
+            ::close(rfd);
+            region = path;
+        }
+
+        setenv("FIO_INTERCEPT_ENABLE", "1", 1);
+        setenv("FIO_DAX_DEVICES", (regions[0] + "@0," + regions[1] + "@1").c_str(), 1);
+        setenv("FIO_NUMA_PLACEMENT", "numa-near=0,numa-far=1", 1);
+        setenv("FIO_FILE_SIZE", std::to_string(kFileSize).c_str(), 1);
+        setenv("FIO_DAX_METADATA", "/tmp/fio_dax_meta.%p.json", 1);
+        setenv("FIO_TEST_REGION", (regions[0] + "," + regions[1]).c_str(), 1);
+        execv("/proc/self/exe", argv);
+        std::cerr << "Failed to re-exec: " << strerror(errno) << std::endl;
+        return 1;
+    }
+
+    if (test_type == "latency-child") {
+        latency_child();
+        return 0;
+    }
+
+    if (test_type == "timing-child") {
+        timing_child();
+    }
+
+    if (test_type == "trace-child") {
+        trace_child();
+        return 0;
+    }
+
+    if (test_type == "windows-child") {
+        windows_child();
+    }
+
+    if (test_type == "write-combine-child") {
+        write_combine_child();
+    }
+
+    if (test_type == "prefetch-child") {
+        prefetch_child();
+    }
+
+    if (test_type == "verify-child") {
+        verify_child();
+    }
+
+    if (test_type == "thin-child") {
+        thin_child();
+    }
+
+    if (test_type == "qos-child") {
+        qos_child();
+    }
+
+    if (test_type == "wal-child") {
+        wal_child();
+    }
+
+    if (test_type == "sparse-child") {
+        sparse_child();
+    }
+
+    if (test_type == "cache-child") {
+        cache_child();
+    }
+
+    if (test_type == "basic" || test_type == "all") {
+        test_basic();
+    }
+
+    if (test_type == "threads" || test_type == "all") {
+        test_threads();
+    }
+
+    if (test_type == "vectored" || test_type == "all") {
+        test_vectored();
+    }
+
+    if (test_type == "mmap" || test_type == "all") {
+        test_mmap();
+    }
+
+    if (test_type == "aio" || test_type == "all") {
+        test_aio();
+    }
+
+    if (test_type == "lazy" || test_type == "all") {
+        test_lazy();
+    }
+
+    if (test_type == "catalog" || test_type == "all") {
+        test_catalog();
+    }
+
+    if (test_type == "numa" || test_type == "all") {
+        test_numa();
+    }
+
+    if (test_type == "namespace" || test_type == "all") {
+        test_namespace();
+    }
+
+    if (test_type == "latency" || test_type == "all") {
+        test_latency();
+    }
+
+    if (test_type == "timing" || test_type == "all") {
+        test_timing();
+    }
+
+    if (test_type == "trace" || test_type == "all") {
+        test_trace();
+    }
+
+    if (test_type == "windows" || test_type == "all") {
+        test_windows();
+    }
+
+    if (test_type == "write-combine" || test_type == "all") {
+        test_write_combine();
+    }
+
+    if (test_type == "prefetch" || test_type == "all") {
+        test_prefetch();
+    }
+
+    if (test_type == "verify" || test_type == "all") {
+        test_verify();
+    }
+
+    if (test_type == "thin" || test_type == "all") {
+        test_thin();
+    }
+
+    if (test_type == "qos" || test_type == "all") {
+        test_qos();
+    }
+
+    if (test_type == "wal" || test_type == "all") {
+        test_wal();
+    }
+
+    if (test_type == "copy" || test_type == "all") {
+        test_copy();
+    }
+
+    if (test_type == "sparse" || test_type == "all") {
+        test_sparse();
+    }
+
+    if (test_type == "cache" || test_type == "all") {
+        test_cache();
+    }
+
+    if (test_type == "engine" || test_type == "all") {
+        test_engine();
+    }
+
+    if (const char* regions = getenv("FIO_TEST_REGION")) {
+        for (const auto& spec : cxl_intercept::parse_region_list(regions)) unlink(spec.path.c_str());
+    }
+
+    std::cout << "\n" << (failures ? "Some tests FAILED" : "All tests completed!") << std::endl;
+    return failures ? 1 : 0;
+}
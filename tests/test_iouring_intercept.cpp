@@ -0,0 +1,249 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <fcntl.h>
+#include <sched.h>
+#include <unistd.h>
+
+// Exercises libiouring_intercept.so. The test links against the library, so
+// its open/close and io_uring calls are interposed; the constructor reads
+// the environment at load time, so main() sets it up and re-executes itself.
+
+// io_uring entry points and the ring ABI of the intercept library
+extern "C" {
+struct io_uring {
+    void* ctx;
+};
+struct io_uring_sqe {
+    uint8_t opcode;
+    uint8_t flags;
+    uint16_t ioprio;
+    int32_t fd;
+    uint64_t off;
+    uint64_t addr;
+    uint32_t len;
+    uint32_t rw_flags;
+    uint64_t user_data;
+};
+struct io_uring_cqe {
+    uint64_t user_data;
+    int32_t res;
+    uint32_t flags;
+};
+int io_uring_queue_init(unsigned entries, struct io_uring* ring, unsigned flags);
+void io_uring_queue_exit(struct io_uring* ring);
+struct io_uring_sqe* io_uring_get_sqe(struct io_uring* ring);
+void io_uring_prep_read(struct io_uring_sqe* sqe, int fd, void* buf, unsigned nbytes, off_t offset);
+void io_uring_prep_write(struct io_uring_sqe* sqe, int fd, const void* buf, unsigned nbytes, off_t offset);
+int io_uring_submit(struct io_uring* ring);
+int io_uring_peek_cqe(struct io_uring* ring, struct io_uring_cqe** cqe_ptr);
+int io_uring_wait_cqe(struct io_uring* ring, struct io_uring_cqe** cqe_ptr);
+void io_uring_cqe_seen(struct io_uring* ring, struct io_uring_cqe* cqe);
+int io_uring_submit_and_wait(struct io_uring* ring, unsigned wait_nr);
+}
+
+namespace {
+
+constexpr size_t kRegionSize = 64ULL << 20;  // backing file of the DAX region
+constexpr size_t kFileSize = 4ULL << 20;     // FIO_FILE_SIZE per fake file
+constexpr unsigned kBlock = 4096;
+
+int failures = 0;
+
+void report(const std::string& name, bool ok) {
+    std::cout << name << ": " << (ok ? "PASSED" : "FAILED") << std::endl;
+    if (!ok) failures++;
+}
+
+std::string fake_path(const std::string& name) {
+    return "/tmp/fio-iouring-test." + name;
+}
+
+// Reap one CQE; false if it is not (user_data, res)
+bool reap(io_uring* ring, uint64_t user_data, int32_t res) {
+    io_uring_cqe* cqe = nullptr;
+    if (io_uring_wait_cqe(ring, &cqe) != 0 || !cqe) return false;
+    bool ok = cqe->user_data == user_data && cqe->res == res;
+    io_uring_cqe_seen(ring, cqe);
+    return ok;
+}
+
+void test_init() {
+    std::cout << "\n=== Ring Setup Test ===" << std::endl;
+
+    io_uring ring{};
+    report("queue_init rejects 0 entries", io_uring_queue_init(0, &ring, 0) == -EINVAL);
+    report("queue_init rejects too many entries", io_uring_queue_init(32769, &ring, 0) == -EINVAL);
+    report("queue_init rejects NULL ring", io_uring_queue_init(8, nullptr, 0) == -EINVAL);
+
+    io_uring_cqe* cqe = nullptr;
+    report("zeroed ring is unknown", io_uring_submit(&ring) == -EINVAL && !io_uring_get_sqe(&ring) &&
+                                     io_uring_peek_cqe(&ring, &cqe) == -EINVAL &&
+                                     io_uring_wait_cqe(&ring, &cqe) == -EINVAL);
+
+    // A ring liburing set up itself holds sq.khead in its first word
+    alignas(64) static uint32_t khead[16];
+    io_uring foreign{khead};
+    report("foreign ring is unknown", io_uring_submit(&foreign) == -EINVAL &&
+                                      io_uring_peek_cqe(&foreign, &cqe) == -EINVAL);
+
+    report("queue_init", io_uring_queue_init(8, &ring, 0) == 0);
+    report("submit with nothing pending", io_uring_submit(&ring) == 0);
+    report("peek on empty CQ", io_uring_peek_cqe(&ring, &cqe) == -EAGAIN);
+    io_uring_queue_exit(&ring);
+    report("exited ring is unknown", io_uring_submit(&ring) == -EINVAL && !io_uring_get_sqe(&ring));
+}
+
+void test_dax() {
+    std::cout << "\n=== DAX Read/Write Test ===" << std::endl;
+
+    int fd = open(fake_path("dax").c_str(), O_RDWR | O_CREAT, 0644);
+    report("open returns fake fd", fd >= 20000);
+
+    io_uring ring{};
+    io_uring_queue_init(8, &ring, 0);
+    std::vector<char> out(4 * kBlock), in(4 * kBlock);
+    for (size_t i = 0; i < out.size(); i++) out[i] = static_cast<char>('a' + i % 26);
+
+    for (unsigned i = 0; i < 4; i++) {
+        io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+        io_uring_prep_write(sqe, fd, out.data() + i * kBlock, kBlock, i * kBlock);
+        sqe->user_data = i;
+    }
+    report("submit writes", io_uring_submit(&ring) == 4);
+    bool ok = true;
+    for (unsigned i = 0; i < 4; i++) ok &= reap(&ring, i, kBlock);
+    report("write CQEs in order", ok);
+
+    io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+    io_uring_prep_read(sqe, fd, in.data(), in.size(), 0);
+    sqe->user_data = 42;
+    report("submit_and_wait", io_uring_submit_and_wait(&ring, 1) == 1);
+    report("read back", reap(&ring, 42, (int32_t)in.size()) && in == out);
+
+    sqe = io_uring_get_sqe(&ring);
+    io_uring_prep_read(sqe, fd, in.data(), in.size(), kFileSize - 8);
+    sqe->user_data = 43;
+    io_uring_submit(&ring);
+    report("read clamps at end", reap(&ring, 43, 8));
+
+    sqe = io_uring_get_sqe(&ring);
+    sqe->opcode = 0;  // IORING_OP_NOP is not emulated
+    sqe->fd = fd;
+    sqe->user_data = 44;
+    io_uring_submit(&ring);
+    report("unsupported opcode", reap(&ring, 44, -EOPNOTSUPP));
+
+    report("close", close(fd) == 0);
+    sqe = io_uring_get_sqe(&ring);
+    io_uring_prep_read(sqe, fd, in.data(), kBlock, 0);
+    sqe->user_data = 45;
+    io_uring_submit(&ring);
+    report("read after close fails", reap(&ring, 45, -EBADF));
+
+    // Descriptors outside the fake range go to libc
+    char path[] = "/tmp/iouring_passthrough.XXXXXX";
+    int real_fd = mkstemp(path);
+    sqe = io_uring_get_sqe(&ring);
+    io_uring_prep_write(sqe, real_fd, out.data(), kBlock, 0);
+    sqe->user_data = 46;
+    io_uring_submit(&ring);
+    report("real fd passes through", reap(&ring, 46, kBlock) && pread(real_fd, in.data(), kBlock, 0) == kBlock &&
+                                     memcmp(in.data(), out.data(), kBlock) == 0);
+    close(real_fd);
+    unlink(path);
+    io_uring_queue_exit(&ring);
+}
+
+void test_full_rings() {
+    std::cout << "\n=== Full SQ and CQ Test ===" << std::endl;
+
+    int fd = open(fake_path("full").c_str(), O_RDWR | O_CREAT, 0644);
+    io_uring ring{};
+    io_uring_queue_init(4, &ring, 0);
+    std::vector<char> buf(kBlock);
+
+    // The SQ holds 4 entries; get_sqe hands out no more until they run
+    unsigned handed = 0;
+    while (handed < 8 && io_uring_get_sqe(&ring)) handed++;
+    report("get_sqe stops at a full SQ", handed == 4);
+    report("submit the full SQ", io_uring_submit(&ring) == 4);
+    bool ok = true;
+    for (unsigned i = 0; i < 4; i++) ok &= reap(&ring, 0, -EOPNOTSUPP);
+    report("full SQ completes", ok);
+
+    // Queue three SQs' worth without reaping: the CQ (twice the SQ) fills,
+    // the worker stalls, and nothing is lost once completions are reaped
+    const unsigned total = 12;
+    unsigned queued = 0;
+    while (queued < total) {
+        io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+        if (!sqe) {
+            io_uring_submit(&ring);
+            sched_yield();
+            continue;
+        }
+        io_uring_prep_read(sqe, fd, buf.data(), kBlock, (off_t)queued * kBlock);
+        sqe->user_data = 100 + queued++;
+    }
+    io_uring_submit(&ring);
+    // SQ and CQ together hold all 12: the SQ stays full behind the CQ
+    report("get_sqe fails while the CQ is full", io_uring_get_sqe(&ring) == nullptr);
+    io_uring_cqe* cqe = nullptr;
+    ok = true;
+    for (unsigned i = 0; i < total; i++) ok &= reap(&ring, 100 + i, kBlock);
+    report("CQ overflow keeps every completion in order", ok);
+    report("CQ drained", io_uring_peek_cqe(&ring, &cqe) == -EAGAIN);
+
+    io_uring_queue_exit(&ring);
+    close(fd);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string test_type = (argc > 2 && std::string(argv[1]) == "--test") ? argv[2] : "all";
+
+    if (!getenv("IOURING_INTERCEPT_ENABLE")) {
+        char path[] = "/tmp/iouring_intercept_region.XXXXXX";
+        int rfd = mkstemp(path);
+        if (rfd < 0 || ftruncate(rfd, kRegionSize) != 0) {
+            std::cerr << "Failed to create backing region" << std::endl;
+            return 1;
+        }
+        ::close(rfd);
+
+        setenv("IOURING_INTERCEPT_ENABLE", "1", 1);
+        setenv("FIO_DAX_DEVICE", path, 1);
+        setenv("FIO_DAX_SIZE", std::to_string(kRegionSize).c_str(), 1);
+        setenv("FIO_FILE_SIZE", std::to_string(kFileSize).c_str(), 1);
+        setenv("IOURING_TEST_REGION", path, 1);
+        execv("/proc/self/exe", argv);
+        std::cerr << "Failed to re-exec: " << strerror(errno) << std::endl;
+        return 1;
+    }
+
+    if (test_type == "init" || test_type == "all") {
+        test_init();
+    }
+
+    if (test_type == "dax" || test_type == "all") {
+        test_dax();
+    }
+
+    if (test_type == "full" || test_type == "all") {
+        test_full_rings();
+    }
+
+    if (const char* region = getenv("IOURING_TEST_REGION")) unlink(region);
+
+    if (failures) {
+        std::cout << "\n" << failures << " test(s) FAILED" << std::endl;
+        return 1;
+    }
+    std::cout << "\nAll tests completed!" << std::endl;
+    return 0;
+}
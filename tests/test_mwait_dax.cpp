@@ -24,6 +24,14 @@ public:
         return device.init(dax_path);
     }
 
+    void set_persist_mode(cxl_ssd::PersistMode mode) {
+        device.set_persist_mode(mode);
+    }
+
+    const char* persist_mode_name() const {
+        return cxl_ssd::persist_mode_name(device.get_persist_mode());
+    }
+
     void test_basic_operations() {
         std::cout << "\n=== Basic DAX Operations Test ===" << std::endl;
 
@@ -222,9 +230,10 @@ public:
 
 int main(int argc, char* argv[]) {
     if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " <mem_device_path> [test_type]" << std::endl;
+        std::cerr << "Usage: " << argv[0] << " <mem_device_path> [test_type] [persist_mode]" << std::endl;
         std::cerr << "  mem_device_path: e.g., /dev/mem with offset 0x100000000" << std::endl;
         std::cerr << "  test_type: basic, byte, mwait, throughput, latency, all (default: all)" << std::endl;
+        std::cerr << "  persist_mode: clflushopt, clwb, nt, none, clflush, lazy (default: $FIO_DAX_PERSIST or clflushopt)" << std::endl;
         return 1;
     }
 
@@ -238,7 +247,17 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
+    if (argc > 3) {
+        cxl_ssd::PersistMode mode;
+        if (!cxl_ssd::parse_persist_mode(argv[3], mode)) {
+            std::cerr << "Unknown persist mode: " << argv[3] << std::endl;
+            return 1;
+        }
+        tester.set_persist_mode(mode);
+    }
+
     std::cout << "DAX device initialized: " << dax_path << std::endl;
+    std::cout << "Persistence mode: " << tester.persist_mode_name() << std::endl;
 
     if (test_type == "basic" || test_type == "all") {
         tester.test_basic_operations();